@@ -0,0 +1,200 @@
+/** $lic$
+ * Copyright (C) 2012-2014 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bbl_trace.h"
+#include <stddef.h>
+#include <string.h>
+#include "core.h"
+#include "decoder.h"
+#include "galloc.h"
+#include "log.h"
+
+#define TRACE_BUF_BYTES (1 << 20)
+
+static uint32_t bblInfoBytes(const BblInfo* bblInfo, bool oooDecode) {
+    return oooDecode? offsetof(BblInfo, oooBbl) + DynBbl::bytes(bblInfo->oooBbl[0].uops) : sizeof(BblInfo);
+}
+
+/* TraceWriter */
+
+TraceWriter::TraceWriter(const char* filename, bool _oooDecode)
+    : oooDecode(_oooDecode), prevBblAddr(0), prevMemAddr(0), records(0)
+{
+    f = fopen(filename, "w");
+    if (!f) panic("Could not open trace file %s for writing", filename);
+    setvbuf(f, NULL, _IOFBF, TRACE_BUF_BYTES);
+    TraceHeader hdr = {TRACE_MAGIC, TRACE_VERSION, (uint16_t)oooDecode};
+    fwrite(&hdr, sizeof(hdr), 1, f);
+}
+
+TraceWriter::~TraceWriter() {
+    close();
+}
+
+void TraceWriter::bbl(uint64_t bblAddr, const BblInfo* bblInfo) {
+    if (!f) return;
+    auto it = bblIds.find(bblInfo);
+    uint32_t id;
+    if (it == bblIds.end()) {
+        id = bblIds.size();
+        bblIds[bblInfo] = id;
+        uint32_t bytes = bblInfoBytes(bblInfo, oooDecode);
+        putTag(TR_BBLDEF, false);
+        putVarint(id);
+        putVarint(bytes);
+        fwrite(bblInfo, bytes, 1, f);
+    } else {
+        id = it->second;
+    }
+
+    putTag(TR_BBL, false);
+    putVarint(id);
+    putDelta(bblAddr, prevBblAddr);
+    prevBblAddr = bblAddr;
+    records++;
+}
+
+void TraceWriter::branch(uint64_t pc, bool taken, uint64_t takenNpc, uint64_t notTakenNpc) {
+    if (!f) return;
+    putTag(TR_BRANCH, taken);
+    putDelta(pc, prevBblAddr);
+    putDelta(takenNpc, pc);
+    putDelta(notTakenNpc, pc);
+    records++;
+}
+
+void TraceWriter::flush() {
+    if (f) fflush(f);
+}
+
+void TraceWriter::close() {
+    if (!f) return;
+    putTag(TR_END, false);
+    fclose(f);
+    f = NULL;
+}
+
+/* TraceReader */
+
+TraceReader::TraceReader(const char* _filename, bool oooDecode)
+    : filename(_filename), prevBblAddr(0), prevMemAddr(0), records(0), done(false)
+{
+    f = fopen(filename, "r");
+    if (!f) panic("Could not open trace file %s", filename);
+    setvbuf(f, NULL, _IOFBF, TRACE_BUF_BYTES);
+
+    TraceHeader hdr;
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 || hdr.magic != TRACE_MAGIC) panic("%s is not a zsim trace", filename);
+    if (hdr.version != TRACE_VERSION) panic("Trace %s has version %d, expected %d", filename, hdr.version, TRACE_VERSION);
+    if (oooDecode && !hdr.oooDecode) panic("Trace %s was recorded without OOO decoding, but the simulated cores need it", filename);
+    // The converse is fine: we just ignore the decoded uops
+}
+
+TraceReader::~TraceReader() {
+    if (f) fclose(f);
+}
+
+void TraceReader::truncated() {
+    if (!done) warn("Trace %s is truncated after %ld records, ending replay", filename, records);
+    done = true;
+}
+
+uint64_t TraceReader::getVarint() {
+    uint64_t v = 0;
+    uint32_t shift = 0;
+    while (true) {
+        int c = getc_unlocked(f);
+        if (unlikely(c == EOF)) {
+            truncated();
+            return 0;
+        }
+        v |= ((uint64_t)(c & 0x7f)) << shift;
+        if (!(c & 0x80)) return v;
+        shift += 7;
+    }
+}
+
+void TraceReader::readBblDef() {
+    uint32_t id = getVarint();
+    uint32_t bytes = getVarint();
+    if (done) return;
+    if (id != bbls.size()) panic("Trace %s: out-of-order BBL definition %d (expected %ld)", filename, id, bbls.size());
+
+    BblInfo* bblInfo = static_cast<BblInfo*>(gm_malloc(bytes));
+    if (fread(bblInfo, bytes, 1, f) != 1) {
+        gm_free(bblInfo);
+        truncated();
+        return;
+    }
+    bbls.push_back(bblInfo);
+}
+
+bool TraceReader::next(TraceRecord& rec) {
+    while (!done) {
+        int c = getc_unlocked(f);
+        if (unlikely(c == EOF)) {
+            truncated();
+            break;
+        }
+
+        rec.type = (TraceRecordType)(c & 0xf);
+        rec.flag = c & 0x10;
+        switch (rec.type) {
+            case TR_BBLDEF:
+                readBblDef();
+                continue;
+            case TR_BBL:
+                {
+                    uint32_t id = getVarint();
+                    rec.addr = prevBblAddr = getDelta(prevBblAddr);
+                    if (done) break;
+                    if (id >= bbls.size()) panic("Trace %s: undefined BBL %d", filename, id);
+                    rec.bblInfo = bbls[id];
+                }
+                break;
+            case TR_LOAD:
+            case TR_STORE:
+            case TR_PRED_LOAD:
+            case TR_PRED_STORE:
+                rec.addr = prevMemAddr = getDelta(prevMemAddr);
+                break;
+            case TR_BRANCH:
+                rec.addr = getDelta(prevBblAddr);
+                rec.takenNpc = getDelta(rec.addr);
+                rec.notTakenNpc = getDelta(rec.addr);
+                break;
+            case TR_END:
+                done = true;
+                break;
+            default:
+                panic("Trace %s: invalid record tag 0x%x after %ld records", filename, c, records);
+        }
+
+        if (done) break;
+        records++;
+        return true;
+    }
+    return false;
+}
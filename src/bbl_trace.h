@@ -0,0 +1,176 @@
+/** $lic$
+ * Copyright (C) 2012-2014 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BBL_TRACE_H_
+#define BBL_TRACE_H_
+
+/* Binary traces of the analysis callback stream of a simulated thread.
+ *
+ * A trace captures exactly what a core sees: basic blocks (with their decoded
+ * BblInfo), loads, stores, predicated loads/stores and conditional branches,
+ * in program order. Replaying a trace through a core's InstrFuncPtrs drives
+ * the same timing models that execution-driven simulation does, without
+ * needing the original binary or its inputs. Replay happens inside the Pin
+ * tool, driven by a trivial host program (see ReplayBasicBlock in zsim.cpp).
+ *
+ * Format: a TraceHeader, followed by records. Each record starts with a tag
+ * byte; the low 4 bits are the record type, and bit 4 is the taken/pred flag
+ * for branches and predicated memops. Integers are LEB128 varints, and
+ * addresses are zigzag-encoded deltas, which keeps most records at 2-4 bytes:
+ *   TR_BBLDEF  id, size, BblInfo bytes (first time a BBL shows up in the trace)
+ *   TR_BBL     id, bblAddr - prevBblAddr
+ *   TR_LOAD/TR_STORE/TR_PRED_LOAD/TR_PRED_STORE  addr - prevMemAddr
+ *   TR_BRANCH  pc - bblAddr, takenNpc - pc, notTakenNpc - pc
+ *   TR_END
+ * BBL definitions are raw copies of the BblInfo, including the decoded uops
+ * when the tracing run used OOO decoding, so traces are only portable across
+ * builds with the same decoder (TRACE_VERSION).
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <unordered_map>
+#include <vector>
+
+struct BblInfo;
+
+#define TRACE_MAGIC 0x7a747263u  // "ztrc"
+#define TRACE_VERSION 1
+
+enum TraceRecordType {
+    TR_BBLDEF,
+    TR_BBL,
+    TR_LOAD,
+    TR_STORE,
+    TR_PRED_LOAD,
+    TR_PRED_STORE,
+    TR_BRANCH,
+    TR_END
+};
+
+struct TraceHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t oooDecode;
+};
+
+struct TraceRecord {
+    TraceRecordType type;
+    bool flag;  // taken for branches, pred for predicated memops
+    uint64_t addr;  // bblAddr, memop addr, or branch pc
+    uint64_t takenNpc;
+    uint64_t notTakenNpc;
+    BblInfo* bblInfo;
+};
+
+// Process-local; one writer per thread
+class TraceWriter {
+    private:
+        FILE* f;
+        const bool oooDecode;
+        std::unordered_map<const BblInfo*, uint32_t> bblIds;
+        uint64_t prevBblAddr;
+        uint64_t prevMemAddr;
+        uint64_t records;
+
+    public:
+        TraceWriter(const char* filename, bool _oooDecode);
+        ~TraceWriter();
+
+        void bbl(uint64_t bblAddr, const BblInfo* bblInfo);
+        void branch(uint64_t pc, bool taken, uint64_t takenNpc, uint64_t notTakenNpc);
+
+        inline void load(uint64_t addr) { memop(TR_LOAD, false, addr); }
+        inline void store(uint64_t addr) { memop(TR_STORE, false, addr); }
+        inline void predLoad(uint64_t addr, bool pred) { memop(TR_PRED_LOAD, pred, addr); }
+        inline void predStore(uint64_t addr, bool pred) { memop(TR_PRED_STORE, pred, addr); }
+
+        // Flushes buffered records without ending the trace
+        void flush();
+        // Writes TR_END and closes the file; further records are dropped
+        void close();
+
+        uint64_t getRecords() const { return records; }
+
+    private:
+        inline void putTag(TraceRecordType type, bool flag) {
+            putc_unlocked(type | (flag? 0x10 : 0), f);
+        }
+
+        inline void putVarint(uint64_t v) {
+            while (v >= 0x80) {
+                putc_unlocked((v & 0x7f) | 0x80, f);
+                v >>= 7;
+            }
+            putc_unlocked(v, f);
+        }
+
+        inline void putDelta(uint64_t cur, uint64_t prev) {
+            int64_t d = (int64_t)(cur - prev);
+            putVarint((d << 1) ^ (d >> 63));
+        }
+
+        inline void memop(TraceRecordType type, bool flag, uint64_t addr) {
+            if (!f) return;
+            putTag(type, flag);
+            putDelta(addr, prevMemAddr);
+            prevMemAddr = addr;
+            records++;
+        }
+};
+
+// Process-local; BblInfos are copied to the global heap, since cores may keep pointers to them
+class TraceReader {
+    private:
+        FILE* f;
+        const char* filename;
+        std::vector<BblInfo*> bbls;
+        uint64_t prevBblAddr;
+        uint64_t prevMemAddr;
+        uint64_t records;
+        bool done;
+
+    public:
+        TraceReader(const char* _filename, bool oooDecode);
+        ~TraceReader();
+
+        // Returns false at the end of the trace (TR_END or a truncated file)
+        bool next(TraceRecord& rec);
+
+        uint64_t getRecords() const { return records; }
+
+    private:
+        uint64_t getVarint();
+
+        inline uint64_t getDelta(uint64_t prev) {
+            uint64_t z = getVarint();
+            return prev + (uint64_t)((int64_t)(z >> 1) ^ -(int64_t)(z & 1));
+        }
+
+        void readBblDef();
+        void truncated();
+};
+
+#endif  // BBL_TRACE_H_
@@ -0,0 +1,230 @@
+/** $lic$
+ * Copyright (C) 2012-2014 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Standalone branch predictor benchmark. Reads the conditional branches of
+ * one or more BBL traces (see bbl_trace.h, recorded with processN.recordTrace)
+ * and runs them through each predictor in branch_pred.h, reporting accuracy
+ * and predictor throughput. Traces are parsed here rather than through
+ * TraceReader so that this does not depend on Pin or the decoder. Without
+ * traces, it uses synthetic branch streams.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include "bbl_trace.h"
+#include "branch_pred.h"
+#include "log.h"
+#include "mtrand.h"
+
+struct BranchRecord {
+    Address pc;
+    bool taken;
+};
+
+struct BranchTrace {
+    std::vector<BranchRecord> branches;
+    uint64_t instrs;
+};
+
+static uint64_t GetVarint(FILE* f, const char* filename) {
+    uint64_t v = 0;
+    uint32_t shift = 0;
+    while (true) {
+        int c = getc_unlocked(f);
+        if (c == EOF) panic("%s: truncated trace", filename);
+        v |= ((uint64_t)(c & 0x7f)) << shift;
+        if (!(c & 0x80)) return v;
+        shift += 7;
+    }
+}
+
+static inline uint64_t GetDelta(FILE* f, const char* filename, uint64_t prev) {
+    uint64_t z = GetVarint(f, filename);
+    return prev + (uint64_t)((int64_t)(z >> 1) ^ -(int64_t)(z & 1));
+}
+
+static void ReadTrace(const char* filename, BranchTrace& trace) {
+    FILE* f = fopen(filename, "r");
+    if (!f) panic("Could not open trace file %s", filename);
+    setvbuf(f, NULL, _IOFBF, 1 << 20);
+
+    TraceHeader hdr;
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 || hdr.magic != TRACE_MAGIC) panic("%s is not a zsim trace", filename);
+    if (hdr.version != TRACE_VERSION) panic("Trace %s has version %d, expected %d", filename, hdr.version, TRACE_VERSION);
+
+    std::vector<uint32_t> bblInstrs;
+    std::vector<uint8_t> buf;
+    uint64_t prevBblAddr = 0;
+    bool done = false;
+    while (!done) {
+        int c = getc_unlocked(f);
+        if (c == EOF) {
+            warn("%s: truncated trace, using %ld branches", filename, trace.branches.size());
+            break;
+        }
+        switch ((TraceRecordType)(c & 0xf)) {
+            case TR_BBLDEF:
+                {
+                    uint32_t id = GetVarint(f, filename);
+                    uint32_t bytes = GetVarint(f, filename);
+                    if (id != bblInstrs.size() || bytes < sizeof(uint32_t)) panic("%s: bad BBL definition %d", filename, id);
+                    buf.resize(bytes);
+                    if (fread(&buf[0], bytes, 1, f) != 1) panic("%s: truncated trace", filename);
+                    uint32_t instrs;
+                    memcpy(&instrs, &buf[0], sizeof(instrs));  // BblInfo::instrs is the first field
+                    bblInstrs.push_back(instrs);
+                }
+                break;
+            case TR_BBL:
+                {
+                    uint32_t id = GetVarint(f, filename);
+                    if (id >= bblInstrs.size()) panic("%s: undefined BBL %d", filename, id);
+                    prevBblAddr = GetDelta(f, filename, prevBblAddr);
+                    trace.instrs += bblInstrs[id];
+                }
+                break;
+            case TR_LOAD:
+            case TR_STORE:
+            case TR_PRED_LOAD:
+            case TR_PRED_STORE:
+                GetVarint(f, filename);
+                break;
+            case TR_BRANCH:
+                {
+                    BranchRecord br;
+                    br.pc = GetDelta(f, filename, prevBblAddr);
+                    br.taken = c & 0x10;
+                    GetVarint(f, filename);  // takenNpc
+                    GetVarint(f, filename);  // notTakenNpc
+                    trace.branches.push_back(br);
+                }
+                break;
+            case TR_END:
+                done = true;
+                break;
+            default:
+                panic("%s: invalid record tag 0x%x", filename, c);
+        }
+    }
+    fclose(f);
+}
+
+/* Synthetic stream of 5M branches from 2000 static branches, visited in
+ * blocks of 20. Most follow short periodic patterns or are always taken, a
+ * few are loop exits with trip counts of 20-200, and randomPct% are random,
+ * which puts a floor of randomPct/2% on the mispredict rate. Assumes a
+ * branch every 7 instructions for MPKI.
+ */
+static void MakeSyntheticTrace(uint32_t randomPct, BranchTrace& trace) {
+    const uint32_t numBranches = 2000;
+    const uint32_t blockSize = 20;
+    MTRand rng(42);
+    std::vector<Address> pcs(numBranches);
+    std::vector<uint32_t> kinds(numBranches), trips(numBranches), iters(numBranches, 0);
+    for (uint32_t b = 0; b < numBranches; b++) {
+        pcs[b] = 0x400000 + 4*rng.randInt(1 << 20);
+        kinds[b] = (rng.randInt(99) < randomPct)? 9 : rng.randInt(8);
+        trips[b] = 20 + rng.randInt(180);
+    }
+
+    uint64_t count = 0;
+    while (trace.branches.size() < 5000000) {
+        uint32_t first = (count/blockSize*blockSize) % numBranches;
+        for (uint32_t i = 0; i < blockSize; i++, count++) {
+            uint32_t b = (first + i) % numBranches;
+            uint32_t k = kinds[b];
+            BranchRecord br;
+            br.pc = pcs[b];
+            if (k < 5) br.taken = count % (k + 2);  // periodic
+            else if (k < 8) br.taken = true;
+            else if (k == 8) br.taken = ++iters[b] % trips[b];  // loop
+            else br.taken = rng.randInt(1);
+            trace.branches.push_back(br);
+        }
+    }
+    trace.instrs = 7*trace.branches.size();
+}
+
+static double GetTime() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+template <typename BP>
+static void Run(const char* name, const BranchTrace& trace) {
+    // Predictors can be large, so keep them off the stack
+    BP* bp = new BP();
+    uint64_t mispredicts = 0;
+    double start = GetTime();
+    for (const BranchRecord& br : trace.branches) {
+        if (!bp->predict(br.pc, br.taken)) mispredicts++;
+    }
+    double secs = GetTime() - start;
+    delete bp;
+
+    uint64_t branches = trace.branches.size();
+    info("%-10s %5ld KB  mispredicts %10ld (%6.3f%%, %7.3f MPKI)  %6.2f ns/branch",
+            name, sizeof(BP)/1024, mispredicts, 100.0*mispredicts/branches,
+            trace.instrs? 1e3*mispredicts/trace.instrs : 0.0, 1e9*secs/branches);
+}
+
+// The predictors of OOOCoreT's parameter sets (ooo_core.h)
+static void RunAll(const BranchTrace& trace) {
+    Run<BranchPredictorPAg<11, 18, 14>>("PAg-11", trace);
+    Run<BranchPredictorPAg<12, 18, 15>>("PAg-12", trace);
+    Run<BranchPredictorPAg<12, 18, 16>>("PAg-16", trace);
+    Run<BranchPredictorTAGEDefault>("TAGE", trace);
+    Run<BranchPredictorTAGESCLDefault>("TAGE-SC-L", trace);
+}
+
+int main(int argc, char *argv[]) {
+    InitLog("[B] ");
+    if (argc < 2) {
+        info("No traces given (usage: %s <trace>...), using synthetic streams", argv[0]);
+        for (uint32_t randomPct : {0, 10, 30}) {
+            BranchTrace trace;
+            MakeSyntheticTrace(randomPct, trace);
+            info("synthetic, %d%% random branches: %ld conditional branches", randomPct, trace.branches.size());
+            RunAll(trace);
+        }
+        return 0;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        BranchTrace trace;
+        trace.instrs = 0;
+        ReadTrace(argv[i], trace);
+        if (trace.branches.empty()) {
+            warn("%s: no conditional branches", argv[i]);
+            continue;
+        }
+        info("%s: %ld instrs, %ld conditional branches", argv[i], trace.instrs, trace.branches.size());
+        RunAll(trace);
+    }
+    return 0;
+}
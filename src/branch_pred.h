@@ -0,0 +1,564 @@
+/** $lic$
+ * Copyright (C) 2012-2014 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BRANCH_PRED_H_
+#define BRANCH_PRED_H_
+
+/* Branch predictors for OOOCore. All predictors have the same interface, a single predict() call that both
+ * predicts and trains on the outcome, so they can be plugged into OOOCoreT's parameter sets (ooo_core.h) and
+ * benchmarked standalone on branch traces (bpbench.cpp).
+ */
+
+#include <algorithm>
+#include <emmintrin.h>
+#include <math.h>
+#include <stdint.h>
+#include "log.h"
+#include "memory_hierarchy.h"
+
+/* 2-level branch predictor:
+ *  - L1: Branch history shift registers (bshr): 2^NB entries, HB bits of history/entry, indexed by XOR'd PC
+ *  - L2: Pattern history table (pht): 2^LB entries, 2-bit sat counters, indexed by XOR'd bshr contents
+ *  NOTE: Assumes LB is in [NB, HB] range for XORing (e.g., HB = 18 and NB = 10, LB = 13 is OK)
+ */
+template<uint32_t NB, uint32_t HB, uint32_t LB>
+class BranchPredictorPAg {
+    private:
+        uint32_t bhsr[1 << NB];
+        uint8_t pht[1 << LB];
+
+    public:
+        BranchPredictorPAg() {
+            uint32_t numBhsrs = 1 << NB;
+            uint32_t phtSize = 1 << LB;
+
+            for (uint32_t i = 0; i < numBhsrs; i++) {
+                bhsr[i] = 0;
+            }
+            for (uint32_t i = 0; i < phtSize; i++) {
+                pht[i] = 1;  // weak non-taken
+            }
+
+            static_assert(LB <= HB, "Too many PHT entries");
+            static_assert(LB >= NB, "Too few PHT entries (you'll need more XOR'ing)");
+        }
+
+        // Predicts and updates; returns false if mispredicted
+        inline bool predict(Address branchPc, bool taken) {
+            uint32_t bhsrMask = (1 << NB) - 1;
+            uint32_t histMask = (1 << HB) - 1;
+            uint32_t phtMask  = (1 << LB) - 1;
+           
+            // Predict
+            // uint32_t bhsrIdx = ((uint32_t)( branchPc ^ (branchPc >> NB) ^ (branchPc >> 2*NB) )) & bhsrMask;
+            uint32_t bhsrIdx = ((uint32_t)( branchPc >> 1)) & bhsrMask;
+            uint32_t phtIdx = bhsr[bhsrIdx];
+
+            // Shift-XOR-mask to fit in PHT
+            phtIdx ^= (phtIdx & ~phtMask) >> (HB - LB); // take the [HB-1, LB] bits of bshr, XOR with [LB-1, ...] bits
+            phtIdx &= phtMask;
+            
+            // If uncommented, behaves like a global history predictor
+            // bhsrIdx = 0;
+            // phtIdx = (bhsr[bhsrIdx] ^ ((uint32_t)branchPc)) & phtMask;
+
+            bool pred = pht[phtIdx] > 1;
+
+            // info("BP Pred: 0x%lx bshr[%d]=%x taken=%d pht=%d pred=%d", branchPc, bhsrIdx, phtIdx, taken, pht[phtIdx], pred);
+
+            // Update
+            pht[phtIdx] = taken? (pred? 3 : (pht[phtIdx]+1)) : (pred? (pht[phtIdx]-1) : 0); //2-bit saturating counter
+            bhsr[bhsrIdx] = ((bhsr[bhsrIdx] << 1) & histMask ) | (taken? 1: 0); //we apply phtMask here, dependence is further away
+
+            // info("BP Update: newPht=%d newBshr=%x", pht[phtIdx], bhsr[bhsrIdx]);
+            return (taken == pred);
+        }
+};
+
+/* TAGE predictor (Seznec and Michaud, "A case for (partially) TAgged GEometric history length branch
+ * prediction", JILP 2006):
+ *  - Base: bimodal table of 2^LB 2-bit sat counters, indexed by PC
+ *  - NT tagged tables of 2^LT entries, indexed by PC hashed with global and path history. Table i uses the
+ *    i-th of NT geometrically increasing history lengths in [MINH, MAXH]. The hit with the longest history
+ *    provides the prediction, unless it was just allocated and the altpred has been doing better.
+ * Tagged entries are packed in 16 bits (TB-bit tag, 2-bit useful ctr, 3-bit sat ctr), so each table is a
+ * contiguous 2^(LT+1)-byte array, and a lookup touches one line per table. Histories are folded
+ * incrementally (circular shift registers), so predict() is O(NT) regardless of MAXH.
+ *
+ * This is on the bound-phase path of every conditional branch, so the per-table work (hashing, tag
+ * compares, and history folding) is done for all tables at once, one 16-bit SSE2 lane per table. This
+ * limits NT to 8, which is what most TAGE configs of this size use anyway.
+ *
+ * Even so, this costs ~20-35 ns per branch vs ~3-7 ns for PAg (bpbench). The cost is mostly the latency of
+ * the dependent hash-lookup-select-update chain: it barely changes with NT or table sizes, and branch-free
+ * updates were slower. At a conditional branch every ~7 instructions, expect bound-phase MIPS of OOO cores
+ * to drop by 5-10% (more with TAGE-SC-L, below), more than the few percent we'd like. TAGE is opt-in
+ * (branchPredictor = "TAGE" or "TAGE-SC-L") for that reason: use it when branch accuracy matters more than
+ * simulation speed.
+ */
+template<uint32_t LB, uint32_t NT, uint32_t LT, uint32_t TB, uint32_t MINH, uint32_t MAXH>
+class BranchPredictorTAGE {
+    private:
+        static const uint32_t LANES = 8;
+        static const uint32_t HSIZE = 1 << 11;  // global history buffer size (circular)
+        static const uint32_t HMASK = HSIZE - 1;
+        static const uint32_t U_SHIFT = 3;
+        static const uint32_t TAG_SHIFT = 5;
+        static const uint32_t U_RESET_PERIOD = 1 << 18;  // branches between graceful resets of useful ctrs
+
+        uint16_t tables[NT][1 << LT];
+        uint8_t base[1 << LB];
+
+        // Per-table (lane) history state: the global history folded to the index and tag widths
+        __m128i idxHist;  // LT bits
+        __m128i tagHist0;  // TB bits
+        __m128i tagHist1;  // TB-1 bits
+        // Per-table constants
+        __m128i idxOutBit, tagOutBit0, tagOutBit1;  // where the bit that leaves each history lands
+        __m128i pathMask;  // path history bits used by each table
+        __m128i pathMul;  // path history shift (as a multiplier)
+        __m128i pcMul;  // PC shift (as a high-half multiplier)
+        uint16_t histLen[LANES];
+
+        uint8_t ghist[HSIZE];
+        uint32_t ghistPtr;
+        uint32_t phist;
+
+        int32_t useAltOnNa;  // 4-bit signed, >= 0 means use altpred on weak, newly allocated entries
+        uint32_t uResetCountdown;
+        uint32_t rng;
+
+    public:
+        BranchPredictorTAGE() {
+            static_assert(NT >= 2 && NT <= LANES, "TAGE needs 2-8 tagged tables");
+            static_assert(TB >= 2 && TB + TAG_SHIFT <= 16, "Tag does not fit in a packed 16-bit entry");
+            static_assert(LT <= 15, "Tagged tables too large");
+            static_assert(MINH >= 1 && MINH < MAXH, "Invalid history lengths");
+            static_assert(MAXH < HSIZE, "MAXH too long for the global history buffer");
+
+            for (uint32_t i = 0; i < NT; i++) {
+                for (uint32_t j = 0; j < (1u << LT); j++) tables[i][j] = 3;  // tag 0, u 0, weak not-taken
+            }
+            for (uint32_t i = 0; i < (1u << LB); i++) base[i] = 1;  // weak not-taken
+            for (uint32_t i = 0; i < HSIZE; i++) ghist[i] = 0;
+
+            uint16_t idxOut[LANES], tagOut0[LANES], tagOut1[LANES], pm[LANES], pmul[LANES], pcm[LANES];
+            for (uint32_t i = 0; i < LANES; i++) {
+                uint32_t len = 0;
+                if (i < NT) {
+                    double ratio = ((double)MAXH)/((double)MINH);
+                    len = (uint32_t)(MINH*pow(ratio, ((double)i)/((double)(NT-1))) + 0.5);
+                }
+                histLen[i] = len;
+                idxOut[i] = len? 1 << (len % LT) : 0;
+                tagOut0[i] = len? 1 << (len % TB) : 0;
+                tagOut1[i] = len? 1 << (len % (TB - 1)) : 0;
+                pm[i] = (1 << std::min(len, 16u)) - 1;
+                pmul[i] = 1 << (i % 4);
+                pcm[i] = 1 << (16 - (LT - (i % LT)));  // mulhi by this is >> (LT - (i % LT))
+            }
+            idxOutBit = load(idxOut);
+            tagOutBit0 = load(tagOut0);
+            tagOutBit1 = load(tagOut1);
+            pathMask = load(pm);
+            pathMul = load(pmul);
+            pcMul = load(pcm);
+
+            idxHist = tagHist0 = tagHist1 = _mm_setzero_si128();
+            ghistPtr = 0;
+            phist = 0;
+            useAltOnNa = 0;
+            uResetCountdown = U_RESET_PERIOD;
+            rng = 0x2545f491;
+        }
+
+        // Predicts and updates; returns false if mispredicted
+        inline bool predict(Address branchPc, bool taken) {
+            uint32_t conf;
+            return predictAndTrain(branchPc, taken, conf) == taken;
+        }
+
+        /* Returns the prediction and how confident it is (conf: 0 low, 1 medium, 2 high, from the providing
+         * counter), and trains on the outcome. TAGE-SC-L builds on this (BranchPredictorTAGESCL).
+         */
+        inline bool predictAndTrain(Address branchPc, bool taken, uint32_t& conf) {
+            uint32_t pc = (uint32_t)branchPc;
+
+            // Hash indexes and tags of all tables
+            __m128i pcv = _mm_set1_epi16((int16_t)(pc ^ (pc >> 16)));
+            __m128i path = _mm_and_si128(_mm_set1_epi16((int16_t)phist), pathMask);
+            path = _mm_xor_si128(_mm_srli_epi16(path, LT), _mm_mullo_epi16(path, pathMul));
+            __m128i idxv = _mm_xor_si128(_mm_xor_si128(pcv, _mm_mulhi_epu16(pcv, pcMul)), _mm_xor_si128(idxHist, path));
+            idxv = _mm_and_si128(idxv, _mm_set1_epi16((1 << LT) - 1));
+            __m128i tagv = _mm_xor_si128(pcv, _mm_xor_si128(tagHist0, _mm_slli_epi16(tagHist1, 1)));
+            tagv = _mm_and_si128(tagv, _mm_set1_epi16((1 << TB) - 1));
+
+            uint16_t idx[LANES] __attribute__((aligned(16)));
+            _mm_store_si128((__m128i*)idx, idxv);
+
+            // Find the provider (longest hit) and alternate (next-longest hit)
+            __m128i entries = _mm_setr_epi16(entry(0, idx), entry(1, idx), entry(2, idx), entry(3, idx),
+                    entry(4, idx), entry(5, idx), entry(6, idx), entry(7, idx));
+            __m128i hits = _mm_cmpeq_epi16(_mm_srli_epi16(entries, TAG_SHIFT), tagv);
+            uint32_t hitMask = _mm_movemask_epi8(hits) & ((1 << 2*NT) - 1);  // 2 bits per lane
+            uint16_t ent[LANES] __attribute__((aligned(16)));
+            _mm_store_si128((__m128i*)ent, entries);
+
+            // Hits are about as predictable as the branches themselves, so don't branch on them. Lane 0 of m is a
+            // sentinel, so provider and alt are -1 if there's no hit.
+            uint32_t m = (hitMask << 2) | 3;
+            int32_t provider = (31 - __builtin_clz(m))/2 - 1;
+            m &= ~(3u << 2*(provider + 1)) | 3u;
+            int32_t alt = (31 - __builtin_clz(m))/2 - 1;
+            uint16_t providerEntry = ent[std::max(provider, 0)];
+            uint16_t altEntry = ent[std::max(alt, 0)];
+
+            uint32_t baseIdx = (pc ^ (pc >> LB)) & ((1 << LB) - 1);
+            bool basePred = base[baseIdx] > 1;
+            bool altPred = (alt >= 0)? ((altEntry & 7) >= 4) : basePred;
+            uint32_t ctr = providerEntry & 7;
+            bool providerPred = (provider >= 0)? (ctr >= 4) : basePred;
+            bool newEntry = (provider >= 0) && (ctr == 3 || ctr == 4) && ((providerEntry >> U_SHIFT) & 3) == 0;
+            bool pred = (newEntry && useAltOnNa >= 0)? altPred : providerPred;
+            if (provider >= 0) conf = (ctr == 0 || ctr == 7)? 2 : (ctr == 1 || ctr == 6)? 1 : 0;  // newEntry is low
+            else conf = (base[baseIdx] == 0 || base[baseIdx] == 3)? 1 : 0;
+
+            // Update
+            if (provider >= 0) {
+                uint16_t& e = tables[provider][idx[provider]];
+                if (newEntry && providerPred != altPred) {
+                    useAltOnNa = (altPred == taken)? std::min(useAltOnNa + 1, 7) : std::max(useAltOnNa - 1, -8);
+                }
+                // A newly allocated provider is not yet trusted, so keep training the altpred
+                if (newEntry) {
+                    if (alt >= 0) tables[alt][idx[alt]] = updateCtr(altEntry, taken);
+                    else updateBase(baseIdx, taken);
+                }
+                e = updateCtr(e, taken);
+                if (providerPred != altPred) {
+                    uint32_t u = (e >> U_SHIFT) & 3;
+                    u = (providerPred == taken)? std::min(u + 1, 3u) : (u? u - 1 : 0);
+                    e = (e & ~(3 << U_SHIFT)) | (u << U_SHIFT);
+                }
+            } else {
+                updateBase(baseIdx, taken);
+            }
+
+            // Allocate on longer-history tables on a mispredict, unless a new provider was right
+            if (unlikely(pred != taken) && provider < (int32_t)NT-1 && !(newEntry && providerPred == taken)) {
+                uint16_t tag[LANES] __attribute__((aligned(16)));
+                _mm_store_si128((__m128i*)tag, tagv);
+                allocate(provider + 1, idx, tag, taken);
+            }
+
+            if (unlikely(--uResetCountdown == 0)) {
+                uResetCountdown = U_RESET_PERIOD;
+                for (uint32_t i = 0; i < NT; i++) {
+                    for (uint32_t j = 0; j < (1u << LT); j++) {
+                        uint16_t& e = tables[i][j];
+                        uint32_t u = (e >> U_SHIFT) & 3;
+                        e = (e & ~(3 << U_SHIFT)) | ((u >> 1) << U_SHIFT);
+                    }
+                }
+            }
+
+            // Update histories
+            uint32_t in = taken? 1 : 0;
+            ghistPtr--;
+            ghist[ghistPtr & HMASK] = in;
+            phist = ((phist << 1) | ((pc ^ (pc >> 4)) & 1)) & 0xffff;
+            __m128i inv = _mm_set1_epi16(in);
+            __m128i outv = _mm_setr_epi16(histOut(0), histOut(1), histOut(2), histOut(3),
+                    histOut(4), histOut(5), histOut(6), histOut(7));
+            outv = _mm_sub_epi16(_mm_setzero_si128(), outv);  // 0 or all ones
+            idxHist = fold<LT>(idxHist, inv, _mm_and_si128(outv, idxOutBit));
+            tagHist0 = fold<TB>(tagHist0, inv, _mm_and_si128(outv, tagOutBit0));
+            tagHist1 = fold<TB-1>(tagHist1, inv, _mm_and_si128(outv, tagOutBit1));
+
+            return pred;
+        }
+
+    private:
+        static inline __m128i load(const uint16_t* v) {
+            return _mm_loadu_si128((const __m128i*)v);
+        }
+
+        // Circular shift register update: shift in the newest bit, cancel the one that left the history
+        template <uint32_t BITS>
+        static inline __m128i fold(__m128i comp, __m128i in, __m128i outBit) {
+            comp = _mm_xor_si128(_mm_or_si128(_mm_slli_epi16(comp, 1), in), outBit);
+            comp = _mm_xor_si128(comp, _mm_srli_epi16(comp, BITS));
+            return _mm_and_si128(comp, _mm_set1_epi16((1 << BITS) - 1));
+        }
+
+        inline uint16_t entry(uint32_t i, const uint16_t* idx) const {
+            return (i < NT)? tables[i][idx[i]] : 0;
+        }
+
+        // The history bit that just left table i's history
+        inline uint16_t histOut(uint32_t i) const {
+            return (i < NT)? ghist[(ghistPtr + histLen[i]) & HMASK] : 0;
+        }
+
+        static inline uint16_t updateCtr(uint16_t e, bool taken) {
+            uint32_t ctr = e & 7;
+            ctr = taken? (ctr == 7? 7 : ctr+1) : (ctr == 0? 0 : ctr-1);
+            return (e & ~7) | ctr;
+        }
+
+        inline void updateBase(uint32_t baseIdx, bool taken) {
+            uint8_t& c = base[baseIdx];
+            c = taken? (c == 3? 3 : c+1) : (c == 0? 0 : c-1);
+        }
+
+        void allocate(uint32_t start, const uint16_t* idx, const uint16_t* tag, bool taken) {
+            // Skip the first candidate half of the time, so that we don't always steal the same table's entries
+            rng ^= rng << 13;
+            rng ^= rng >> 17;
+            rng ^= rng << 5;
+            if ((rng & 1) && start < NT-1) start++;
+
+            for (uint32_t i = start; i < NT; i++) {
+                uint16_t& e = tables[i][idx[i]];
+                if (((e >> U_SHIFT) & 3) == 0) {
+                    e = (tag[i] << TAG_SHIFT) | (taken? 4 : 3);
+                    return;
+                }
+            }
+
+            // No free entries; age the candidates so that we can allocate eventually
+            for (uint32_t i = start; i < NT; i++) {
+                uint16_t& e = tables[i][idx[i]];
+                e -= 1 << U_SHIFT;  // u > 0, checked above
+            }
+        }
+};
+
+// 8 tagged tables of 1K entries with 4-320 bits of history, an 8K-entry base table, and a 2K-entry global history (26KB total)
+typedef BranchPredictorTAGE<13, 8, 10, 11, 4, 320> BranchPredictorTAGEDefault;
+
+/* Loop predictor of TAGE-SC-L (Seznec, "TAGE-SC-L branch predictors again", CBP-5 2016): 2^LL entries,
+ * 4-way associative, that learn the trip counts of loops whose exits the base predictor mispredicts. Once an
+ * entry has seen the same trip count CONF_MAX times in a row, it predicts the exit, and overrides the base
+ * prediction if its overrides have been right more often than not.
+ */
+template <uint32_t LL>
+class LoopPredictor {
+    private:
+        static const uint32_t WAYS = 4;
+        static const uint32_t ITER_MASK = (1 << 10) - 1;
+        static const uint32_t CONF_MAX = 3;
+        static const uint32_t AGE_MAX = 7;
+
+        struct Entry {
+            uint16_t tag;  // 0 if free
+            uint16_t trip;  // iterations per execution of the loop, 0 if not known yet
+            uint16_t iter;  // iterations since the last exit
+            uint8_t conf;
+            uint8_t age;  // only entries with age 0 can be replaced
+            uint8_t dir;  // direction that stays in the loop
+        };
+
+        Entry entries[1 << LL];
+        int32_t useLoop;  // 7-bit signed, >= 0 means overriding has paid off
+        uint32_t rng;
+
+    public:
+        LoopPredictor() {
+            static_assert(LL >= 2 && LL <= 12, "Loop predictor needs 4-4096 entries");
+            for (uint32_t i = 0; i < (1u << LL); i++) free(entries[i]);
+            useLoop = -1;
+            rng = 0x1f123bb5;
+        }
+
+        // Returns the loop prediction if it has a confident one and should override basePred, basePred otherwise; trains
+        inline bool predict(uint32_t pc, bool taken, bool basePred) {
+            Entry* set = &entries[((pc ^ (pc >> (LL - 2))) & ((1 << (LL - 2)) - 1)) * WAYS];
+            uint16_t tag = ((pc >> (LL - 2)) ^ (pc >> 20)) | 0x8000;
+            Entry* e = NULL;
+            for (uint32_t w = 0; w < WAYS; w++) {
+                if (set[w].tag == tag) e = &set[w];
+            }
+
+            if (likely(!e)) {
+                if (basePred != taken) allocate(set, tag, taken);
+                return basePred;
+            }
+
+            bool valid = e->conf == CONF_MAX;
+            bool loopPred = (e->iter + 1u == e->trip)? !e->dir : e->dir;
+            bool pred = (valid && useLoop >= 0)? loopPred : basePred;
+
+            if (valid) {
+                if (loopPred != basePred) useLoop = (loopPred == taken)? std::min(useLoop + 1, 63) : std::max(useLoop - 1, -64);
+                if (loopPred != taken) {
+                    free(*e);
+                    return pred;
+                }
+                if (loopPred != basePred && e->age < AGE_MAX) e->age++;
+            }
+
+            e->iter = (e->iter + 1) & ITER_MASK;
+            if (e->iter > e->trip) {
+                e->conf = 0;
+                e->trip = 0;
+            }
+            if (taken != e->dir) {  // loop exit
+                if (e->iter == e->trip) {
+                    if (e->conf < CONF_MAX) e->conf++;
+                    if (e->trip < 3) free(*e);  // too short to be worth it
+                } else if (e->trip == 0) {
+                    e->trip = e->iter;  // first execution seen from start to end
+                    e->conf = 0;
+                } else {
+                    e->trip = 0;  // trip count changed
+                    e->conf = 0;
+                }
+                e->iter = 0;
+            }
+            return pred;
+        }
+
+    private:
+        static inline void free(Entry& e) {
+            e.tag = e.trip = e.iter = 0;
+            e.conf = e.age = e.dir = 0;
+        }
+
+        void allocate(Entry* set, uint16_t tag, bool taken) {
+            rng ^= rng << 13;
+            rng ^= rng >> 17;
+            rng ^= rng << 5;
+            if (rng & 3) return;  // one in 4 mispredicts, so that irregular branches do not thrash the table
+            Entry& e = set[(rng >> 2) % WAYS];
+            if (e.age) {
+                e.age--;
+                return;
+            }
+            e.tag = tag;
+            e.trip = e.iter = 0;
+            e.conf = 0;
+            e.age = AGE_MAX;
+            e.dir = !taken;  // the mispredicted outcome is taken to be the exit
+        }
+};
+
+/* Statistical corrector of TAGE-SC-L: a sum of 6-bit counters, from two bias tables indexed by PC and the base
+ * prediction (one also by its confidence) and NG tables indexed by PC and 6-40 bits of global history, that
+ * overrides the base prediction when it disagrees strongly enough given the base's confidence. It catches
+ * branches that are statistically biased but that TAGE's tagged entries track poorly. This leaves out the
+ * local-history and IMLI components of the full design.
+ */
+template <uint32_t LS>
+class StatCorrector {
+    private:
+        static const uint32_t NG = 4;
+        static const uint32_t NTAB = NG + 2;
+
+        int8_t tables[NTAB][1 << LS];
+        uint64_t ghist;
+        int32_t threshold;  // |sum| below which counters keep training even on correct predictions
+        int32_t thresholdCtr;
+
+    public:
+        StatCorrector() {
+            static_assert(LS >= 4 && LS <= 16, "Statistical corrector tables must have 16-64K entries");
+            for (uint32_t i = 0; i < NTAB; i++) {
+                for (uint32_t j = 0; j < (1u << LS); j++) tables[i][j] = 0;
+            }
+            ghist = 0;
+            threshold = 6*NTAB;
+            thresholdCtr = 0;
+        }
+
+        // Returns the corrected prediction, given the base prediction and its confidence (0-2, as in TAGE); trains
+        inline bool predict(uint32_t pc, bool taken, bool basePred, uint32_t conf) {
+            static const uint32_t HIST_LENS[NG] = {6, 12, 22, 40};
+            const uint32_t mask = (1 << LS) - 1;
+            int8_t* ctrs[NTAB];
+            ctrs[0] = &tables[0][((pc << 1) | basePred) & mask];
+            ctrs[1] = &tables[1][(((pc ^ (pc >> LS)) << 2) | (basePred << 1) | (conf == 0)) & mask];
+            for (uint32_t i = 0; i < NG; i++) {
+                uint64_t h = ((ghist & ((1ul << HIST_LENS[i]) - 1)) ^ ((uint64_t)pc << 24) ^ i) * 0x9E3779B97F4A7C15ul;
+                ctrs[2 + i] = &tables[2 + i][h >> (64 - LS)];
+            }
+
+            int32_t sum = 0;
+            for (uint32_t i = 0; i < NTAB; i++) sum += 2*(*ctrs[i]) + 1;
+            bool scPred = sum >= 0;
+            int32_t mag = std::abs(sum);
+
+            // A confident base prediction needs a larger sum to be overridden
+            bool pred = basePred;
+            if (scPred != basePred) {
+                int32_t minMag = (conf == 2)? threshold/2 : (conf == 1)? threshold/4 : 0;
+                if (mag >= minMag) pred = scPred;
+            }
+
+            if (scPred != taken || mag < threshold) {
+                for (uint32_t i = 0; i < NTAB; i++) {
+                    int8_t& c = *ctrs[i];
+                    c += (taken & (c != 31)) - (!taken & (c != -32));
+                }
+                // Adapt the threshold so that mispredicts and low-magnitude training balance out
+                thresholdCtr += (scPred != taken)? 1 : -1;
+                if (thresholdCtr > 31 || thresholdCtr < -32) {
+                    threshold = std::max(threshold + ((thresholdCtr > 0)? 1 : -1), (int32_t)NTAB);
+                    thresholdCtr = 0;
+                }
+            }
+
+            ghist = (ghist << 1) | (taken? 1 : 0);
+            return pred;
+        }
+};
+
+/* TAGE-SC-L: TAGE, whose prediction the loop predictor may override, whose prediction the statistical
+ * corrector may in turn override. Each component trains on its own prediction, not on the final one. The
+ * extra components add about 6KB and make predict() 1.3-1.4x as expensive as TAGE's (see bpbench).
+ */
+template<typename TAGE, uint32_t LL, uint32_t LS>
+class BranchPredictorTAGESCL {
+    private:
+        TAGE tage;
+        LoopPredictor<LL> loop;
+        StatCorrector<LS> sc;
+
+    public:
+        // Predicts and updates; returns false if mispredicted
+        inline bool predict(Address branchPc, bool taken) {
+            uint32_t pc = (uint32_t)branchPc;
+            uint32_t conf;
+            bool tagePred = tage.predictAndTrain(branchPc, taken, conf);
+            bool loopPred = loop.predict(pc, taken, tagePred);
+            if (loopPred != tagePred) conf = 2;  // the loop predictor only overrides once it is confident
+            return sc.predict(pc, taken, loopPred, conf) == taken;
+        }
+};
+
+// The default TAGE with a 64-entry loop predictor and 6 1K-entry SC tables (32KB total)
+typedef BranchPredictorTAGESCL<BranchPredictorTAGEDefault, 6, 10> BranchPredictorTAGESCLDefault;
+
+#endif  // BRANCH_PRED_H_
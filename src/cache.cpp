@@ -54,6 +54,13 @@ void Cache::initCacheStats(AggregateStat* cacheStat) {
     rp->initStats(cacheStat);
 }
 
+void Cache::checkpointState(Checkpoint& ckpt) {
+    std::string prefix = name.c_str();
+    array->checkpointState(ckpt, prefix + ".array");
+    rp->checkpointState(ckpt, prefix + ".repl");
+    cc->checkpointState(ckpt, prefix + ".cc");
+}
+
 uint64_t Cache::access(MemReq& req) {
     uint64_t respCycle = req.cycle;
     bool skipAccess = cc->startAccess(req); //may need to skip access due to races (NOTE: may change req.type!)
@@ -85,14 +92,14 @@ uint64_t Cache::access(MemReq& req) {
     return respCycle;
 }
 
-uint64_t Cache::invalidate(Address lineAddr, InvType type, bool* reqWriteback, uint64_t reqCycle, uint32_t srcId) {
+uint64_t Cache::invalidate(Address lineAddr, InvType type, bool* reqWriteback, uint64_t reqCycle, uint32_t srcId, uint32_t flags) {
     cc->startInv(); //note we don't grab tcc; tcc serializes multiple up accesses, down accesses don't see it
 
     int32_t lineId = array->lookup(lineAddr, NULL, false);
     assert_msg(lineId != -1, "[%s] Invalidate on non-existing address 0x%lx type %s lineId %d, reqWriteback %d", name.c_str(), lineAddr, InvTypeName(type), lineId, *reqWriteback);
     uint64_t respCycle = reqCycle + invLat;
     trace(Cache, "[%s] Invalidate start 0x%lx type %s lineId %d, reqWriteback %d", name.c_str(), lineAddr, InvTypeName(type), lineId, *reqWriteback);
-    respCycle = cc->processInv(lineAddr, lineId, type, reqWriteback, respCycle, srcId); //send invalidates or downgrades to children, and adjust our own state
+    respCycle = cc->processInv(lineAddr, lineId, type, reqWriteback, respCycle, srcId, flags); //send invalidates or downgrades to children, and adjust our own state
     trace(Cache, "[%s] Invalidate end 0x%lx type %s lineId %d, reqWriteback %d, latency %ld", name.c_str(), lineAddr, InvTypeName(type), lineId, *reqWriteback, respCycle - reqCycle);
 
     return respCycle;
@@ -24,28 +24,80 @@
  */
 
 #include "cache_arrays.h"
+#include <string.h>
 #include "hash.h"
+#include "pad.h"
 #include "repl_policies.h"
 
+/* Partial tags */
+
+PartialTags::PartialTags(uint32_t numEntries, uint32_t bits) {
+    if (bits < 1 || bits > 16) panic("Partial tags must have 1-16 bits, %d specified", bits);
+    ptags = gm_memalign<uint16_t>(CACHE_LINE_BYTES, numEntries);
+    memset(ptags, 0, numEntries*sizeof(uint16_t));
+    shift = 64 - bits;
+}
+
+void PartialTags::initStats(AggregateStat* parentStat) {
+    profRejects.init("ptagRejects", "Lookups that missed on partial tags alone");
+    profFalsePositives.init("ptagFalsePos", "Partial tag matches that failed the full tag compare");
+    parentStat->append(&profRejects);
+    parentStat->append(&profFalsePositives);
+}
+
 /* Set-associative array implementation */
 
-SetAssocArray::SetAssocArray(uint32_t _numLines, uint32_t _assoc, ReplPolicy* _rp, HashFamily* _hf) : rp(_rp), hf(_hf), numLines(_numLines), assoc(_assoc)  {
-    array = gm_calloc<Address>(numLines);
+TagSearchISA tagSearchISA = DetectTagSearchISA();  // per process, when the library loads
+
+SetAssocArray::SetAssocArray(uint32_t _numLines, uint32_t _assoc, ReplPolicy* _rp, HashFamily* _hf, uint32_t partialTagBits) : rp(_rp), hf(_hf), numLines(_numLines), assoc(_assoc)  {
+    array = gm_memalign<Address>(CACHE_LINE_BYTES, numLines);  // with a multiple of 8 ways, each set starts on a line
+    memset(array, 0, numLines*sizeof(Address));
     numSets = numLines/assoc;
     setMask = numSets - 1;
     assert(isPow2(numSets));
+    ptags = partialTagBits? new PartialTags(numLines, partialTagBits) : NULL;
+}
+
+void SetAssocArray::initStats(AggregateStat* parentStat) {
+    if (!ptags) return;
+    AggregateStat* objStats = new AggregateStat();
+    objStats->init("array", "SetAssocArray stats");
+    ptags->initStats(objStats);
+    parentStat->append(objStats);
+}
+
+void SetAssocArray::checkpointState(Checkpoint& ckpt, const std::string& prefix) {
+    ckpt.array(prefix + ".tags", array, numLines);
+    // Partial tags are rebuilt rather than checkpointed, so they can differ in width across runs
+    if (ptags && ckpt.isRestoring()) {
+        for (uint32_t i = 0; i < numLines; i++) (*ptags)[i] = ptags->hash(array[i]);
+    }
 }
 
 int32_t SetAssocArray::lookup(const Address lineAddr, const MemReq* req, bool updateReplacement) {
     uint32_t set = hf->hash(0, lineAddr) & setMask;
     uint32_t first = set*assoc;
-    for (uint32_t id = first; id < first + assoc; id++) {
-        if (array[id] ==  lineAddr) {
-            if (updateReplacement) rp->update(id, req);
-            return id;
+    if (ptags) {
+        uint16_t ptag = ptags->hash(lineAddr);
+        bool partialHit = false;
+        for (uint32_t id = first; id < first + assoc; id++) {
+            if ((*ptags)[id] != ptag) continue;
+            if (array[id] == lineAddr) {
+                if (updateReplacement) rp->update(id, req);
+                return id;
+            }
+            ptags->profFalsePositives.inc();
+            partialHit = true;
         }
+        if (!partialHit) ptags->profRejects.inc();
+        return -1;
     }
-    return -1;
+
+    int32_t way = findTag(&array[first], assoc, lineAddr);
+    if (way == -1) return -1;
+    uint32_t id = first + way;
+    if (updateReplacement) rp->update(id, req);
+    return id;
 }
 
 uint32_t SetAssocArray::preinsert(const Address lineAddr, const MemReq* req, Address* wbLineAddr) { //TODO: Give out valid bit of wb cand?
@@ -61,13 +113,14 @@ uint32_t SetAssocArray::preinsert(const Address lineAddr, const MemReq* req, Add
 void SetAssocArray::postinsert(const Address lineAddr, const MemReq* req, uint32_t candidate) {
     rp->replaced(candidate);
     array[candidate] = lineAddr;
+    if (ptags) (*ptags)[candidate] = ptags->hash(lineAddr);
     rp->update(candidate, req);
 }
 
 
 /* ZCache implementation */
 
-ZArray::ZArray(uint32_t _numLines, uint32_t _ways, uint32_t _candidates, ReplPolicy* _rp, HashFamily* _hf) //(int _size, int _lineSize, int _assoc, int _zassoc, ReplacementPolicy<T>* _rp, int _hashType)
+ZArray::ZArray(uint32_t _numLines, uint32_t _ways, uint32_t _candidates, ReplPolicy* _rp, HashFamily* _hf, uint32_t partialTagBits) //(int _size, int _lineSize, int _assoc, int _zassoc, ReplacementPolicy<T>* _rp, int _hashType)
     : rp(_rp), hf(_hf), numLines(_numLines), ways(_ways), cands(_candidates)
 {
     assert_msg(ways > 1, "zcaches need >=2 ways to work");
@@ -85,6 +138,7 @@ ZArray::ZArray(uint32_t _numLines, uint32_t _ways, uint32_t _candidates, ReplPol
         lookupArray[i] = i;  // start with a linear mapping; with swaps, it'll get progressively scrambled
     }
     swapArray = gm_calloc<uint32_t>(cands/ways + 2);  // conservative upper bound (tight within 2 ways)
+    ptags = partialTagBits? new PartialTags(numLines, partialTagBits) : NULL;
 }
 
 void ZArray::initStats(AggregateStat* parentStat) {
@@ -92,9 +146,18 @@ void ZArray::initStats(AggregateStat* parentStat) {
     objStats->init("array", "ZArray stats");
     statSwaps.init("swaps", "Block swaps in replacement process");
     objStats->append(&statSwaps);
+    if (ptags) ptags->initStats(objStats);
     parentStat->append(objStats);
 }
 
+void ZArray::checkpointState(Checkpoint& ckpt, const std::string& prefix) {
+    ckpt.array(prefix + ".tags", array, numLines);
+    ckpt.array(prefix + ".positions", lookupArray, numLines);
+    if (ptags && ckpt.isRestoring()) {
+        for (uint32_t i = 0; i < numLines; i++) (*ptags)[i] = ptags->hash(array[lookupArray[i]]);
+    }
+}
+
 int32_t ZArray::lookup(const Address lineAddr, const MemReq* req, bool updateReplacement) {
     /* Be defensive: If the line is 0, panic instead of asserting. Now this can
      * only happen on a segfault in the main program, but when we move to full
@@ -103,15 +166,22 @@ int32_t ZArray::lookup(const Address lineAddr, const MemReq* req, bool updateRep
      */
     if (unlikely(!lineAddr)) panic("ZArray::lookup called with lineAddr==0 -- your app just segfaulted");
 
+    uint16_t ptag = ptags? ptags->hash(lineAddr) : 0;
+    bool partialHit = false;
     for (uint32_t w = 0; w < ways; w++) {
-        uint32_t lineId = lookupArray[w*numSets + (hf->hash(w, lineAddr) & setMask)];
+        uint32_t pos = w*numSets + (hf->hash(w, lineAddr) & setMask);
+        if (ptags && (*ptags)[pos] != ptag) continue;
+        uint32_t lineId = lookupArray[pos];
         if (array[lineId] == lineAddr) {
             if (updateReplacement) {
                 rp->update(lineId, req);
             }
             return lineId;
         }
+        partialHit = true;
+        if (ptags) ptags->profFalsePositives.inc();
     }
+    if (ptags && !partialHit) ptags->profRejects.inc();
     return -1;
 }
 
@@ -196,8 +266,10 @@ void ZArray::postinsert(const Address lineAddr, const MemReq* req, uint32_t cand
     for (uint32_t i = 0; i < swapArrayLen-1; i++) {
         //info("Moving position %d (lineId %d) <- %d (lineId %d)", swapArray[i], lookupArray[swapArray[i]], swapArray[i+1], lookupArray[swapArray[i+1]]);
         lookupArray[swapArray[i]] = lookupArray[swapArray[i+1]];
+        if (ptags) (*ptags)[swapArray[i]] = (*ptags)[swapArray[i+1]];
     }
     lookupArray[swapArray[swapArrayLen-1]] = candidate; //note that in preinsert() we walk the array backwards when populating swapArray, so the last elem is where the new line goes
+    if (ptags) (*ptags)[swapArray[swapArrayLen-1]] = ptags->hash(lineAddr);
     //info("Inserting lineId %d in position %d", candidate, swapArray[swapArrayLen-1]);
 
     rp->replaced(candidate);
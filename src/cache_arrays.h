@@ -26,6 +26,8 @@
 #ifndef CACHE_ARRAYS_H_
 #define CACHE_ARRAYS_H_
 
+#include <immintrin.h>
+#include "checkpoint.h"
 #include "memory_hierarchy.h"
 #include "stats.h"
 
@@ -49,11 +51,122 @@ class CacheArray : public GlobAlloc {
         virtual void postinsert(const Address lineAddr, const MemReq* req, uint32_t lineId) = 0;
 
         virtual void initStats(AggregateStat* parent) {}
+
+        /* Saves or restores the tags (see checkpoint.h). Does not include
+         * replacement state, which the cache checkpoints separately.
+         */
+        virtual void checkpointState(Checkpoint& ckpt, const std::string& prefix) {
+            panic("%s: cache array does not support checkpoints", prefix.c_str());
+        }
 };
 
 class ReplPolicy;
 class HashFamily;
 
+/* Optional sidecar with a few hash bits of each line's address. Lookups
+ * check these before the full tags, so most misses are resolved with one
+ * cache line of partial tags instead of a full-tag comparison per way.
+ * Entries mirror the array's tags (empty lines hold partial tag 0, as 0 is
+ * also the empty full tag), so there are no false negatives.
+ */
+class PartialTags : public GlobAlloc {
+    private:
+        uint16_t* ptags;
+        uint32_t shift;
+
+    public:
+        Counter profRejects;  // lookups resolved as misses without comparing any full tag
+        Counter profFalsePositives;  // partial matches that failed the full comparison
+
+        PartialTags(uint32_t numEntries, uint32_t bits);
+
+        inline uint16_t hash(Address lineAddr) const {
+            return (lineAddr * 0x9E3779B97F4A7C15ul) >> shift;  // lineAddr 0 -> 0
+        }
+
+        inline uint16_t& operator[](uint32_t idx) { return ptags[idx]; }
+
+        void initStats(AggregateStat* parentStat);
+};
+
+/* Tag search: returns the index of lineAddr in tags[0..n), or -1 if it is
+ * not there. The SIMD versions compare a cache line of tags (8 ways) per
+ * branch. Default builds target core2, so rather than relying on -march, each
+ * version is compiled for its own ISA and findTag picks the widest one the
+ * host supports, chosen once at load time (tagSearchISA). On narrower arrays,
+ * and with compilers too old to build them (gcc < 4.9), it uses the scalar
+ * loop, which gcc unrolls well enough (an SSE2 version that emulates 64-bit
+ * compares was slower than it). See tagbench.cpp.
+ */
+#if defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define TAG_SEARCH_SIMD
+#endif
+
+enum TagSearchISA {TAG_SEARCH_SCALAR, TAG_SEARCH_SSE41, TAG_SEARCH_AVX2};
+
+extern TagSearchISA tagSearchISA;  // cache_arrays.cpp
+
+static inline TagSearchISA DetectTagSearchISA() {
+#ifdef TAG_SEARCH_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return TAG_SEARCH_AVX2;
+    if (__builtin_cpu_supports("sse4.1")) return TAG_SEARCH_SSE41;
+#endif
+    return TAG_SEARCH_SCALAR;
+}
+
+static inline int32_t findTagScalar(const Address* tags, uint32_t n, Address lineAddr) {
+    for (uint32_t i = 0; i < n; i++) {
+        if (tags[i] == lineAddr) return i;
+    }
+    return -1;
+}
+
+#ifdef TAG_SEARCH_SIMD
+static inline __attribute__((target("avx2"))) int32_t findTagAVX2(const Address* tags, uint32_t n, Address lineAddr) {
+    uint32_t i = 0;
+    __m256i key = _mm256_set1_epi64x(lineAddr);
+    for (; i + 8 <= n; i += 8) {
+        __m256i eq0 = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i*)&tags[i]), key);
+        __m256i eq1 = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i*)&tags[i + 4]), key);
+        uint32_t mask = _mm256_movemask_pd(_mm256_castsi256_pd(eq0)) | (_mm256_movemask_pd(_mm256_castsi256_pd(eq1)) << 4);
+        if (mask) return i + __builtin_ctz(mask);
+    }
+    for (; i < n; i++) {
+        if (tags[i] == lineAddr) return i;
+    }
+    return -1;
+}
+
+static inline __attribute__((target("sse4.1"))) int32_t findTagSSE41(const Address* tags, uint32_t n, Address lineAddr) {
+    uint32_t i = 0;
+    __m128i key = _mm_set1_epi64x(lineAddr);
+    for (; i + 8 <= n; i += 8) {
+        __m128i eq0 = _mm_cmpeq_epi64(_mm_loadu_si128((const __m128i*)&tags[i]), key);
+        __m128i eq1 = _mm_cmpeq_epi64(_mm_loadu_si128((const __m128i*)&tags[i + 2]), key);
+        __m128i eq2 = _mm_cmpeq_epi64(_mm_loadu_si128((const __m128i*)&tags[i + 4]), key);
+        __m128i eq3 = _mm_cmpeq_epi64(_mm_loadu_si128((const __m128i*)&tags[i + 6]), key);
+        uint32_t mask = _mm_movemask_pd(_mm_castsi128_pd(eq0)) | (_mm_movemask_pd(_mm_castsi128_pd(eq1)) << 2) |
+            (_mm_movemask_pd(_mm_castsi128_pd(eq2)) << 4) | (_mm_movemask_pd(_mm_castsi128_pd(eq3)) << 6);
+        if (mask) return i + __builtin_ctz(mask);
+    }
+    for (; i < n; i++) {
+        if (tags[i] == lineAddr) return i;
+    }
+    return -1;
+}
+#endif
+
+static inline int32_t findTag(const Address* tags, uint32_t n, Address lineAddr) {
+#ifdef TAG_SEARCH_SIMD
+    if (n >= 8) {
+        if (tagSearchISA == TAG_SEARCH_AVX2) return findTagAVX2(tags, n, lineAddr);
+        if (tagSearchISA == TAG_SEARCH_SSE41) return findTagSSE41(tags, n, lineAddr);
+    }
+#endif
+    return findTagScalar(tags, n, lineAddr);
+}
+
 /* Set-associative cache array */
 class SetAssocArray : public CacheArray {
     protected:
@@ -64,13 +177,17 @@ class SetAssocArray : public CacheArray {
         uint32_t numSets;
         uint32_t assoc;
         uint32_t setMask;
+        PartialTags* ptags; //indexed by line id, NULL if disabled
 
     public:
-        SetAssocArray(uint32_t _numLines, uint32_t _assoc, ReplPolicy* _rp, HashFamily* _hf);
+        SetAssocArray(uint32_t _numLines, uint32_t _assoc, ReplPolicy* _rp, HashFamily* _hf, uint32_t partialTagBits = 0);
 
         int32_t lookup(const Address lineAddr, const MemReq* req, bool updateReplacement);
         uint32_t preinsert(const Address lineAddr, const MemReq* req, Address* wbLineAddr);
         void postinsert(const Address lineAddr, const MemReq* req, uint32_t candidate);
+
+        void initStats(AggregateStat* parentStat);
+        void checkpointState(Checkpoint& ckpt, const std::string& prefix);
 };
 
 /* The cache array that started this simulator :) */
@@ -78,6 +195,7 @@ class ZArray : public CacheArray {
     private:
         Address* array; //maps line id to address
         uint32_t* lookupArray; //maps physical position to lineId
+        PartialTags* ptags; //indexed by physical position (so lookups skip lookupArray too), NULL if disabled
         ReplPolicy* rp;
         HashFamily* hf;
         uint32_t numLines;
@@ -95,7 +213,7 @@ class ZArray : public CacheArray {
         Counter statSwaps;
 
     public:
-        ZArray(uint32_t _numLines, uint32_t _ways, uint32_t _candidates, ReplPolicy* _rp, HashFamily* _hf);
+        ZArray(uint32_t _numLines, uint32_t _ways, uint32_t _candidates, ReplPolicy* _rp, HashFamily* _hf, uint32_t partialTagBits = 0);
 
         int32_t lookup(const Address lineAddr, const MemReq* req, bool updateReplacement);
         uint32_t preinsert(const Address lineAddr, const MemReq* req, Address* wbLineAddr);
@@ -106,6 +224,7 @@ class ZArray : public CacheArray {
         uint32_t getLastCandIdx() const {return lastCandIdx;}
 
         void initStats(AggregateStat* parentStat);
+        void checkpointState(Checkpoint& ckpt, const std::string& prefix);
 };
 
 // Simple wrapper classes and iterators for candidates in each case; simplifies replacement policy interface without sacrificing performance
@@ -0,0 +1,181 @@
+/** $lic$
+ * Copyright (C) 2012-2014 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "checkpoint.h"
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "core.h"
+#include "log.h"
+#include "memory_hierarchy.h"
+#include "page_alloc.h"
+#include "tlb.h"
+#include "zsim.h"
+
+#define CHECKPOINT_MAGIC 0x5a53494d434b5054ul  // "ZSIMCKPT"
+#define CHECKPOINT_NAME_BYTES 64
+
+struct CheckpointHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t numBlobs;
+    uint64_t phase;  // the phase it was taken at the end of, informational
+};
+
+struct CheckpointTableEntry {
+    char name[CHECKPOINT_NAME_BYTES];
+    uint64_t offset;  // from the start of the file, line-aligned
+    uint64_t size;
+};
+
+static inline uint64_t alignToLine(uint64_t x) {
+    return (x + CACHE_LINE_BYTES - 1) & ~((uint64_t)CACHE_LINE_BYTES - 1);
+}
+
+static void writeAt(int fd, const void* data, size_t size, uint64_t offset, const char* file) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    while (size) {
+        ssize_t res = pwrite(fd, p, size, offset);
+        if (res <= 0) panic("Could not write checkpoint %s", file);
+        p += res;
+        size -= res;
+        offset += res;
+    }
+}
+
+/* CheckpointWriter */
+
+void CheckpointWriter::blob(const std::string& name, void* data, size_t size) {
+    if (name.size() >= CHECKPOINT_NAME_BYTES) panic("Checkpoint blob name %s is too long", name.c_str());
+    if (!names.insert(name).second) panic("Duplicate checkpoint blob %s", name.c_str());
+    blobs.push_back({name, data, size});
+}
+
+void CheckpointWriter::write(const char* file) {
+    // Write to a temporary file and rename it, so an interrupted save never leaves a torn checkpoint behind
+    std::string tmpFile = std::string(file) + ".tmp";
+    int fd = open(tmpFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) panic("Could not create checkpoint %s", tmpFile.c_str());
+
+    CheckpointHeader hdr = {CHECKPOINT_MAGIC, CHECKPOINT_VERSION, (uint32_t)blobs.size(), zinfo->numPhases};
+    std::vector<CheckpointTableEntry> table(blobs.size());
+    uint64_t offset = alignToLine(sizeof(hdr) + table.size()*sizeof(CheckpointTableEntry));
+    for (uint32_t i = 0; i < blobs.size(); i++) {
+        memset(table[i].name, 0, CHECKPOINT_NAME_BYTES);
+        strncpy(table[i].name, blobs[i].name.c_str(), CHECKPOINT_NAME_BYTES - 1);
+        table[i].offset = offset;
+        table[i].size = blobs[i].size;
+        offset = alignToLine(offset + blobs[i].size);
+    }
+
+    writeAt(fd, &hdr, sizeof(hdr), 0, file);
+    if (table.size()) writeAt(fd, &table[0], table.size()*sizeof(CheckpointTableEntry), sizeof(hdr), file);
+    for (uint32_t i = 0; i < blobs.size(); i++) writeAt(fd, blobs[i].data, blobs[i].size, table[i].offset, file);
+    if (ftruncate(fd, offset) != 0) panic("Could not write checkpoint %s", file);  // covers the last blob's padding
+    close(fd);
+    if (rename(tmpFile.c_str(), file) != 0) panic("Could not rename checkpoint %s to %s", tmpFile.c_str(), file);
+
+    info("Saved checkpoint %s at the end of phase %ld: %ld blobs, %ld KB", file, zinfo->numPhases, blobs.size(), offset/1024);
+}
+
+/* CheckpointReader */
+
+CheckpointReader::CheckpointReader(const char* _file) : file(_file) {
+    int fd = open(_file, O_RDONLY);
+    if (fd < 0) panic("Could not open checkpoint %s", _file);
+    struct stat st;
+    if (fstat(fd, &st) != 0) panic("Could not stat checkpoint %s", _file);
+    fileBytes = st.st_size;
+    if (fileBytes < sizeof(CheckpointHeader)) panic("Checkpoint %s is truncated", _file);
+    void* m = mmap(NULL, fileBytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (m == MAP_FAILED) panic("Could not map checkpoint %s", _file);
+    close(fd);
+    base = static_cast<const uint8_t*>(m);
+
+    const CheckpointHeader* hdr = reinterpret_cast<const CheckpointHeader*>(base);
+    if (hdr->magic != CHECKPOINT_MAGIC) panic("%s is not a checkpoint", _file);
+    if (hdr->version != CHECKPOINT_VERSION) {
+        panic("Checkpoint %s has version %d, but this build reads version %d", _file, hdr->version, CHECKPOINT_VERSION);
+    }
+    if (sizeof(CheckpointHeader) + (uint64_t)hdr->numBlobs*sizeof(CheckpointTableEntry) > fileBytes) panic("Checkpoint %s is truncated", _file);
+
+    const CheckpointTableEntry* table = reinterpret_cast<const CheckpointTableEntry*>(base + sizeof(CheckpointHeader));
+    for (uint32_t i = 0; i < hdr->numBlobs; i++) {
+        const CheckpointTableEntry& e = table[i];
+        if (strnlen(e.name, CHECKPOINT_NAME_BYTES) == CHECKPOINT_NAME_BYTES || e.offset + e.size > fileBytes) {
+            panic("Checkpoint %s is corrupted (blob %d)", _file, i);
+        }
+        index[e.name] = {e.offset, e.size, false};
+    }
+    info("Restoring checkpoint %s, taken at the end of phase %ld (%d blobs)", _file, hdr->phase, hdr->numBlobs);
+}
+
+CheckpointReader::~CheckpointReader() {
+    munmap(const_cast<uint8_t*>(base), fileBytes);
+}
+
+void CheckpointReader::blob(const std::string& name, void* data, size_t size) {
+    auto it = index.find(name);
+    if (it == index.end()) panic("Checkpoint %s has no state for %s (different system config?)", file.c_str(), name.c_str());
+    Blob& b = it->second;
+    if (b.size != size) {
+        panic("Checkpoint %s: %s has %ld bytes, expected %ld (different system config?)", file.c_str(), name.c_str(), b.size, size);
+    }
+    memcpy(data, base + b.offset, size);
+    b.restored = true;
+}
+
+void CheckpointReader::finish() {
+    for (auto& kv : index) {
+        if (!kv.second.restored) warn("Checkpoint %s: state for %s not used", file.c_str(), kv.first.c_str());
+    }
+}
+
+/* System-wide save and restore */
+
+static void CheckpointSystem(Checkpoint& ckpt) {
+    //Cache contents are physical addresses, so the page tables that produced them go along
+    if (zinfo->pageAllocator) zinfo->pageAllocator->checkpointState(ckpt);
+    for (BaseCache* cache : zinfo->caches) cache->checkpointState(ckpt);
+    for (MemObject* mem : zinfo->memoryControllers) mem->checkpointState(ckpt);
+    for (uint32_t i = 0; i < zinfo->numCores; i++) {
+        zinfo->cores[i]->checkpointState(ckpt);
+        if (zinfo->cores[i]->getMMU()) zinfo->cores[i]->getMMU()->checkpointState(ckpt);
+    }
+}
+
+void SaveCheckpoint(const char* file) {
+    CheckpointWriter ckpt;
+    CheckpointSystem(ckpt);
+    ckpt.write(file);
+}
+
+void RestoreCheckpoint(const char* file) {
+    CheckpointReader ckpt(file);
+    CheckpointSystem(ckpt);
+    ckpt.finish();
+}
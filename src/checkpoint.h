@@ -0,0 +1,124 @@
+/** $lic$
+ * Copyright (C) 2012-2014 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CHECKPOINT_H_
+#define CHECKPOINT_H_
+
+/* Checkpoints of microarchitectural state.
+ *
+ * A checkpoint captures the long-lived state of the simulated system: the
+ * tags, replacement and coherence state (including directory sharers) of
+ * every cache array, prefetcher tables, DRAM cache tags, branch predictors,
+ * TLBs, and the page allocator's page tables. It is saved at the end of a
+ * phase (sim.checkpointPhase, or the phase in which the application issues
+ * the checkpoint magic op), and restored right after initialization
+ * (sim.restoreCheckpoint), so later runs start warm and need no warmup.
+ *
+ * Each component describes its state once, as a list of named fixed-size
+ * blobs, in checkpointState(); the same method saves and restores, so the two
+ * cannot drift apart. The file is a header, a table of blob names, offsets
+ * and sizes, and the blobs, each aligned to a cache line, so restoring maps
+ * the file and copies each blob straight into place. A checkpoint can only be
+ * restored into a compatible system, i.e., the same version and the same
+ * blobs with the same sizes (same cache names, geometries, and policies);
+ * anything else panics. Transient timing state (e.g., bank occupancy, DRAM
+ * rows, filter caches) is not captured and starts cold.
+ */
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/* Bump this whenever the state of a checkpointed component changes meaning
+ * (not just size, which is checked per blob).
+ */
+#define CHECKPOINT_VERSION 1
+
+class Checkpoint {
+    public:
+        virtual ~Checkpoint() {}
+
+        virtual bool isRestoring() const = 0;
+
+        // Saves or restores size bytes at data. Names must be unique.
+        virtual void blob(const std::string& name, void* data, size_t size) = 0;
+
+        template <typename T> void value(const std::string& name, T& v) {
+            blob(name, &v, sizeof(T));
+        }
+
+        template <typename T> void array(const std::string& name, T* a, size_t n) {
+            blob(name, a, n*sizeof(T));
+        }
+};
+
+class CheckpointWriter : public Checkpoint {
+    private:
+        struct Blob {
+            std::string name;
+            const void* data;
+            size_t size;
+        };
+        std::vector<Blob> blobs;
+        std::unordered_set<std::string> names;
+
+    public:
+        bool isRestoring() const {return false;}
+        void blob(const std::string& name, void* data, size_t size);
+
+        // Writes all recorded blobs, which must not have changed since they were recorded
+        void write(const char* file);
+};
+
+class CheckpointReader : public Checkpoint {
+    private:
+        struct Blob {
+            uint64_t offset;
+            uint64_t size;
+            bool restored;
+        };
+        std::unordered_map<std::string, Blob> index;
+        std::string file;
+        const uint8_t* base;
+        size_t fileBytes;
+
+    public:
+        explicit CheckpointReader(const char* _file);
+        ~CheckpointReader();
+
+        bool isRestoring() const {return true;}
+        void blob(const std::string& name, void* data, size_t size);
+
+        // Warns about blobs in the file that nothing restored
+        void finish();
+};
+
+// Save or restore the state of all caches, memories, and cores
+void SaveCheckpoint(const char* file);
+void RestoreCheckpoint(const char* file);
+
+#endif  // CHECKPOINT_H_
@@ -26,6 +26,7 @@
 #include "coherence_ctrls.h"
 #include "cache.h"
 #include "network.h"
+#include "page_alloc.h"
 
 /* Do a simple XOR block hash on address to determine its bank. Hacky for now,
  * should probably have a class that deals with this with a real hash function
@@ -39,6 +40,11 @@ uint32_t MESIBottomCC::getParentId(Address lineAddr) {
         res ^= (uint32_t) ( ((uint64_t)0xffff) & tmp);
         tmp = tmp >> 16;
     }
+    if (numaNodes > 1) {
+        //Each node's lines go to its own controllers
+        uint32_t nodeParents = parents.size()/numaNodes;
+        return zinfo->pageAllocator->getNode(lineAddr)*nodeParents + (res % nodeParents);
+    }
     return (res % parents.size());
 }
 
@@ -46,14 +52,43 @@ uint32_t MESIBottomCC::getParentId(Address lineAddr) {
 void MESIBottomCC::init(const g_vector<MemObject*>& _parents, Network* network, const char* name) {
     parents.resize(_parents.size());
     parentRTTs.resize(_parents.size());
+    parentIsCache.resize(_parents.size());
     for (uint32_t p = 0; p < parents.size(); p++) {
         parents[p] = _parents[p];
         parentRTTs[p] = (network)? network->getRTT(name, parents[p]->getName()) : 0;
+        parentIsCache[p] = dynamic_cast<BaseCache*>(parents[p]) != NULL;
+    }
+
+    //Without an interleaver (sys.mem.splitAddrs = false), LLC banks pick the controller of each line's node themselves
+    if (zinfo->pageAllocator && zinfo->pageAllocator->getNumNodes() > 1 && parents.size() > 1 && !parentIsCache[0]) {
+        numaNodes = zinfo->pageAllocator->getNumNodes();
+        if (parents.size() % numaNodes) panic("%s: %ld memory controllers can't be split evenly across %d NUMA nodes", name, parents.size(), numaNodes);
     }
 }
 
+/* Warming accesses are not sent to memory: memory controllers would
+ * simulate them. Instead, grant the permissions memory would.
+ */
+uint64_t MESIBottomCC::accessParent(uint32_t parentId, MemReq& req) {
+    if (likely(!req.is(MemReq::WARM) || parentIsCache[parentId])) return parents[parentId]->access(req);
+    switch (req.type) {
+        case PUTS:
+        case PUTX:
+            *req.state = I;
+            break;
+        case GETS:
+            *req.state = req.is(MemReq::NOEXCL)? S : E;
+            break;
+        case GETX:
+            *req.state = M;
+            break;
+        default: panic("!?");
+    }
+    return req.cycle;
+}
+
 
-uint64_t MESIBottomCC::processEviction(Address wbLineAddr, uint32_t lineId, bool lowerLevelWriteback, uint64_t cycle, uint32_t srcId) {
+uint64_t MESIBottomCC::processEviction(Address wbLineAddr, uint32_t lineId, bool lowerLevelWriteback, uint64_t cycle, uint32_t srcId, uint32_t flags) {
     MESIState* state = &array[lineId];
     if (lowerLevelWriteback) {
         //If this happens, when tcc issued the invalidations, it got a writeback. This means we have to do a PUTX, i.e. we have to transition to M if we are in E
@@ -67,14 +102,14 @@ uint64_t MESIBottomCC::processEviction(Address wbLineAddr, uint32_t lineId, bool
         case S:
         case E:
             {
-                MemReq req = {wbLineAddr, PUTS, selfId, state, cycle, &ccLock, *state, srcId, 0 /*no flags*/};
-                respCycle = parents[getParentId(wbLineAddr)]->access(req);
+                MemReq req = {wbLineAddr, PUTS, selfId, state, cycle, &ccLock, *state, srcId, flags & MemReq::WARM /*no other flags*/};
+                respCycle = accessParent(getParentId(wbLineAddr), req);
             }
             break;
         case M:
             {
-                MemReq req = {wbLineAddr, PUTX, selfId, state, cycle, &ccLock, *state, srcId, 0 /*no flags*/};
-                respCycle = parents[getParentId(wbLineAddr)]->access(req);
+                MemReq req = {wbLineAddr, PUTX, selfId, state, cycle, &ccLock, *state, srcId, flags & MemReq::WARM /*no other flags*/};
+                respCycle = accessParent(getParentId(wbLineAddr), req);
             }
             break;
 
@@ -87,11 +122,12 @@ uint64_t MESIBottomCC::processEviction(Address wbLineAddr, uint32_t lineId, bool
 uint64_t MESIBottomCC::processAccess(Address lineAddr, uint32_t lineId, AccessType type, uint64_t cycle, uint32_t srcId, uint32_t flags) {
     uint64_t respCycle = cycle;
     MESIState* state = &array[lineId];
+    bool warm = flags & MemReq::WARM; //warming accesses are not profiled
     switch (type) {
         // A PUTS/PUTX does nothing w.r.t. higher coherence levels --- it dies here
         case PUTS: //Clean writeback, nothing to do (except profiling)
             assert(*state != I);
-            profPUTS.inc();
+            if (!warm) profPUTS.inc();
             break;
         case PUTX: //Dirty writeback
             assert(*state == M || *state == E);
@@ -99,35 +135,41 @@ uint64_t MESIBottomCC::processAccess(Address lineAddr, uint32_t lineId, AccessTy
                 //Silent transition, record that block was written to
                 *state = M;
             }
-            profPUTX.inc();
+            if (!warm) profPUTX.inc();
             break;
         case GETS:
             if (*state == I) {
                 uint32_t parentId = getParentId(lineAddr);
                 MemReq req = {lineAddr, GETS, selfId, state, cycle, &ccLock, *state, srcId, flags};
-                uint32_t nextLevelLat = parents[parentId]->access(req) - cycle;
+                uint32_t nextLevelLat = accessParent(parentId, req) - cycle;
                 uint32_t netLat = parentRTTs[parentId];
-                profGETNextLevelLat.inc(nextLevelLat);
-                profGETNetLat.inc(netLat);
                 respCycle += nextLevelLat + netLat;
-                profGETSMiss.inc();
+                if (!warm) {
+                    profGETNextLevelLat.inc(nextLevelLat);
+                    profGETNetLat.inc(netLat);
+                    profGETSMiss.inc();
+                }
                 assert(*state == S || *state == E);
-            } else {
+            } else if (!warm) {
                 profGETSHit.inc();
             }
             break;
         case GETX:
             if (*state == I || *state == S) {
                 //Profile before access, state changes
-                if (*state == I) profGETXMissIM.inc();
-                else profGETXMissSM.inc();
+                if (!warm) {
+                    if (*state == I) profGETXMissIM.inc();
+                    else profGETXMissSM.inc();
+                }
                 uint32_t parentId = getParentId(lineAddr);
                 MemReq req = {lineAddr, GETX, selfId, state, cycle, &ccLock, *state, srcId, flags};
-                uint32_t nextLevelLat = parents[parentId]->access(req) - cycle;
+                uint32_t nextLevelLat = accessParent(parentId, req) - cycle;
                 uint32_t netLat = parentRTTs[parentId];
-                profGETNextLevelLat.inc(nextLevelLat);
-                profGETNetLat.inc(netLat);
                 respCycle += nextLevelLat + netLat;
+                if (!warm) {
+                    profGETNextLevelLat.inc(nextLevelLat);
+                    profGETNetLat.inc(netLat);
+                }
             } else {
                 if (*state == E) {
                     // Silent transition
@@ -139,7 +181,7 @@ uint64_t MESIBottomCC::processAccess(Address lineAddr, uint32_t lineId, AccessTy
                      */
                     *state = M;
                 }
-                profGETXHit.inc();
+                if (!warm) profGETXHit.inc();
             }
             assert_msg(*state == M, "Wrong final state on GETX, lineId %d numLines %d, finalState %s", lineId, numLines, MESIStateName(*state));
             break;
@@ -159,7 +201,7 @@ void MESIBottomCC::processWritebackOnAccess(Address lineAddr, uint32_t lineId, A
     }
 }
 
-void MESIBottomCC::processInval(Address lineAddr, uint32_t lineId, InvType type, bool* reqWriteback) {
+void MESIBottomCC::processInval(Address lineAddr, uint32_t lineId, InvType type, bool* reqWriteback, uint32_t flags) {
     MESIState* state = &array[lineId];
     assert(*state != I);
     switch (type) {
@@ -168,17 +210,17 @@ void MESIBottomCC::processInval(Address lineAddr, uint32_t lineId, InvType type,
             assert_msg(*state == E || *state == M, "Invalid state %s", MESIStateName(*state));
             if (*state == M) *reqWriteback = true;
             *state = S;
-            profINVX.inc();
+            if (!(flags & MemReq::WARM)) profINVX.inc();
             break;
         case INV: //invalidate
             assert(*state != I);
             if (*state == M) *reqWriteback = true;
             *state = I;
-            profINV.inc();
+            if (!(flags & MemReq::WARM)) profINV.inc();
             break;
         case FWD: //forward
             assert_msg(*state == S, "Invalid state %s on FWD", MESIStateName(*state));
-            profFWD.inc();
+            if (!(flags & MemReq::WARM)) profFWD.inc();
             break;
         default: panic("!?");
     }
@@ -191,7 +233,7 @@ uint64_t MESIBottomCC::processNonInclusiveWriteback(Address lineAddr, AccessType
 
     //info("Non-inclusive wback, forwarding");
     MemReq req = {lineAddr, type, selfId, state, cycle, &ccLock, *state, srcId, flags | MemReq::NONINCLWB};
-    uint64_t respCycle = parents[getParentId(lineAddr)]->access(req);
+    uint64_t respCycle = accessParent(getParentId(lineAddr), req);
     return respCycle;
 }
 
@@ -210,7 +252,7 @@ void MESITopCC::init(const g_vector<BaseCache*>& _children, Network* network, co
     }
 }
 
-uint64_t MESITopCC::sendInvalidates(Address lineAddr, uint32_t lineId, InvType type, bool* reqWriteback, uint64_t cycle, uint32_t srcId) {
+uint64_t MESITopCC::sendInvalidates(Address lineAddr, uint32_t lineId, InvType type, bool* reqWriteback, uint64_t cycle, uint32_t srcId, uint32_t flags) {
     //Send down downgrades/invalidates
     Entry* e = &array[lineId];
 
@@ -225,7 +267,7 @@ uint64_t MESITopCC::sendInvalidates(Address lineAddr, uint32_t lineId, InvType t
         uint32_t sentInvs = 0;
         for (uint32_t c = 0; c < numChildren; c++) {
             if (e->sharers[c]) {
-                uint64_t respCycle = children[c]->invalidate(lineAddr, type, reqWriteback, cycle, srcId);
+                uint64_t respCycle = children[c]->invalidate(lineAddr, type, reqWriteback, cycle, srcId, flags & MemReq::WARM);
                 respCycle += childrenRTTs[c];
                 maxCycle = MAX(respCycle, maxCycle);
                 if (type == INV) e->sharers[c] = false;
@@ -246,14 +288,14 @@ uint64_t MESITopCC::sendInvalidates(Address lineAddr, uint32_t lineId, InvType t
 }
 
 
-uint64_t MESITopCC::processEviction(Address wbLineAddr, uint32_t lineId, bool* reqWriteback, uint64_t cycle, uint32_t srcId) {
+uint64_t MESITopCC::processEviction(Address wbLineAddr, uint32_t lineId, bool* reqWriteback, uint64_t cycle, uint32_t srcId, uint32_t flags) {
     if (nonInclusiveHack) {
         // Don't invalidate anything, just clear our entry
         array[lineId].clear();
         return cycle;
     } else {
         //Send down invalidates
-        return sendInvalidates(wbLineAddr, lineId, INV, reqWriteback, cycle, srcId);
+        return sendInvalidates(wbLineAddr, lineId, INV, reqWriteback, cycle, srcId, flags);
     }
 }
 
@@ -290,7 +332,7 @@ uint64_t MESITopCC::processAccess(Address lineAddr, uint32_t lineId, AccessType
 
                 if (e->isExclusive()) {
                     //Downgrade the exclusive sharer
-                    respCycle = sendInvalidates(lineAddr, lineId, INVX, inducedWriteback, cycle, srcId);
+                    respCycle = sendInvalidates(lineAddr, lineId, INVX, inducedWriteback, cycle, srcId, flags);
                 }
 
                 assert_msg(!e->isExclusive(), "Can't have exclusivity here. isExcl=%d excl=%d numSharers=%d", e->isExclusive(), e->exclusive, e->numSharers);
@@ -312,7 +354,7 @@ uint64_t MESITopCC::processAccess(Address lineAddr, uint32_t lineId, AccessType
             }
 
             // Invalidate all other copies
-            respCycle = sendInvalidates(lineAddr, lineId, INV, inducedWriteback, cycle, srcId);
+            respCycle = sendInvalidates(lineAddr, lineId, INV, inducedWriteback, cycle, srcId, flags);
 
             // Set current sharer, mark exclusive
             e->sharers[childId] = true;
@@ -330,13 +372,13 @@ uint64_t MESITopCC::processAccess(Address lineAddr, uint32_t lineId, AccessType
     return respCycle;
 }
 
-uint64_t MESITopCC::processInval(Address lineAddr, uint32_t lineId, InvType type, bool* reqWriteback, uint64_t cycle, uint32_t srcId) {
+uint64_t MESITopCC::processInval(Address lineAddr, uint32_t lineId, InvType type, bool* reqWriteback, uint64_t cycle, uint32_t srcId, uint32_t flags) {
     if (type == FWD) {//if it's a FWD, we should be inclusive for now, so we must have the line, just invLat works
         assert(!nonInclusiveHack); //dsm: ask me if you see this failing and don't know why
         return cycle;
     } else {
         //Just invalidate or downgrade down to children as needed
-        return sendInvalidates(lineAddr, lineId, type, reqWriteback, cycle, srcId);
+        return sendInvalidates(lineAddr, lineId, type, reqWriteback, cycle, srcId, flags);
     }
 }
 
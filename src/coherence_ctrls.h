@@ -27,6 +27,7 @@
 #define COHERENCE_CTRLS_H_
 
 #include <bitset>
+#include "checkpoint.h"
 #include "constants.h"
 #include "g_std/g_string.h"
 #include "g_std/g_vector.h"
@@ -54,11 +55,14 @@ class CC : public GlobAlloc {
 
         //Inv methods
         virtual void startInv() = 0;
-        virtual uint64_t processInv(Address lineAddr, int32_t lineId, InvType type, bool* reqWriteback, uint64_t startCycle, uint32_t srcId) = 0;
+        virtual uint64_t processInv(Address lineAddr, int32_t lineId, InvType type, bool* reqWriteback, uint64_t startCycle, uint32_t srcId, uint32_t flags) = 0;
 
         //Repl policy interface
         virtual uint32_t numSharers(uint32_t lineId) = 0;
         virtual bool isValid(uint32_t lineId) = 0;
+
+        //Checkpoint interface (see checkpoint.h)
+        virtual void checkpointState(Checkpoint& ckpt, const std::string& prefix) = 0;
 };
 
 
@@ -83,6 +87,8 @@ class MESIBottomCC : public GlobAlloc {
         MESIState* array;
         g_vector<MemObject*> parents;
         g_vector<uint32_t> parentRTTs;
+        g_vector<bool> parentIsCache; //warming accesses stop at the last cache level
+        uint32_t numaNodes; //if > 1, parents are memory controllers split evenly across NUMA nodes (see page_alloc.h)
         uint32_t numLines;
         uint32_t selfId;
 
@@ -101,7 +107,7 @@ class MESIBottomCC : public GlobAlloc {
         PAD();
 
     public:
-        MESIBottomCC(uint32_t _numLines, uint32_t _selfId, bool _nonInclusiveHack) : numLines(_numLines), selfId(_selfId), nonInclusiveHack(_nonInclusiveHack) {
+        MESIBottomCC(uint32_t _numLines, uint32_t _selfId, bool _nonInclusiveHack) : numaNodes(1), numLines(_numLines), selfId(_selfId), nonInclusiveHack(_nonInclusiveHack) {
             array = gm_calloc<MESIState>(numLines);
             for (uint32_t i = 0; i < numLines; i++) {
                 array[i] = I;
@@ -144,13 +150,13 @@ class MESIBottomCC : public GlobAlloc {
             parentStat->append(&profGETNetLat);
         }
 
-        uint64_t processEviction(Address wbLineAddr, uint32_t lineId, bool lowerLevelWriteback, uint64_t cycle, uint32_t srcId);
+        uint64_t processEviction(Address wbLineAddr, uint32_t lineId, bool lowerLevelWriteback, uint64_t cycle, uint32_t srcId, uint32_t flags);
 
         uint64_t processAccess(Address lineAddr, uint32_t lineId, AccessType type, uint64_t cycle, uint32_t srcId, uint32_t flags);
 
         void processWritebackOnAccess(Address lineAddr, uint32_t lineId, AccessType type);
 
-        void processInval(Address lineAddr, uint32_t lineId, InvType type, bool* reqWriteback);
+        void processInval(Address lineAddr, uint32_t lineId, InvType type, bool* reqWriteback, uint32_t flags);
 
         uint64_t processNonInclusiveWriteback(Address lineAddr, AccessType type, uint64_t cycle, MESIState* state, uint32_t srcId, uint32_t flags);
 
@@ -167,10 +173,15 @@ class MESIBottomCC : public GlobAlloc {
             return array[lineId] != I;
         }
 
+        void checkpointState(Checkpoint& ckpt, const std::string& prefix) {
+            ckpt.array(prefix + ".states", array, numLines);
+        }
+
         //Could extend with isExclusive, isDirty, etc, but not needed for now.
 
     private:
         uint32_t getParentId(Address lineAddr);
+        uint64_t accessParent(uint32_t parentId, MemReq& req);
 };
 
 
@@ -220,12 +231,12 @@ class MESITopCC : public GlobAlloc {
 
         void init(const g_vector<BaseCache*>& _children, Network* network, const char* name);
 
-        uint64_t processEviction(Address wbLineAddr, uint32_t lineId, bool* reqWriteback, uint64_t cycle, uint32_t srcId);
+        uint64_t processEviction(Address wbLineAddr, uint32_t lineId, bool* reqWriteback, uint64_t cycle, uint32_t srcId, uint32_t flags);
 
         uint64_t processAccess(Address lineAddr, uint32_t lineId, AccessType type, uint32_t childId, bool haveExclusive,
                 MESIState* childState, bool* inducedWriteback, uint64_t cycle, uint32_t srcId, uint32_t flags);
 
-        uint64_t processInval(Address lineAddr, uint32_t lineId, InvType type, bool* reqWriteback, uint64_t cycle, uint32_t srcId);
+        uint64_t processInval(Address lineAddr, uint32_t lineId, InvType type, bool* reqWriteback, uint64_t cycle, uint32_t srcId, uint32_t flags);
 
         inline void lock() {
             futex_lock(&ccLock);
@@ -240,8 +251,12 @@ class MESITopCC : public GlobAlloc {
             return array[lineId].numSharers;
         }
 
+        void checkpointState(Checkpoint& ckpt, const std::string& prefix) {
+            ckpt.array(prefix + ".sharers", array, numLines);
+        }
+
     private:
-        uint64_t sendInvalidates(Address lineAddr, uint32_t lineId, InvType type, bool* reqWriteback, uint64_t cycle, uint32_t srcId);
+        uint64_t sendInvalidates(Address lineAddr, uint32_t lineId, InvType type, bool* reqWriteback, uint64_t cycle, uint32_t srcId, uint32_t flags);
 };
 
 static inline bool CheckForMESIRace(AccessType& type, MESIState* state, MESIState initialState) {
@@ -339,8 +354,8 @@ class MESICC : public CC {
 
         uint64_t processEviction(const MemReq& triggerReq, Address wbLineAddr, int32_t lineId, uint64_t startCycle) {
             bool lowerLevelWriteback = false;
-            uint64_t evCycle = tcc->processEviction(wbLineAddr, lineId, &lowerLevelWriteback, startCycle, triggerReq.srcId); //1. if needed, send invalidates/downgrades to lower level
-            evCycle = bcc->processEviction(wbLineAddr, lineId, lowerLevelWriteback, evCycle, triggerReq.srcId); //2. if needed, write back line to upper level
+            uint64_t evCycle = tcc->processEviction(wbLineAddr, lineId, &lowerLevelWriteback, startCycle, triggerReq.srcId, triggerReq.flags); //1. if needed, send invalidates/downgrades to lower level
+            evCycle = bcc->processEviction(wbLineAddr, lineId, lowerLevelWriteback, evCycle, triggerReq.srcId, triggerReq.flags); //2. if needed, write back line to upper level
             return evCycle;
         }
 
@@ -394,9 +409,9 @@ class MESICC : public CC {
             bcc->lock(); //note we don't grab tcc; tcc serializes multiple up accesses, down accesses don't see it
         }
 
-        uint64_t processInv(Address lineAddr, int32_t lineId, InvType type, bool* reqWriteback, uint64_t startCycle, uint32_t srcId) {
-            uint64_t respCycle = tcc->processInval(lineAddr, lineId, type, reqWriteback, startCycle, srcId); //send invalidates or downgrades to children
-            bcc->processInval(lineAddr, lineId, type, reqWriteback); //adjust our own state
+        uint64_t processInv(Address lineAddr, int32_t lineId, InvType type, bool* reqWriteback, uint64_t startCycle, uint32_t srcId, uint32_t flags) {
+            uint64_t respCycle = tcc->processInval(lineAddr, lineId, type, reqWriteback, startCycle, srcId, flags); //send invalidates or downgrades to children
+            bcc->processInval(lineAddr, lineId, type, reqWriteback, flags); //adjust our own state
 
             bcc->unlock();
             return respCycle;
@@ -405,6 +420,11 @@ class MESICC : public CC {
         //Repl policy interface
         uint32_t numSharers(uint32_t lineId) {return tcc->numSharers(lineId);}
         bool isValid(uint32_t lineId) {return bcc->isValid(lineId);}
+
+        void checkpointState(Checkpoint& ckpt, const std::string& prefix) {
+            bcc->checkpointState(ckpt, prefix + ".bottom");
+            tcc->checkpointState(ckpt, prefix + ".top");
+        }
 };
 
 // Terminal CC, i.e., without children --- accepts GETS/X, but not PUTS/X
@@ -458,7 +478,7 @@ class MESITerminalCC : public CC {
 
         uint64_t processEviction(const MemReq& triggerReq, Address wbLineAddr, int32_t lineId, uint64_t startCycle) {
             bool lowerLevelWriteback = false;
-            uint64_t endCycle = bcc->processEviction(wbLineAddr, lineId, lowerLevelWriteback, startCycle, triggerReq.srcId); //2. if needed, write back line to upper level
+            uint64_t endCycle = bcc->processEviction(wbLineAddr, lineId, lowerLevelWriteback, startCycle, triggerReq.srcId, triggerReq.flags); //2. if needed, write back line to upper level
             return endCycle;  // critical path unaffected, but TimingCache needs it
         }
 
@@ -484,8 +504,8 @@ class MESITerminalCC : public CC {
             bcc->lock();
         }
 
-        uint64_t processInv(Address lineAddr, int32_t lineId, InvType type, bool* reqWriteback, uint64_t startCycle, uint32_t srcId) {
-            bcc->processInval(lineAddr, lineId, type, reqWriteback); //adjust our own state
+        uint64_t processInv(Address lineAddr, int32_t lineId, InvType type, bool* reqWriteback, uint64_t startCycle, uint32_t srcId, uint32_t flags) {
+            bcc->processInval(lineAddr, lineId, type, reqWriteback, flags); //adjust our own state
             bcc->unlock();
             return startCycle; //no extra delay in terminal caches
         }
@@ -493,6 +513,10 @@ class MESITerminalCC : public CC {
         //Repl policy interface
         uint32_t numSharers(uint32_t lineId) {return 0;} //no sharers
         bool isValid(uint32_t lineId) {return bcc->isValid(lineId);}
+
+        void checkpointState(Checkpoint& ckpt, const std::string& prefix) {
+            bcc->checkpointState(ckpt, prefix + ".bottom");
+        }
 };
 
 #endif  // COHERENCE_CTRLS_H_
@@ -41,6 +41,11 @@
 #define POST_MORTEM 0
 //#define POST_MORTEM 1
 
+//Max events a sim thread simulates on a domain before giving it back to the shared queue
+#define DOMAIN_QUANTUM 256
+
+enum SimThreadState {SIMTHREAD_SLEEP, SIMTHREAD_BUSY, SIMTHREAD_IDLE};
+
 bool ContentionSim::CompareEvents::operator()(TimingEvent* lhs, TimingEvent* rhs) const {
     return lhs->cycle > rhs->cycle;
 }
@@ -61,6 +66,13 @@ void ContentionSim::SimThreadTrampoline(void* arg) {
 ContentionSim::ContentionSim(uint32_t _numDomains, uint32_t _numSimThreads) {
     numDomains = _numDomains;
     numSimThreads = _numSimThreads;
+    if (numSimThreads > numDomains) {
+        warn("More contention threads (%d) than domains (%d), extra threads would always idle", numSimThreads, numDomains);
+        numSimThreads = numDomains;
+    }
+    //Keep the lookahead of the original static split: a thread that owned a single domain stopped before limit,
+    //while threads that multiplexed domains also ran the events at limit
+    runLimitEvents = numDomains > numSimThreads;
     threadsDone = 0;
     limit = 0;
     lastLimit = 0;
@@ -72,16 +84,23 @@ ContentionSim::ContentionSim(uint32_t _numDomains, uint32_t _numSimThreads) {
     for (uint32_t i = 0; i < numDomains; i++) {
         new (&domains[i].pq) PrioQueue<TimingEvent, PQ_BLOCKS>();
         domains[i].curCycle = 0;
+        domains[i].drainedLimit = -1L;
         futex_init(&domains[i].pqLock);
     }
 
-    if ((numDomains % numSimThreads) != 0) panic("numDomains(%d) must be a multiple of numSimThreads(%d) for now", numDomains, numSimThreads);
+    futex_init(&domQueueLock);
+    domQueue.reserve(numDomains);
+    domQueueSize = 0;
+    domainsDone = 0;
+
+    //Cores are known by now (see InitSystem); anything enqueued before they run takes the locked path
+    numStagingCores = zinfo->numCores;
+    staging = gm_memalign<StagingBuffer>(CACHE_LINE_BYTES, numStagingCores*numDomains);
+    for (uint32_t i = 0; i < numStagingCores*numDomains; i++) staging[i].size = 0;
 
     for (uint32_t i = 0; i < numSimThreads; i++) {
         futex_init(&simThreads[i].wakeLock);
         futex_lock(&simThreads[i].wakeLock); //starts locked, so first actual call to lock blocks
-        simThreads[i].firstDomain = i*numDomains/numSimThreads;
-        simThreads[i].supDomain = (i+1)*numDomains/numSimThreads;
     }
 
     futex_init(&waitLock);
@@ -140,6 +159,17 @@ void ContentionSim::initStats(AggregateStat* parentStat) {
         domStat->append(&domains[i].profTime);
         objStat->append(domStat);
     }
+    for (uint32_t i = 0; i < numSimThreads; i++) {
+        std::stringstream ss;
+        ss << "thread-" << i;
+        AggregateStat* thStat = new AggregateStat();
+        thStat->init(gm_strdup(ss.str().c_str()), "Simulation thread stats");
+        new (&simThreads[i].profTime) TimeBreakdownStat();
+        const char* stateNames[] = {"sleep", "busy", "idle"};
+        simThreads[i].profTime.init("time", "Weave thread time breakdown (ns)", 3, stateNames);
+        thStat->append(&simThreads[i].profTime);
+        objStat->append(thStat);
+    }
     parentStat->append(objStat);
 }
 
@@ -157,6 +187,16 @@ void ContentionSim::simulatePhase(uint64_t limit) {
         if (ocore) ocore->cSimStart();
     }
 
+    //All domains start unfinished; their staged events are drained by whichever thread claims them first
+    domainsDone = 0;
+    assert(domQueue.empty());
+    for (uint32_t i = 0; i < numDomains; i++) {
+        domains[i].queuePrio = domains[i].curCycle;
+        domQueue.push_back(&domains[i]);
+    }
+    std::make_heap(domQueue.begin(), domQueue.end(), CompareDomains());
+    domQueueSize = numDomains;
+
     inCSim = true;
     __sync_synchronize();
 
@@ -204,18 +244,43 @@ void ContentionSim::enqueueSynced(TimingEvent* ev, uint64_t cycle) {
     assert(ev->domain < (int32_t)numDomains);
     uint32_t domain = ev->domain;
 
-    futex_lock(&domains[domain].pqLock);
-
     assert_msg(cycle >= lastLimit, "Enqueued (synced) event before last limit! cycle %ld min %ld", cycle, lastLimit);
     //Hacky, but helpful to chase events scheduled too far ahead due to bugs (e.g., cycle -1). We should probably formalize this a bit more
     assert_msg(cycle < lastLimit+10*zinfo->phaseLength+10000, "Queued  (synced) event too far into the future, cycle %ld lastLimit %ld", cycle, lastLimit);
     ev->privCycle = cycle;
     assert(ev->numParents == 0);
-    domains[ev->domain].pq.enqueue(ev, cycle);
 
+    //Fast path: threads running on a core own that core's staging buffers
+    uint32_t tid = PIN_ThreadId();
+    uint32_t cid = (tid < MAX_THREADS)? getCid(tid) : (uint32_t)-1;
+    if (cid < numStagingCores) {
+        StagingBuffer& sb = staging[cid*numDomains + domain];
+        uint32_t size = sb.size;
+        if (size < STAGING_SLOTS) {
+            sb.evs[size] = ev;
+            sb.size = size + 1;
+            return;
+        }
+    }
+
+    futex_lock(&domains[domain].pqLock);
+    domains[domain].pq.enqueue(ev, cycle);
     futex_unlock(&domains[domain].pqLock);
 }
 
+void ContentionSim::drainStaging(uint32_t domain) {
+    PrioQueue<TimingEvent, PQ_BLOCKS>& pq = domains[domain].pq;
+    for (uint32_t c = 0; c < numStagingCores; c++) {
+        StagingBuffer& sb = staging[c*numDomains + domain];
+        uint32_t size = sb.size;
+        for (uint32_t i = 0; i < size; i++) {
+            TimingEvent* ev = sb.evs[i];
+            pq.enqueue(ev, ev->privCycle);
+        }
+        sb.size = 0;
+    }
+}
+
 void ContentionSim::enqueueCrossing(CrossingEvent* ev, uint64_t cycle, uint32_t srcId, uint32_t srcDomain, uint32_t dstDomain, EventRecorder* evRec) {
     CrossingStack& cs = evRec->getCrossingStack();
     bool isFirst = cs.empty();
@@ -288,123 +353,114 @@ void ContentionSim::simThreadLoop(uint32_t thid) {
     info("Finished contention simulation thread %d", thid);
 }
 
+ContentionSim::DomainData* ContentionSim::claimDomain() {
+    DomainData* domain = NULL;
+    if (!domQueueSize) return NULL; //don't contend for the lock when there is nothing to claim
+    futex_lock(&domQueueLock);
+    if (domQueue.size()) {
+        std::pop_heap(domQueue.begin(), domQueue.end(), CompareDomains());
+        domain = domQueue.back();
+        domQueue.pop_back();
+        domQueueSize = domQueue.size();
+    }
+    futex_unlock(&domQueueLock);
+    return domain;
+}
+
+void ContentionSim::returnDomain(DomainData* domain) {
+    futex_lock(&domQueueLock);
+    domQueue.push_back(domain);
+    std::push_heap(domQueue.begin(), domQueue.end(), CompareDomains());
+    domQueueSize = domQueue.size();
+    futex_unlock(&domQueueLock);
+}
+
 void ContentionSim::simulatePhaseThread(uint32_t thid) {
-    uint32_t thDomains = simThreads[thid].supDomain - simThreads[thid].firstDomain;
-    uint32_t numFinished = 0;
-
-    if (thDomains == 1) {
-        DomainData& domain = domains[simThreads[thid].firstDomain];
-        domain.profTime.start();
-        PrioQueue<TimingEvent, PQ_BLOCKS>& pq = domain.pq;
-        while (pq.size() && pq.firstCycle() < limit) {
-            uint64_t domCycle = domain.curCycle;
+    SimThreadData& st = simThreads[thid];
+    uint32_t state = SIMTHREAD_SLEEP;
+
+    //Domains are scheduled dynamically: claim the most lagging domain, simulate it for a quantum or until it stalls
+    //on a crossing, then give it back. Lagging domains are the ones others wait on, so this preserves progress
+    //regardless of how domains are spread across threads.
+    while (domainsDone < numDomains) {
+        DomainData* domain = claimDomain();
+        uint32_t newState = domain? SIMTHREAD_BUSY : SIMTHREAD_IDLE;
+        if (newState != state) {
+            st.profTime.transition(newState);
+            state = newState;
+        }
+        if (!domain) {
+            //Spin on reads only until a domain is returned or the last one finishes, so that idle threads
+            //don't slow down returnDomain() on the busy ones
+            while (!domQueueSize && domainsDone < numDomains) _mm_pause();
+            continue;
+        }
+
+        uint32_t domIdx = domain - domains;
+        if (domain->drainedLimit != limit) {
+            drainStaging(domIdx);
+            domain->drainedLimit = limit;
+        }
+
+        domain->profTime.start();
+        PrioQueue<TimingEvent, PQ_BLOCKS>& pq = domain->pq;
+        bool finished = false;
+        for (uint32_t i = 0; i < DOMAIN_QUANTUM; i++) {
+            if (!pq.size() || pq.firstCycle() > limit || (pq.firstCycle() == limit && !runLimitEvents)) {
+                finished = true;
+                break;
+            }
             uint64_t cycle;
             TimingEvent* te = pq.dequeue(cycle);
-            assert(cycle >= domCycle);
-            if (cycle != domCycle) {
-                domCycle = cycle;
-                domain.curCycle = cycle;
-            }
+            assert(cycle >= domain->curCycle);
+            if (cycle != domain->curCycle) domain->curCycle = cycle;
             te->run(cycle);
-            uint64_t newCycle = pq.size()? pq.firstCycle() : limit;
-            assert(newCycle >= domCycle);
-            if (newCycle != domCycle) domain.curCycle = newCycle;
+            domain->curCycle = pq.size()? pq.firstCycle() : limit;
 #if POST_MORTEM
-            simThreads[thid].logVec.push_back(std::make_pair(cycle, te));
+            st.logVec.push_back(std::make_pair(cycle, te));
 #endif
+            if (domain->prio != 0) break;  // stalled on a crossing, let its source domain make progress
         }
-        domain.curCycle = limit;
-        domain.profTime.end();
-
-#if POST_MORTEM
-        //Post-mortem
-        if (limit % 10000000 == 0)  {
-            futex_lock(&postMortemLock); //serialize output
-            uint32_t uniqueEvs = 0;
-            std::unordered_map<TimingEvent*, std::string> evsSeen;
-            for (std::pair<uint64_t, TimingEvent*> p : simThreads[thid].logVec) {
-                uint64_t cycle = p.first;
-                TimingEvent* te = p.second;
-                std::string desc = evsSeen[te];
-                if (desc == "") { //non-existnt
-                    std::stringstream ss;
-                    ss << uniqueEvs << " " << typeid(*te).name();
-                    CrossingEvent* ce = dynamic_cast<CrossingEvent*>(te);
-                    if (ce) {
-                        ss << " slack " << (ce->preSlack + ce->postSlack) << " osc " << ce->origStartCycle << " cnt " << ce->simCount;
-                    }
-
-                    evsSeen[te] = ss.str();
-                    uniqueEvs++;
-                    desc = ss.str();
-                }
-                info("[%d] %ld %s", thid, cycle, desc.c_str());
-            }
-            futex_unlock(&postMortemLock);
-        }
-        simThreads[thid].logVec.clear();
-#endif
-
-    } else {
-        //info("XXX %d / %d %d %d", thid, thDomains, simThreads[thid].supDomain, simThreads[thid].firstDomain);
+        domain->profTime.end();
 
-        std::priority_queue<DomainData*, std::vector<DomainData*>, CompareDomains> domPq;
-        for (uint32_t i = simThreads[thid].firstDomain; i < simThreads[thid].supDomain; i++) {
-            domPq.push(&domains[i]);
+        if (finished) {
+            domain->curCycle = limit;
+            __sync_fetch_and_add(&domainsDone, 1);
+        } else {
+            domain->queuePrio = domain->curCycle;
+            returnDomain(domain);
         }
+    }
+    st.profTime.transition(SIMTHREAD_SLEEP);
 
-        std::vector<DomainData*> sq1;
-        std::vector<DomainData*> sq2;
-
-        std::vector<DomainData*>& stalledQueue = sq1;
-        std::vector<DomainData*>& nextStalledQueue = sq2;
-
-        while (numFinished < thDomains) {
-            while (domPq.size()) {
-                DomainData* domain = domPq.top();
-                domPq.pop();
-                PrioQueue<TimingEvent, PQ_BLOCKS>& pq = domain->pq;
-                if (!pq.size() || pq.firstCycle() > limit) {
-                    numFinished++;
-                    domain->curCycle = limit;
-                } else {
-                    //info("YYY %d %ld %ld %d", numFinished, domPq.size(), domain->curCycle, domain->prio);
-                    uint64_t cycle;
-                    TimingEvent* te = pq.dequeue(cycle);
-                    //uint64_t nextCycle = pq.size()? pq.firstCycle() : cycle;
-                    if (cycle != domain->curCycle) domain->curCycle = cycle;
-                    te->run(cycle);
-                    domain->curCycle = pq.size()? pq.firstCycle() : limit;
-                    domain->queuePrio = domain->curCycle;
-                    if (domain->prio == 0) domPq.push(domain);
-                    else stalledQueue.push_back(domain);
+#if POST_MORTEM
+    //Post-mortem
+    if (limit % 10000000 == 0)  {
+        futex_lock(&postMortemLock); //serialize output
+        uint32_t uniqueEvs = 0;
+        std::unordered_map<TimingEvent*, std::string> evsSeen;
+        for (std::pair<uint64_t, TimingEvent*> p : st.logVec) {
+            uint64_t cycle = p.first;
+            TimingEvent* te = p.second;
+            std::string desc = evsSeen[te];
+            if (desc == "") { //non-existnt
+                std::stringstream ss;
+                ss << uniqueEvs << " " << typeid(*te).name();
+                CrossingEvent* ce = dynamic_cast<CrossingEvent*>(te);
+                if (ce) {
+                    ss << " slack " << (ce->preSlack + ce->postSlack) << " osc " << ce->origStartCycle << " cnt " << ce->simCount;
                 }
-            }
 
-            while (stalledQueue.size()) {
-                DomainData* domain = stalledQueue.back();
-                stalledQueue.pop_back();
-                PrioQueue<TimingEvent, PQ_BLOCKS>& pq = domain->pq;
-                if (!pq.size() || pq.firstCycle() > limit) {
-                    numFinished++;
-                    domain->curCycle = limit;
-                } else {
-                    //info("SSS %d %ld %ld", numFinished, stalledQueue.size(), domain->curCycle);
-                    uint64_t cycle;
-                    TimingEvent* te = pq.dequeue(cycle);
-                    if (cycle != domain->curCycle) domain->curCycle = cycle;
-                    te->state = EV_RUNNING;
-                    te->simulate(cycle);
-                    domain->curCycle = pq.size()? pq.firstCycle() : limit;
-                    domain->queuePrio = domain->curCycle;
-                    if (domain->prio == 0) domPq.push(domain);
-                    else nextStalledQueue.push_back(domain);
-                }
-                if (domPq.size()) break;
+                evsSeen[te] = ss.str();
+                uniqueEvs++;
+                desc = ss.str();
             }
-            if (!stalledQueue.size()) std::swap(stalledQueue, nextStalledQueue);
+            info("[%d] %ld %s", thid, cycle, desc.c_str());
         }
+        futex_unlock(&postMortemLock);
     }
+    st.logVec.clear();
+#endif
 
     //info("Phase done");
     __sync_synchronize();
@@ -49,6 +49,9 @@ class CrossingEvent;
 
 #define PQ_BLOCKS 1024
 
+//Per core and domain staging buffer capacity (so that each buffer is 1KB); bound-phase enqueues beyond this take the domain lock
+#define STAGING_SLOTS 127
+
 class ContentionSim : public GlobAlloc {
     private:
         struct CompareEvents : public std::binary_function<TimingEvent*, TimingEvent*, bool> {
@@ -68,11 +71,12 @@ class ContentionSim : public GlobAlloc {
             PAD();
 
             volatile uint64_t curCycle;
-            lock_t pqLock; //used on phase 1 enqueues
+            lock_t pqLock; //used on phase 1 enqueues that cannot be staged
             //lock_t domainLock; //used by simulation thread
 
             uint32_t prio;
             uint64_t queuePrio;
+            uint64_t drainedLimit; //limit of the last phase its staging buffers were drained in
 
             PAD();
 
@@ -91,21 +95,31 @@ class ContentionSim : public GlobAlloc {
 
         struct SimThreadData {
             lock_t wakeLock; //used to sleep/wake up simulation thread
-            uint32_t firstDomain;
-            uint32_t supDomain; //supreme, ie first not included
+            TimeBreakdownStat profTime; //sleep (outside weave phase) / busy (simulating a domain) / idle (no domain available)
 
             std::vector<std::pair<uint64_t, TimingEvent*> > logVec;
         };
 
+        //Phase 1 enqueues from a thread running on a core go to that core's buffer for the destination domain, which
+        //is drained into the domain's pq at the start of phase 2. Each buffer has a single producer (the core's
+        //thread) and a single consumer (the domain's sim thread), and phases do not overlap, so this needs no locks.
+        struct StagingBuffer {
+            volatile uint32_t size;
+            TimingEvent* evs[STAGING_SLOTS];
+        };
+
         //RO
         DomainData* domains;
         SimThreadData* simThreads;
+        StagingBuffer* staging; //indexed by [cid*numDomains + domain]
 
         PAD();
 
         uint32_t numDomains;
         uint32_t numSimThreads;
+        uint32_t numStagingCores;
         bool skipContention;
+        bool runLimitEvents; //events at exactly limit run in this phase (only when domains outnumber threads)
 
         PAD();
 
@@ -115,6 +129,12 @@ class ContentionSim : public GlobAlloc {
         volatile uint64_t lastLimit;
         volatile bool terminate;
 
+        //Domains not currently claimed by a sim thread and not finished in this phase
+        lock_t domQueueLock;
+        g_vector<DomainData*> domQueue; //min-heap on queuePrio
+        volatile uint32_t domQueueSize; //domQueue.size(), so idle threads can poll it without taking domQueueLock
+        volatile uint32_t domainsDone;
+
         volatile uint32_t threadsDone;
         volatile uint32_t threadTicket; //used only at init
 
@@ -162,6 +182,9 @@ class ContentionSim : public GlobAlloc {
     private:
         void simThreadLoop(uint32_t thid);
         void simulatePhaseThread(uint32_t thid);
+        void drainStaging(uint32_t domain);
+        DomainData* claimDomain();
+        void returnDomain(DomainData* domain);
 
         static void SimThreadTrampoline(void* arg);
 };
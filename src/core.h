@@ -31,6 +31,9 @@
 #include "g_std/g_string.h"
 #include "stats.h"
 
+class Checkpoint;
+class MMU;
+
 struct BblInfo {
     uint32_t instrs;
     uint32_t bytes;
@@ -68,9 +71,13 @@ class Core : public GlobAlloc {
 
     protected:
         g_string name;
+        MMU* mmu; //NULL if the core does not model address translation (see tlb.h)
 
     public:
-        explicit Core(g_string& _name) : lastUpdateCycles(0), lastUpdateInstrs(0), name(_name) {}
+        explicit Core(g_string& _name) : lastUpdateCycles(0), lastUpdateInstrs(0), name(_name), mmu(NULL) {}
+
+        void setMMU(MMU* _mmu) {mmu = _mmu;}
+        MMU* getMMU() const {return mmu;}
 
         virtual uint64_t getInstrs() const = 0; // typically used to find out termination conditions or dumps
         virtual uint64_t getPhaseCycles() const = 0; // used by RDTSC faking --- we need to know how far along we are in the phase, but not the total number of phases
@@ -84,6 +91,16 @@ class Core : public GlobAlloc {
         virtual void join() {}
 
         virtual InstrFuncPtrs GetFuncPtrs() = 0;
+
+        //Functional warming (sim.ffWarming): fast-forwarded threads feed their accesses and branches to a core,
+        //which updates its caches and predictors without advancing time. Cores with nothing to warm ignore them.
+        virtual void warmBbl(ADDRINT bblAddr, BblInfo* bblInfo) {}
+        virtual void warmLoad(ADDRINT addr) {}
+        virtual void warmStore(ADDRINT addr) {}
+        virtual void warmBranch(ADDRINT pc, bool taken) {}
+
+        //Saves or restores predictor state (see checkpoint.h). Pipeline state is transient and not checkpointed.
+        virtual void checkpointState(Checkpoint& ckpt) {}
 };
 
 #endif  // CORE_H_
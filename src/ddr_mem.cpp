@@ -43,13 +43,15 @@ class DDRMemoryAccEvent : public TimingEvent {
         DDRMemory* mem;
         Address addr;
         bool write;
+        uint32_t srcId;
 
     public:
-        DDRMemoryAccEvent(DDRMemory* _mem, bool _isWrite, Address _addr, int32_t domain, uint32_t preDelay, uint32_t postDelay)
-            : TimingEvent(preDelay, postDelay, domain), mem(_mem), addr(_addr), write(_isWrite) {}
+        DDRMemoryAccEvent(DDRMemory* _mem, bool _isWrite, Address _addr, uint32_t _srcId, int32_t domain, uint32_t preDelay, uint32_t postDelay)
+            : TimingEvent(preDelay, postDelay, domain), mem(_mem), addr(_addr), write(_isWrite), srcId(_srcId) {}
 
         Address getAddr() const {return addr;}
         bool isWrite() const {return write;}
+        uint32_t getSrcId() const {return srcId;}
 
         void simulate(uint64_t startCycle) {
             mem->enqueue(this, startCycle);
@@ -152,18 +154,36 @@ class SchedEvent : public TimingEvent, public GlobAlloc {
 
 DDRMemory::DDRMemory(uint32_t _lineSize, uint32_t _colSize, uint32_t _ranksPerChannel, uint32_t _banksPerRank,
         uint32_t _sysFreqMHz, const char* tech, const char* addrMapping, uint32_t _controllerSysLatency,
-        uint32_t _queueDepth, uint32_t _rowHitLimit, bool _deferredWrites, bool _closedPage,
-        uint32_t _domain, g_string& _name)
+        uint32_t _queueDepth, uint32_t _rowHitLimit, bool _deferredWrites, bool _closedPage, const char* refresh,
+        DDRSchedPolicy* _schedPolicy, uint32_t _domain, g_string& _name)
     : lineSize(_lineSize), ranksPerChannel(_ranksPerChannel), banksPerRank(_banksPerRank),
       controllerSysLatency(_controllerSysLatency), queueDepth(_queueDepth), rowHitLimit(_rowHitLimit),
-      deferredWrites(_deferredWrites), closedPage(_closedPage), domain(_domain), name(_name)
+      deferredWrites(_deferredWrites), closedPage(_closedPage), domain(_domain), schedPolicy(_schedPolicy),
+      numSources(zinfo->numCores), name(_name)
 {
     sysFreqKHz = 1000 * _sysFreqMHz;
-    initTech(tech);  // sets all tXX and memFreqKHz
+    initTech(tech);  // sets all tXX, bankGroups, and memFreqKHz
     if (memFreqKHz >= sysFreqKHz/2) {
-        panic("You may need to tweak the scheduling code, which works with system cycles." \
-            "With these frequencies, events (which run on system cycles) can't hit us every memory cycle.");
+        // Events run on system cycles, so they can't hit us every memory cycle. Commands still issue at the
+        // right memory cycles, but scheduling decisions are made at system-cycle granularity.
+        warn("%s: memory clock (%ld KHz) is not below half the system clock (%ld KHz); scheduling decisions will be coarser",
+                name.c_str(), memFreqKHz, sysFreqKHz);
     }
+    if (banksPerRank % bankGroups != 0) {
+        panic("%s: %d banks/rank, but tech %s has %d bank groups; set banksPerRank to a multiple of the number of bank groups",
+                name.c_str(), banksPerRank, tech, bankGroups);
+    }
+
+    std::string refreshStr(refresh);
+    if (refreshStr == "AllBank") {
+        refreshMode = REF_ALL_BANK;
+    } else if (refreshStr == "SameBank" || refreshStr == "PerBank") {
+        if (!tRFCpb) panic("%s: tech %s does not support single-bank refreshes, use AllBank", name.c_str(), tech);
+        refreshMode = (refreshStr == "SameBank")? REF_SAME_BANK : REF_PER_BANK;
+    } else {
+        panic("%s: Invalid refresh mode %s (AllBank, SameBank, PerBank)", name.c_str(), refresh);
+    }
+    refreshIdx = 0;
 
     minRdLatency = controllerSysLatency + memToSysCycle(tCL+tBL-1);
     minWrLatency = controllerSysLatency;
@@ -174,10 +194,13 @@ DDRMemory::DDRMemory(uint32_t _lineSize, uint32_t _colSize, uint32_t _ranksPerCh
     rdQueue.init(queueDepth);
     wrQueue.init(queueDepth);
 
-    info("%s: domain %d, %d ranks/ch %d banks/rank, tech %s, boundLat %d rd / %d wr",
-            name.c_str(), domain, ranksPerChannel, banksPerRank, tech, minRdLatency, minWrLatency);
+    info("%s: domain %d, %d ranks/ch %d banks/rank (%d groups), tech %s, boundLat %d rd / %d wr, %s scheduler, %s refresh",
+            name.c_str(), domain, ranksPerChannel, banksPerRank, bankGroups, tech, minRdLatency, minWrLatency,
+            schedPolicy? schedPolicy->getName() : "FR-FCFS", refresh);
 
     minRespCycle = tCL + tBL + 1; // We subtract tCL + tBL from this on some checks; this avoids overflows
+    lastCmdWasWrite = false;
+    lastCmdRank = lastCmdBankGroup = 0;
 
     banks.resize(ranksPerChannel);
     for (uint32_t i = 0; i < ranksPerChannel; i++) banks[i].resize(banksPerRank);
@@ -185,6 +208,13 @@ DDRMemory::DDRMemory(uint32_t _lineSize, uint32_t _colSize, uint32_t _ranksPerCh
     rankActWindows.resize(ranksPerChannel);
     for (uint32_t i = 0; i < ranksPerChannel; i++) rankActWindows[i].init(4);  // we only model FAW; for TAW (other technologies) change this to 2
 
+    bankGroupState.resize(ranksPerChannel);
+    for (uint32_t i = 0; i < ranksPerChannel; i++) bankGroupState[i].resize(bankGroups);
+    rankLastActCycle.resize(ranksPerChannel, 0);
+    rankLastCmdCycle.resize(ranksPerChannel, 0);
+
+    srcLastRow.resize(numSources*ranksPerChannel*banksPerRank, -1ul);
+
     // We get line addresses, and for a 64-byte line, there are _colSize/(JEDEC_BUS_WIDTH/8) lines/page
     uint32_t colBits = ilog2(_colSize/(JEDEC_BUS_WIDTH/8)*64/lineSize);
     uint32_t bankBits = ilog2(banksPerRank);
@@ -218,7 +248,9 @@ DDRMemory::DDRMemory(uint32_t _lineSize, uint32_t _colSize, uint32_t _ranksPerCh
             ilog2(rankMask << rankShift), rankShift, ilog2(bankMask << bankShift), bankShift);
 
     // Weave phase events
-    new RefreshEvent(this, memToSysCycle(tREFI), domain);
+    uint32_t refreshesPerInterval = (refreshMode == REF_ALL_BANK)? 1 :
+        (refreshMode == REF_SAME_BANK)? banksPerRank/bankGroups : banksPerRank;
+    new RefreshEvent(this, memToSysCycle(tREFI/refreshesPerInterval), domain);
 
     nextSchedCycle = -1ul;
     nextSchedEvent = NULL;
@@ -235,6 +267,17 @@ void DDRMemory::initStats(AggregateStat* parentStat) {
     profReadHits.init("rdhits", "Read row hits"); memStats->append(&profReadHits);
     profWriteHits.init("wrhits", "Write row hits"); memStats->append(&profWriteHits);
     latencyHist.init("mlh", "latency histogram for memory requests", NUMBINS); memStats->append(&latencyHist);
+    profSrcReads.init("srcRd", "Read requests per source", numSources); memStats->append(&profSrcReads);
+    profSrcWrites.init("srcWr", "Write requests per source", numSources); memStats->append(&profSrcWrites);
+    profSrcRdLat.init("srcRdlat", "Total latency experienced by read requests per source", numSources); memStats->append(&profSrcRdLat);
+    profSrcAloneRdLat.init("srcAloneRdlat", "Estimated total read latency per source without interference from other sources", numSources);
+    memStats->append(&profSrcAloneRdLat);
+    if (schedPolicy) {
+        AggregateStat* schedStats = new AggregateStat();
+        schedStats->init("sched", "Scheduling policy stats");
+        schedPolicy->initStats(schedStats);
+        memStats->append(schedStats);
+    }
     parentStat->append(memStats);
 }
 
@@ -263,7 +306,7 @@ uint64_t DDRMemory::access(MemReq& req) {
         uint64_t respCycle = req.cycle + (isWrite? minWrLatency : minRdLatency);
         if (zinfo->eventRecorders[req.srcId]) {
             DDRMemoryAccEvent* memEv = new (zinfo->eventRecorders[req.srcId]) DDRMemoryAccEvent(this,
-                    isWrite, req.lineAddr, domain, preDelay, isWrite? postDelayWr : postDelayRd);
+                    isWrite, req.lineAddr, req.srcId, domain, preDelay, isWrite? postDelayWr : postDelayRd);
             memEv->setMinStartCycle(req.cycle);
             TimingRecord tr = {req.lineAddr, req.cycle, respCycle, req.type, memEv, memEv};
             zinfo->eventRecorders[req.srcId]->pushRecord(tr);
@@ -310,6 +353,11 @@ void DDRMemory::enqueue(DDRMemoryAccEvent* ev, uint64_t sysCycle) {
     req->arrivalCycle = memCycle;
     req->startSysCycle = sysCycle;
 
+    req->sched.srcId = ev->getSrcId();
+    req->sched.bankId = req->loc.rank*banksPerRank + req->loc.bank;
+    req->sched.marked = false;
+    assert(req->sched.srcId < numSources);
+
     req->ev = ev;
     ev->hold();
 
@@ -319,7 +367,8 @@ void DDRMemory::enqueue(DDRMemoryAccEvent* ev, uint64_t sysCycle) {
         queue(req, memCycle);
 
         // If needed, schedule an event to handle this new request
-        if (!req->prev /* first in bank */) {
+        // (with a scheduling policy, any request in the bank queue may issue)
+        if (!req->prev /* first in bank */ || schedPolicy) {
             uint64_t minSchedCycle = std::max(memCycle, minRespCycle - tCL - tBL);  
             if (nextSchedCycle > minSchedCycle) minSchedCycle = std::max(minSchedCycle, findMinCmdCycle(*req));
             if (nextSchedCycle > minSchedCycle) {
@@ -425,7 +474,9 @@ void DDRMemory::queue(Request* req, uint64_t memCycle) {
 // For external ticks
 uint64_t DDRMemory::tick(uint64_t sysCycle) {
     uint64_t memCycle = sysToMemCycle(sysCycle);
-    assert_msg(memCycle == nextSchedCycle, "%ld != %ld", memCycle, nextSchedCycle);
+    // With memFreq >= sysFreq/2, we may only be able to wake up after nextSchedCycle
+    assert_msg(memCycle == nextSchedCycle || (memCycle > nextSchedCycle && memFreqKHz >= sysFreqKHz/2),
+            "%ld != %ld", memCycle, nextSchedCycle);
 
     uint64_t minSchedCycle = trySchedule(memCycle, sysCycle);
     assert(minSchedCycle >= memCycle);
@@ -439,7 +490,7 @@ uint64_t DDRMemory::tick(uint64_t sysCycle) {
         queue(req, memCycle);
         
         // This request may be schedulable before trySchedule's minSchedCycle
-        if (!req->prev /*first in bank queue*/) {
+        if (!req->prev /*first in bank queue*/ || schedPolicy) {
             uint64_t minQueuedSchedCycle = std::max(memCycle, minRespCycle - tCL - tBL);
             if (minSchedCycle > minQueuedSchedCycle) minSchedCycle = std::max(minQueuedSchedCycle, findMinCmdCycle(*req));
             if (minSchedCycle > minQueuedSchedCycle) {
@@ -483,9 +534,10 @@ uint64_t DDRMemory::findMinCmdCycle(const Request& r) const {
         }
         uint64_t actCycle = std::max(r.arrivalCycle, std::max(preCycle + tRP, bank.lastActCycle + tRRD));
         actCycle = std::max(actCycle, rankActWindows[r.loc.rank].minActCycle() + tFAW);
+        actCycle = std::max(actCycle, minBankGroupActCycle(r.loc));
         minCmdCycle = actCycle + tRCD;
     }
-    return minCmdCycle;
+    return std::max(minCmdCycle, minBankGroupCmdCycle(r.loc));
 }
 
 uint64_t DDRMemory::trySchedule(uint64_t curCycle, uint64_t sysCycle) {
@@ -516,7 +568,35 @@ uint64_t DDRMemory::trySchedule(uint64_t curCycle, uint64_t sysCycle) {
     Request* r = NULL;
     RequestQueue<Request>::iterator ir = queue.begin();
     uint64_t minSchedCycle = -1ul;
-    while (ir != queue.end()) {
+    if (schedPolicy) {
+        schedPolicy->update(curCycle);
+        if (!isWriteQueue && schedPolicy->startBatch()) {
+            for (RequestQueue<Request>::iterator it = queue.begin(); it != queue.end(); it.inc()) schedPolicy->mark((*it)->sched);
+            schedPolicy->endBatch();
+        }
+
+        // Among all requests that can issue now, pick the highest-priority one (oldest on ties)
+        RequestQueue<Request>::iterator best = queue.end();
+        uint64_t bestPrio = 0;
+        while (ir != queue.end()) {
+            uint64_t minCmdCycle = findMinCmdCycle(**ir);
+            minSchedCycle = std::min(minSchedCycle, minCmdCycle);
+            if (minCmdCycle <= curCycle) {
+                const Bank& b = banks[(*ir)->loc.rank][(*ir)->loc.bank];
+                bool hit = b.open && b.openRow == (*ir)->loc.row;
+                uint64_t prio = schedPolicy->priority((*ir)->sched, hit, curCycle - (*ir)->arrivalCycle);
+                if (!r || prio > bestPrio) {
+                    r = *ir;
+                    best = ir;
+                    bestPrio = prio;
+                }
+            }
+            ir.inc();
+        }
+        ir = best;
+    }
+
+    while (!r && ir != queue.end()) {
         //Bank& bank = banks[(*ir)->loc.rank][(*ir)->loc.bank];
         //if ((isWriteQueue? bank.wrReqs : bank.rdReqs).front() == *ir) {
         if (!(*ir)->prev) {  // FASTAH!
@@ -548,9 +628,15 @@ uint64_t DDRMemory::trySchedule(uint64_t curCycle, uint64_t sysCycle) {
 
     // Compute the minimum cycle at which the read or write command can be issued,
     // without column access or data bus constraints
+    uint32_t bankGroup = r->loc.bank % bankGroups;
     uint64_t minCmdCycle = std::max(curCycle, minRespCycle - tCL);
-    if (lastCmdWasWrite && !r->write) minCmdCycle = std::max(minCmdCycle, minRespCycle + tWTR);
+    if (lastCmdWasWrite && !r->write) {
+        bool sameGroup = lastCmdRank == r->loc.rank && lastCmdBankGroup == bankGroup;
+        minCmdCycle = std::max(minCmdCycle, minRespCycle + (sameGroup? tWTR_L : tWTR));
+    }
+    minCmdCycle = std::max(minCmdCycle, minBankGroupCmdCycle(r->loc));
     bool rowHit = false;
+    uint32_t service = tBL;  // bank cycles used by this request, for the scheduling policy
     if (r->loc.row == bank.openRow && bank.open) {
         // Row buffer hit
         rowHit = true;
@@ -567,21 +653,31 @@ uint64_t DDRMemory::trySchedule(uint64_t curCycle, uint64_t sysCycle) {
 
         uint64_t actCycle = std::max(r->arrivalCycle, std::max(preCycle + tRP, bank.lastActCycle + tRRD));
         actCycle = std::max(actCycle, rankActWindows[r->loc.rank].minActCycle() + tFAW);
-        
+        actCycle = std::max(actCycle, minBankGroupActCycle(r->loc));
+
         // Record ACT
         bank.open = true;
         bank.openRow = r->loc.row;
         if (preIssued) bank.minPreCycle = preCycle + tRAS;
         rankActWindows[r->loc.rank].addActivation(actCycle);
         bank.lastActCycle = actCycle;
+        // ACTs may be recorded somewhat out of order, so these are conservative
+        rankLastActCycle[r->loc.rank] = std::max(rankLastActCycle[r->loc.rank], actCycle);
+        BankGroup& group = bankGroupState[r->loc.rank][bankGroup];
+        group.lastActCycle = std::max(group.lastActCycle, actCycle);
 
         minCmdCycle = std::max(minCmdCycle, actCycle + tRCD);
+        service += tRCD + (preIssued? tRP : 0);
     }
 
     // Figure out data bus constraints, find actual time at which command is issued
     uint64_t cmdCycle = std::max(minCmdCycle, minRespCycle - tCL);
     minRespCycle = cmdCycle + tCL + tBL;
     lastCmdWasWrite = r->write;
+    lastCmdRank = r->loc.rank;
+    lastCmdBankGroup = bankGroup;
+    rankLastCmdCycle[r->loc.rank] = cmdCycle;
+    bankGroupState[r->loc.rank][bankGroup].lastCmdCycle = cmdCycle;
 
     // Record PRE
     // if closed-page, close (auto-precharge) if no more row buffer hits
@@ -598,6 +694,13 @@ uint64_t DDRMemory::trySchedule(uint64_t curCycle, uint64_t sysCycle) {
     bank.lastCmdCycle = cmdCycle;
     bank.curRowHits = r->rowHitSeq;
 
+    if (schedPolicy) schedPolicy->served(r->sched, rowHit, service);
+
+    // Had this source run alone, would this request have hit in the row buffer?
+    uint64_t& lastRow = srcLastRow[r->sched.srcId*ranksPerChannel*banksPerRank + r->sched.bankId];
+    bool aloneHit = (lastRow == r->loc.row) && (rowHit || !closedPage);
+    lastRow = r->loc.row;
+
     // Issue response
     if (r->ev) {
         auto ev = r->ev;
@@ -615,44 +718,65 @@ uint64_t DDRMemory::trySchedule(uint64_t curCycle, uint64_t sysCycle) {
         if (rowHit) profReadHits.inc();
         uint32_t bucket = std::min(NUMBINS-1, scDelay/BINSIZE);
         latencyHist.inc(bucket, 1);
+
+        uint32_t aloneDelay = aloneHit? minRdLatency :
+            controllerSysLatency + memToSysCycle(tCL + tBL - 1 + tRCD + (closedPage? 0 : tRP));
+        profSrcReads.inc(r->sched.srcId);
+        profSrcRdLat.inc(r->sched.srcId, scDelay);
+        profSrcAloneRdLat.inc(r->sched.srcId, aloneDelay);
     } else {
         uint32_t scDelay = memToSysCycle(minRespCycle) + controllerSysLatency - r->startSysCycle;
         profWrites.inc();
         profTotalWrLat.inc(scDelay);
         if (rowHit) profWriteHits.inc();
+        profSrcWrites.inc(r->sched.srcId);
     }
 
     DEBUG("Served 0x%lx lat %ld clocks", r->addr, minRespCycle-curCycle);
     
     // Dequeue this req
     queue.remove(ir);
-    (isWriteQueue? bank.wrReqs : bank.rdReqs).pop_front();
+    (isWriteQueue? bank.wrReqs : bank.rdReqs).remove(r);
 
     return (rdQueue.empty() && wrQueue.empty())? -1ul : minRespCycle - tCL;
 }
 
 void DDRMemory::refresh(uint64_t sysCycle) {
     uint64_t memCycle = sysToMemCycle(sysCycle);
+
+    // Banks [firstBank, lastBank) of every rank are refreshed. Same-bank refreshes cover
+    // the same bank of every group, which are consecutive since groups are the low bank bits
+    uint32_t firstBank = 0;
+    uint32_t lastBank = banksPerRank;
+    uint32_t refreshCycles = tRFC;
+    if (refreshMode != REF_ALL_BANK) {
+        uint32_t refBanks = (refreshMode == REF_SAME_BANK)? bankGroups : 1;
+        firstBank = refreshIdx*refBanks;
+        lastBank = firstBank + refBanks;
+        refreshIdx = (lastBank == banksPerRank)? 0 : refreshIdx + 1;
+        refreshCycles = tRFCpb;
+    }
+
     uint64_t minRefreshCycle = memCycle;
     for (auto& rankBanks : banks) {
-        for (auto& bank : rankBanks) {
-            minRefreshCycle = std::max(minRefreshCycle, std::max(bank.minPreCycle, bank.lastCmdCycle));
+        for (uint32_t b = firstBank; b < lastBank; b++) {
+            minRefreshCycle = std::max(minRefreshCycle, std::max(rankBanks[b].minPreCycle, rankBanks[b].lastCmdCycle));
         }
     }
     assert(minRefreshCycle >= memCycle);
 
-    uint64_t refreshDoneCycle = minRefreshCycle + tRFC;
-    assert(tRFC >= tRP);
+    uint64_t refreshDoneCycle = minRefreshCycle + refreshCycles;
+    assert(refreshCycles >= tRP);
     for (auto& rankBanks : banks) {
-        for (auto& bank : rankBanks) {
+        for (uint32_t b = firstBank; b < lastBank; b++) {
             // Close and force the ACT to happen at least at tRFC
             // PRE <-tRP-> ACT, so discount tRP
-            bank.minPreCycle = refreshDoneCycle - tRP;
-            bank.open = false;
+            rankBanks[b].minPreCycle = refreshDoneCycle - tRP;
+            rankBanks[b].open = false;
         }
     }
-    
-    DEBUG("Refresh %ld start %ld done %ld", memCycle, minRefreshCycle, refreshDoneCycle);
+
+    DEBUG("Refresh %ld banks %d-%d start %ld done %ld", memCycle, firstBank, lastBank-1, minRefreshCycle, refreshDoneCycle);
 }
 
 
@@ -664,8 +788,77 @@ void DDRMemory::initTech(const char* techName) {
 
     // tBL's below are for 64-byte lines; we adjust as needed
 
+    // Single bank group and all-bank refreshes only, unless the technology sets them
+    bankGroups = 1;
+    tCCD_S = tCCD_L = tRRD_S = tRRD_L = tWTR_L = tRFCpb = 0;
+
     // Please keep this orderly; go from faster to slower technologies
-    if (tech == "DDR3-1333-CL10") {
+    if (tech == "DDR5-4800-CL40") {
+        // JEDEC DDR5-4800B (40-39-39), 16Gb x8 devices. We model one 32-bit subchannel per controller,
+        // so a 64-byte line is a BL16 burst. tWTR (and tWTR_L) are from the end of the burst
+        tCK = 0.416;
+        tBL = 8;
+        tCL = 40;
+        tRCD = 39;
+        tRTP = 18;   // 7.5ns
+        tRP = 39;
+        tRRD = 12;
+        tRAS = 77;   // 32ns
+        tFAW = 32;
+        tWTR = 6;    // 2.5ns
+        tWR = 72;    // 30ns
+        tRFC = 709;  // tRFC1, 295ns
+        tREFI = 9375;  // 3.9us
+        bankGroups = 8;
+        tCCD_S = 8;
+        tCCD_L = 12;  // 5ns
+        tRRD_S = 8;
+        tRRD_L = 12;  // 5ns
+        tWTR_L = 24;  // 10ns
+        tRFCpb = 313; // tRFCsb, 130ns
+    } else if (tech == "DDR4-3200-CL22") {
+        // JEDEC DDR4-3200AA (22-22-22), 8Gb x8 devices (1KB page)
+        tCK = 0.625;
+        tBL = 4;
+        tCL = 22;
+        tRCD = 22;
+        tRTP = 12;   // 7.5ns
+        tRP = 22;
+        tRRD = 8;
+        tRAS = 52;   // 32ns
+        tFAW = 34;   // 21ns
+        tWTR = 4;    // 2.5ns
+        tWR = 24;    // 15ns
+        tRFC = 560;  // 350ns
+        tREFI = 12480;  // 7.8us
+        bankGroups = 4;
+        tCCD_S = 4;
+        tCCD_L = 8;  // 5ns
+        tRRD_S = 4;
+        tRRD_L = 8;  // 4.9ns
+        tWTR_L = 12; // 7.5ns
+    } else if (tech == "DDR4-2400-CL17") {
+        // JEDEC DDR4-2400T (17-17-17), 8Gb x8 devices (1KB page)
+        tCK = 0.833;
+        tBL = 4;
+        tCL = 17;
+        tRCD = 17;
+        tRTP = 9;    // 7.5ns
+        tRP = 17;
+        tRRD = 6;
+        tRAS = 39;   // 32ns
+        tFAW = 26;   // 21ns
+        tWTR = 3;    // 2.5ns
+        tWR = 18;    // 15ns
+        tRFC = 420;  // 350ns
+        tREFI = 9363;  // 7.8us
+        bankGroups = 4;
+        tCCD_S = 4;
+        tCCD_L = 6;  // 5ns
+        tRRD_S = 4;
+        tRRD_L = 6;  // 4.9ns
+        tWTR_L = 9;  // 7.5ns
+    } else if (tech == "DDR3-1333-CL10") {
         // from DRAMSim2/ini/DDR3_micron_16M_8B_x4_sg15.ini (Micron)
         tCK = 1.5;  // ns; all other in mem cycles
         tBL = 4;
@@ -718,6 +911,8 @@ void DDRMemory::initTech(const char* techName) {
     // Check all params were set
     assert(tCK > 0.0);
     assert(tBL && tCL && tRCD && tRTP && tRP && tRRD && tRAS && tFAW && tWTR && tWR && tRFC && tREFI);
+    assert(bankGroups == 1 || (isPow2(bankGroups) && tCCD_S && tCCD_L && tRRD_S && tRRD_L && tWTR_L));
+    if (bankGroups == 1) tWTR_L = tWTR;
 
     if (isPow2(lineSize) && lineSize >= 64) {
         tBL = lineSize*tBL/64;
@@ -26,8 +26,10 @@
 #ifndef DDR_MEM_H_
 #define DDR_MEM_H_
 
+#include <algorithm>
 #include <deque>
 
+#include "ddr_sched.h"
 #include "g_std/g_string.h"
 #include "intrusive_list.h"
 #include "memory_hierarchy.h"
@@ -149,6 +151,7 @@ class DDRMemory : public MemObject {
             bool write;
 
             uint64_t rowHitSeq; // sequence number used to throttle max # row hits
+            DDRSchedReq sched;  // source and policy state
 
             // Cycle accounting
             uint64_t arrivalCycle;  // in memCycles
@@ -174,6 +177,18 @@ class DDRMemory : public MemObject {
             InList<Request> wrReqs;
         };
 
+        // DDR4/DDR5 bank group; banks in the same group share ACT and RD/WR spacing constraints (tRRD_L, tCCD_L)
+        struct BankGroup {
+            uint64_t lastActCycle;
+            uint64_t lastCmdCycle;
+        };
+
+        enum RefreshMode {
+            REF_ALL_BANK,   // all banks of every rank, every tREFI
+            REF_SAME_BANK,  // the same bank in every bank group (DDR5 REFsb), every tREFI/(banks per group)
+            REF_PER_BANK,   // a single bank (as in LPDDR REFpb), every tREFI/banksPerRank
+        };
+
         // Global timing constraints
         /* We wake up at minSchedCycle, issue one or more requests, and
          * reschedule ourselves at the new minSchedCycle if any requests remain
@@ -184,6 +199,7 @@ class DDRMemory : public MemObject {
         // Equivalent to first cycle that the data bus can be used
         uint64_t minRespCycle;
         bool lastCmdWasWrite;
+        uint32_t lastCmdRank, lastCmdBankGroup;
 
         static const uint32_t JEDEC_BUS_WIDTH = 64;
         const uint32_t lineSize, ranksPerChannel, banksPerRank;
@@ -193,6 +209,12 @@ class DDRMemory : public MemObject {
         const bool deferredWrites;
         const bool closedPage;
         const uint32_t domain;
+        RefreshMode refreshMode;
+        uint32_t refreshIdx;  // next bank (or bank within each group) to refresh, for per-bank modes
+
+        // Application-aware scheduling policy; if NULL, we use FR-FCFS
+        DDRSchedPolicy* const schedPolicy;
+        const uint32_t numSources;
 
         // DRAM timing parameters -- initialized in initTech()
         // All parameters are in memory clocks (multiples of tCK)
@@ -209,6 +231,16 @@ class DDRMemory : public MemObject {
         uint32_t tRFC;   // Refresh to ACT (refresh leaves rows closed)
         uint32_t tREFI;  // Refresh interval
 
+        // Bank group parameters (DDR4 and later). With a single bank group (DDR3), these are unused,
+        // and tRRD is enforced only between ACTs to the same bank
+        uint32_t bankGroups;  // per rank
+        uint32_t tCCD_S; // RD/WR to RD/WR, different bank group
+        uint32_t tCCD_L; // RD/WR to RD/WR, same bank group
+        uint32_t tRRD_S; // ACT to ACT, different bank group
+        uint32_t tRRD_L; // ACT to ACT, same bank group
+        uint32_t tWTR_L; // end of WR burst to RD command, same bank group (tWTR is for different groups)
+        uint32_t tRFCpb; // single-bank refresh to ACT (DDR5 tRFCsb); 0 if the technology only refreshes all banks
+
         // Address mapping information
         uint32_t colShift, colMask;
         uint32_t rankShift, rankMask;
@@ -224,6 +256,13 @@ class DDRMemory : public MemObject {
 
         g_vector< g_vector<Bank> > banks; // indexed by rank, bank
         g_vector<ActWindow> rankActWindows;
+        g_vector< g_vector<BankGroup> > bankGroupState; // indexed by rank, bank group
+        g_vector<uint64_t> rankLastActCycle;
+        g_vector<uint64_t> rankLastCmdCycle;
+
+        // Last row each source accessed in each bank, indexed by source, rank*banksPerRank+bank.
+        // Used to estimate the latency a source would see if it ran alone.
+        g_vector<uint64_t> srcLastRow;
         
         // Event scheduling
         SchedEvent* nextSchedEvent;
@@ -238,6 +277,10 @@ class DDRMemory : public MemObject {
         Counter profTotalRdLat, profTotalWrLat;
         Counter profReadHits, profWriteHits;  // row buffer hits
         VectorCounter latencyHist;
+        // Per-source (core) stats. Bandwidth is (rd+wr)*lineSize over time, and the
+        // estimated slowdown due to interference is rdlat/aloneRdlat
+        VectorCounter profSrcReads, profSrcWrites;
+        VectorCounter profSrcRdLat, profSrcAloneRdLat;
         static const uint32_t BINSIZE = 10, NUMBINS = 100;
         PAD();
 
@@ -251,17 +294,21 @@ class DDRMemory : public MemObject {
         inline uint64_t memToSysCycle(uint64_t memCycle) { return (memCycle+1)*sysFreqKHz/memFreqKHz; }
 
         // Produces a sysCycle that, when translated back using sysToMemCycle, will produce the same memCycle
-        // Requires memFreq < sysFreq/2
+        // Exact if memFreq <= sysFreq; with faster memories, produces the first sysCycle that translates to memCycle or later
         inline uint64_t matchingMemToSysCycle(uint64_t memCycle) {
-            // The -sysFreqKHz/memFreqKHz/2 cancels the +1 in sysToMemCycle in integer arithmetic --- you can prove this with inequalities
-            return (2*memCycle-1)*sysFreqKHz/memFreqKHz/2;
+            if (memFreqKHz < sysFreqKHz/2) {
+                // The -sysFreqKHz/memFreqKHz/2 cancels the +1 in sysToMemCycle in integer arithmetic --- you can prove this with inequalities
+                return (2*memCycle-1)*sysFreqKHz/memFreqKHz/2;
+            } else {
+                return ((memCycle-1)*sysFreqKHz + memFreqKHz - 1)/memFreqKHz;
+            }
         }
 
     public:
         DDRMemory(uint32_t _lineSize, uint32_t _colSize, uint32_t _ranksPerChannel, uint32_t _banksPerRank,
             uint32_t _sysFreqMHz, const char* tech, const char* addrMapping, uint32_t _controllerSysLatency,
-            uint32_t _queueDepth, uint32_t _rowHitLimit, bool _deferredWrites, bool _closedPage,
-            uint32_t _domain, g_string& _name);
+            uint32_t _queueDepth, uint32_t _rowHitLimit, bool _deferredWrites, bool _closedPage, const char* refresh,
+            DDRSchedPolicy* _schedPolicy, uint32_t _domain, g_string& _name);
 
         void initStats(AggregateStat* parentStat);
         const char* getName() {return name.c_str();}
@@ -284,6 +331,17 @@ class DDRMemory : public MemObject {
         
         inline uint64_t trySchedule(uint64_t curCycle, uint64_t sysCycle);
         uint64_t findMinCmdCycle(const Request& r) const;
+
+        // Bank group constraints on ACTs and RD/WRs to loc (0 if there is a single bank group)
+        inline uint64_t minBankGroupActCycle(const AddrLoc& loc) const {
+            if (bankGroups == 1) return 0;
+            return std::max(rankLastActCycle[loc.rank] + tRRD_S, bankGroupState[loc.rank][loc.bank % bankGroups].lastActCycle + tRRD_L);
+        }
+
+        inline uint64_t minBankGroupCmdCycle(const AddrLoc& loc) const {
+            if (bankGroups == 1) return 0;
+            return std::max(rankLastCmdCycle[loc.rank] + tCCD_S, bankGroupState[loc.rank][loc.bank % bankGroups].lastCmdCycle + tCCD_L);
+        }
         
         void initTech(const char* tech);
 };
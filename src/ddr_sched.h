@@ -0,0 +1,363 @@
+/** $lic$
+ * Copyright (C) 2012-2014 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DDR_SCHED_H_
+#define DDR_SCHED_H_
+
+#include <algorithm>
+#include "g_std/g_vector.h"
+#include "galloc.h"
+#include "log.h"
+#include "stats.h"
+
+/* Application-aware scheduling policies for DDRMemory.
+ *
+ * By default, DDRMemory uses FR-FCFS (capped by rowHitLimit) and needs no
+ * policy. With a policy, the controller considers every queued request that
+ * could issue its column access now, not just the head of each bank queue,
+ * and picks the one with the highest priority(), breaking ties by age.
+ * Policies learn about each source (core) through served(), which reports
+ * the bank cycles each request occupied (its attained service).
+ *
+ * All policies are per-controller: unlike the original ATLAS and TCM, ranks
+ * are not coordinated across channels, as controllers may be simulated in
+ * different weave domains.
+ */
+
+// Scheduling state of each request that policies can see
+struct DDRSchedReq {
+    uint32_t srcId;
+    uint32_t bankId;  // flat rank/bank index
+    bool marked;  // in the current batch (PAR-BS)
+};
+
+class DDRSchedPolicy : public GlobAlloc {
+    protected:
+        const uint32_t numSources, numBanks;
+
+    public:
+        DDRSchedPolicy(uint32_t _numSources, uint32_t _numBanks) : numSources(_numSources), numBanks(_numBanks) {}
+
+        virtual const char* getName() const = 0;
+
+        // Called before each scheduling decision with the current memory cycle; quantum-based policies rerank here
+        virtual void update(uint64_t memCycle) {}
+
+        // Called when a request issues its column access; service is in memory cycles
+        virtual void served(const DDRSchedReq& r, bool rowHit, uint32_t service) = 0;
+
+        // Priority of a ready request (higher first). age is in memory cycles
+        virtual uint64_t priority(const DDRSchedReq& r, bool rowHit, uint64_t age) const = 0;
+
+        /* Batching interface (PAR-BS). If startBatch() returns true, the
+         * controller calls mark() on every queued read in arrival order, then
+         * endBatch().
+         */
+        virtual bool startBatch() {return false;}
+        virtual void mark(DDRSchedReq& r) {}
+        virtual void endBatch() {}
+
+        virtual void initStats(AggregateStat* parentStat) {}
+};
+
+/* ATLAS (Kim et al., HPCA 2010): Least-attained-service ranking. At the end
+ * of each quantum, each source's total attained service is updated with an
+ * exponential moving average, and sources that have attained the least
+ * service get the highest rank. Requests older than ageThreshold bypass
+ * ranks to avoid starvation.
+ */
+class ATLASSchedPolicy : public DDRSchedPolicy {
+    private:
+        const uint64_t quantum;
+        const double alpha;  // weight of history
+        const uint64_t ageThreshold;
+
+        g_vector<uint64_t> attained;  // in the current quantum
+        g_vector<double> totalAttained;
+        g_vector<uint32_t> rank;
+        g_vector<uint32_t> order;
+        uint64_t quantumEnd;
+
+        Counter profQuanta;
+
+    public:
+        ATLASSchedPolicy(uint32_t _numSources, uint32_t _numBanks, uint64_t _quantum, double _alpha, uint64_t _ageThreshold)
+            : DDRSchedPolicy(_numSources, _numBanks), quantum(_quantum), alpha(_alpha), ageThreshold(_ageThreshold),
+              attained(numSources, 0), totalAttained(numSources, 0.0), rank(numSources, 0), order(numSources, 0), quantumEnd(quantum)
+        {
+            for (uint32_t i = 0; i < numSources; i++) order[i] = i;
+        }
+
+        const char* getName() const {return "ATLAS";}
+
+        void update(uint64_t memCycle) {
+            if (memCycle < quantumEnd) return;
+            for (uint32_t i = 0; i < numSources; i++) {
+                totalAttained[i] = alpha*totalAttained[i] + (1.0 - alpha)*attained[i];
+                attained[i] = 0;
+            }
+            std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+                return totalAttained[a] < totalAttained[b];
+            });
+            for (uint32_t i = 0; i < numSources; i++) rank[order[i]] = numSources - i;
+            quantumEnd = (memCycle/quantum + 1)*quantum;
+            profQuanta.inc();
+        }
+
+        void served(const DDRSchedReq& r, bool rowHit, uint32_t service) {
+            attained[r.srcId] += service;
+        }
+
+        uint64_t priority(const DDRSchedReq& r, bool rowHit, uint64_t age) const {
+            return ((age > ageThreshold)? (1ul << 33) : 0) | ((uint64_t)rank[r.srcId] << 1) | (rowHit? 1 : 0);
+        }
+
+        void initStats(AggregateStat* parentStat) {
+            profQuanta.init("quanta", "Ranking quanta"); parentStat->append(&profQuanta);
+        }
+};
+
+/* TCM (Kim et al., MICRO 2010): Thread cluster memory scheduling. At the end
+ * of each quantum, sources are sorted by memory intensity (requests served)
+ * and the least intensive ones, up to clusterThresh of the total bandwidth,
+ * form the latency-sensitive cluster, which is strictly prioritized (less
+ * intensive first). The remaining bandwidth-sensitive sources are ranked by
+ * intensity, and their ranks are rotated every shuffleInterval so that no
+ * source is persistently deprioritized. The original policy shuffles by
+ * niceness (bank-level parallelism vs row-buffer locality); we use the
+ * simpler round-robin shuffle.
+ */
+class TCMSchedPolicy : public DDRSchedPolicy {
+    private:
+        const uint64_t quantum;
+        const double clusterThresh;
+        const uint64_t shuffleInterval;
+
+        g_vector<uint64_t> reqs;  // in the current quantum
+        g_vector<uint64_t> bandwidth;  // bank cycles used in the current quantum
+        g_vector<uint32_t> rank;
+        g_vector<uint32_t> order;
+        g_vector<uint32_t> bwCluster;  // bandwidth-sensitive sources, most intensive first
+        uint32_t shuffleOffset;
+        uint64_t quantumEnd, nextShuffle;
+
+        Counter profQuanta, profLatClusterSize;
+
+    public:
+        TCMSchedPolicy(uint32_t _numSources, uint32_t _numBanks, uint64_t _quantum, double _clusterThresh, uint64_t _shuffleInterval)
+            : DDRSchedPolicy(_numSources, _numBanks), quantum(_quantum), clusterThresh(_clusterThresh), shuffleInterval(_shuffleInterval),
+              reqs(numSources, 0), bandwidth(numSources, 0), rank(numSources, 0), order(numSources, 0), shuffleOffset(0), quantumEnd(quantum), nextShuffle(shuffleInterval) {}
+
+        const char* getName() const {return "TCM";}
+
+        void update(uint64_t memCycle) {
+            if (memCycle >= quantumEnd) {
+                uint64_t totalBw = 0;
+                for (uint32_t i = 0; i < numSources; i++) {
+                    order[i] = i;
+                    totalBw += bandwidth[i];
+                }
+                std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+                    return reqs[a] < reqs[b];
+                });
+
+                // Latency cluster: least intensive first, get the top ranks
+                uint32_t latSize = 0;
+                uint64_t latBw = 0;
+                while (latSize < numSources && latBw + bandwidth[order[latSize]] <= clusterThresh*totalBw) {
+                    latBw += bandwidth[order[latSize]];
+                    rank[order[latSize]] = 2*numSources - latSize;
+                    latSize++;
+                }
+                profLatClusterSize.inc(latSize);
+
+                bwCluster.clear();
+                for (uint32_t i = numSources; i > latSize; i--) bwCluster.push_back(order[i-1]);
+                shuffleOffset = 0;
+                shuffle();
+
+                for (uint32_t i = 0; i < numSources; i++) reqs[i] = bandwidth[i] = 0;
+                quantumEnd = (memCycle/quantum + 1)*quantum;
+                nextShuffle = memCycle + shuffleInterval;
+                profQuanta.inc();
+            } else if (memCycle >= nextShuffle) {
+                shuffleOffset++;
+                shuffle();
+                nextShuffle = memCycle + shuffleInterval;
+            }
+        }
+
+        void served(const DDRSchedReq& r, bool rowHit, uint32_t service) {
+            reqs[r.srcId]++;
+            bandwidth[r.srcId] += service;
+        }
+
+        uint64_t priority(const DDRSchedReq& r, bool rowHit, uint64_t age) const {
+            return ((uint64_t)rank[r.srcId] << 1) | (rowHit? 1 : 0);
+        }
+
+        void initStats(AggregateStat* parentStat) {
+            profQuanta.init("quanta", "Clustering quanta"); parentStat->append(&profQuanta);
+            profLatClusterSize.init("latClusterSize", "Sum of latency-sensitive cluster sizes over quanta"); parentStat->append(&profLatClusterSize);
+        }
+
+    private:
+        // Bandwidth-sensitive ranks are in [1, bwCluster.size()], below all latency-sensitive ones
+        void shuffle() {
+            uint32_t bwSize = bwCluster.size();
+            for (uint32_t i = 0; i < bwSize; i++) {
+                rank[bwCluster[i]] = 1 + (i + shuffleOffset) % bwSize;
+            }
+        }
+};
+
+/* BLISS (Subramanian et al., ICCD 2014): Blacklisting. A source that gets
+ * blacklistThreshold consecutive requests served is blacklisted, and its
+ * requests are deprioritized until the blacklist is cleared, every
+ * clearInterval cycles. Row hits and age order requests within each class.
+ */
+class BLISSSchedPolicy : public DDRSchedPolicy {
+    private:
+        const uint32_t blacklistThreshold;
+        const uint64_t clearInterval;
+
+        g_vector<bool> blacklisted;
+        uint32_t lastSrcId;
+        uint32_t streak;
+        uint64_t nextClear;
+
+        Counter profBlacklists;
+
+    public:
+        BLISSSchedPolicy(uint32_t _numSources, uint32_t _numBanks, uint32_t _blacklistThreshold, uint64_t _clearInterval)
+            : DDRSchedPolicy(_numSources, _numBanks), blacklistThreshold(_blacklistThreshold), clearInterval(_clearInterval),
+              blacklisted(numSources, false), lastSrcId(-1u), streak(0), nextClear(clearInterval) {}
+
+        const char* getName() const {return "BLISS";}
+
+        void update(uint64_t memCycle) {
+            if (memCycle < nextClear) return;
+            for (uint32_t i = 0; i < numSources; i++) blacklisted[i] = false;
+            nextClear = (memCycle/clearInterval + 1)*clearInterval;
+        }
+
+        void served(const DDRSchedReq& r, bool rowHit, uint32_t service) {
+            if (r.srcId == lastSrcId) {
+                streak++;
+            } else {
+                lastSrcId = r.srcId;
+                streak = 1;
+            }
+            if (streak >= blacklistThreshold && !blacklisted[r.srcId]) {
+                blacklisted[r.srcId] = true;
+                profBlacklists.inc();
+            }
+        }
+
+        uint64_t priority(const DDRSchedReq& r, bool rowHit, uint64_t age) const {
+            return (blacklisted[r.srcId]? 0 : 2) | (rowHit? 1 : 0);
+        }
+
+        void initStats(AggregateStat* parentStat) {
+            profBlacklists.init("blacklists", "Sources blacklisted"); parentStat->append(&profBlacklists);
+        }
+};
+
+/* PAR-BS (Mutlu and Moscibroda, ISCA 2008): Parallelism-aware batch
+ * scheduling. When all requests of the current batch have been served, a new
+ * batch marks up to markingCap of the oldest queued requests of each source
+ * to each bank. Marked requests go first; within them, row hits, then
+ * sources ranked shortest-job-first (fewest marked requests to their most
+ * loaded bank, then fewest in total).
+ */
+class PARBSSchedPolicy : public DDRSchedPolicy {
+    private:
+        const uint32_t markingCap;
+
+        g_vector<uint32_t> bankLoad;  // marked requests, indexed by source, bank
+        g_vector<uint32_t> maxLoad;
+        g_vector<uint32_t> totalLoad;
+        g_vector<uint32_t> rank;
+        g_vector<uint32_t> order;
+        uint32_t markedLeft;
+
+        Counter profBatches, profMarked;
+
+    public:
+        PARBSSchedPolicy(uint32_t _numSources, uint32_t _numBanks, uint32_t _markingCap)
+            : DDRSchedPolicy(_numSources, _numBanks), markingCap(_markingCap), bankLoad(numSources*numBanks, 0),
+              maxLoad(numSources, 0), totalLoad(numSources, 0), rank(numSources, 0), order(numSources, 0), markedLeft(0)
+        {
+            for (uint32_t i = 0; i < numSources; i++) order[i] = i;
+        }
+
+        const char* getName() const {return "PAR-BS";}
+
+        void served(const DDRSchedReq& r, bool rowHit, uint32_t service) {
+            if (r.marked) {
+                assert(markedLeft);
+                markedLeft--;
+            }
+        }
+
+        uint64_t priority(const DDRSchedReq& r, bool rowHit, uint64_t age) const {
+            return (r.marked? (1ul << 33) : 0) | (rowHit? (1ul << 32) : 0) | rank[r.srcId];
+        }
+
+        bool startBatch() {
+            if (markedLeft) return false;
+            for (uint32_t i = 0; i < numSources*numBanks; i++) bankLoad[i] = 0;
+            for (uint32_t i = 0; i < numSources; i++) maxLoad[i] = totalLoad[i] = 0;
+            return true;
+        }
+
+        void mark(DDRSchedReq& r) {
+            uint32_t& load = bankLoad[r.srcId*numBanks + r.bankId];
+            if (load < markingCap) {
+                load++;
+                r.marked = true;
+                markedLeft++;
+                totalLoad[r.srcId]++;
+                maxLoad[r.srcId] = std::max(maxLoad[r.srcId], load);
+            }
+        }
+
+        void endBatch() {
+            if (!markedLeft) return;
+            std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+                return (maxLoad[a] < maxLoad[b]) || (maxLoad[a] == maxLoad[b] && totalLoad[a] < totalLoad[b]);
+            });
+            for (uint32_t i = 0; i < numSources; i++) rank[order[i]] = numSources - i;
+            profBatches.inc();
+            profMarked.inc(markedLeft);
+        }
+
+        void initStats(AggregateStat* parentStat) {
+            profBatches.init("batches", "Batches formed"); parentStat->append(&profBatches);
+            profMarked.init("marked", "Requests marked"); parentStat->append(&profMarked);
+        }
+};
+
+#endif  // DDR_SCHED_H_
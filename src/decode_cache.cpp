@@ -0,0 +1,339 @@
+/** $lic$
+ * Copyright (C) 2012-2014 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "decode_cache.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+#include "bithacks.h"
+#include "core.h"
+#include "decoder.h"
+#include "log.h"
+
+#define DECODE_CACHE_MAGIC 0x5a4445434143484ful
+#define DECODE_CACHE_ENTRY_MARKER 0xdec0ded1u
+
+struct CacheHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t layout;
+};
+
+struct CacheEntry {
+    uint32_t marker;
+    uint32_t objBytes;  // size of the BblInfo that follows the entry
+    uint64_t imageHash;
+    uint64_t offset;
+    uint64_t codeHash;
+};
+
+// Captures the layout of the structures we copy around verbatim
+static uint32_t layoutSignature() {
+    return (sizeof(DynUop) << 16) | (offsetof(DynBbl, uop) << 8) | offsetof(BblInfo, oooBbl);
+}
+
+static inline size_t entryBytes(uint32_t objBytes) {
+    return sizeof(CacheEntry) + ((objBytes + 7) & ~7);
+}
+
+static uint64_t hashBytes(const void* data, size_t len, uint64_t h) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    while (len >= 8) {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        h = (h ^ w) * 0x9E3779B97F4A7C15ul;
+        h ^= h >> 32;
+        p += 8;
+        len -= 8;
+    }
+    while (len--) {
+        h = (h ^ *p++) * 0x9E3779B97F4A7C15ul;
+        h ^= h >> 32;
+    }
+    return h;
+}
+
+static inline uint64_t mix(uint64_t h, uint64_t v) {
+    h = (h ^ v) * 0xC2B2AE3D27D4EB4Ful;
+    return h ^ (h >> 29);
+}
+
+uint64_t DecodeKey::hash() const {
+    return mix(mix(mix(mix(imageHash, offset), codeHash), instrs), bytes);
+}
+
+static inline DecodeKey entryKey(const CacheEntry* e) {
+    const BblInfo* bblInfo = reinterpret_cast<const BblInfo*>(e + 1);
+    DecodeKey key = {e->imageHash, e->offset, e->codeHash, bblInfo->instrs, bblInfo->bytes};
+    return key;
+}
+
+/* Process-local state: the mapped file, its index, and the image hashes of this process */
+static int cacheFd = -1;
+static std::unordered_map<uint64_t, const CacheEntry*> cacheIndex;
+static std::unordered_map<UINT32, uint64_t> imageHashes;
+
+// Returns the bytes of valid entries in [start, start+size), optionally indexing them
+static size_t scanEntries(const uint8_t* start, size_t size, bool index, uint64_t& numEntries) {
+    size_t pos = 0;
+    numEntries = 0;
+    while (pos + sizeof(CacheEntry) <= size) {
+        const CacheEntry* e = reinterpret_cast<const CacheEntry*>(start + pos);
+        if (e->marker != DECODE_CACHE_ENTRY_MARKER || e->objBytes < offsetof(BblInfo, oooBbl) + DynBbl::bytes(0)) break;
+        if (pos + entryBytes(e->objBytes) > size) break;
+        const BblInfo* bblInfo = reinterpret_cast<const BblInfo*>(e + 1);
+        if (e->objBytes != offsetof(BblInfo, oooBbl) + DynBbl::bytes(bblInfo->oooBbl[0].uops)) break;
+
+        if (index) cacheIndex.insert(std::make_pair(entryKey(e).hash(), e));  // keeps the first of any duplicates
+        pos += entryBytes(e->objBytes);
+        numEntries++;
+    }
+    return pos;
+}
+
+// 0 if the image is not file-backed
+static uint64_t getImageHash(IMG img) {
+    auto it = imageHashes.find(IMG_Id(img));
+    if (it != imageHashes.end()) return it->second;
+
+    uint64_t h = 0;
+    int fd = open(IMG_Name(img).c_str(), O_RDONLY);
+    if (fd >= 0) {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* m = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (m != MAP_FAILED) {
+                h = hashBytes(m, st.st_size, st.st_size);
+                if (!h) h = 1;
+                munmap(m, st.st_size);
+            }
+        }
+        close(fd);
+    }
+    imageHashes[IMG_Id(img)] = h;
+    return h;
+}
+
+// 0 if some code byte could not be read
+static uint64_t getCodeHash(BBL bbl) {
+    uint8_t buf[256];
+    uint64_t h = BBL_Size(bbl);
+    ADDRINT addr = BBL_Address(bbl);
+    uint32_t left = BBL_Size(bbl);
+    while (left) {
+        uint32_t n = std::min(left, (uint32_t)sizeof(buf));
+        if (PIN_SafeCopy(buf, (VOID*)addr, n) != n) return 0;
+        h = hashBytes(buf, n, h);
+        addr += n;
+        left -= n;
+    }
+    return h;
+}
+
+bool DecodeKey::get(BBL bbl, DecodeKey& key) {
+    IMG img = IMG_FindByAddress(BBL_Address(bbl));
+    if (!IMG_Valid(img)) return false;
+    key.imageHash = getImageHash(img);
+    key.codeHash = getCodeHash(bbl);
+    if (!key.imageHash || !key.codeHash) return false;
+    key.offset = BBL_Address(bbl) - IMG_LowAddress(img);
+    key.instrs = BBL_NumIns(bbl);
+    key.bytes = BBL_Size(bbl);
+    return true;
+}
+
+/* SharedDecodeTable */
+
+SharedDecodeTable::SharedDecodeTable(uint32_t _numSlots) : numSlots(_numSlots), hits(0), inserts(0), races(0), overflows(0) {
+    if (!isPow2(numSlots)) panic("Shared decode table size must be a power of 2, %d given", numSlots);
+    slots = gm_calloc<Node*>(numSlots);
+}
+
+void SharedDecodeTable::initStats(AggregateStat* parentStat) {
+    AggregateStat* tableStat = new AggregateStat();
+    tableStat->init("decodeTable", "Shared decode table stats");
+    profHits.init("hits", "BBLs decoded by another process", &hits);
+    profInserts.init("inserts", "BBLs published to the table", &inserts);
+    profRaces.init("races", "BBLs published concurrently by another process", &races);
+    profOverflows.init("overflows", "BBLs not published because the table was full", &overflows);
+    tableStat->append(&profHits);
+    tableStat->append(&profInserts);
+    tableStat->append(&profRaces);
+    tableStat->append(&profOverflows);
+    parentStat->append(tableStat);
+}
+
+#define MAX_DECODE_TABLE_PROBES 64
+
+BblInfo* SharedDecodeTable::lookup(const DecodeKey& key) {
+    uint32_t idx = key.hash() & (numSlots - 1);
+    for (uint32_t p = 0; p < MAX_DECODE_TABLE_PROBES; p++) {
+        Node* node = slots[(idx + p) & (numSlots - 1)];
+        if (!node) return NULL;  // insert-only, so the key is not further down
+        if (node->key == key) {
+            __sync_fetch_and_add(&hits, 1);
+            return node->bblInfo;
+        }
+    }
+    return NULL;
+}
+
+BblInfo* SharedDecodeTable::insert(const DecodeKey& key, BblInfo* bblInfo) {
+    Node* ourNode = new Node;
+    ourNode->key = key;
+    ourNode->bblInfo = bblInfo;
+    __sync_synchronize();  // node must be complete before it is visible
+
+    uint32_t idx = key.hash() & (numSlots - 1);
+    for (uint32_t p = 0; p < MAX_DECODE_TABLE_PROBES; p++) {
+        Node* volatile* slot = &slots[(idx + p) & (numSlots - 1)];
+        Node* node = *slot;
+        if (!node) {
+            node = __sync_val_compare_and_swap(slot, (Node*)NULL, ourNode);
+            if (!node) {
+                __sync_fetch_and_add(&inserts, 1);
+                return bblInfo;
+            }
+        }
+        // Occupied (perhaps by a racing insert)
+        if (node->key == key) {
+            __sync_fetch_and_add(&races, 1);
+            delete ourNode;
+            gm_free(bblInfo);
+            return node->bblInfo;
+        }
+    }
+
+    __sync_fetch_and_add(&overflows, 1);
+    delete ourNode;
+    return bblInfo;
+}
+
+/* DecodeCache */
+
+DecodeCache::DecodeCache(const g_string& _path) : path(_path), hits(0), misses(0), inserts(0) {
+    int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) panic("Could not open decode cache %s", path.c_str());
+    struct stat st;
+    if (fstat(fd, &st) != 0) panic("Could not stat decode cache %s", path.c_str());
+    size_t fileBytes = st.st_size;
+
+    size_t validBytes = 0;
+    uint64_t numEntries = 0;
+    if (fileBytes >= sizeof(CacheHeader)) {
+        void* m = mmap(NULL, fileBytes, PROT_READ, MAP_SHARED, fd, 0);
+        if (m == MAP_FAILED) panic("Could not map decode cache %s", path.c_str());
+        const CacheHeader* hdr = static_cast<const CacheHeader*>(m);
+        if (hdr->magic == DECODE_CACHE_MAGIC && hdr->version == DECODER_VERSION && hdr->layout == layoutSignature()) {
+            const uint8_t* start = static_cast<const uint8_t*>(m) + sizeof(CacheHeader);
+            validBytes = sizeof(CacheHeader) + scanEntries(start, fileBytes - sizeof(CacheHeader), false, numEntries);
+        } else {
+            info("Decode cache %s is stale or invalid (version %d, layout 0x%x; expected %d, 0x%x), discarding",
+                    path.c_str(), hdr->version, hdr->layout, DECODER_VERSION, layoutSignature());
+        }
+        munmap(m, fileBytes);
+    }
+
+    if (!validBytes) {
+        CacheHeader hdr = {DECODE_CACHE_MAGIC, DECODER_VERSION, layoutSignature()};
+        if (ftruncate(fd, 0) != 0 || write(fd, &hdr, sizeof(hdr)) != sizeof(hdr)) panic("Could not initialize decode cache %s", path.c_str());
+    } else if (validBytes < fileBytes) {
+        // No other process is running yet, so a bad tail must come from an earlier run
+        warn("Decode cache %s: trimming %ld bytes of torn entries", path.c_str(), fileBytes - validBytes);
+        if (ftruncate(fd, validBytes) != 0) panic("Could not trim decode cache %s", path.c_str());
+    }
+    close(fd);
+    info("Decode cache %s: %ld entries", path.c_str(), numEntries);
+}
+
+void DecodeCache::initStats(AggregateStat* parentStat) {
+    AggregateStat* cacheStat = new AggregateStat();
+    cacheStat->init("decodeCache", "Persistent decode cache stats");
+    profHits.init("hits", "BBLs found in the decode cache", &hits);
+    profMisses.init("misses", "Cacheable BBLs not in the decode cache", &misses);
+    profInserts.init("inserts", "BBLs added to the decode cache", &inserts);
+    cacheStat->append(&profHits);
+    cacheStat->append(&profMisses);
+    cacheStat->append(&profInserts);
+    parentStat->append(cacheStat);
+}
+
+void DecodeCache::attach() {
+    cacheFd = open(path.c_str(), O_RDWR | O_APPEND);
+    if (cacheFd < 0) panic("Could not open decode cache %s", path.c_str());
+    struct stat st;
+    if (fstat(cacheFd, &st) != 0) panic("Could not stat decode cache %s", path.c_str());
+    size_t fileBytes = st.st_size;
+    assert(fileBytes >= sizeof(CacheHeader));
+
+    // The mapping covers only the entries written so far; we never unmap it, since cacheIndex points into it
+    void* m = mmap(NULL, fileBytes, PROT_READ, MAP_SHARED, cacheFd, 0);
+    if (m == MAP_FAILED) panic("Could not map decode cache %s", path.c_str());
+    const uint8_t* start = static_cast<const uint8_t*>(m) + sizeof(CacheHeader);
+    uint64_t numEntries;
+    scanEntries(start, fileBytes - sizeof(CacheHeader), true, numEntries);
+    info("Attached to decode cache %s, %ld entries", path.c_str(), numEntries);
+}
+
+BblInfo* DecodeCache::lookup(const DecodeKey& key, ADDRINT bblAddr) {
+    auto it = cacheIndex.find(key.hash());
+    if (it == cacheIndex.end() || !(entryKey(it->second) == key)) {
+        __sync_fetch_and_add(&misses, 1);
+        return NULL;
+    }
+
+    const CacheEntry* e = it->second;
+    BblInfo* bblInfo = static_cast<BblInfo*>(gm_malloc(e->objBytes));
+    memcpy(bblInfo, e + 1, e->objBytes);
+    bblInfo->oooBbl[0].addr = bblAddr;
+    __sync_fetch_and_add(&hits, 1);
+    return bblInfo;
+}
+
+void DecodeCache::insert(const DecodeKey& key, const BblInfo* bblInfo) {
+    uint32_t objBytes = offsetof(BblInfo, oooBbl) + DynBbl::bytes(bblInfo->oooBbl[0].uops);
+    std::vector<uint8_t> buf(entryBytes(objBytes), 0);
+    CacheEntry* e = reinterpret_cast<CacheEntry*>(&buf[0]);
+    e->marker = DECODE_CACHE_ENTRY_MARKER;
+    e->objBytes = objBytes;
+    e->imageHash = key.imageHash;
+    e->offset = key.offset;
+    e->codeHash = key.codeHash;
+    memcpy(e + 1, bblInfo, objBytes);
+
+    // A single O_APPEND write, so entries from concurrent processes never interleave
+    ssize_t res = write(cacheFd, &buf[0], buf.size());
+    if (res != (ssize_t)buf.size()) {
+        warn("Decode cache %s: append failed (%ld / %ld bytes)", path.c_str(), res, buf.size());
+        return;
+    }
+    __sync_fetch_and_add(&inserts, 1);
+}
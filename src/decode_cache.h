@@ -0,0 +1,143 @@
+/** $lic$
+ * Copyright (C) 2012-2014 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DECODE_CACHE_H_
+#define DECODE_CACHE_H_
+
+/* Reuse of decoded basic blocks across processes and runs.
+ *
+ * OOO decoding (Decoder::decodeBbl) is a large chunk of instrumentation time
+ * for big binaries, and it is repeated in every process of every run. BBLs
+ * are identified by a DecodeKey: a hash of the image file the BBL comes from,
+ * the BBL's offset within the image, and a hash of the BBL's code bytes. This
+ * makes keys stable across processes, runs, and ASLR, and rebuilt binaries
+ * simply produce new keys. Code outside of file-backed images (e.g., JIT'd
+ * code or the vDSO) has no key, and is always decoded.
+ *
+ * SharedDecodeTable is an insert-only hash table in the global heap, so each
+ * BBL is decoded once per simulation, and all processes share its BblInfo.
+ *
+ * DecodeCache persists decoded BBLs in a file (by default, decode.cache in
+ * the output directory) that later runs memory-map on startup. The file
+ * header records DECODER_VERSION and the layout of the decoded structures,
+ * and the whole file is discarded when they do not match this build. The file
+ * is an append-only log: processes append entries with single O_APPEND
+ * writes, so concurrent processes never interleave entries; each entry starts
+ * with a marker, and torn entries (e.g., from a killed run) are trimmed on
+ * startup.
+ */
+
+#include <stdint.h>
+#include "g_std/g_string.h"
+#include "galloc.h"
+#include "pin.H"
+#include "stats.h"
+
+struct BblInfo;
+
+/* Bump this whenever a change to the decoder changes the uops it produces
+ * for a given instruction sequence, so that stale decode caches are dropped.
+ */
+#define DECODER_VERSION 1
+
+struct DecodeKey {
+    uint64_t imageHash;
+    uint64_t offset;
+    uint64_t codeHash;
+    uint32_t instrs;
+    uint32_t bytes;
+
+    // Returns false if the BBL is not in a file-backed image. Process-local (caches image hashes).
+    static bool get(BBL bbl, DecodeKey& key);
+
+    bool operator==(const DecodeKey& other) const {
+        return imageHash == other.imageHash && offset == other.offset && codeHash == other.codeHash &&
+            instrs == other.instrs && bytes == other.bytes;
+    }
+
+    uint64_t hash() const;
+};
+
+class SharedDecodeTable : public GlobAlloc {
+    private:
+        struct Node : public GlobAlloc {
+            DecodeKey key;
+            BblInfo* bblInfo;
+        };
+
+        Node* volatile* slots;
+        uint32_t numSlots;  // power of 2
+
+        // Updated atomically
+        uint64_t hits;
+        uint64_t inserts;
+        uint64_t races;
+        uint64_t overflows;
+
+        ProxyStat profHits, profInserts, profRaces, profOverflows;
+
+    public:
+        explicit SharedDecodeTable(uint32_t _numSlots);
+
+        void initStats(AggregateStat* parentStat);
+
+        // Returns the shared BblInfo, or NULL if no process has decoded this BBL yet
+        BblInfo* lookup(const DecodeKey& key);
+
+        /* Publishes a BblInfo that this process decoded, and returns the one
+         * to use. If another process published the same BBL first, frees ours
+         * and returns theirs. If the table is full, returns ours unshared.
+         */
+        BblInfo* insert(const DecodeKey& key, BblInfo* bblInfo);
+};
+
+class DecodeCache : public GlobAlloc {
+    private:
+        g_string path;
+
+        // Shared by all processes, updated atomically
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t inserts;
+
+        ProxyStat profHits, profMisses, profInserts;
+
+    public:
+        // Called once, at initialization, to create or validate the file
+        explicit DecodeCache(const g_string& _path);
+
+        void initStats(AggregateStat* parentStat);
+
+        // Called by every process before it instruments any code; maps the file and builds the process-local index
+        void attach();
+
+        // Returns a fully initialized copy of the BBL's cached BblInfo, or NULL on a miss
+        BblInfo* lookup(const DecodeKey& key, ADDRINT bblAddr);
+
+        // Adds a freshly decoded BBL to the file (not visible until the next attach)
+        void insert(const DecodeKey& key, const BblInfo* bblInfo);
+};
+
+#endif  // DECODE_CACHE_H_
@@ -32,8 +32,10 @@
 #include <string>
 #include <vector>
 #include "core.h"
+#include "decode_cache.h"
 #include "locks.h"
 #include "log.h"
+#include "zsim.h"
 
 extern "C" {
 #include "xed-interface.h"
@@ -1262,6 +1264,16 @@ BblInfo* Decoder::decodeBbl(BBL bbl, bool oooDecoding) {
     uint32_t bytes = BBL_Size(bbl);
     BblInfo* bblInfo;
 
+    //Reuse BBLs decoded by other processes or earlier runs (see decode_cache.h)
+    DecodeKey key;
+    bool keyed = (zinfo->decodeTable || zinfo->decodeCache) && DecodeKey::get(bbl, key);
+    if (keyed) {
+        if (zinfo->decodeTable && (bblInfo = zinfo->decodeTable->lookup(key))) return bblInfo;
+        if (oooDecoding && zinfo->decodeCache && (bblInfo = zinfo->decodeCache->lookup(key, BBL_Address(bbl)))) {
+            return zinfo->decodeTable? zinfo->decodeTable->insert(key, bblInfo) : bblInfo;
+        }
+    }
+
     if (oooDecoding) {
         //Decode BBL
         uint32_t approxInstrs = 0;
@@ -1446,6 +1458,11 @@ BblInfo* Decoder::decodeBbl(BBL bbl, bool oooDecoding) {
     bblInfo->instrs = instrs;
     bblInfo->bytes = bytes;
 
+    if (keyed) {
+        if (oooDecoding && zinfo->decodeCache) zinfo->decodeCache->insert(key, bblInfo);
+        if (zinfo->decodeTable) bblInfo = zinfo->decodeTable->insert(key, bblInfo);
+    }
+
     return bblInfo;
 }
 
@@ -0,0 +1,462 @@
+/** $lic$
+ * Copyright (C) 2012-2014 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dram_cache_mem.h"
+#include "bithacks.h"
+#include "checkpoint.h"
+#include "timing_event.h"
+#include "zsim.h"
+
+DRAMCacheMemory::DRAMCacheMemory(MemObject* _cacheMem, MemObject* _mainMem, uint32_t cacheMB, uint32_t lineSize,
+        Organization _org, uint32_t _ways, uint32_t blockSize, uint32_t rowSize, bool _tagsInDRAM,
+        uint32_t _tagLatency, Predictor _pred, uint32_t _historyEntries, const g_string& _name)
+    : cacheMem(_cacheMem), mainMem(_mainMem), org(_org), pred(_pred), tagsInDRAM(_tagsInDRAM), tagLatency(_tagLatency),
+      numSets(((uint64_t)cacheMB << 20)/blockSize/_ways), ways(_ways), blockLines(blockSize/lineSize), blockBits(ilog2(blockSize/lineSize)),
+      rowLines(rowSize/lineSize), name(_name)
+{
+    if (blockSize % lineSize || !isPow2(blockLines) || blockLines > 64) {
+        panic("%s: block size (%d) must be a power-of-two multiple of the line size, up to 64 lines", name.c_str(), blockSize);
+    }
+    if (org != FOOTPRINT && blockLines != 1) panic("%s: only Footprint DRAM caches can have blocks larger than a line", name.c_str());
+    if (org == ALLOY && (ways != 1 || !tagsInDRAM)) panic("%s: Alloy DRAM caches are direct-mapped with tags in DRAM", name.c_str());
+    if (org == LOHHILL && tagsInDRAM && rowLines <= ways) panic("%s: %d-way sets do not leave room for tags in a %d-line row", name.c_str(), ways, rowLines);
+    if (pred != PRED_NONE && !tagsInDRAM) panic("%s: miss predictors only make sense with tags in DRAM", name.c_str());
+    if (!isPow2(numSets)) panic("%s: number of sets must be a power of two (%d)", name.c_str(), numSets);
+
+    uint32_t numBlocks = numSets*ways;
+    tags = gm_calloc<Address>(numBlocks);
+    for (uint32_t i = 0; i < numBlocks; i++) tags[i] = INVALID;
+    lastUse = (ways > 1)? gm_calloc<uint32_t>(numBlocks) : NULL;
+    useCounter = 0;
+
+    if (org == FOOTPRINT) {
+        validLines = gm_calloc<uint64_t>(numBlocks);
+        dirtyLines = gm_calloc<uint64_t>(numBlocks);
+        usedLines = gm_calloc<uint64_t>(numBlocks);
+        historyEntries = _historyEntries;
+        if (!isPow2(historyEntries)) panic("%s: footprint history entries must be a power of two (%d)", name.c_str(), historyEntries);
+        historyTags = gm_calloc<Address>(historyEntries);
+        historyMasks = gm_calloc<uint64_t>(historyEntries);
+        for (uint32_t i = 0; i < historyEntries; i++) historyTags[i] = INVALID;
+    } else {
+        validLines = dirtyLines = usedLines = NULL;
+        historyTags = NULL;
+        historyMasks = NULL;
+        historyEntries = 0;
+    }
+
+    mapCounters = (pred == PRED_MAPI)? gm_calloc<uint8_t>(zinfo->numCores) : NULL;
+
+    futex_init(&lock);
+    info("%s: %d MB DRAM cache, %d sets x %d ways of %d-line blocks, tags in %s",
+            name.c_str(), cacheMB, numSets, ways, blockLines, tagsInDRAM? "DRAM" : "SRAM");
+}
+
+void DRAMCacheMemory::initStats(AggregateStat* parentStat) {
+    AggregateStat* memStats = new AggregateStat();
+    memStats->init(name.c_str(), "DRAM cache stats");
+    profGETSHit.init("hGETS", "GETS hits"); memStats->append(&profGETSHit);
+    profGETXHit.init("hGETX", "GETX hits"); memStats->append(&profGETXHit);
+    profGETSMiss.init("mGETS", "GETS misses"); memStats->append(&profGETSMiss);
+    profGETXMiss.init("mGETX", "GETX misses"); memStats->append(&profGETXMiss);
+    profPUTS.init("PUTS", "Clean evictions (from lower level), dropped"); memStats->append(&profPUTS);
+    profPUTXHit.init("hPUTX", "Dirty evictions (from lower level) that hit"); memStats->append(&profPUTXHit);
+    profPUTXMiss.init("mPUTX", "Dirty evictions (from lower level) that allocate"); memStats->append(&profPUTXMiss);
+    profFills.init("fills", "Lines filled from backing memory"); memStats->append(&profFills);
+    profWritebacks.init("wbs", "Dirty lines written back to backing memory"); memStats->append(&profWritebacks);
+    profEvictions.init("evictions", "Valid blocks evicted"); memStats->append(&profEvictions);
+    if (pred != PRED_NONE) {
+        profPredHits.init("predHit", "Accesses predicted to hit"); memStats->append(&profPredHits);
+        profPredMisses.init("predMiss", "Accesses predicted to miss"); memStats->append(&profPredMisses);
+        profPredWrong.init("predWrong", "Mispredicted accesses"); memStats->append(&profPredWrong);
+    }
+    if (org == FOOTPRINT) {
+        profFootprintFetches.init("fpFetches", "Non-demand lines fetched on block misses"); memStats->append(&profFootprintFetches);
+    }
+    profHitLat.init("latHit", "Cumulative latency of GETs that hit"); memStats->append(&profHitLat);
+    profMissLat.init("latMiss", "Cumulative latency of GETs that miss"); memStats->append(&profMissLat);
+    cacheMem->initStats(memStats);
+    mainMem->initStats(memStats);
+    parentStat->append(memStats);
+}
+
+void DRAMCacheMemory::checkpointState(Checkpoint& ckpt) {
+    // The cache's and main memory's DRAMs only have timing state
+    std::string prefix = name.c_str();
+    uint32_t numBlocks = numSets*ways;
+    ckpt.array(prefix + ".tags", tags, numBlocks);
+    if (lastUse) {
+        ckpt.value(prefix + ".useCounter", useCounter);
+        ckpt.array(prefix + ".lastUse", lastUse, numBlocks);
+    }
+    if (org == FOOTPRINT) {
+        ckpt.array(prefix + ".validLines", validLines, numBlocks);
+        ckpt.array(prefix + ".dirtyLines", dirtyLines, numBlocks);
+        ckpt.array(prefix + ".usedLines", usedLines, numBlocks);
+        ckpt.array(prefix + ".historyTags", historyTags, historyEntries);
+        ckpt.array(prefix + ".historyMasks", historyMasks, historyEntries);
+    }
+    if (mapCounters) ckpt.array(prefix + ".mapCounters", mapCounters, zinfo->numCores);
+}
+
+int32_t DRAMCacheMemory::lookup(Address blockAddr, uint32_t set) {
+    uint32_t first = set*ways;
+    for (uint32_t id = first; id < first + ways; id++) {
+        if ((tags[id] & ~DIRTY_BIT) == blockAddr) return id;
+    }
+    return -1;
+}
+
+uint32_t DRAMCacheMemory::findVictim(uint32_t set) const {
+    uint32_t first = set*ways;
+    uint32_t victim = first;
+    for (uint32_t id = first; id < first + ways; id++) {
+        if (tags[id] == INVALID) return id;
+        if (lastUse && lastUse[id] < lastUse[victim]) victim = id;
+    }
+    return victim;
+}
+
+Address DRAMCacheMemory::tagLineAddr(uint32_t set) const {
+    switch (org) {
+        case ALLOY: return set;  // TAD: tag and data share a burst
+        case LOHHILL: return (Address)set*rowLines;
+        default: return (Address)numSets*ways*blockLines + set;  // tags stored after all data
+    }
+}
+
+Address DRAMCacheMemory::dataLineAddr(uint32_t blockId, uint32_t line) const {
+    switch (org) {
+        case ALLOY: return blockId;
+        case LOHHILL: {
+            uint32_t set = blockId/ways;
+            uint32_t way = blockId % ways;
+            return (Address)set*rowLines + (tagsInDRAM? rowLines - ways : 0) + way;
+        }
+        default: return (Address)blockId*blockLines + line;
+    }
+}
+
+DRAMCacheMemory::Op DRAMCacheMemory::issue(MemObject* mem, Address lineAddr, AccessType type, uint64_t cycle, const MemReq& req) {
+    EventRecorder* evRec = zinfo->eventRecorders[req.srcId];
+    size_t initialRecords = evRec? evRec->numRecords() : 0;
+
+    MESIState state = I;
+    MemReq memReq = {lineAddr, type, 0, &state, cycle, NULL, state, req.srcId, 0 /*no flags*/};
+    Op op;
+    op.reqCycle = cycle;
+    op.respCycle = mem->access(memReq);
+    op.hasRecord = false;
+    op.follows = false;
+
+    if (evRec && evRec->numRecords() > initialRecords) {
+        assert_msg(evRec->numRecords() == initialRecords + 1, "%s: evRec records %ld", name.c_str(), evRec->numRecords());
+        op.rec = evRec->getRecord(initialRecords);
+        op.hasRecord = true;
+        evRec->popRecord();
+    }
+    return op;
+}
+
+uint64_t DRAMCacheMemory::evict(uint32_t blockId, uint64_t cycle, const MemReq& req) {
+    Address blockAddr = tags[blockId] & ~DIRTY_BIT;
+    uint64_t dirty = (org == FOOTPRINT)? dirtyLines[blockId] : ((tags[blockId] & DIRTY_BIT)? 1 : 0);
+    uint64_t doneCycle = cycle;
+    profEvictions.inc();
+
+    while (dirty) {
+        uint32_t line = __builtin_ctzl(dirty);
+        dirty &= dirty - 1;
+
+        // Alloy read the victim's data along with its tag; others read it now
+        uint64_t wbCycle = cycle;
+        if (org != ALLOY) {
+            Op rd = issue(cacheMem, dataLineAddr(blockId, line), GETS, cycle, req);
+            offPath.push_back(rd);
+            wbCycle = rd.respCycle;
+        }
+        Op wb = issue(mainMem, (blockAddr << blockBits) | line, PUTX, wbCycle, req);
+        wb.follows = (org != ALLOY);
+        offPath.push_back(wb);
+        doneCycle = MAX(doneCycle, wb.respCycle);
+        profWritebacks.inc();
+    }
+
+    if (org == FOOTPRINT) {
+        // Remember which lines this residency used, to fetch them next time
+        uint32_t h = blockAddr & (historyEntries - 1);
+        historyTags[h] = blockAddr;
+        historyMasks[h] = usedLines[blockId];
+        validLines[blockId] = dirtyLines[blockId] = usedLines[blockId] = 0;
+    }
+    tags[blockId] = INVALID;
+    return doneCycle;
+}
+
+uint64_t DRAMCacheMemory::access(MemReq& req) {
+    switch (req.type) {
+        case PUTS:
+            // Clean data is also in the backing memory, no need to keep it
+            profPUTS.inc();
+            *req.state = I;
+            return req.cycle;
+        case PUTX:
+            *req.state = I;
+            break;
+        case GETS:
+            *req.state = req.is(MemReq::NOEXCL)? S : E;
+            break;
+        case GETX:
+            *req.state = M;
+            break;
+        default: panic("!?");
+    }
+
+    futex_lock(&lock);
+    critPath.clear();
+    offPath.clear();
+    parallelOp.hasRecord = false;
+    bool hasParallelOp = false;
+
+    Address blockAddr = req.lineAddr >> blockBits;
+    uint32_t line = req.lineAddr & (blockLines - 1);
+    uint64_t lineBit = 1ul << line;
+    uint32_t set = getSet(blockAddr);
+    int32_t blockId = lookup(blockAddr, set);
+    bool hit = (blockId != -1) && (org != FOOTPRINT || (validLines[blockId] & lineBit));
+    bool isGet = (req.type != PUTX);
+
+    // Tag check: SRAM tag store or MissMap lookup, then optionally the DRAM probe
+    uint64_t cycle = req.cycle;
+    if (!tagsInDRAM || pred == PRED_MISSMAP) {
+        Op tagOp = {cycle, cycle + tagLatency, false};
+        critPath.push_back(tagOp);
+        cycle += tagLatency;
+    }
+    bool probe = tagsInDRAM && (hit || pred != PRED_MISSMAP);  // MissMap misses skip the probe
+
+    bool fetchInParallel = false;
+    if (pred != PRED_NONE && isGet) {
+        bool predMiss = (pred == PRED_MISSMAP)? !hit : (mapCounters[req.srcId] >= 4);
+        if (predMiss) profPredMisses.inc();
+        else profPredHits.inc();
+        if (predMiss == hit) profPredWrong.inc();
+        if (pred == PRED_MAPI) {
+            uint8_t& ctr = mapCounters[req.srcId];
+            if (hit) ctr = ctr? ctr - 1 : 0;
+            else ctr = MIN(7, ctr + 1);
+            fetchInParallel = predMiss;
+        }
+    }
+
+    if (probe && org != ALLOY) {
+        // Alloy's probe is the data access itself; others read the tags first
+        Op tagRd = issue(cacheMem, tagLineAddr(set), GETS, cycle, req);
+        critPath.push_back(tagRd);
+        cycle = tagRd.respCycle;
+    }
+
+    uint64_t respCycle;
+    if (isGet) {
+        if (fetchInParallel) {
+            // Predicted miss: backing memory access starts with the tag check
+            parallelOp = issue(mainMem, req.lineAddr, GETS, req.cycle, req);
+            hasParallelOp = true;
+        }
+
+        if (hit) {
+            Op rd = issue(cacheMem, (org == ALLOY)? tagLineAddr(set) : dataLineAddr(blockId, line), GETS, cycle, req);
+            critPath.push_back(rd);
+            respCycle = rd.respCycle;
+            touch(blockId);
+            if (org == FOOTPRINT) usedLines[blockId] |= lineBit;
+            if (req.type == GETS) profGETSHit.inc();
+            else profGETXHit.inc();
+            profHitLat.inc(respCycle - req.cycle);
+            if (hasParallelOp) {
+                // Wasted access, off the critical path
+                offPath.push_back(parallelOp);
+                hasParallelOp = false;
+            }
+        } else {
+            if (probe && org == ALLOY) {
+                Op tad = issue(cacheMem, tagLineAddr(set), GETS, cycle, req);
+                critPath.push_back(tad);
+                cycle = tad.respCycle;
+            }
+
+            uint64_t fetchCycle = cycle;
+            if (hasParallelOp) {
+                respCycle = MAX(cycle, parallelOp.respCycle);
+                fetchCycle = req.cycle;
+            } else {
+                Op rd = issue(mainMem, req.lineAddr, GETS, cycle, req);
+                critPath.push_back(rd);
+                respCycle = rd.respCycle;
+            }
+
+            // Allocate. Footprint fetches the rest of the predicted footprint with the demand line.
+            uint64_t fetchMask = lineBit;
+            if (blockId == -1) {
+                blockId = findVictim(set);
+                if (tags[blockId] != INVALID) evict(blockId, respCycle, req);
+                tags[blockId] = blockAddr;
+                if (org == FOOTPRINT) {
+                    uint32_t h = blockAddr & (historyEntries - 1);
+                    if (historyTags[h] == blockAddr) fetchMask |= historyMasks[h];
+                }
+            }
+            touch(blockId);
+
+            for (uint64_t m = fetchMask; m; m &= m - 1) {
+                uint32_t l = __builtin_ctzl(m);
+                if (l != line) {
+                    Op rd = issue(mainMem, (blockAddr << blockBits) | l, GETS, fetchCycle, req);
+                    offPath.push_back(rd);
+                    Op wr = issue(cacheMem, dataLineAddr(blockId, l), PUTX, rd.respCycle, req);
+                    wr.follows = true;
+                    offPath.push_back(wr);
+                    profFootprintFetches.inc();
+                } else {
+                    offPath.push_back(issue(cacheMem, dataLineAddr(blockId, l), PUTX, respCycle, req));
+                }
+                profFills.inc();
+            }
+            if (org == FOOTPRINT) {
+                validLines[blockId] |= fetchMask;
+                usedLines[blockId] |= lineBit;
+            }
+
+            if (req.type == GETS) profGETSMiss.inc();
+            else profGETXMiss.inc();
+            profMissLat.inc(respCycle - req.cycle);
+        }
+    } else {
+        // Dirty writeback from the LLC, write-allocate
+        if (hit) {
+            profPUTXHit.inc();
+        } else {
+            if (blockId == -1) {
+                blockId = findVictim(set);
+                if (tags[blockId] != INVALID) evict(blockId, cycle, req);
+                tags[blockId] = blockAddr;
+            }
+            profPUTXMiss.inc();
+        }
+        touch(blockId);
+
+        Op wr = issue(cacheMem, (org == ALLOY)? tagLineAddr(set) : dataLineAddr(blockId, line), PUTX, cycle, req);
+        critPath.push_back(wr);
+        respCycle = wr.respCycle;
+
+        if (org == FOOTPRINT) {
+            validLines[blockId] |= lineBit;
+            dirtyLines[blockId] |= lineBit;
+            usedLines[blockId] |= lineBit;
+        } else {
+            tags[blockId] |= DIRTY_BIT;
+        }
+    }
+
+    EventRecorder* evRec = zinfo->eventRecorders[req.srcId];
+    if (evRec) recordEvents(evRec, req, respCycle, hasParallelOp);
+
+    futex_unlock(&lock);
+    return respCycle;
+}
+
+/* Timing-graph construction. The critical path is a chain of accesses and
+ * fixed delays from req.cycle to respCycle, optionally joined by a parallel
+ * backing memory access. Off-path accesses (fills, writebacks, wasted
+ * predicted fetches) hang off the start or end of the critical path, or off
+ * the previous off-path access if they depend on it.
+ */
+
+TimingEvent* DRAMCacheMemory::delay(EventRecorder* evRec, TimingEvent* from, uint64_t fromCycle, uint64_t toCycle) {
+    assert_msg(fromCycle <= toCycle, "%s: %ld > %ld", name.c_str(), fromCycle, toCycle);
+    DelayEvent* d = new (evRec) DelayEvent(toCycle - fromCycle);
+    d->setMinStartCycle(fromCycle);
+    from->addChild(d, evRec);
+    return d;
+}
+
+TimingEvent* DRAMCacheMemory::link(EventRecorder* evRec, TimingEvent* from, uint64_t fromCycle, const Op& op) {
+    if (!op.hasRecord) return delay(evRec, from, fromCycle, op.respCycle);
+    assert_msg(fromCycle <= op.rec.reqCycle, "%s: %ld > %ld", name.c_str(), fromCycle, op.rec.reqCycle);
+    if (op.rec.reqCycle > fromCycle) from = delay(evRec, from, fromCycle, op.rec.reqCycle);
+    from->addChild(op.rec.startEvent, evRec);
+    if (op.respCycle > op.rec.respCycle) return delay(evRec, op.rec.endEvent, op.rec.respCycle, op.respCycle);
+    return op.rec.endEvent;
+}
+
+void DRAMCacheMemory::recordEvents(EventRecorder* evRec, const MemReq& req, uint64_t respCycle, bool hasParallelOp) {
+    // If no access left a record (e.g., Simple backends), there is nothing to simulate
+    bool anyRecord = hasParallelOp && parallelOp.hasRecord;
+    for (const Op& op : critPath) anyRecord |= op.hasRecord;
+    for (const Op& op : offPath) anyRecord |= op.hasRecord;
+    if (!anyRecord) return;
+
+    DelayEvent* startEv = new (evRec) DelayEvent(0);
+    startEv->setMinStartCycle(req.cycle);
+
+    TimingEvent* cur = startEv;
+    uint64_t curCycle = req.cycle;
+    for (const Op& op : critPath) {
+        cur = link(evRec, cur, curCycle, op);
+        curCycle = op.respCycle;
+    }
+
+    TimingEvent* endEv;
+    if (hasParallelOp) {
+        DelayEvent* join = new (evRec) DelayEvent(0);
+        join->setMinStartCycle(respCycle);
+        if (curCycle < respCycle) cur = delay(evRec, cur, curCycle, respCycle);
+        cur->addChild(join, evRec);
+        TimingEvent* par = link(evRec, startEv, req.cycle, parallelOp);
+        if (parallelOp.respCycle < respCycle) par = delay(evRec, par, parallelOp.respCycle, respCycle);
+        par->addChild(join, evRec);
+        endEv = join;
+    } else {
+        assert(curCycle == respCycle);
+        endEv = cur;
+    }
+
+    TimingEvent* prevOffEnd = NULL;
+    uint64_t prevOffCycle = 0;
+    for (const Op& op : offPath) {
+        if (op.follows) {
+            assert(prevOffEnd);
+            prevOffEnd = link(evRec, prevOffEnd, prevOffCycle, op);
+        } else if (op.reqCycle >= respCycle) {
+            prevOffEnd = link(evRec, endEv, respCycle, op);
+        } else {
+            prevOffEnd = link(evRec, startEv, req.cycle, op);
+        }
+        prevOffCycle = op.respCycle;
+    }
+
+    TimingRecord tr = {req.lineAddr << lineBits, req.cycle, respCycle, req.type, startEv, endEv};
+    evRec->pushRecord(tr);
+}
@@ -0,0 +1,151 @@
+/** $lic$
+ * Copyright (C) 2012-2014 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DRAM_CACHE_MEM_H_
+#define DRAM_CACHE_MEM_H_
+
+#include "event_recorder.h"
+#include "g_std/g_string.h"
+#include "g_std/g_vector.h"
+#include "locks.h"
+#include "memory_hierarchy.h"
+#include "pad.h"
+#include "stats.h"
+
+class TimingEvent;
+
+/* Memory-side DRAM cache (e.g., 3D-stacked DRAM) in front of a backing
+ * memory. Both the cache's DRAM and the backing memory are regular memory
+ * objects (DDR, NVMain, DRAMSim, ...), so their contention is simulated in
+ * the weave phase as usual. This class keeps the tags, decides hits and
+ * misses, and stitches the events of the accesses it issues into a single
+ * timing record.
+ *
+ * Organizations:
+ *  - Alloy: direct-mapped, tag and data read in a single DRAM burst (TAD)
+ *  - LohHill: set-associative, one DRAM row per set, tags in the first lines
+ *    of the row (tag read, then data read)
+ *  - Footprint: page-sized blocks with per-line valid bits; a block miss
+ *    fetches the lines used during the page's previous residency
+ *
+ * Tags may live in DRAM (Alloy always does) or in an SRAM tag store. With
+ * tags in DRAM, misses can be sped up with a MissMap (exact presence info,
+ * misses skip the DRAM probe) or a MAP-I style per-requester predictor
+ * (predicted misses access the backing memory in parallel with the probe).
+ */
+class DRAMCacheMemory : public MemObject {
+    public:
+        enum Organization {ALLOY, LOHHILL, FOOTPRINT};
+        enum Predictor {PRED_NONE, PRED_MISSMAP, PRED_MAPI};
+
+    private:
+        // Result of an access issued to one of the two memories
+        struct Op {
+            uint64_t reqCycle;
+            uint64_t respCycle;
+            bool hasRecord;
+            TimingRecord rec;
+            bool follows;  // off-path op that starts when the previous off-path op ends
+        };
+
+        MemObject* const cacheMem;  // the DRAM cache's own DRAM
+        MemObject* const mainMem;   // backing memory
+        const Organization org;
+        const Predictor pred;
+        const bool tagsInDRAM;
+        const uint32_t tagLatency;  // SRAM tag store or MissMap lookup, in sys cycles
+
+        const uint32_t numSets, ways;
+        const uint32_t blockLines, blockBits;  // lines per block (1 unless Footprint)
+        const uint32_t rowLines;               // LohHill: lines per DRAM row (tags + ways)
+
+        // Tag store. Block addresses never use the top bit, so it holds the
+        // dirty bit for line-sized blocks.
+        Address* tags;
+        uint32_t* lastUse;  // LRU timestamps, NULL if direct-mapped
+        uint32_t useCounter;
+        static const Address INVALID = -1L;
+        static const Address DIRTY_BIT = 1ul << 63;
+
+        // Footprint-only per-block line masks and footprint history
+        uint64_t* validLines;
+        uint64_t* dirtyLines;
+        uint64_t* usedLines;
+        Address* historyTags;
+        uint64_t* historyMasks;
+        uint32_t historyEntries;
+
+        // MAP-I predictor, one 3-bit counter per requester
+        uint8_t* mapCounters;
+
+        // Per-access scratch, protected by lock
+        g_vector<Op> critPath;
+        g_vector<Op> offPath;
+        Op parallelOp;
+
+        lock_t lock;
+        const g_string name;
+
+        PAD();
+        Counter profGETSHit, profGETXHit, profGETSMiss, profGETXMiss;
+        Counter profPUTS, profPUTXHit, profPUTXMiss;
+        Counter profFills, profWritebacks, profEvictions;
+        Counter profPredHits, profPredMisses, profPredWrong;
+        Counter profFootprintFetches;
+        Counter profHitLat, profMissLat;
+        PAD();
+
+    public:
+        DRAMCacheMemory(MemObject* _cacheMem, MemObject* _mainMem, uint32_t cacheMB, uint32_t lineSize,
+                Organization _org, uint32_t _ways, uint32_t blockSize, uint32_t rowSize, bool _tagsInDRAM,
+                uint32_t _tagLatency, Predictor _pred, uint32_t _historyEntries, const g_string& _name);
+
+        const char* getName() {return name.c_str();}
+        void initStats(AggregateStat* parentStat);
+        void checkpointState(Checkpoint& ckpt);
+        uint64_t access(MemReq& req);
+
+    private:
+        inline uint32_t getSet(Address blockAddr) const { return blockAddr & (numSets - 1); }
+        int32_t lookup(Address blockAddr, uint32_t set);
+        uint32_t findVictim(uint32_t set) const;
+        inline void touch(uint32_t blockId) { if (lastUse) lastUse[blockId] = ++useCounter; }
+
+        // Locations of tags and data in the cache's DRAM
+        Address tagLineAddr(uint32_t set) const;
+        Address dataLineAddr(uint32_t blockId, uint32_t line) const;
+
+        Op issue(MemObject* mem, Address lineAddr, AccessType type, uint64_t cycle, const MemReq& req);
+
+        // Evicts blockId, writing dirty lines back. Returns when the last writeback completes
+        uint64_t evict(uint32_t blockId, uint64_t cycle, const MemReq& req);
+
+        // Timing-graph construction
+        TimingEvent* link(EventRecorder* evRec, TimingEvent* from, uint64_t fromCycle, const Op& op);
+        TimingEvent* delay(EventRecorder* evRec, TimingEvent* from, uint64_t fromCycle, uint64_t toCycle);
+        void recordEvents(EventRecorder* evRec, const MemReq& req, uint64_t respCycle, bool hasParallelOp);
+};
+
+#endif  // DRAM_CACHE_MEM_H_
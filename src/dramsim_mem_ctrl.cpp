@@ -27,7 +27,6 @@
 #include <map>
 #include <string>
 #include "event_recorder.h"
-#include "tick_event.h"
 #include "timing_event.h"
 #include "zsim.h"
 
@@ -61,12 +60,75 @@ class DRAMSimAccEvent : public TimingEvent {
         }
 };
 
+/* Globally allocated event for scheduling
+ *
+ * NOTE: Reusing the same interface used in DDRMemory and NVMainMemory.
+ */
+class SchedEventDRAMSim : public TimingEvent, public GlobAlloc {
+    private:
+        DRAMSimMemory* const mem;
+        enum State { IDLE, QUEUED, RUNNING, ANNULLED };
+        State state;
+
+    public:
+        SchedEventDRAMSim* next;  // for event freelist
+
+        SchedEventDRAMSim(DRAMSimMemory* _mem, int32_t domain) : TimingEvent(0, 0, domain), mem(_mem) {
+            setMinStartCycle(0);
+            setRunning();
+            hold();
+            state = IDLE;
+            next = NULL;
+        }
+
+        void parentDone(uint64_t startCycle) {
+            panic("This is queued directly");
+        }
+
+        void simulate(uint64_t startCycle) {
+            if (state == QUEUED) {
+                state = RUNNING;
+                uint64_t nextCycle = mem->tick(startCycle);
+                if (nextCycle) {
+                    requeue(nextCycle);
+                    state = QUEUED;
+                } else {
+                    state = IDLE;
+                    hold();
+                    mem->recycleEvent(this);
+                }
+            } else {
+                assert(state == ANNULLED);
+                state = IDLE;
+                hold();
+                mem->recycleEvent(this);
+            }
+        }
+
+        void enqueue(uint64_t cycle) {
+            assert(state == IDLE);
+            state = QUEUED;
+            requeue(cycle);
+        }
+
+        void annul() {
+            assert_msg(state == QUEUED, "sched state %d", state);
+            state = ANNULLED;
+        }
+
+        // Use glob mem
+        using GlobAlloc::operator new;
+        using GlobAlloc::operator delete;
+};
+
 
 DRAMSimMemory::DRAMSimMemory(string& dramTechIni, string& dramSystemIni, string& outputDir, string& traceName,
-        uint32_t capacityMB, uint64_t cpuFreqHz, uint32_t _minLatency, uint32_t _domain, const g_string& _name)
+        uint32_t capacityMB, uint64_t cpuFreqHz, uint32_t _minLatency, bool _simulateIdle, uint32_t _domain, const g_string& _name)
 {
     curCycle = 0;
+    updateCycle = 0;
     minLatency = _minLatency;
+    simulateIdle = _simulateIdle;
     // NOTE: this will alloc DRAM on the heap and not the glob_heap, make sure only one process ever handles this
     dramCore = getMemorySystemInstance(dramTechIni, dramSystemIni, outputDir, traceName, capacityMB);
     dramCore->setCPUClockSpeed(cpuFreqHz);
@@ -76,8 +138,10 @@ DRAMSimMemory::DRAMSimMemory(string& dramTechIni, string& dramSystemIni, string&
     dramCore->RegisterCallbacks(read_cb, write_cb, NULL);
 
     domain = _domain;
-    TickEvent<DRAMSimMemory>* tickEv = new TickEvent<DRAMSimMemory>(this, domain);
-    tickEv->queue(0);  // start the sim at time 0
+    // No TickEvent: DRAMSim is ticked by a SchedEvent only while requests are in flight
+    nextSchedEvent = NULL;
+    nextSchedCycle = -1ul;
+    eventFreelist = NULL;
 
     name = _name;
 }
@@ -89,6 +153,10 @@ void DRAMSimMemory::initStats(AggregateStat* parentStat) {
     profWrites.init("wr", "Write requests"); memStats->append(&profWrites);
     profTotalRdLat.init("rdlat", "Total latency experienced by read requests"); memStats->append(&profTotalRdLat);
     profTotalWrLat.init("wrlat", "Total latency experienced by write requests"); memStats->append(&profTotalWrLat);
+    profTicks.init("ticks", "Cycles simulated by ticking with requests in flight"); memStats->append(&profTicks);
+    profWakeups.init("wakeups", "Requests that arrived while DRAMSim was idle"); memStats->append(&profWakeups);
+    profIdleCycles.init("idleCycles", "Idle cycles simulated in bulk on wakeups"); memStats->append(&profIdleCycles);
+    profSkippedCycles.init("skippedCycles", "Idle cycles not simulated (simulateIdle = false, the default)"); memStats->append(&profSkippedCycles);
     parentStat->append(memStats);
 }
 
@@ -123,17 +191,69 @@ uint64_t DRAMSimMemory::access(MemReq& req) {
     return respCycle;
 }
 
-uint32_t DRAMSimMemory::tick(uint64_t cycle) {
-    dramCore->update();
-    curCycle++;
-    return 1;
+uint64_t DRAMSimMemory::tick(uint64_t cycle) {
+    assert(nextSchedEvent && cycle == nextSchedCycle);
+    assert(updateCycle == cycle);
+    profTicks.inc();
+    advance(cycle + 1);
+
+    if (inflightRequests.empty()) {
+        // Go dormant until the next request
+        nextSchedEvent = NULL;
+        nextSchedCycle = -1ul;
+        return 0; //this will recycle the SchedEvent
+    } else {
+        // DRAMSim is not event-driven, so we can't tell when requests finish; tick every cycle
+        nextSchedCycle = cycle + 1;
+        return nextSchedCycle;
+    }
+}
+
+// Simulates DRAMSim up to (not including) cycle. Completions in the cycle being simulated finish in the next one.
+void DRAMSimMemory::advance(uint64_t cycle) {
+    if (inflightRequests.empty() && updateCycle < cycle) {
+        if (simulateIdle) {
+            profIdleCycles.inc(cycle - updateCycle);
+        } else {
+            profSkippedCycles.inc(cycle - updateCycle);
+            updateCycle = cycle;
+        }
+    }
+    while (updateCycle < cycle) {
+        curCycle = updateCycle;
+        dramCore->update();
+        updateCycle++;
+    }
 }
 
 void DRAMSimMemory::enqueue(DRAMSimAccEvent* ev, uint64_t cycle) {
     //info("[%s] %s access to %lx added at %ld, %ld inflight reqs", getName(), ev->isWrite()? "Write" : "Read", ev->getAddr(), cycle, inflightRequests.size());
+    // Catch up with idle cycles; if the current cycle was already ticked, the request is seen in the next one
+    advance(cycle);
     dramCore->addTransaction(ev->isWrite(), ev->getAddr());
     inflightRequests.insert(std::pair<Address, DRAMSimAccEvent*>(ev->getAddr(), ev));
     ev->hold();
+
+    // Wake up if dormant
+    if (!nextSchedEvent) {
+        profWakeups.inc();
+        if (eventFreelist) {
+            nextSchedEvent = eventFreelist;
+            eventFreelist = eventFreelist->next;
+            nextSchedEvent->next = NULL;
+        } else {
+            nextSchedEvent = new SchedEventDRAMSim(this, domain);
+        }
+        nextSchedEvent->enqueue(updateCycle);
+        nextSchedCycle = updateCycle;
+    }
+}
+
+void DRAMSimMemory::recycleEvent(SchedEventDRAMSim* ev) {
+    assert(ev != nextSchedEvent);
+    assert(ev->next == NULL);
+    ev->next = eventFreelist;
+    eventFreelist = ev;
 }
 
 void DRAMSimMemory::DRAM_read_return_cb(uint32_t id, uint64_t addr, uint64_t memCycle) {
@@ -166,15 +286,17 @@ void DRAMSimMemory::DRAM_write_return_cb(uint32_t id, uint64_t addr, uint64_t me
 using std::string;
 
 DRAMSimMemory::DRAMSimMemory(string& dramTechIni, string& dramSystemIni, string& outputDir, string& traceName,
-        uint32_t capacityMB, uint64_t cpuFreqHz, uint32_t _minLatency, uint32_t _domain, const g_string& _name)
+        uint32_t capacityMB, uint64_t cpuFreqHz, uint32_t _minLatency, bool _simulateIdle, uint32_t _domain, const g_string& _name)
 {
     panic("Cannot use DRAMSimMemory, zsim was not compiled with DRAMSim");
 }
 
 void DRAMSimMemory::initStats(AggregateStat* parentStat) { panic("???"); }
 uint64_t DRAMSimMemory::access(MemReq& req) { panic("???"); return 0; }
-uint32_t DRAMSimMemory::tick(uint64_t cycle) { panic("???"); return 0; }
+uint64_t DRAMSimMemory::tick(uint64_t cycle) { panic("???"); return 0; }
+void DRAMSimMemory::advance(uint64_t cycle) { panic("???"); }
 void DRAMSimMemory::enqueue(DRAMSimAccEvent* ev, uint64_t cycle) { panic("???"); }
+void DRAMSimMemory::recycleEvent(SchedEventDRAMSim* ev) { panic("???"); }
 void DRAMSimMemory::DRAM_read_return_cb(uint32_t id, uint64_t addr, uint64_t memCycle) { panic("???"); }
 void DRAMSimMemory::DRAM_write_return_cb(uint32_t id, uint64_t addr, uint64_t memCycle) { panic("???"); }
 
@@ -38,6 +38,7 @@ namespace DRAMSim {
 };
 
 class DRAMSimAccEvent;
+class SchedEventDRAMSim;
 
 class DRAMSimMemory : public MemObject { //one DRAMSim controller
     private:
@@ -50,6 +51,21 @@ class DRAMSimMemory : public MemObject { //one DRAMSim controller
         std::multimap<uint64_t, DRAMSimAccEvent*> inflightRequests;
 
         uint64_t curCycle; //processor cycle, used in callbacks
+        uint64_t updateCycle; //next processor cycle DRAMSim will simulate
+
+        // DRAMSim is only ticked while requests are in flight. By default (simulateIdle = false),
+        // DRAMSim's clock stands still while idle, so idle periods cost nothing. This is not exact:
+        // refreshes and power-downs that fall in idle periods never happen (so latencies are slightly
+        // optimistic, and DRAMSim's power and epoch stats only cover busy cycles), and timing
+        // constraints still pending when DRAMSim went idle delay the next request as if no time had
+        // passed. If simulateIdle is set, idle cycles are simulated in bulk when a request arrives, so
+        // results match ticking every cycle, at the cost of one DRAMSim update per idle cycle.
+        bool simulateIdle;
+
+        // Weave phase handling
+        SchedEventDRAMSim* nextSchedEvent;
+        uint64_t nextSchedCycle;
+        SchedEventDRAMSim* eventFreelist;
 
         // R/W stats
         PAD();
@@ -57,11 +73,15 @@ class DRAMSimMemory : public MemObject { //one DRAMSim controller
         Counter profWrites;
         Counter profTotalRdLat;
         Counter profTotalWrLat;
+        Counter profTicks;
+        Counter profWakeups;
+        Counter profIdleCycles;
+        Counter profSkippedCycles;
         PAD();
 
     public:
         DRAMSimMemory(std::string& dramTechIni, std::string& dramSystemIni, std::string& outputDir, std::string& traceName, uint32_t capacityMB,
-                uint64_t cpuFreqHz,  uint32_t _minLatency, uint32_t _domain, const g_string& _name);
+                uint64_t cpuFreqHz,  uint32_t _minLatency, bool _simulateIdle, uint32_t _domain, const g_string& _name);
 
         const char* getName() {return name.c_str();}
 
@@ -71,41 +91,15 @@ class DRAMSimMemory : public MemObject { //one DRAMSim controller
         uint64_t access(MemReq& req);
 
         // Event-driven simulation (phase 2)
-        uint32_t tick(uint64_t cycle);
+        uint64_t tick(uint64_t cycle);
         void enqueue(DRAMSimAccEvent* ev, uint64_t cycle);
+        void recycleEvent(SchedEventDRAMSim* ev);
 
     private:
+        void advance(uint64_t cycle);
+
         void DRAM_read_return_cb(uint32_t id, uint64_t addr, uint64_t returnCycle);
         void DRAM_write_return_cb(uint32_t id, uint64_t addr, uint64_t returnCycle);
 };
 
-//DRAMSIM does not support non-pow2 channels, so:
-// - Encapsulate multiple DRAMSim controllers
-// - Fan out addresses interleaved across banks, and change the address to a "memory address"
-class SplitAddrMemory : public MemObject {
-    private:
-        const g_vector<MemObject*> mems;
-        const g_string name;
-    public:
-        SplitAddrMemory(const g_vector<MemObject*>& _mems, const char* _name) : mems(_mems), name(_name) {}
-
-        uint64_t access(MemReq& req) {
-            Address addr = req.lineAddr;
-            uint32_t mem = addr % mems.size();
-            Address ctrlAddr = addr/mems.size();
-            req.lineAddr = ctrlAddr;
-            uint64_t respCycle = mems[mem]->access(req);
-            req.lineAddr = addr;
-            return respCycle;
-        }
-
-        const char* getName() {
-            return name.c_str();
-        }
-
-        void initStats(AggregateStat* parentStat) {
-            for (auto mem : mems) mem->initStats(parentStat);
-        }
-};
-
 #endif  // DRAMSIM_MEM_CTRL_H_
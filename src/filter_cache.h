@@ -29,6 +29,7 @@
 #include "bithacks.h"
 #include "cache.h"
 #include "galloc.h"
+#include "page_alloc.h"
 #include "zsim.h"
 
 /* Extends Cache with an L0 direct-mapped cache, optimized to hell for hits
@@ -47,8 +48,9 @@ class FilterCache : public Cache {
             volatile Address rdAddr;
             volatile Address wrAddr;
             volatile uint64_t availCycle;
+            volatile Address pAddr; //physical line of rdAddr, matched by invalidations
 
-            void clear() {wrAddr = 0; rdAddr = 0; availCycle = 0;}
+            void clear() {wrAddr = 0; rdAddr = 0; availCycle = 0; pAddr = 0;}
         };
 
         //Replicates the most accessed line of each set in the cache
@@ -126,7 +128,7 @@ class FilterCache : public Cache {
         }
 
         uint64_t replace(Address vLineAddr, uint32_t idx, bool isLoad, uint64_t curCycle) {
-            Address pLineAddr = procMask | vLineAddr;
+            Address pLineAddr = translate(vLineAddr);
             MESIState dummyState = MESIState::I;
             futex_lock(&filterLock);
             MemReq req = {pLineAddr, isLoad? GETS : GETX, 0, &dummyState, curCycle, &filterLock, dummyState, srcId, reqFlags};
@@ -138,6 +140,7 @@ class FilterCache : public Cache {
             Address oldAddr = filterArray[idx].rdAddr;
             filterArray[idx].wrAddr = isLoad? -1L : vLineAddr;
             filterArray[idx].rdAddr = vLineAddr;
+            filterArray[idx].pAddr = pLineAddr;
 
             //For LSU simulation purposes, loads bypass stores even to the same line if there is no conflict,
             //(e.g., st to x, ld from x+8) and we implement store-load forwarding at the core.
@@ -148,19 +151,43 @@ class FilterCache : public Cache {
             return respCycle;
         }
 
+        //Functional warming: like a load/store, but the access is flagged WARM, and neither timing nor filter hits are tracked
+        inline void warm(Address vAddr, bool isLoad) {
+            Address vLineAddr = vAddr >> lineBits;
+            uint32_t idx = vLineAddr & setMask;
+            if (vLineAddr == (isLoad? filterArray[idx].rdAddr : filterArray[idx].wrAddr)) return;
+
+            Address pLineAddr = translate(vLineAddr);
+            MESIState dummyState = MESIState::I;
+            futex_lock(&filterLock);
+            MemReq req = {pLineAddr, isLoad? GETS : GETX, 0, &dummyState, 0, &filterLock, dummyState, srcId, reqFlags | MemReq::WARM};
+            access(req);
+            filterArray[idx].wrAddr = isLoad? -1L : vLineAddr;
+            filterArray[idx].rdAddr = vLineAddr;
+            filterArray[idx].pAddr = pLineAddr;
+            filterArray[idx].availCycle = 0;
+            futex_unlock(&filterLock);
+        }
+
         //NOTE: reqWriteback is pulled up to true, but not pulled down to false.
-        uint64_t invalidate(Address lineAddr, InvType type, bool* reqWriteback, uint64_t cycle, uint32_t srcId) {
+        uint64_t invalidate(Address lineAddr, InvType type, bool* reqWriteback, uint64_t cycle, uint32_t srcId, uint32_t flags) {
             futex_lock(&filterLock);
-            uint32_t idx = lineAddr & setMask; //works because of how virtual<->physical is done...
-            if ((filterArray[idx].rdAddr | procMask) == lineAddr) { //FIXME: If another process calls invalidate(), procMask will not match even though we may be doing a capacity-induced invalidation!
+            uint32_t idx = lineAddr & setMask; //works because the set bits are within the page offset (checked in init with the page allocator)
+            if (filterArray[idx].pAddr == lineAddr) {
                 filterArray[idx].wrAddr = -1L;
                 filterArray[idx].rdAddr = -1L;
+                filterArray[idx].pAddr = -1L;
             }
             futex_unlock(&filterLock);
-            uint64_t respCycle = Cache::invalidate(lineAddr, type, reqWriteback, cycle, srcId);
+            uint64_t respCycle = Cache::invalidate(lineAddr, type, reqWriteback, cycle, srcId, flags);
             return respCycle;
         }
 
+        //Physical line of a virtual line of the current process
+        inline Address translate(Address vLineAddr) {
+            return zinfo->pageAllocator? zinfo->pageAllocator->translate(vLineAddr, srcId) : (procMask | vLineAddr);
+        }
+
         void contextSwitch() {
             futex_lock(&filterLock);
             for (uint32_t i = 0; i < numSets; i++) filterArray[i].clear();
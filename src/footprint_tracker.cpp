@@ -0,0 +1,184 @@
+/** $lic$
+ * Copyright (C) 2012-2014 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "footprint_tracker.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bithacks.h"
+#include "log.h"
+
+void FootprintTracker::initStats(AggregateStat* parentStat) {
+    profFootprint.init("footprint", "Total memory footprint in bytes"); parentStat->append(&profFootprint);
+    profAddresses.init("addresses", "Total number of distinct memory addresses"); parentStat->append(&profAddresses);
+    profReuseHist.init("addressReuse", "address reuse histogram for memory requests", reuseBins); parentStat->append(&profReuseHist);
+}
+
+/* LineCountTable */
+
+LineCountTable::LineCountTable(uint8_t _maxCount, uint64_t initialSlots) : maxCount(_maxCount) {
+    assert(isPow2(initialSlots));
+    numSlots = initialSlots;
+    slotBits = ilog2(numSlots);
+    elems = 0;
+    keys = static_cast<Address*>(malloc(numSlots*sizeof(Address)));
+    counts = static_cast<uint8_t*>(calloc(numSlots, sizeof(uint8_t)));
+    memset(keys, 0xff, numSlots*sizeof(Address));
+}
+
+LineCountTable::~LineCountTable() {
+    free(keys);
+    free(counts);
+}
+
+uint8_t LineCountTable::inc(Address lineAddr) {
+    assert(lineAddr != EMPTY);
+    uint64_t mask = numSlots - 1;
+    uint64_t s = slot(lineAddr);
+    while (keys[s] != EMPTY) {
+        if (keys[s] == lineAddr) {
+            uint8_t prev = counts[s];
+            if (prev < maxCount) counts[s]++;
+            return prev;
+        }
+        s = (s + 1) & mask;
+    }
+
+    keys[s] = lineAddr;
+    counts[s] = 1;
+    if (++elems > numSlots/2) grow();
+    return 0;
+}
+
+void LineCountTable::grow() {
+    Address* oldKeys = keys;
+    uint8_t* oldCounts = counts;
+    uint64_t oldSlots = numSlots;
+
+    numSlots *= 2;
+    slotBits++;
+    keys = static_cast<Address*>(malloc(numSlots*sizeof(Address)));
+    counts = static_cast<uint8_t*>(calloc(numSlots, sizeof(uint8_t)));
+    memset(keys, 0xff, numSlots*sizeof(Address));
+
+    uint64_t mask = numSlots - 1;
+    for (uint64_t i = 0; i < oldSlots; i++) {
+        if (oldKeys[i] == EMPTY) continue;
+        uint64_t s = slot(oldKeys[i]);
+        while (keys[s] != EMPTY) s = (s + 1) & mask;
+        keys[s] = oldKeys[i];
+        counts[s] = oldCounts[i];
+    }
+
+    free(oldKeys);
+    free(oldCounts);
+}
+
+/* ExactFootprintTracker */
+
+ExactFootprintTracker::ExactFootprintTracker(uint32_t _lineSize, uint32_t _reuseBins)
+    : FootprintTracker(_lineSize, _reuseBins), table(_reuseBins - 1) {}
+
+void ExactFootprintTracker::access(Address lineAddr) {
+    uint8_t prev = table.inc(lineAddr);
+    if (prev == 0) {
+        profAddresses.inc(1);
+        profFootprint.inc(lineSize);
+        profReuseHist.inc(1);
+    } else if (prev < reuseBins - 1) {
+        profReuseHist.dec(prev);
+        profReuseHist.inc(prev + 1);
+    }
+}
+
+/* ApproxFootprintTracker */
+
+// 64-bit finalizer (splitmix64); lineAddrs are too regular to feed HLL directly
+static inline uint64_t mixHash(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ul;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebul;
+    x ^= x >> 31;
+    return x;
+}
+
+ApproxFootprintTracker::ApproxFootprintTracker(uint32_t _lineSize, uint32_t _reuseBins, double relError, uint32_t _sampleRate)
+    : FootprintTracker(_lineSize, _reuseBins), sampled(_reuseBins - 1), sampleRate(_sampleRate)
+{
+    if (relError <= 0.0 || relError >= 1.0) panic("Invalid footprint tracking error %f, must be in (0, 1)", relError);
+    if (!isPow2(sampleRate)) panic("Footprint sampling rate must be a power of 2 (%d)", sampleRate);
+
+    // HLL relative std error is 1.04/sqrt(m)
+    double m = (1.04/relError)*(1.04/relError);
+    precision = MIN(18u, MAX(4u, (uint32_t)ceil(log2(m))));
+    numRegisters = 1 << precision;
+    registers = static_cast<uint8_t*>(calloc(numRegisters, sizeof(uint8_t)));
+    zeroRegisters = numRegisters;
+    invSum = numRegisters;  // all registers at 0 -> 2^0 each
+    info("Approximate footprint tracking: %d HLL registers (%.2f%% std error), 1/%d reuse sampling",
+            numRegisters, 104.0/sqrt(numRegisters), sampleRate);
+}
+
+ApproxFootprintTracker::~ApproxFootprintTracker() {
+    free(registers);
+}
+
+uint64_t ApproxFootprintTracker::estimate() const {
+    double m = numRegisters;
+    double alpha = (numRegisters >= 128)? 0.7213/(1.0 + 1.079/m) : ((numRegisters == 64)? 0.709 : ((numRegisters == 32)? 0.697 : 0.673));
+    double est = alpha*m*m/invSum;
+    if (est <= 2.5*m && zeroRegisters) est = m*log(m/zeroRegisters);  // linear counting for small sets
+    return (uint64_t)(est + 0.5);
+}
+
+void ApproxFootprintTracker::access(Address lineAddr) {
+    uint64_t h = mixHash(lineAddr);
+
+    // HLL: top bits pick the register, leading zeros of the rest give the rank
+    uint32_t idx = h >> (64 - precision);
+    uint64_t rest = (h << precision) | (1ul << (precision - 1));  // bound rank to 64 - precision + 1
+    uint8_t rank = __builtin_clzl(rest) + 1;
+    if (rank > registers[idx]) {
+        if (registers[idx] == 0) zeroRegisters--;
+        invSum += ldexp(1.0, -rank) - ldexp(1.0, -registers[idx]);
+        registers[idx] = rank;
+
+        uint64_t addresses = estimate();
+        profAddresses.set(addresses);
+        profFootprint.set(addresses*lineSize);
+    }
+
+    // Reuse: exact counts on the lines whose low hash bits are zero
+    if ((h & (sampleRate - 1)) == 0) {
+        uint8_t prev = sampled.inc(lineAddr);
+        if (prev == 0) {
+            profReuseHist.inc(1, sampleRate);
+        } else if (prev < reuseBins - 1) {
+            profReuseHist.dec(prev, sampleRate);
+            profReuseHist.inc(prev + 1, sampleRate);
+        }
+    }
+}
@@ -0,0 +1,128 @@
+/** $lic$
+ * Copyright (C) 2012-2014 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FOOTPRINT_TRACKER_H_
+#define FOOTPRINT_TRACKER_H_
+
+#include <stdint.h>
+#include "galloc.h"
+#include "memory_hierarchy.h"
+#include "pad.h"
+#include "stats.h"
+
+/* Tracks the distinct lines a memory controller has seen and how often each
+ * one is reused. Exports three stats: footprint (bytes), addresses (distinct
+ * lines) and addressReuse (histogram of lines by access count, last bin
+ * saturates). All stats are updated as accesses arrive, so trackers can keep
+ * their tables in the process-local heap.
+ */
+class FootprintTracker : public GlobAlloc {
+    protected:
+        const uint32_t lineSize;
+        const uint32_t reuseBins;
+
+        PAD();
+        Counter profFootprint;
+        Counter profAddresses;
+        VectorCounter profReuseHist;
+        PAD();
+
+    public:
+        FootprintTracker(uint32_t _lineSize, uint32_t _reuseBins) : lineSize(_lineSize), reuseBins(_reuseBins) {}
+        virtual ~FootprintTracker() {}
+
+        void initStats(AggregateStat* parentStat);
+
+        virtual void access(Address lineAddr) = 0;
+};
+
+/* Compact open-addressing table of per-line saturating access counters.
+ * Uses ~9 bytes/slot (vs ~50 bytes/entry for an std::unordered_map), and
+ * grows by doubling at 50% occupancy.
+ */
+class LineCountTable {
+    private:
+        static const Address EMPTY = ~0ul;  // lineAddrs never have all bits set
+
+        Address* keys;
+        uint8_t* counts;
+        uint64_t numSlots;  // power of 2
+        uint64_t slotBits;
+        uint64_t elems;
+        const uint8_t maxCount;
+
+    public:
+        LineCountTable(uint8_t _maxCount, uint64_t initialSlots = 1024);
+        ~LineCountTable();
+
+        // Increments lineAddr's counter, inserting it if needed. Returns the previous count (0 if new).
+        uint8_t inc(Address lineAddr);
+
+        uint64_t size() const { return elems; }
+
+    private:
+        inline uint64_t slot(Address lineAddr) const {
+            return (lineAddr * 0x9E3779B97F4A7C15ul) >> (64 - slotBits);
+        }
+
+        void grow();
+};
+
+/* Exact tracking: every line gets a counter */
+class ExactFootprintTracker : public FootprintTracker {
+    private:
+        LineCountTable table;
+
+    public:
+        ExactFootprintTracker(uint32_t _lineSize, uint32_t _reuseBins);
+        void access(Address lineAddr);
+};
+
+/* Approximate tracking with bounded memory. Distinct lines are counted with
+ * a HyperLogLog sketch, sized for the requested relative standard error.
+ * Reuse is tracked exactly for a hash-sampled subset of lines (1 in
+ * sampleRate) and scaled up.
+ */
+class ApproxFootprintTracker : public FootprintTracker {
+    private:
+        uint8_t* registers;
+        uint32_t precision;  // log2(registers)
+        uint32_t numRegisters;
+        uint32_t zeroRegisters;
+        double invSum;  // sum of 2^-register, maintained incrementally
+
+        LineCountTable sampled;
+        const uint32_t sampleRate;  // power of 2
+
+    public:
+        ApproxFootprintTracker(uint32_t _lineSize, uint32_t _reuseBins, double relError, uint32_t _sampleRate);
+        ~ApproxFootprintTracker();
+        void access(Address lineAddr);
+
+    private:
+        uint64_t estimate() const;
+};
+
+#endif  // FOOTPRINT_TRACKER_H_
@@ -0,0 +1,101 @@
+/** $lic$
+ * Copyright (C) 2012-2014 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INFLIGHT_HEAP_H_
+#define INFLIGHT_HEAP_H_
+
+#include <stdint.h>
+#include <vector>
+#include "log.h"
+
+/* Indexed min-heap of in-flight requests, ordered by minFinishCycle.
+ * Requests complete out of order, so each one records its heap position
+ * (heapIdx) to allow O(log n) removal from the middle without a search.
+ * T must have uint64_t minFinishCycle and uint32_t heapIdx fields.
+ */
+template <typename T>
+class InflightHeap {
+    private:
+        std::vector<T*> heap;
+
+    public:
+        inline bool empty() const {return heap.empty();}
+        inline size_t size() const {return heap.size();}
+        inline T* top() const {return heap.front();}
+
+        inline bool contains(const T* req) const {
+            return req->heapIdx < heap.size() && heap[req->heapIdx] == req;
+        }
+
+        void insert(T* req) {
+            req->heapIdx = heap.size();
+            heap.push_back(req);
+            siftUp(req->heapIdx);
+        }
+
+        void remove(T* req) {
+            assert(contains(req));
+            uint32_t idx = req->heapIdx;
+            T* last = heap.back();
+            heap.pop_back();
+            if (last == req) return;
+            heap[idx] = last;
+            last->heapIdx = idx;
+            siftUp(idx);
+            siftDown(last->heapIdx);
+        }
+
+    private:
+        void siftUp(uint32_t idx) {
+            T* req = heap[idx];
+            while (idx) {
+                uint32_t parent = (idx - 1)/2;
+                if (heap[parent]->minFinishCycle <= req->minFinishCycle) break;
+                heap[idx] = heap[parent];
+                heap[idx]->heapIdx = idx;
+                idx = parent;
+            }
+            heap[idx] = req;
+            req->heapIdx = idx;
+        }
+
+        void siftDown(uint32_t idx) {
+            T* req = heap[idx];
+            uint32_t size = heap.size();
+            while (true) {
+                uint32_t child = 2*idx + 1;
+                if (child >= size) break;
+                if (child + 1 < size && heap[child + 1]->minFinishCycle < heap[child]->minFinishCycle) child++;
+                if (req->minFinishCycle <= heap[child]->minFinishCycle) break;
+                heap[idx] = heap[child];
+                heap[idx]->heapIdx = idx;
+                idx = child;
+            }
+            heap[idx] = req;
+            req->heapIdx = idx;
+        }
+};
+
+#endif  // INFLIGHT_HEAP_H_
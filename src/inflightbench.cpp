@@ -0,0 +1,136 @@
+/** $lic$
+ * Copyright (C) 2012-2014 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Standalone benchmark of NVMainMemory's in-flight request tracking. Keeps
+ * a fixed number of requests outstanding and repeatedly completes one of
+ * them out of order and issues a new one, as the weave phase does, through
+ * InflightHeap and through the original vector with a linear search. Reports
+ * ns per complete+issue pair at each occupancy. This uses a stand-in request
+ * type so that it does not depend on NVMain; InflightHeap only touches the
+ * minFinishCycle and heapIdx fields.
+ */
+
+#include <stdlib.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+#include "inflight_heap.h"
+#include "log.h"
+#include "mtrand.h"
+
+struct BenchRequest {
+    uint64_t minFinishCycle;
+    uint32_t heapIdx;
+};
+
+static double GetTime() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static const uint64_t MIN_LATENCY = 100;
+
+/* Completion order is precomputed, so both trackers see the same stream and
+ * the RNG stays out of the timed loop. Each step completes a random
+ * outstanding request, since NVMain reorders requests across banks, and
+ * reissues it.
+ */
+static void MakeStream(uint32_t occupancy, uint64_t ops, std::vector<uint32_t>& victims) {
+    MTRand rng(occupancy);
+    victims.resize(ops);
+    for (uint64_t i = 0; i < ops; i++) victims[i] = rng.randInt(occupancy - 1);
+}
+
+static double RunHeap(uint32_t occupancy, const std::vector<uint32_t>& victims, uint64_t& checksum) {
+    std::vector<BenchRequest> reqs(occupancy);
+    InflightHeap<BenchRequest> heap;
+    for (uint32_t i = 0; i < occupancy; i++) {
+        reqs[i].minFinishCycle = i + MIN_LATENCY;
+        heap.insert(&reqs[i]);
+    }
+
+    double start = GetTime();
+    uint64_t cycle = occupancy;
+    for (uint32_t v : victims) {
+        BenchRequest* req = &reqs[v];
+        heap.remove(req);
+        req->minFinishCycle = cycle++ + MIN_LATENCY;
+        heap.insert(req);
+        checksum += heap.top()->minFinishCycle;
+    }
+    return GetTime() - start;
+}
+
+// The original tracking: a vector searched linearly on completion
+static double RunVector(uint32_t occupancy, const std::vector<uint32_t>& victims, uint64_t& checksum) {
+    std::vector<BenchRequest> reqs(occupancy);
+    std::vector<BenchRequest*> inflight;
+    for (uint32_t i = 0; i < occupancy; i++) {
+        reqs[i].minFinishCycle = i + MIN_LATENCY;
+        inflight.push_back(&reqs[i]);
+    }
+
+    double start = GetTime();
+    uint64_t cycle = occupancy;
+    for (uint32_t v : victims) {
+        BenchRequest* req = &reqs[v];
+        auto it = inflight.begin();
+        for (; it != inflight.end(); ++it) {
+            if (*it == req) break;
+        }
+        assert(it != inflight.end());
+        inflight.erase(it);
+        req->minFinishCycle = cycle++ + MIN_LATENCY;
+        inflight.push_back(req);
+        checksum += inflight.front()->minFinishCycle;
+    }
+    return GetTime() - start;
+}
+
+int main(int argc, const char* argv[]) {
+    InitLog("[I] ");
+    if (argc > 3) {
+        info("Usage: %s [ops per occupancy] [max occupancy]", argv[0]);
+        return 1;
+    }
+    uint64_t ops = (argc > 1)? strtoul(argv[1], NULL, 0) : 1000000;
+    uint32_t maxOccupancy = (argc > 2)? strtoul(argv[2], NULL, 0) : 4096;
+
+    uint64_t checksum = 0;  // keeps the loops from being optimized away
+    for (uint32_t occupancy = 1; occupancy <= maxOccupancy; occupancy *= 4) {
+        std::vector<uint32_t> victims;
+        MakeStream(occupancy, ops, victims);
+        // Vector ops grow linearly with occupancy; cap them so that large occupancies finish
+        std::vector<uint32_t> vecVictims(victims.begin(), victims.begin() + std::min(ops, 64*ops/occupancy));
+
+        double heapSecs = RunHeap(occupancy, victims, checksum);
+        double vecSecs = RunVector(occupancy, vecVictims, checksum);
+        info("%5d in flight:  heap %7.2f ns/op  vector %9.2f ns/op",
+                occupancy, 1e9*heapSecs/victims.size(), 1e9*vecSecs/vecVictims.size());
+    }
+    info("checksum %ld", checksum);
+    return 0;
+}
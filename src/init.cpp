@@ -33,6 +33,7 @@
 #include <vector>
 #include "cache.h"
 #include "cache_arrays.h"
+#include "checkpoint.h"
 #include "config.h"
 #include "constants.h"
 #include "contention_sim.h"
@@ -40,11 +41,14 @@
 #include "detailed_mem.h"
 #include "detailed_mem_params.h"
 #include "ddr_mem.h"
+#include "dram_cache_mem.h"
 #include "debug_zsim.h"
+#include "decode_cache.h"
 #include "dramsim_mem_ctrl.h"
 #include "nvmain_mem_ctrl.h"
 #include "event_queue.h"
 #include "filter_cache.h"
+#include "footprint_tracker.h"
 #include "galloc.h"
 #include "hash.h"
 #include "ideal_arrays.h"
@@ -53,6 +57,7 @@
 #include "mem_ctrls.h"
 #include "network.h"
 #include "null_core.h"
+#include "page_alloc.h"
 #include "ooo_core.h"
 #include "part_repl_policies.h"
 #include "pin_cmd.h"
@@ -68,6 +73,7 @@
 #include "timing_cache.h"
 #include "timing_core.h"
 #include "timing_event.h"
+#include "tlb.h"
 #include "virt/port_virtualizer.h"
 #include "weave_md1_mem.h" //validation, could be taken out...
 #include "zsim.h"
@@ -91,6 +97,7 @@ BaseCache* BuildCacheBank(Config& config, const string& prefix, g_string& name,
     uint32_t ways = config.get<uint32_t>(prefix + "array.ways", 4);
     string arrayType = config.get<const char*>(prefix + "array.type", "SetAssoc");
     uint32_t candidates = (arrayType == "Z")? config.get<uint32_t>(prefix + "array.candidates", 16) : ways;
+    uint32_t partialTagBits = config.get<uint32_t>(prefix + "array.partialTags", 0);  // 0 disables, 8-16 typical for large LLCs
 
     //Need to know number of hash functions before instantiating array
     if (arrayType == "SetAssoc") {
@@ -221,9 +228,9 @@ BaseCache* BuildCacheBank(Config& config, const string& prefix, g_string& name,
     //Alright, build the array
     CacheArray* array = NULL;
     if (arrayType == "SetAssoc") {
-        array = new SetAssocArray(numLines, ways, rp, hf);
+        array = new SetAssocArray(numLines, ways, rp, hf, partialTagBits);
     } else if (arrayType == "Z") {
-        array = new ZArray(numLines, ways, candidates, rp, hf);
+        array = new ZArray(numLines, ways, candidates, rp, hf, partialTagBits);
     } else if (arrayType == "IdealLRU") {
         assert(replType == "LRU");
         assert(!hf);
@@ -273,6 +280,8 @@ BaseCache* BuildCacheBank(Config& config, const string& prefix, g_string& name,
         //Filter cache optimization
         if (type != "Simple") panic("Terminal cache %s can only have type == Simple", name.c_str());
         if (arrayType != "SetAssoc" || hashType != "None" || replType != "LRU") panic("Invalid FilterCache config %s", name.c_str());
+        //Filter caches are virtually indexed; with the page allocator, they must be indexed by page offset bits only
+        if (zinfo->pageAllocator && numSets*lineSize > 4096) panic("%s: with sys.pageAllocator, terminal caches can have at most %d sets", name.c_str(), 4096/lineSize);
         cache = new FilterCache(numSets, numLines, cc, array, rp, accLat, invLat, name);
     }
 
@@ -292,12 +301,27 @@ string replace(string s, const string& a, const string& b) {
   return s;
 }
 
-MemObject* BuildMemoryController(Config& config, uint32_t lineSize, uint32_t frequency, uint32_t domain, g_string& name) {
+FootprintTracker* BuildFootprintTracker(Config& config, const string& prefix, uint32_t lineSize, uint32_t reuseBins) {
+    string type = config.get<const char*>(prefix + "footprintTracking", "Exact");
+    if (type == "None") {
+        return NULL;
+    } else if (type == "Exact") {
+        return new ExactFootprintTracker(lineSize, reuseBins);
+    } else if (type == "Approx") {
+        double relError = config.get<double>(prefix + "footprintError", 0.01);  // HLL relative std error
+        uint32_t sampleRate = config.get<uint32_t>(prefix + "footprintSampling", 64);  // track reuse for 1 in N lines
+        return new ApproxFootprintTracker(lineSize, reuseBins, relError, sampleRate);
+    } else {
+        panic("Invalid footprint tracking type %s", type.c_str());
+    }
+}
+
+MemObject* BuildMemoryController(Config& config, const string& prefix, uint32_t lineSize, uint32_t frequency, uint32_t domain, g_string& name) {
     //Type
-    string type = config.get<const char*>("sys.mem.type", "Simple");
+    string type = config.get<const char*>(prefix + "type", "Simple");
 
     //Latency
-    uint32_t latency = (type == "DDR")? -1 : config.get<uint32_t>("sys.mem.latency", 100);
+    uint32_t latency = (type == "DDR" || type == "DRAMCache")? -1 : config.get<uint32_t>(prefix + "latency", 100);
 
     MemObject* mem = NULL;
     if (type == "Simple") {
@@ -308,56 +332,126 @@ MemObject* BuildMemoryController(Config& config, uint32_t lineSize, uint32_t fre
         // a single CCT across the system, and we are dealing with latencies in *core* clock cycles
 
         // Peak bandwidth (in MB/s)
-        uint32_t bandwidth = config.get<uint32_t>("sys.mem.bandwidth", 6400);
+        uint32_t bandwidth = config.get<uint32_t>(prefix + "bandwidth", 6400);
 
         mem = new MD1Memory(lineSize, frequency, bandwidth, latency, name);
     } else if (type == "WeaveMD1") {
-        uint32_t bandwidth = config.get<uint32_t>("sys.mem.bandwidth", 6400);
-        uint32_t boundLatency = config.get<uint32_t>("sys.mem.boundLatency", latency);
+        uint32_t bandwidth = config.get<uint32_t>(prefix + "bandwidth", 6400);
+        uint32_t boundLatency = config.get<uint32_t>(prefix + "boundLatency", latency);
         mem = new WeaveMD1Memory(lineSize, frequency, bandwidth, latency, boundLatency, domain, name);
     } else if (type == "WeaveSimple") {
-        uint32_t boundLatency = config.get<uint32_t>("sys.mem.boundLatency", 100);
+        uint32_t boundLatency = config.get<uint32_t>(prefix + "boundLatency", 100);
         mem = new WeaveSimpleMemory(latency, boundLatency, domain, name);
     } else if (type == "DDR") {
-        uint32_t ranksPerChannel = config.get<uint32_t>("sys.mem.ranksPerChannel", 4);
-        uint32_t banksPerRank = config.get<uint32_t>("sys.mem.banksPerRank", 8);  // DDR3 std is 8
-        uint32_t pageSize = config.get<uint32_t>("sys.mem.pageSize", 8*1024);  // 1Kb cols, x4 devices
-        const char* tech = config.get<const char*>("sys.mem.tech", "DDR3-1333-CL10");  // see cpp file for other techs
-        const char* addrMapping = config.get<const char*>("sys.mem.addrMapping", "rank:col:bank");  // address splitter interleaves channels; row always on top
+        uint32_t ranksPerChannel = config.get<uint32_t>(prefix + "ranksPerChannel", 4);
+        const char* tech = config.get<const char*>(prefix + "tech", "DDR3-1333-CL10");  // see cpp file for other techs
+        string techFamily = string(tech).substr(0, 4);
+        uint32_t defBanks = (techFamily == "DDR5")? 32 : (techFamily == "DDR4")? 16 : 8;
+        uint32_t banksPerRank = config.get<uint32_t>(prefix + "banksPerRank", defBanks);  // DDR3 std is 8, DDR4 is 4 groups x 4, DDR5 is 8 groups x 4
+        uint32_t pageSize = config.get<uint32_t>(prefix + "pageSize", 8*1024);  // 1Kb cols, x4 devices
+        const char* addrMapping = config.get<const char*>(prefix + "addrMapping", "rank:col:bank");  // address splitter interleaves channels; row always on top
 
         // If set, writes are deferred and bursted out to reduce WTR overheads
-        bool deferWrites = config.get<bool>("sys.mem.deferWrites", true);
-        bool closedPage = config.get<bool>("sys.mem.closedPage", true);
+        bool deferWrites = config.get<bool>(prefix + "deferWrites", true);
+        bool closedPage = config.get<bool>(prefix + "closedPage", true);
+
+        // AllBank, or SameBank (same bank in all bank groups, DDR5 only) / PerBank, which spread refreshes over tREFI
+        const char* refresh = config.get<const char*>(prefix + "refresh", "AllBank");
 
         // Max row hits before we stop prioritizing further row hits to this bank.
         // Balances throughput and fairness; 0 -> FCFS / high (e.g., -1) -> pure FR-FCFS
-        uint32_t maxRowHits = config.get<uint32_t>("sys.mem.maxRowHits", 4);
+        uint32_t maxRowHits = config.get<uint32_t>(prefix + "maxRowHits", 4);
 
         // Request queues
-        uint32_t queueDepth = config.get<uint32_t>("sys.mem.queueDepth", 16);
-        uint32_t controllerLatency = config.get<uint32_t>("sys.mem.controllerLatency", 10);  // in system cycles
+        uint32_t queueDepth = config.get<uint32_t>(prefix + "queueDepth", 16);
+        uint32_t controllerLatency = config.get<uint32_t>(prefix + "controllerLatency", 10);  // in system cycles
+
+        // Scheduler: FR-FCFS (capped by maxRowHits), or an application-aware policy that ranks sources (cores)
+        // Intervals are in memory cycles; defaults follow each paper
+        string scheduler = config.get<const char*>(prefix + "scheduler", "FR-FCFS");
+        uint32_t numBanks = ranksPerChannel*banksPerRank;
+        DDRSchedPolicy* schedPolicy = NULL;
+        if (scheduler == "FR-FCFS") {
+            // no policy
+        } else if (scheduler == "ATLAS") {
+            uint64_t quantum = config.get<uint64_t>(prefix + "sched.quantum", 10000000);
+            double alpha = config.get<double>(prefix + "sched.historyWeight", 0.875);
+            uint64_t ageThreshold = config.get<uint64_t>(prefix + "sched.ageThreshold", 100000);
+            schedPolicy = new ATLASSchedPolicy(zinfo->numCores, numBanks, quantum, alpha, ageThreshold);
+        } else if (scheduler == "TCM") {
+            uint64_t quantum = config.get<uint64_t>(prefix + "sched.quantum", 1000000);
+            double clusterThresh = config.get<double>(prefix + "sched.clusterThresh", 0.15);  // fraction of bandwidth
+            uint64_t shuffleInterval = config.get<uint64_t>(prefix + "sched.shuffleInterval", 800);
+            schedPolicy = new TCMSchedPolicy(zinfo->numCores, numBanks, quantum, clusterThresh, shuffleInterval);
+        } else if (scheduler == "BLISS") {
+            uint32_t blacklistThreshold = config.get<uint32_t>(prefix + "sched.blacklistThreshold", 4);
+            uint64_t clearInterval = config.get<uint64_t>(prefix + "sched.clearInterval", 10000);
+            schedPolicy = new BLISSSchedPolicy(zinfo->numCores, numBanks, blacklistThreshold, clearInterval);
+        } else if (scheduler == "PAR-BS") {
+            uint32_t markingCap = config.get<uint32_t>(prefix + "sched.markingCap", 5);
+            schedPolicy = new PARBSSchedPolicy(zinfo->numCores, numBanks, markingCap);
+        } else {
+            panic("Invalid scheduler %s on %s (FR-FCFS, ATLAS, TCM, BLISS, PAR-BS)", scheduler.c_str(), name.c_str());
+        }
 
         mem = new DDRMemory(zinfo->lineSize, pageSize, ranksPerChannel, banksPerRank, frequency, tech,
-                addrMapping, controllerLatency, queueDepth, maxRowHits, deferWrites, closedPage, domain, name);
+                addrMapping, controllerLatency, queueDepth, maxRowHits, deferWrites, closedPage, refresh, schedPolicy, domain, name);
     } else if (type == "DRAMSim") {
         uint64_t cpuFreqHz = 1000000 * frequency;
-        uint32_t capacity = config.get<uint32_t>("sys.mem.capacityMB", 16384);
-        string dramTechIni = config.get<const char*>("sys.mem.techIni");
-        string dramSystemIni = config.get<const char*>("sys.mem.systemIni");
-        string outputDir = config.get<const char*>("sys.mem.outputDir");
-        string traceName = config.get<const char*>("sys.mem.traceName");
-        mem = new DRAMSimMemory(dramTechIni, dramSystemIni, outputDir, traceName, capacity, cpuFreqHz, latency, domain, name);
+        uint32_t capacity = config.get<uint32_t>(prefix + "capacityMB", 16384);
+        string dramTechIni = config.get<const char*>(prefix + "techIni");
+        string dramSystemIni = config.get<const char*>(prefix + "systemIni");
+        string outputDir = config.get<const char*>(prefix + "outputDir");
+        string traceName = config.get<const char*>(prefix + "traceName");
+        // By default DRAMSim's clock stops while it has no requests, which loses idle refreshes (see dramsim_mem_ctrl.h); set to match per-cycle ticking
+        bool simulateIdle = config.get<bool>(prefix + "simulateIdle", false);
+        mem = new DRAMSimMemory(dramTechIni, dramSystemIni, outputDir, traceName, capacity, cpuFreqHz, latency, simulateIdle, domain, name);
     } else if (type == "NVMain") {
-        uint32_t capacity = config.get<uint32_t>("sys.mem.capacityMB", 16384);
-        string nvmainTechIni = config.get<const char*>("sys.mem.techIni");
-        string envVar = config.get<const char*>("sys.mem.envVar");
+        uint32_t capacity = config.get<uint32_t>(prefix + "capacityMB", 16384);
+        string nvmainTechIni = config.get<const char*>(prefix + "techIni");
+        string envVar = config.get<const char*>(prefix + "envVar");
         nvmainTechIni = replace(nvmainTechIni, envVar, getenv(envVar.c_str())? getenv(envVar.c_str()): "");
-        string outputFile = config.get<const char*>("sys.mem.outputFile");
-        string traceName = config.get<const char*>("sys.mem.traceName");
-        mem = new NVMainMemory(nvmainTechIni, outputFile, traceName, capacity, latency, domain, name);
+        string outputFile = config.get<const char*>(prefix + "outputFile");
+        string traceName = config.get<const char*>(prefix + "traceName");
+        FootprintTracker* footprint = BuildFootprintTracker(config, prefix, lineSize, 100);
+        mem = new NVMainMemory(nvmainTechIni, outputFile, traceName, capacity, latency, domain, name, footprint);
+        zinfo->hasNVMain = true;
+        zinfo->nvmainControllers.push_back(mem);
+    } else if (type == "DRAMCache") {
+        // The cache's DRAM and the backing memory are full memory controllers, configured under cache.* and main.*
+        g_string cacheName = name + "-cache";
+        g_string mainName = name + "-main";
+        MemObject* cacheMem = BuildMemoryController(config, prefix + "cache.", lineSize, frequency, domain, cacheName);
+        MemObject* mainMem = BuildMemoryController(config, prefix + "main.", lineSize, frequency, domain, mainName);
+
+        string orgStr = config.get<const char*>(prefix + "org", "Alloy");
+        DRAMCacheMemory::Organization org;
+        if (orgStr == "Alloy") org = DRAMCacheMemory::ALLOY;
+        else if (orgStr == "LohHill") org = DRAMCacheMemory::LOHHILL;
+        else if (orgStr == "Footprint") org = DRAMCacheMemory::FOOTPRINT;
+        else panic("Invalid DRAM cache organization %s", orgStr.c_str());
+
+        string predStr = config.get<const char*>(prefix + "predictor", "None");
+        DRAMCacheMemory::Predictor pred;
+        if (predStr == "None") pred = DRAMCacheMemory::PRED_NONE;
+        else if (predStr == "MissMap") pred = DRAMCacheMemory::PRED_MISSMAP;
+        else if (predStr == "MAPI") pred = DRAMCacheMemory::PRED_MAPI;
+        else panic("Invalid DRAM cache predictor %s", predStr.c_str());
+
+        bool isAlloy = (org == DRAMCacheMemory::ALLOY);
+        uint32_t sizeMB = config.get<uint32_t>(prefix + "sizeMB", 256);
+        uint32_t ways = config.get<uint32_t>(prefix + "ways", isAlloy? 1 : 29);
+        uint32_t blockSize = config.get<uint32_t>(prefix + "blockSize", (org == DRAMCacheMemory::FOOTPRINT)? 2048 : lineSize);
+        uint32_t rowSize = config.get<uint32_t>(prefix + "rowSize", 2048);  // LohHill: one set per row
+        bool tagsInDRAM = config.get<bool>(prefix + "tagsInDRAM", true);
+        uint32_t tagLatency = config.get<uint32_t>(prefix + "tagLatency", 10);  // SRAM tags or MissMap, in sys cycles
+        uint32_t historyEntries = config.get<uint32_t>(prefix + "footprintHistory", 16384);
+
+        mem = new DRAMCacheMemory(cacheMem, mainMem, sizeMB, lineSize, org, ways, blockSize, rowSize,
+                tagsInDRAM, tagLatency, pred, historyEntries, name);
     } else if (type == "Detailed") {
         // FIXME(dsm): Don't use a separate config file... see DDRMemory
-        g_string mcfg = config.get<const char*>("sys.mem.paramFile", "");
+        g_string mcfg = config.get<const char*>(prefix + "paramFile", "");
         mem = new MemControllerBase(mcfg, lineSize, frequency, domain, name);
     } else {
         panic("Invalid memory controller type %s", type.c_str());
@@ -415,6 +509,60 @@ CacheGroup* BuildCacheGroup(Config& config, const string& name, bool isTerminal)
     return cgp;
 }
 
+// OOO core types, one per OOOCoreT instantiation (see ooo_core.h). "OOO" is the original configuration.
+static bool IsOOOCoreType(const string& type) {
+    return type == "OOO" || type == "OOONehalem" || type == "OOOSandyBridge" || type == "OOOSkylake" || type == "OOOWide";
+}
+
+template <typename P>
+static OOOCore* NewOOOCore(FilterCache* ic, FilterCache* dc, g_string& name, uint32_t id) {
+    OOOCoreT<P>* core = gm_memalign<OOOCoreT<P>>(CACHE_LINE_BYTES, 1);
+    return new (core) OOOCoreT<P>(ic, dc, name, id);
+}
+
+// The branch predictor is part of the parameter set too; "PAg" is each type's own
+template <typename P>
+static OOOCore* NewOOOCore(const string& bp, FilterCache* ic, FilterCache* dc, g_string& name, uint32_t id) {
+    if (bp == "PAg") return NewOOOCore<P>(ic, dc, name, id);
+    else if (bp == "TAGE") return NewOOOCore<OOOTAGEParams<P>>(ic, dc, name, id);
+    else if (bp == "TAGE-SC-L") return NewOOOCore<OOOTAGESCLParams<P>>(ic, dc, name, id);
+    panic("Invalid branch predictor %s", bp.c_str());
+}
+
+static OOOCore* BuildOOOCore(const string& type, const string& bp, FilterCache* ic, FilterCache* dc, g_string& name, uint32_t id) {
+    if (type == "OOO") return NewOOOCore<OOODefaultParams>(bp, ic, dc, name, id);
+    else if (type == "OOONehalem") return NewOOOCore<OOONehalemParams>(bp, ic, dc, name, id);
+    else if (type == "OOOSandyBridge") return NewOOOCore<OOOSandyBridgeParams>(bp, ic, dc, name, id);
+    else if (type == "OOOSkylake") return NewOOOCore<OOOSkylakeParams>(bp, ic, dc, name, id);
+    else if (type == "OOOWide") return NewOOOCore<OOOWideParams>(bp, ic, dc, name, id);
+    panic("Invalid OOO core type %s", type.c_str());
+}
+
+// Entries of 0 disable an optional TLB or page-walk cache; ways == entries makes it fully associative
+static TranslationArray* BuildTranslationArray(Config& config, const string& prefix, uint32_t defEntries, uint32_t defWays) {
+    uint32_t entries = config.get<uint32_t>(prefix + "Entries", defEntries);
+    if (!entries) return NULL;
+    uint32_t ways = config.get<uint32_t>(prefix + "Ways", MIN(defWays, entries));
+    return new TranslationArray(entries, ways);
+}
+
+// Defaults follow Skylake's data-side TLBs and page-walk caches
+static MMU* BuildMMU(Config& config, const string& prefix, g_string& name) {
+    TranslationArray* l1Tlbs[MMU::PAGE_SIZES];
+    l1Tlbs[0] = BuildTranslationArray(config, prefix + "l1", 64, 4);
+    l1Tlbs[1] = BuildTranslationArray(config, prefix + "l1Huge", 32, 4);
+    l1Tlbs[2] = BuildTranslationArray(config, prefix + "l1Giant", 4, 4);
+    TranslationArray* l2Tlb = BuildTranslationArray(config, prefix + "l2", 1536, 12);
+    TranslationArray* l2HugeTlb = BuildTranslationArray(config, prefix + "l2Giant", 16, 4);
+    uint32_t l2Lat = config.get<uint32_t>(prefix + "l2Latency", 7);
+
+    TranslationArray* pwcs[MMU::PT_LEVELS - 1];
+    pwcs[0] = BuildTranslationArray(config, prefix + "pml4", 2, 2);
+    pwcs[1] = BuildTranslationArray(config, prefix + "pdpt", 4, 4);
+    pwcs[2] = BuildTranslationArray(config, prefix + "pd", 32, 32);
+    return new MMU(name, l1Tlbs, l2Tlb, l2HugeTlb, pwcs, l2Lat);
+}
+
 static void InitSystem(Config& config) {
     unordered_map<string, string> parentMap; //child -> parent
     unordered_map<string, vector<string>> childMap; //parent -> children (a parent may have multiple children, they are ordered by appearance in the file)
@@ -478,7 +626,6 @@ static void InitSystem(Config& config) {
     g_vector<MemObject*> mems;
     mems.resize(memControllers);
     zinfo->numMemoryControllers = memControllers;
-    zinfo->hasNVMain = (config.get<const char*>("sys.mem.type", "Simple") == string("NVMain")) ? true : false;
     zinfo->hasDRAMCache = config.get<bool>("sys.mem.hasDRAMCache", false);
 
     for (uint32_t i = 0; i < memControllers; i++) {
@@ -487,7 +634,7 @@ static void InitSystem(Config& config) {
         g_string name(ss.str().c_str());
         //uint32_t domain = nextDomain(); //i*zinfo->numDomains/memControllers;
         uint32_t domain = i*zinfo->numDomains/memControllers;
-        mems[i] = BuildMemoryController(config, zinfo->lineSize, zinfo->freqMHz, domain, name);
+        mems[i] = BuildMemoryController(config, "sys.mem.", zinfo->lineSize, zinfo->freqMHz, domain, name);
     }
 
     zinfo->memoryControllers = mems;
@@ -495,7 +642,14 @@ static void InitSystem(Config& config) {
     if (memControllers > 1) {
         bool splitAddrs = config.get<bool>("sys.mem.splitAddrs", true);
         if (splitAddrs) {
-            MemObject* splitter = new SplitAddrMemory(mems, "mem-splitter");
+            //Channel interleaving (see InterleavedMemory); the defaults interleave lines round-robin
+            uint32_t granularity = config.get<uint32_t>("sys.mem.interleave.granularity", zinfo->lineSize);  // bytes, e.g., 256 or 4096
+            string hash = config.get<const char*>("sys.mem.interleave.hash", "None");
+            if (hash != "None" && hash != "XOR") panic("Invalid sys.mem.interleave.hash %s (None or XOR)", hash.c_str());
+            uint32_t bankXorBits = config.get<uint32_t>("sys.mem.interleave.bankXorBits", 0);  // low bits of local line addresses to permute
+            uint32_t bankXorShift = config.get<uint32_t>("sys.mem.interleave.bankXorShift", 16);  // position of the (row) bits XORed into them
+            if (granularity % zinfo->lineSize) panic("sys.mem.interleave.granularity must be a multiple of the line size");
+            MemObject* splitter = new InterleavedMemory(mems, granularity/zinfo->lineSize, hash == "XOR", bankXorBits, bankXorShift, "mem-splitter");
             mems.resize(1);
             mems[0] = splitter;
         }
@@ -587,20 +741,20 @@ static void InitSystem(Config& config) {
         string prefix = string("sys.cores.") + group + ".";
         uint32_t cores = config.get<uint32_t>(prefix + "cores", 1);
         string type = config.get<const char*>(prefix + "type", "Simple");
+        string branchPredictor = IsOOOCoreType(type)? config.get<const char*>(prefix + "branchPredictor", "PAg") : "";
 
         //Build the core group
         union {
             SimpleCore* simpleCores;
             TimingCore* timingCores;
-            OOOCore* oooCores;
             NullCore* nullCores;
         };
         if (type == "Simple") {
             simpleCores = gm_memalign<SimpleCore>(CACHE_LINE_BYTES, cores);
         } else if (type == "Timing") {
             timingCores = gm_memalign<TimingCore>(CACHE_LINE_BYTES, cores);
-        } else if (type == "OOO") {
-            oooCores = gm_memalign<OOOCore>(CACHE_LINE_BYTES, cores);
+        } else if (IsOOOCoreType(type)) {
+            //OOO cores are allocated one by one in BuildOOOCore, since their class depends on the type and predictor
             zinfo->oooDecode = true; //enable uop decoding, this is false by default, must be true if even one OOO cpu is in the system
         } else if (type == "Null") {
             nullCores = gm_memalign<NullCore>(CACHE_LINE_BYTES, cores);
@@ -652,12 +806,12 @@ static void InitSystem(Config& config) {
                     zinfo->eventRecorders[coreIdx]->setSourceId(coreIdx);
                     core = tcore;
                 } else {
-                    assert(type == "OOO");
-                    OOOCore* ocore = new (&oooCores[j]) OOOCore(ic, dc, name, j);
+                    OOOCore* ocore = BuildOOOCore(type, branchPredictor, ic, dc, name, j);
                     zinfo->eventRecorders[coreIdx] = ocore->getEventRecorder();
                     zinfo->eventRecorders[coreIdx]->setSourceId(coreIdx);
                     core = ocore;
                 }
+                if (config.get<bool>(prefix + "tlb.enabled", false)) core->setMMU(BuildMMU(config, prefix + "tlb.", name));
                 coreMap[group].push_back(core);
                 coreIdx++;
             }
@@ -698,7 +852,12 @@ static void InitSystem(Config& config) {
     for (const char* group : cacheGroupNames) {
         AggregateStat* groupStat = new AggregateStat(true);
         groupStat->init(gm_strdup(group), "Cache stats");
-        for (vector<BaseCache*>& banks : *cMap[group]) for (BaseCache* bank : banks) bank->initStats(groupStat);
+        for (vector<BaseCache*>& banks : *cMap[group]) {
+            for (BaseCache* bank : banks) {
+                bank->initStats(groupStat);
+                zinfo->caches.push_back(bank);
+            }
+        }
         zinfo->rootStat->append(groupStat);
     }
 
@@ -858,6 +1017,16 @@ void SimInit(const char* configFile, const char* outputDir, uint32_t shmid) {
     zinfo->ignoreHooks = config.get<bool>("sim.ignoreHooks", false);
     zinfo->ffReinstrument = config.get<bool>("sim.ffReinstrument", false);
     if (zinfo->ffReinstrument) warn("sim.ffReinstrument = true, switching fast-forwarding on a multi-threaded process may be unstable");
+    zinfo->ffWarming = config.get<bool>("sim.ffWarming", false);
+    if (zinfo->ffWarming && zinfo->ffReinstrument) panic("sim.ffWarming needs fast-forwarded code to be instrumented, so it is incompatible with sim.ffReinstrument");
+
+    //Checkpoints
+    zinfo->checkpointPhase = config.get<uint64_t>("sim.checkpointPhase", 0);
+    string defaultCheckpointFile = string(zinfo->outputDir) + "/zsim.ckpt";
+    zinfo->checkpointFile = gm_strdup(config.get<const char*>("sim.checkpointFile", defaultCheckpointFile.c_str()));
+    zinfo->checkpointPending = false;
+    //Warming threads keep running while the checkpoint is saved at the phase barrier, so it could be torn
+    if (zinfo->checkpointPhase && zinfo->ffWarming) panic("sim.checkpointPhase is incompatible with sim.ffWarming");
 
     zinfo->registerThreads = config.get<bool>("sim.registerThreads", false);
     zinfo->globalPauseFlag = config.get<bool>("sim.startInGlobalPause", false);
@@ -892,6 +1061,16 @@ void SimInit(const char* configFile, const char* outputDir, uint32_t shmid) {
     //Address randomization
     zinfo->addressRandomization = config.get<bool>("sys.addressRandomization", false);
 
+    //Physical page allocator, supersedes address randomization
+    if (config.get<bool>("sys.pageAllocator.enabled", false)) {
+        if (zinfo->addressRandomization) panic("sys.addressRandomization and sys.pageAllocator are mutually exclusive");
+        uint32_t numaNodes = config.get<uint32_t>("sys.numa.nodes", 1);
+        uint64_t nodeMB = config.get<uint64_t>("sys.numa.nodeMB", 16384);
+        bool randomFrames = config.get<bool>("sys.pageAllocator.randomFrames", true);
+        zinfo->pageAllocator = new PageAllocator(numaNodes, nodeMB, randomFrames);
+        zinfo->pageAllocator->initStats(zinfo->rootStat);
+    }
+
     //Port virtualization
     for (uint32_t i = 0; i < MAX_PORT_DOMAINS; i++) zinfo->portVirt[i] = new PortVirtualizer();
 
@@ -900,11 +1079,57 @@ void SimInit(const char* configFile, const char* outputDir, uint32_t shmid) {
     CreateProcessTree(config);
     zinfo->procArray[0]->notifyStart(); //called here so that we can detect end-before-start races
 
+    //Warming threads update their core's caches, predictors, and TLBs without synchronizing with threads simulated on
+    //that core. A process only fast-forwards as a whole, so this is safe as long as no other process can run there.
+    if (zinfo->ffWarming) {
+        for (uint32_t p = 0; p < zinfo->numProcs; p++) {
+            const g_vector<bool>& pMask = zinfo->procArray[p]->getMask();
+            for (uint32_t q = p + 1; q < zinfo->numProcs; q++) {
+                const g_vector<bool>& qMask = zinfo->procArray[q]->getMask();
+                for (uint32_t c = 0; c < zinfo->numCores; c++) {
+                    if (pMask[c] && qMask[c]) panic("sim.ffWarming needs processes to run on disjoint cores, but processes %d and %d can both run on core %d (set processN.mask)", p, q, c);
+                }
+            }
+        }
+    }
+
     zinfo->pinCmd = new PinCmd(&config, NULL /*don't pass config file to children --- can go either way, it's optional*/, outputDir, shmid);
 
     //Caches, cores, memory controllers
     InitSystem(config);
 
+    //Start from checkpointed state instead of cold structures
+    string restoreFile = config.get<const char*>("sim.restoreCheckpoint", "");
+    if (!restoreFile.empty()) RestoreCheckpoint(restoreFile.c_str());
+
+    //Decode cache (after InitSystem, which determines whether we do OOO decoding at all)
+    if (config.get<bool>("sim.decodeCache", false)) {
+        string defaultFile = string(zinfo->outputDir) + "/decode.cache";
+        string decodeCacheFile = config.get<const char*>("sim.decodeCacheFile", defaultFile.c_str());
+#ifdef BBL_PROFILING
+        warn("sim.decodeCache is incompatible with BBL_PROFILING, disabling");
+#else
+        if (zinfo->oooDecode) {
+            zinfo->decodeCache = new DecodeCache(decodeCacheFile.c_str());
+            zinfo->decodeCache->initStats(zinfo->rootStat);
+        } else {
+            info("sim.decodeCache has no effect, no cores use OOO decoding");
+        }
+#endif
+    }
+
+    //Shared decode table, only useful with multiple processes (unless they are created on the fly)
+    if (config.get<bool>("sim.sharedDecodeTable", zinfo->numProcs > 1)) {
+        uint32_t slots = config.get<uint32_t>("sim.sharedDecodeTableSlots", 1 << 20);
+#ifdef BBL_PROFILING
+        (void)slots;
+        warn("sim.sharedDecodeTable is incompatible with BBL_PROFILING, disabling");
+#else
+        zinfo->decodeTable = new SharedDecodeTable(slots);
+        zinfo->decodeTable->initStats(zinfo->rootStat);
+#endif
+    }
+
     //Sched stats (deferred because of circular deps)
     zinfo->sched->initStats(zinfo->rootStat);
 
@@ -26,6 +26,8 @@
 //#include "timing_event.h"
 //#include "event_recorder.h"
 #include "mem_ctrls.h"
+#include "bithacks.h"
+#include "page_alloc.h"
 #include "zsim.h"
 
 uint64_t SimpleMemory::access(MemReq& req) {
@@ -145,3 +147,24 @@ uint64_t MD1Memory::access(MemReq& req) {
     return req.cycle + ((req.type == PUTS)? 0 /*PUTS is not a real access*/ : curLatency);
 }
 
+
+InterleavedMemory::InterleavedMemory(const g_vector<MemObject*>& _mems, uint32_t granuleLines, bool _xorHash,
+        uint32_t _bankXorBits, uint32_t _bankXorShift, const char* _name)
+    : mems(_mems), name(_name), xorHash(_xorHash), bankXorBits(_bankXorBits), bankXorShift(_bankXorShift)
+{
+    if (!isPow2(granuleLines)) panic("%s: interleaving granularity must be a power-of-2 number of lines, %d given", name.c_str(), granuleLines);
+    granuleBits = ilog2(granuleLines);
+
+    numaNodes = (zinfo->pageAllocator)? zinfo->pageAllocator->getNumNodes() : 1;
+    nodeLineBits = (numaNodes > 1)? zinfo->pageAllocator->getNodeLineBits() : 0;
+    if (mems.size() % numaNodes) panic("%s: %ld memory controllers can't be split evenly across %d NUMA nodes", name.c_str(), mems.size(), numaNodes);
+    channels = mems.size()/numaNodes;
+    channelBits = (channels > 1)? ilog2(channels - 1) + 1 : 0;
+    if (channels == 1) xorHash = false;  // one channel per node, nothing to rotate (and no bits to fold)
+
+    // XORing bits below bankXorShift with bits above it keeps local addresses unique
+    if (bankXorBits > bankXorShift) panic("%s: bankXorBits (%d) must not exceed bankXorShift (%d)", name.c_str(), bankXorBits, bankXorShift);
+
+    info("%s: %ld channels, %d-line granules, %s hashing%s", name.c_str(), mems.size(), granuleLines, xorHash? "XOR" : "no",
+            (numaNodes > 1)? ", split across NUMA nodes" : "");
+}
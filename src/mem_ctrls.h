@@ -27,6 +27,7 @@
 #define MEM_CTRLS_H_
 
 #include "g_std/g_string.h"
+#include "g_std/g_vector.h"
 #include "memory_hierarchy.h"
 #include "pad.h"
 #include "stats.h"
@@ -97,4 +98,78 @@ class MD1Memory : public MemObject {
         void updateLatency();
 };
 
+
+/* Interleaves lines across several memory controllers (channels).
+ *
+ * Addresses are interleaved at a configurable granularity (a line, 256B, a
+ * page...). Each group of consecutive granules, one per channel, is spread
+ * across all channels; with XOR hashing, the channel order within a group is
+ * rotated by a fold of the group's index, which breaks up the hotspots that
+ * power-of-2 strides cause. The number of channels need not be a power of 2
+ * (DRAMSim, for one, only supports power-of-2 channels itself, so it is
+ * instantiated once per channel behind this).
+ * Controllers see dense local addresses (their granules, back to back), and
+ * optionally, the bits that backends map to banks and ranks can be XORed with
+ * higher (row) bits, as in permutation-based page interleaving.
+ *
+ * With the page allocator and several NUMA nodes, channels are split evenly
+ * across nodes, and each line goes to a channel of its node.
+ */
+class InterleavedMemory : public MemObject {
+    private:
+        const g_vector<MemObject*> mems;
+        const g_string name;
+        uint32_t granuleBits;  // log2 of lines per granule
+        uint32_t channels;  // per NUMA node
+        uint32_t channelBits;  // ceil(log2(channels)), the width of folds
+        bool xorHash;
+        uint32_t numaNodes;
+        uint32_t nodeLineBits;  // log2 of lines per NUMA node, if numaNodes > 1
+        uint32_t bankXorBits, bankXorShift;
+
+    public:
+        InterleavedMemory(const g_vector<MemObject*>& _mems, uint32_t granuleLines, bool _xorHash,
+                uint32_t _bankXorBits, uint32_t _bankXorShift, const char* _name);
+
+        uint64_t access(MemReq& req) {
+            Address lineAddr = req.lineAddr;
+            uint32_t mem;
+            req.lineAddr = map(lineAddr, mem);
+            uint64_t respCycle = mems[mem]->access(req);
+            req.lineAddr = lineAddr;
+            return respCycle;
+        }
+
+        const char* getName() {return name.c_str();}
+
+        void initStats(AggregateStat* parentStat) {
+            for (auto mem : mems) mem->initStats(parentStat);
+        }
+
+    private:
+        // Returns the controller-local line address, and the controller in mem
+        inline Address map(Address lineAddr, uint32_t& mem) const {
+            uint32_t node = 0;
+            if (numaNodes > 1) {
+                node = lineAddr >> nodeLineBits;
+                lineAddr &= (1ul << nodeLineBits) - 1;
+            }
+            Address granule = lineAddr >> granuleBits;
+            Address group = granule / channels;
+            uint32_t channel = granule % channels;
+            if (xorHash) {
+                uint32_t fold = 0;
+                for (Address g = group; g; g >>= channelBits) fold ^= g;
+                fold &= (1 << channelBits) - 1;
+                // Both are permutations of the channels in the group, so local addresses stay unique
+                channel = (channels & (channels - 1))? (channel + fold) % channels : channel ^ fold;
+            }
+            mem = node*channels + channel;
+
+            Address localAddr = (group << granuleBits) | (lineAddr & ((1ul << granuleBits) - 1));
+            if (bankXorBits) localAddr ^= (localAddr >> bankXorShift) & ((1ul << bankXorBits) - 1);
+            return localAddr;
+        }
+};
+
 #endif  // MEM_CTRLS_H_
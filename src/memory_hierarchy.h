@@ -93,6 +93,7 @@ struct MemReq {
         NONINCLWB     = (1<<3), //This is a non-inclusive writeback. Do not assume that the line was in the lower level. Used on NUCA (BankDir).
         PUTX_KEEPEXCL = (1<<4), //Non-relinquishing PUTX. On a PUTX, maintain the requestor's E state instead of removing the sharer (i.e., this is a pure writeback)
         PREFETCH      = (1<<5), //Prefetch GETS access. Only set at level where prefetch is issued; handled early in MESICC
+        WARM          = (1<<6), //Functional warming access (from fast-forwarded code). Updates tag, replacement, and coherence state, but is not profiled and never reaches memory controllers; latencies are meaningless. Unlike other flags, propagates to the evictions it causes
     };
     uint32_t flags;
 
@@ -103,6 +104,7 @@ struct MemReq {
 /** INTERFACES **/
 
 class AggregateStat;
+class Checkpoint;
 class Network;
 
 /* Base class for all memory objects (caches and memories) */
@@ -112,6 +114,8 @@ class MemObject : public GlobAlloc {
         virtual uint64_t access(MemReq& req) = 0;
         virtual void initStats(AggregateStat* parentStat) {}
         virtual const char* getName() = 0;
+        //Saves or restores long-lived state, such as tags (see checkpoint.h); timing state is not checkpointed
+        virtual void checkpointState(Checkpoint& ckpt) {}
 };
 
 /* Base class for all cache objects */
@@ -119,7 +123,8 @@ class BaseCache : public MemObject {
     public:
         virtual void setParents(uint32_t _childId, const g_vector<MemObject*>& parents, Network* network) = 0;
         virtual void setChildren(const g_vector<BaseCache*>& children, Network* network) = 0;
-        virtual uint64_t invalidate(Address lineAddr, InvType type, bool* reqWriteback, uint64_t reqCycle, uint32_t srcId) = 0;
+        //flags are those of the request that triggered the invalidation; only MemReq::WARM propagates
+        virtual uint64_t invalidate(Address lineAddr, InvType type, bool* reqWriteback, uint64_t reqCycle, uint32_t srcId, uint32_t flags) = 0;
 };
 
 #endif  // MEMORY_HIERARCHY_H_
@@ -24,6 +24,7 @@
  */
 
 
+#include <limits>
 #include <map>
 #include <string>
 #include <math.h>
@@ -127,7 +128,7 @@ class SchedEventNVMain : public TimingEvent, public GlobAlloc {
 };
 
 
-NVMainMemory::NVMainMemory(std::string& nvmainTechIni, std::string& outputFile, std::string& traceName, uint32_t capacityMB, uint64_t _minLatency, uint32_t _domain, const g_string& _name) {
+NVMainMemory::NVMainMemory(std::string& nvmainTechIni, std::string& outputFile, std::string& traceName, uint32_t capacityMB, uint64_t _minLatency, uint32_t _domain, const g_string& _name, FootprintTracker* _footprint) {
 
     nvmainConfig = new NVM::Config();
     nvmainConfig->Read(nvmainTechIni);
@@ -178,6 +179,7 @@ NVMainMemory::NVMainMemory(std::string& nvmainTechIni, std::string& outputFile,
     info("NVMain: with %f cpuFreq, %f busFreq", cpuFreq, busFreq);
     minLatency = _minLatency;
     domain = _domain;
+    footprint = _footprint;
 
     // No longer necessary, now we do not tick every cycle, we use SchedEvent
     //TickEvent<NVMainMemory>* tickEv = new TickEvent<NVMainMemory>(this, domain);
@@ -192,6 +194,20 @@ NVMainMemory::NVMainMemory(std::string& nvmainTechIni, std::string& outputFile,
         ignoreData = false;
     }
 
+    // All requests start as a copy of this one. No data in memory for now,
+    // so the data block is zeroed once here.
+    if (!ignoreData) {
+        int transfer_size = zinfo->lineSize;
+        requestTemplate.data.SetSize(transfer_size);
+        for(int i = 0; i < transfer_size; i++) {
+            requestTemplate.data.SetByte(i, 0);
+        }
+    }
+    requestTemplate.access = NVM::UNKNOWN_ACCESS;
+    requestTemplate.status = NVM::MEM_REQUEST_INCOMPLETE;
+    requestTemplate.owner = (NVMObject *)this;
+    requestFreelist = NULL;
+
     // NVMain stats output file
     std::string path = zinfo->outputDir;
     path += "/";
@@ -201,8 +217,8 @@ NVMainMemory::NVMainMemory(std::string& nvmainTechIni, std::string& outputFile,
     out << "===" << std::endl;
 
     // Wave phase handling
-    nextSchedRequest = NULL;
     nextSchedEvent = NULL;
+    nextSchedCycle = -1ul;
     eventFreelist = NULL;
 }
 
@@ -216,10 +232,8 @@ void NVMainMemory::initStats(AggregateStat* parentStat) {
     profPUTX.init("PUTX", "Dirty Evictions (from lower level)"); memStats->append(&profPUTX);
     profTotalRdLat.init("rdlat", "Total latency experienced by read requests"); memStats->append(&profTotalRdLat);
     profTotalWrLat.init("wrlat", "Total latency experienced by write requests"); memStats->append(&profTotalWrLat);
-    profMemoryFootprint.init("footprint", "Total memory footprint in bytes"); memStats->append(&profMemoryFootprint);
-    profMemoryAddresses.init("addresses", "Total number of distinct memory addresses"); memStats->append(&profMemoryAddresses);
+    if (footprint) footprint->initStats(memStats);
     latencyHist.init("mlh", "latency histogram for memory requests", NUMBINS); memStats->append(&latencyHist);
-    addressReuseHist.init("addressReuse", "address reuse histogram for memory requests", NUMBINS); memStats->append(&addressReuseHist);
     parentStat->append(memStats);
 }
 
@@ -274,35 +288,43 @@ uint64_t NVMainMemory::access(MemReq& req) {
 
 uint64_t NVMainMemory::tick(uint64_t cycle) {
 
-    // Advance NVMain to current cycle
+    // Advance NVMain to current cycle. We may have skipped idle cycles, so
+    // set curCycle first: completions in this step finish at cycle+1.
     //info("[%s] [Tick] Update NVMain %lu cycles", getName(), (cycle+1) - updateCycle);
+    curCycle = cycle;
     nvmainGlobalEventQueue->Cycle((cycle+1) - updateCycle);
     updateCycle = cycle + 1;
     curCycle = updateCycle;
 
-    // Check if nextSchedEvent has been serviced by RequestComplete
-    // TODO: Maybe I need to save the Address in a nextSchedAddress varaible to know this
-    // If the event has not been serviced do 'return 1', which reschedules for next cycle.
-    // Else check multiset/multimap for next event if any.
     assert(nextSchedEvent);
-    if (nextSchedRequest) { // Not serviced yet, cycle by cycle until it's served
-        return cycle + 1;
-    } else { // has been serviced, check for inflight requests
-        if (inflightRequests.empty()) {
-            nextSchedEvent = NULL;
-            nextSchedRequest = NULL;
-            return 0; //this will recycle the SchedEvent
-        } else {
-            nextSchedRequest = inflightRequests.front().first;
-            if (cycle >= inflightRequests.front().second.second) {
-                return cycle + 1; // we are past min finish cycle for next request
-            } else {
-                return inflightRequests.front().second.second; //get min finish cycle for next request
-            }
-        }
+    if (inflightHeap.empty()) {
+        nextSchedEvent = NULL;
+        nextSchedCycle = -1ul;
+        return 0; //this will recycle the SchedEvent
+    } else {
+        nextSchedCycle = nextWakeCycle(cycle);
+        return nextSchedCycle;
     }
 }
 
+/* Next cycle at which some in-flight request may complete. No request
+ * finishes before the lowest min finish cycle in flight, and an event-driven
+ * NVMain does nothing between its own events, so we sleep until both hold
+ * instead of polling every cycle.
+ */
+uint64_t NVMainMemory::nextWakeCycle(uint64_t cycle) {
+    assert(!inflightHeap.empty());
+    uint64_t wakeCycle = std::max(cycle + 1, inflightHeap.top()->minFinishCycle);
+    if (!eventDriven) return wakeCycle; // NVMain must be cycled every step
+
+    NVM::EventQueue* eq;
+    NVM::ncycle_t nextEvent = nvmainGlobalEventQueue->GetNextEvent(&eq);
+    if (nextEvent == std::numeric_limits<NVM::ncycle_t>::max()) return wakeCycle;
+
+    // An event at NVMain tick t is processed by tick(t-1), which cycles NVMain up to t
+    return std::max(wakeCycle, (uint64_t)nextEvent - 1);
+}
+
 void NVMainMemory::recycleEvent(SchedEventNVMain* ev) {
     assert(ev != nextSchedEvent);
     assert(ev->next == NULL);
@@ -342,22 +364,9 @@ void NVMainMemory::enqueue(NVMainAccEvent* ev, uint64_t cycle) {
     profIssued.inc();
 
     // Build NVMainRequest and send it to NVMain
-    NVM::NVMainRequest *request = new NVM::NVMainRequest();
-
-    // No data in memory for now
-    if (!ignoreData) {
-        int transfer_size = zinfo->lineSize;
-        request->data.SetSize(transfer_size);
-        for(int i = 0; i < transfer_size; i++) {
-            request->data.SetByte(i, 0);
-        }
-    }
-
-    request->access = NVM::UNKNOWN_ACCESS;
+    NVMainInflightRequest *request = allocRequest();
     request->address.SetPhysicalAddress(ev->getAddr());
-    request->status = NVM::MEM_REQUEST_INCOMPLETE;
     request->type = (ev->isWrite()) ? NVM::WRITE : NVM::READ;
-    request->owner = (NVMObject *)this;
 
     // Sync NVMain state to curCycle
     // NVMain can only issue command in the current cycle
@@ -370,34 +379,29 @@ void NVMainMemory::enqueue(NVMainAccEvent* ev, uint64_t cycle) {
     if (!nvmainPtr->IsIssuable(request, NULL)) {
         //info("[%s] %s access to %lx requeued. Curent cycle %ld, requeue cycle %ld", getName(), ev->isWrite()? "Write" : "Read", ev->getAddr(), cycle, cycle+1);
         ev->requeue(cycle+1);
-        delete request;
+        freeRequest(request);
         return;
     }
 
-    //info("[%s] [Enqueue] Address %lx curCycle %lu, cycle %lu, updateCycle %lu, inflight requests %ld", getName(), ev->getAddr(), curCycle, cycle, updateCycle, inflightRequests.size());
+    //info("[%s] [Enqueue] Address %lx curCycle %lu, cycle %lu, updateCycle %lu, inflight requests %ld", getName(), ev->getAddr(), curCycle, cycle, updateCycle, inflightHeap.size());
     bool enqueued = nvmainPtr->IssueCommand(request);
     assert(enqueued);
 
     // Update stats
-    const auto it = memoryHistogram.find(ev->getAddr());
-    if (it == memoryHistogram.end()){
-        memoryHistogram.insert(std::make_pair<uint64_t, uint64_t>(ev->getAddr(), 1));
-        profMemoryAddresses.inc(1);
-        profMemoryFootprint.inc(zinfo->lineSize);
-        addressReuseHist.inc(1);
-    } else {
-        addressReuseHist.dec(std::min(NUMBINS-1, it->second));
-        it->second++;
-        addressReuseHist.inc(std::min(NUMBINS-1, it->second));
-    }
+    if (footprint) footprint->access(ev->getAddr() >> lineBits);
 
-    // Add this request to list of inflight requests
-    inflightRequests.push_back(std::make_pair(request, std::make_pair(ev, cycle + minLatency)));
+    // Add this request to the inflight heap
+    request->ev = ev;
+    request->minFinishCycle = cycle + minLatency;
+    inflightHeap.insert(request);
     ev->hold();
 
-    // Event handling
-    if (!nextSchedEvent) {
-        assert(inflightRequests.size() == 1);
+    // Event handling. The new request may finish before the current wakeup
+    // (e.g., a read issued while a long PCM write is pending), so reschedule
+    // earlier if needed.
+    uint64_t wakeCycle = nextWakeCycle(cycle);
+    if (nextSchedCycle > wakeCycle) {
+        if (nextSchedEvent) nextSchedEvent->annul();
         if (eventFreelist) {
             nextSchedEvent = eventFreelist;
             eventFreelist = eventFreelist->next;
@@ -405,8 +409,8 @@ void NVMainMemory::enqueue(NVMainAccEvent* ev, uint64_t cycle) {
         } else {
             nextSchedEvent = new SchedEventNVMain(this, domain);
         }
-        nextSchedEvent->enqueue(cycle + minLatency);
-        nextSchedRequest = request;
+        nextSchedEvent->enqueue(wakeCycle);
+        nextSchedCycle = wakeCycle;
     }
 
     return;
@@ -414,15 +418,11 @@ void NVMainMemory::enqueue(NVMainAccEvent* ev, uint64_t cycle) {
 
 bool NVMainMemory::RequestComplete(NVM::NVMainRequest *creq) {
 
-    assert(inflightRequests.size() > 0);
-    auto it = inflightRequests.begin();
-    for (; it != inflightRequests.end(); ++it) {
-        if (it->first == creq) break;
-    }
-    assert(it != inflightRequests.end());
-    NVMainAccEvent* ev = it->second.first;
+    NVMainInflightRequest* req = static_cast<NVMainInflightRequest*>(creq);
+    assert(inflightHeap.contains(req));
+    NVMainAccEvent* ev = req->ev;
 
-    // Note that curCycle is up to date because we are advancing cycle by cycle in tick while
+    // Note that curCycle is up to date because tick wakes up at every NVMain event while
     // we are waiting for a request completion.
     uint64_t lat = curCycle+1 - ev->sCycle;
     if (ev->isWrite()) {
@@ -438,17 +438,38 @@ bool NVMainMemory::RequestComplete(NVM::NVMainRequest *creq) {
     ev->release();
     ev->done(curCycle+1);
 
-    if (creq == nextSchedRequest)
-        nextSchedRequest = NULL;
-
-    inflightRequests.erase(it);
+    inflightHeap.remove(req);
 
-    //info("[%s] [RequestComplete] %s access to %lx DONE at %ld (%ld cycles), %ld inflight reqs", getName(), ev->isWrite()? "W" : "R", ev->getAddr(), curCycle, lat, inflightRequests.size());
+    //info("[%s] [RequestComplete] %s access to %lx DONE at %ld (%ld cycles), %ld inflight reqs", getName(), ev->isWrite()? "W" : "R", ev->getAddr(), curCycle, lat, inflightHeap.size());
 
-    delete creq;
+    freeRequest(req);
     return true;
 }
 
+/* Request pool. Requests are recycled through a per-controller freelist and
+ * reset from requestTemplate, which already holds the zeroed line, so the
+ * common case does no allocation and no per-byte data setup.
+ */
+
+NVMainInflightRequest* NVMainMemory::allocRequest() {
+    NVMainInflightRequest* req;
+    if (requestFreelist) {
+        req = requestFreelist;
+        requestFreelist = requestFreelist->next;
+    } else {
+        req = new NVMainInflightRequest();
+    }
+    *static_cast<NVM::NVMainRequest*>(req) = requestTemplate;
+    req->next = NULL;
+    return req;
+}
+
+void NVMainMemory::freeRequest(NVMainInflightRequest* req) {
+    assert(req->next == NULL);
+    req->next = requestFreelist;
+    requestFreelist = req;
+}
+
 void NVMainMemory::printStats() {
     //info("Print NVMain stats for %s, curCycle %ld, updateCycle %ld", getName(), dynamic_cast<OOOCore*>(zinfo->cores[0])->getCycles(), updateCycle);
     std::ofstream out(nvmainStatsFile, std::ios_base::app);
@@ -462,7 +483,7 @@ void NVMainMemory::printStats() {
 #else //no nvmain, have the class fail when constructed
 
 NVMainMemory::NVMainMemory(std::string& nvmainTechIni, std::string& outputFile, std::string& traceName,
-        uint32_t capacityMB, uint64_t _minLatency, uint32_t _domain, const g_string& _name)
+        uint32_t capacityMB, uint64_t _minLatency, uint32_t _domain, const g_string& _name, FootprintTracker* _footprint)
 {
     panic("Cannot use NVMainMemory, zsim was not compiled with NVMain");
 }
@@ -470,10 +491,13 @@ NVMainMemory::NVMainMemory(std::string& nvmainTechIni, std::string& outputFile,
 void NVMainMemory::initStats(AggregateStat* parentStat) { panic("???"); }
 uint64_t NVMainMemory::access(MemReq& req) { panic("???"); return 0; }
 uint64_t NVMainMemory::tick(uint64_t cycle) { panic("???"); return 0; }
+uint64_t NVMainMemory::nextWakeCycle(uint64_t cycle) { panic("???"); return 0; }
 void NVMainMemory::enqueue(NVMainAccEvent* ev, uint64_t cycle) { panic("???"); }
 void NVMainMemory::recycleEvent(SchedEventNVMain* ev) { panic("???"); }
 bool NVMainMemory::RequestComplete(NVM::NVMainRequest *creq) { panic("???"); }
 void NVMainMemory::printStats() { panic("???"); }
+NVMainInflightRequest* NVMainMemory::allocRequest() { panic("???"); return NULL; }
+void NVMainMemory::freeRequest(NVMainInflightRequest* req) { panic("???"); }
 
 #endif
 
@@ -27,10 +27,12 @@
 #define NVMAIN_MEM_CTRL_H_
 
 #include <map>
-#include <unordered_map>
+#include <vector>
 #include <set>
 #include <string>
+#include "footprint_tracker.h"
 #include "g_std/g_string.h"
+#include "inflight_heap.h"
 #include "memory_hierarchy.h"
 #include "pad.h"
 #include "stats.h"
@@ -58,6 +60,17 @@
 class NVMainAccEvent;
 class SchedEventNVMain;
 
+/* NVMain request extended with the zsim-side state needed to complete it.
+ * NVMain hands the same pointer back in RequestComplete, so finding the
+ * corresponding event is a cast instead of a search.
+ */
+struct NVMainInflightRequest : public NVM::NVMainRequest {
+    NVMainAccEvent* ev;
+    uint64_t minFinishCycle;  // earliest cycle this request may complete
+    uint32_t heapIdx;         // position in the in-flight heap
+    NVMainInflightRequest* next;  // for request freelist
+};
+
 class NVMainMemory : public MemObject, public NVM::NVMObject { //one NVMain controller
     private:
         g_string name;
@@ -73,8 +86,14 @@ class NVMainMemory : public MemObject, public NVM::NVMObject { //one NVMain cont
         NVM::GlobalEventQueue *nvmainGlobalEventQueue;
         NVM::TagGenerator *nvmainTagGenerator;
 
-        std::vector<std::pair<NVM::NVMainRequest*, std::pair<NVMainAccEvent*, uint64_t>>> inflightRequests;
-        std::unordered_map<uint64_t,uint64_t> memoryHistogram;
+        // In-flight requests, kept as a min-heap on minFinishCycle
+        InflightHeap<NVMainInflightRequest> inflightHeap;
+
+        // Request pool; freed requests are reset from requestTemplate on reuse
+        NVM::NVMainRequest requestTemplate;
+        NVMainInflightRequest* requestFreelist;
+
+        FootprintTracker* footprint;  // NULL if disabled
 
         uint64_t curCycle; //processor cycle, used in callbacks
         uint64_t updateCycle; //latest cycle where nvmain was updated
@@ -90,10 +109,7 @@ class NVMainMemory : public MemObject, public NVM::NVMObject { //one NVMain cont
         Counter profPUTX;
         Counter profTotalRdLat;
         Counter profTotalWrLat;
-        Counter profMemoryFootprint;
-        Counter profMemoryAddresses;
         VectorCounter latencyHist;
-        VectorCounter addressReuseHist;
         static const uint64_t BINSIZE = 10, NUMBINS = 100;
         PAD();
 
@@ -102,12 +118,12 @@ class NVMainMemory : public MemObject, public NVM::NVMObject { //one NVMain cont
 
         // Wave phase information
         SchedEventNVMain* nextSchedEvent;
-        NVM::NVMainRequest* nextSchedRequest;
+        uint64_t nextSchedCycle;
         SchedEventNVMain* eventFreelist;
 
 
     public:
-        NVMainMemory(std::string& nvmainTechIni, std::string& outputFile, std::string& traceName, uint32_t capacityMB, uint64_t _minLatency, uint32_t _domain, const g_string& _name);
+        NVMainMemory(std::string& nvmainTechIni, std::string& outputFile, std::string& traceName, uint32_t capacityMB, uint64_t _minLatency, uint32_t _domain, const g_string& _name, FootprintTracker* _footprint);
 
         const char* getName() {return name.c_str();}
 
@@ -124,6 +140,12 @@ class NVMainMemory : public MemObject, public NVM::NVMObject { //one NVMain cont
         bool RequestComplete(NVM::NVMainRequest *creq);
         void Cycle(NVM::ncycle_t){};
         void printStats();
+
+    private:
+        uint64_t nextWakeCycle(uint64_t cycle);
+
+        NVMainInflightRequest* allocRequest();
+        void freeRequest(NVMainInflightRequest* req);
 };
 
 #endif  // NVMAIN_MEM_CTRL_H_
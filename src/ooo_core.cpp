@@ -28,8 +28,10 @@
 #include <queue>
 #include <string>
 #include "bithacks.h"
+#include "checkpoint.h"
 #include "decoder.h"
 #include "filter_cache.h"
+#include "tlb.h"
 #include "zsim.h"
 #include "rng.h"
 
@@ -42,22 +44,11 @@
 #define DEBUG_MSG(args...)
 //#define DEBUG_MSG(args...) info(args)
 
-// Core parameters
-// TODO(dsm): Make OOOCore templated, subsuming these
+// Core parameters are in the OOO*Params structs (see ooo_core.h)
 
-// Stages --- more or less matched to Westmere, but have not seen detailed pipe diagrams anywhare
-#define FETCH_STAGE 1
-#define DECODE_STAGE 4  // NOTE: Decoder adds predecode delays to decode
-#define ISSUE_STAGE 7
-#define DISPATCH_STAGE 13  // RAT + ROB + RS, each is easily 2 cycles
-
-#define L1D_LAT 4  // fixed, and FilterCache does not include L1 delay
-#define FETCH_BYTES_PER_CYCLE 16
-#define ISSUES_PER_CYCLE 4
-#define RF_READS_PER_CYCLE 3
-
-OOOCore::OOOCore(FilterCache* _l1i, FilterCache* _l1d, g_string& _name, uint32_t _id) : Core(_name), l1i(_l1i), l1d(_l1d), id(_id), cRec(0, _name) {
-    decodeCycle = DECODE_STAGE;  // allow subtracting from it
+template <typename P>
+OOOCoreT<P>::OOOCoreT(FilterCache* _l1i, FilterCache* _l1d, g_string& _name, uint32_t _id) : OOOCore(_name), l1i(_l1i), l1d(_l1d), id(_id), cRec(0, _name) {
+    decodeCycle = P::DECODE_STAGE;  // allow subtracting from it
     curCycle = 0;
     phaseEndCycle = zinfo->phaseLength;
 
@@ -92,7 +83,8 @@ OOOCore::OOOCore(FilterCache* _l1i, FilterCache* _l1d, g_string& _name, uint32_t
 
 }
 
-void OOOCore::initStats(AggregateStat* parentStat) {
+template <typename P>
+void OOOCoreT<P>::initStats(AggregateStat* parentStat) {
     AggregateStat* coreStat = new AggregateStat();
     coreStat->init(name.c_str(), "Core stats");
 
@@ -129,13 +121,18 @@ void OOOCore::initStats(AggregateStat* parentStat) {
     profIssueStalls.init("issueStalls",  "Issue stalls");  coreStat->append(&profIssueStalls);
 #endif
 
+    if (mmu) mmu->initStats(coreStat);
+
     parentStat->append(coreStat);
 }
 
-uint64_t OOOCore::getInstrs() const {return instrs;}
-uint64_t OOOCore::getPhaseCycles() const {return curCycle % zinfo->phaseLength;}
+template <typename P>
+uint64_t OOOCoreT<P>::getInstrs() const {return instrs;}
+template <typename P>
+uint64_t OOOCoreT<P>::getPhaseCycles() const {return curCycle % zinfo->phaseLength;}
 
-void OOOCore::contextSwitch(int32_t gid) {
+template <typename P>
+void OOOCoreT<P>::contextSwitch(int32_t gid) {
     if (gid == -1) {
         // Do not execute previous BBL, as we were context-switched
         prevBbl = NULL;
@@ -147,31 +144,82 @@ void OOOCore::contextSwitch(int32_t gid) {
 }
 
 
-InstrFuncPtrs OOOCore::GetFuncPtrs() {return {LoadFunc, StoreFunc, BblFunc, BranchFunc, PredLoadFunc, PredStoreFunc, FPTR_ANALYSIS, {0}};}
+template <typename P>
+InstrFuncPtrs OOOCoreT<P>::GetFuncPtrs() {return {LoadFunc, StoreFunc, BblFunc, BranchFunc, PredLoadFunc, PredStoreFunc, FPTR_ANALYSIS, {0}};}
+
+// Functional warming: same addresses as the simulated path, no timing (and no wrong-path fetches)
+template <typename P>
+void OOOCoreT<P>::warmBbl(ADDRINT bblAddr, BblInfo* bblInfo) {
+    Address addr = this->RandomizeAddress(bblAddr);
+    Address endAddr = addr + bblInfo->bytes;
+    for (Address fetchAddr = addr; fetchAddr < endAddr; fetchAddr += (1 << lineBits)) {
+        l1i->warm(fetchAddr, true);
+    }
+}
+
+template <typename P>
+void OOOCoreT<P>::warmLoad(ADDRINT addr) {
+    Address vAddr = this->RandomizeAddress(addr);
+    if (mmu) mmu->warm(vAddr, [this](Address pteAddr) { l1d->warm(pteAddr, true); });
+    l1d->warm(vAddr, true);
+}
+
+template <typename P>
+void OOOCoreT<P>::warmStore(ADDRINT addr) {
+    Address vAddr = this->RandomizeAddress(addr);
+    if (mmu) mmu->warm(vAddr, [this](Address pteAddr) { l1d->warm(pteAddr, true); });
+    l1d->warm(vAddr, false);
+}
+
+template <typename P>
+void OOOCoreT<P>::warmBranch(ADDRINT pc, bool taken) {
+    branchPred.predict(this->RandomizeAddress(pc), taken);
+}
+
+template <typename P>
+void OOOCoreT<P>::checkpointState(Checkpoint& ckpt) {
+    // Predictors are plain tables, so they are saved verbatim; a different predictor or preset fails the size check
+    ckpt.value(std::string(name.c_str()) + ".branchPred", branchPred);
+}
 
-inline void OOOCore::load(Address addr) {
+template <typename P>
+inline void OOOCoreT<P>::load(Address addr) {
     loadAddrs[loads++] = this->RandomizeAddress(addr);
 }
 
-void OOOCore::store(Address addr) {
+template <typename P>
+void OOOCoreT<P>::store(Address addr) {
     storeAddrs[stores++] = this->RandomizeAddress(addr);
 }
 
 // Predicated loads and stores call this function, gets recorded as a 0-cycle op.
 // Predication is rare enough that we don't need to model it perfectly to be accurate (i.e. the uops still execute, retire, etc), but this is needed for correctness.
-void OOOCore::predFalseMemOp() {
+template <typename P>
+void OOOCoreT<P>::predFalseMemOp() {
     // I'm going to go out on a limb and assume just loads are predicated (this will not fail silently if it's a store)
     loadAddrs[loads++] = -1L;
 }
 
-void OOOCore::branch(Address pc, bool taken, Address takenNpc, Address notTakenNpc) {
+template <typename P>
+void OOOCoreT<P>::branch(Address pc, bool taken, Address takenNpc, Address notTakenNpc) {
     branchPc = this->RandomizeAddress(pc);
     branchTaken = taken;
     branchTakenNpc = this->RandomizeAddress(takenNpc);
     branchNotTakenNpc = this->RandomizeAddress(notTakenNpc);
 }
 
-inline void OOOCore::bbl(Address bblAddr, BblInfo* bblInfo) {
+// Page walks issue their PTE loads through the l1d as dependent loads, recorded like the uop's own access
+template <typename P>
+inline uint64_t OOOCoreT<P>::translate(Address addr, uint64_t dispatchCycle) {
+    return mmu->translate(addr, dispatchCycle, [this](Address pteAddr, uint64_t cycle) {
+        uint64_t respCycle = l1d->load(pteAddr, cycle) + P::L1D_LAT;
+        cRec.record(curCycle, cycle, respCycle);
+        return respCycle;
+    });
+}
+
+template <typename P>
+inline void OOOCoreT<P>::bbl(Address bblAddr, BblInfo* bblInfo) {
     bblAddr = this->RandomizeAddress(bblAddr);
     if (!prevBbl) {
         // This is the 1st BBL since scheduled, nothing to simulate
@@ -213,8 +261,8 @@ inline void OOOCore::bbl(Address bblAddr, BblInfo* bblInfo) {
         prevDecCycle = uop->decCycle;
         uopQueue.markLeave(curCycle);
 
-        // Implement issue width limit --- we can only issue 4 uops/cycle
-        if (curCycleIssuedUops >= ISSUES_PER_CYCLE) {
+        // Implement issue width limit --- we can only issue P::ISSUES_PER_CYCLE uops/cycle
+        if (curCycleIssuedUops >= P::ISSUES_PER_CYCLE) {
 #ifdef OOO_STALL_STATS
             profIssueStalls.inc();
 #endif
@@ -235,8 +283,8 @@ inline void OOOCore::bbl(Address bblAddr, BblInfo* bblInfo) {
         // RF read stalls
         // if srcs are not available at issue time, we have to go thru the RF
         curCycleRFReads += ((c0 < curCycle)? 1 : 0) + ((c1 < curCycle)? 1 : 0);
-        if (curCycleRFReads > RF_READS_PER_CYCLE) {
-            curCycleRFReads -= RF_READS_PER_CYCLE;
+        if (curCycleRFReads > P::RF_READS_PER_CYCLE) {
+            curCycleRFReads -= P::RF_READS_PER_CYCLE;
             curCycleIssuedUops = 0;  // or 1? that's probably a 2nd-order detail
             insWindow.advancePos(curCycle);
         }
@@ -247,7 +295,7 @@ inline void OOOCore::bbl(Address bblAddr, BblInfo* bblInfo) {
         uint64_t cOps = MAX(c0, c1);
 
         // Model RAT + ROB + RS delay between issue and dispatch
-        uint64_t dispatchCycle = MAX(cOps, MAX(c2, c3) + (DISPATCH_STAGE - ISSUE_STAGE));
+        uint64_t dispatchCycle = MAX(cOps, MAX(c2, c3) + (P::DISPATCH_STAGE - P::ISSUE_STAGE));
 
         // info("IW 0x%lx %d %ld %ld %x", bblAddr, i, c2, dispatchCycle, uop->portMask);
         // NOTE: Schedule can adjust both cur and dispatch cycles
@@ -285,7 +333,8 @@ inline void OOOCore::bbl(Address bblAddr, BblInfo* bblInfo) {
                     Address addr = loadAddrs[loadIdx++];
                     uint64_t reqSatisfiedCycle = dispatchCycle;
                     if (addr != ((Address)-1L)) {
-                        reqSatisfiedCycle = l1d->load(addr, dispatchCycle) + L1D_LAT;
+                        if (mmu) dispatchCycle = translate(addr, dispatchCycle);
+                        reqSatisfiedCycle = l1d->load(addr, dispatchCycle) + P::L1D_LAT;
                         cRec.record(curCycle, dispatchCycle, reqSatisfiedCycle);
                     }
 
@@ -322,7 +371,8 @@ inline void OOOCore::bbl(Address bblAddr, BblInfo* bblInfo) {
                     dispatchCycle = MAX(lastStoreAddrCommitCycle+1, dispatchCycle);
                     
                     Address addr = storeAddrs[storeIdx++];
-                    uint64_t reqSatisfiedCycle = l1d->store(addr, dispatchCycle) + L1D_LAT;
+                    if (mmu) dispatchCycle = translate(addr, dispatchCycle);
+                    uint64_t reqSatisfiedCycle = l1d->store(addr, dispatchCycle) + P::L1D_LAT;
                     cRec.record(curCycle, dispatchCycle, reqSatisfiedCycle);
 
                     // Fill the forwarding table
@@ -387,7 +437,7 @@ inline void OOOCore::bbl(Address bblAddr, BblInfo* bblInfo) {
      */
 
     // Model fetch-decode delay (fixed, weak predec/IQ assumption)
-    uint64_t fetchCycle = decodeCycle - (DECODE_STAGE - FETCH_STAGE);
+    uint64_t fetchCycle = decodeCycle - (P::DECODE_STAGE - P::FETCH_STAGE);
     uint32_t lineSize = 1 << lineBits;
 
     // Simulate branch prediction
@@ -428,7 +478,7 @@ inline void OOOCore::bbl(Address bblAddr, BblInfo* bblInfo) {
                 break;
             }
             // Model fetch throughput limit
-            reqCycle = respCycle + lineSize/FETCH_BYTES_PER_CYCLE;
+            reqCycle = respCycle + lineSize/P::FETCH_BYTES_PER_CYCLE;
         }
 
         fetchCycle = lastCommitCycle;
@@ -450,7 +500,7 @@ inline void OOOCore::bbl(Address bblAddr, BblInfo* bblInfo) {
     // If fetch rules, take into account delay between fetch and decode;
     // If decode rules, different BBLs make the decoders skip a cycle
     decodeCycle++;
-    uint64_t minFetchDecCycle = fetchCycle + (DECODE_STAGE - FETCH_STAGE);
+    uint64_t minFetchDecCycle = fetchCycle + (P::DECODE_STAGE - P::FETCH_STAGE);
     if (minFetchDecCycle > decodeCycle) {
 #ifdef OOO_STALL_STATS
         profFetchStalls.inc(decodeCycle - minFetchDecCycle);
@@ -460,7 +510,8 @@ inline void OOOCore::bbl(Address bblAddr, BblInfo* bblInfo) {
 }
 
 // Timing simulation code
-void OOOCore::join() {
+template <typename P>
+void OOOCoreT<P>::join() {
     DEBUG_MSG("[%s] Joining, curCycle %ld phaseEnd %ld", name.c_str(), curCycle, phaseEndCycle);
     uint64_t targetCycle = cRec.notifyJoin(curCycle);
     if (targetCycle > curCycle) advance(targetCycle);
@@ -469,24 +520,28 @@ void OOOCore::join() {
     DEBUG_MSG("[%s] Joined, curCycle %ld phaseEnd %ld", name.c_str(), curCycle, phaseEndCycle);
 }
 
-void OOOCore::leave() {
+template <typename P>
+void OOOCoreT<P>::leave() {
     DEBUG_MSG("[%s] Leaving, curCycle %ld phaseEnd %ld", name.c_str(), curCycle, phaseEndCycle);
     cRec.notifyLeave(curCycle);
 }
 
-void OOOCore::cSimStart() {
+template <typename P>
+void OOOCoreT<P>::cSimStart() {
     uint64_t targetCycle = cRec.cSimStart(curCycle);
     assert(targetCycle >= curCycle);
     if (targetCycle > curCycle) advance(targetCycle);
 }
 
-void OOOCore::cSimEnd() {
+template <typename P>
+void OOOCoreT<P>::cSimEnd() {
     uint64_t targetCycle = cRec.cSimEnd(curCycle);
     assert(targetCycle >= curCycle);
     if (targetCycle > curCycle) advance(targetCycle);
 }
 
-void OOOCore::advance(uint64_t targetCycle) {
+template <typename P>
+void OOOCoreT<P>::advance(uint64_t targetCycle) {
     assert(targetCycle > curCycle);
     decodeCycle += targetCycle - curCycle;
     insWindow.longAdvance(curCycle, targetCycle);
@@ -501,7 +556,8 @@ void OOOCore::advance(uint64_t targetCycle) {
 
 // Address randomization code
 
-ADDRINT OOOCore::RandomizeAddress(ADDRINT vAddr) {
+template <typename P>
+ADDRINT OOOCoreT<P>::RandomizeAddress(ADDRINT vAddr) {
     uint64_t vaPageShift = 12; // For 4KB pages
     uint64_t vaPageMask = (1 << vaPageShift) - 1;
     if (zinfo->addressRandomization) {
@@ -512,7 +568,8 @@ ADDRINT OOOCore::RandomizeAddress(ADDRINT vAddr) {
     return vAddr;
 }
 
-ADDRINT OOOCore::RemapAddress(ADDRINT vaPage) {
+template <typename P>
+ADDRINT OOOCoreT<P>::RemapAddress(ADDRINT vaPage) {
    // vaPage is the virtual address shifted right by the page size
    // By randomly remapping the lower 24 bits of vaPage, addresses will be distributed
    // over a 1<<(16+3*8) = 64 GB range which should avoid artificial set contention in all cache levels.
@@ -529,23 +586,28 @@ ADDRINT OOOCore::RemapAddress(ADDRINT vaPage) {
 
 // Pin interface code
 
-void OOOCore::LoadFunc(THREADID tid, ADDRINT addr) {static_cast<OOOCore*>(cores[tid])->load(addr);}
-void OOOCore::StoreFunc(THREADID tid, ADDRINT addr) {static_cast<OOOCore*>(cores[tid])->store(addr);}
+template <typename P>
+void OOOCoreT<P>::LoadFunc(THREADID tid, ADDRINT addr) {static_cast<OOOCoreT<P>*>(cores[tid])->load(addr);}
+template <typename P>
+void OOOCoreT<P>::StoreFunc(THREADID tid, ADDRINT addr) {static_cast<OOOCoreT<P>*>(cores[tid])->store(addr);}
 
-void OOOCore::PredLoadFunc(THREADID tid, ADDRINT addr, BOOL pred) {
-    OOOCore* core = static_cast<OOOCore*>(cores[tid]);
+template <typename P>
+void OOOCoreT<P>::PredLoadFunc(THREADID tid, ADDRINT addr, BOOL pred) {
+    OOOCoreT<P>* core = static_cast<OOOCoreT<P>*>(cores[tid]);
     if (pred) core->load(addr);
     else core->predFalseMemOp();
 }
 
-void OOOCore::PredStoreFunc(THREADID tid, ADDRINT addr, BOOL pred) {
-    OOOCore* core = static_cast<OOOCore*>(cores[tid]);
+template <typename P>
+void OOOCoreT<P>::PredStoreFunc(THREADID tid, ADDRINT addr, BOOL pred) {
+    OOOCoreT<P>* core = static_cast<OOOCoreT<P>*>(cores[tid]);
     if (pred) core->store(addr);
     else core->predFalseMemOp();
 }
 
-void OOOCore::BblFunc(THREADID tid, ADDRINT bblAddr, BblInfo* bblInfo) {
-    OOOCore* core = static_cast<OOOCore*>(cores[tid]);
+template <typename P>
+void OOOCoreT<P>::BblFunc(THREADID tid, ADDRINT bblAddr, BblInfo* bblInfo) {
+    OOOCoreT<P>* core = static_cast<OOOCoreT<P>*>(cores[tid]);
     core->bbl(bblAddr, bblInfo);
 
     while (core->curCycle > core->phaseEndCycle) {
@@ -564,7 +626,24 @@ void OOOCore::BblFunc(THREADID tid, ADDRINT bblAddr, BblInfo* bblInfo) {
     }
 }
 
-void OOOCore::BranchFunc(THREADID tid, ADDRINT pc, BOOL taken, ADDRINT takenNpc, ADDRINT notTakenNpc) {
-    static_cast<OOOCore*>(cores[tid])->branch(pc, taken, takenNpc, notTakenNpc);
+template <typename P>
+void OOOCoreT<P>::BranchFunc(THREADID tid, ADDRINT pc, BOOL taken, ADDRINT takenNpc, ADDRINT notTakenNpc) {
+    static_cast<OOOCoreT<P>*>(cores[tid])->branch(pc, taken, takenNpc, notTakenNpc);
 }
 
+// Core types (see ooo_core.h)
+template class OOOCoreT<OOODefaultParams>;
+template class OOOCoreT<OOONehalemParams>;
+template class OOOCoreT<OOOSandyBridgeParams>;
+template class OOOCoreT<OOOSkylakeParams>;
+template class OOOCoreT<OOOWideParams>;
+template class OOOCoreT<OOOTAGEParams<OOODefaultParams>>;
+template class OOOCoreT<OOOTAGEParams<OOONehalemParams>>;
+template class OOOCoreT<OOOTAGEParams<OOOSandyBridgeParams>>;
+template class OOOCoreT<OOOTAGEParams<OOOSkylakeParams>>;
+template class OOOCoreT<OOOTAGEParams<OOOWideParams>>;
+template class OOOCoreT<OOOTAGESCLParams<OOODefaultParams>>;
+template class OOOCoreT<OOOTAGESCLParams<OOONehalemParams>>;
+template class OOOCoreT<OOOTAGESCLParams<OOOSandyBridgeParams>>;
+template class OOOCoreT<OOOTAGESCLParams<OOOSkylakeParams>>;
+template class OOOCoreT<OOOTAGESCLParams<OOOWideParams>>;
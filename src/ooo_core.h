@@ -29,6 +29,7 @@
 #include <algorithm>
 #include <queue>
 #include <string>
+#include "branch_pred.h"
 #include "core.h"
 #include "g_std/g_multimap.h"
 #include "memory_hierarchy.h"
@@ -40,66 +41,6 @@
 
 class FilterCache;
 
-/* 2-level branch predictor:
- *  - L1: Branch history shift registers (bshr): 2^NB entries, HB bits of history/entry, indexed by XOR'd PC
- *  - L2: Pattern history table (pht): 2^LB entries, 2-bit sat counters, indexed by XOR'd bshr contents
- *  NOTE: Assumes LB is in [NB, HB] range for XORing (e.g., HB = 18 and NB = 10, LB = 13 is OK)
- */
-template<uint32_t NB, uint32_t HB, uint32_t LB>
-class BranchPredictorPAg {
-    private:
-        uint32_t bhsr[1 << NB];
-        uint8_t pht[1 << LB];
-
-    public:
-        BranchPredictorPAg() {
-            uint32_t numBhsrs = 1 << NB;
-            uint32_t phtSize = 1 << LB;
-
-            for (uint32_t i = 0; i < numBhsrs; i++) {
-                bhsr[i] = 0;
-            }
-            for (uint32_t i = 0; i < phtSize; i++) {
-                pht[i] = 1;  // weak non-taken
-            }
-
-            static_assert(LB <= HB, "Too many PHT entries");
-            static_assert(LB >= NB, "Too few PHT entries (you'll need more XOR'ing)");
-        }
-
-        // Predicts and updates; returns false if mispredicted
-        inline bool predict(Address branchPc, bool taken) {
-            uint32_t bhsrMask = (1 << NB) - 1;
-            uint32_t histMask = (1 << HB) - 1;
-            uint32_t phtMask  = (1 << LB) - 1;
-           
-            // Predict
-            // uint32_t bhsrIdx = ((uint32_t)( branchPc ^ (branchPc >> NB) ^ (branchPc >> 2*NB) )) & bhsrMask;
-            uint32_t bhsrIdx = ((uint32_t)( branchPc >> 1)) & bhsrMask;
-            uint32_t phtIdx = bhsr[bhsrIdx];
-
-            // Shift-XOR-mask to fit in PHT
-            phtIdx ^= (phtIdx & ~phtMask) >> (HB - LB); // take the [HB-1, LB] bits of bshr, XOR with [LB-1, ...] bits
-            phtIdx &= phtMask;
-            
-            // If uncommented, behaves like a global history predictor
-            // bhsrIdx = 0;
-            // phtIdx = (bhsr[bhsrIdx] ^ ((uint32_t)branchPc)) & phtMask;
-
-            bool pred = pht[phtIdx] > 1;
-
-            // info("BP Pred: 0x%lx bshr[%d]=%x taken=%d pht=%d pred=%d", branchPc, bhsrIdx, phtIdx, taken, pht[phtIdx], pred);
-
-            // Update
-            pht[phtIdx] = taken? (pred? 3 : (pht[phtIdx]+1)) : (pred? (pht[phtIdx]-1) : 0); //2-bit saturating counter
-            bhsr[bhsrIdx] = ((bhsr[bhsrIdx] << 1) & histMask ) | (taken? 1: 0); //we apply phtMask here, dependence is further away
-
-            // info("BP Update: newPht=%d newBshr=%x", pht[phtIdx], bhsr[bhsrIdx]);
-            return (taken == pred);
-        }
-};
-
-
 template<uint32_t H, uint32_t WSZ>
 class WindowStructure {
     private:
@@ -356,9 +297,114 @@ class CycleQueue {
         }
 };
 
+/* OOO core parameter sets. OOOCoreT is templated on these, so every structure
+ * size and latency is a compile-time constant in the bbl() hot loop. Each set
+ * is a core type (sys.cores.X.type, see init.cpp), and must be instantiated at
+ * the end of ooo_core.cpp.
+ *
+ * NOTE: Issue ports are set by the decoder, which models Nehalem's 6 ports, so
+ * beyond ISSUES_PER_CYCLE, wider cores are still limited by port contention.
+ */
+
+// Sandy Bridge (e.g., Xeon E5-2670): the window sizes OOOCore has always had,
+// plus the physical register file, which removes most RF read stalls
+struct OOOSandyBridgeParams {
+    // Stages --- more or less matched to Westmere, but have not seen detailed pipe diagrams anywhare
+    static const uint32_t FETCH_STAGE = 1;
+    static const uint32_t DECODE_STAGE = 4;  // NOTE: Decoder adds predecode delays to decode
+    static const uint32_t ISSUE_STAGE = 7;
+    static const uint32_t DISPATCH_STAGE = 13;  // RAT + ROB + RS, each is easily 2 cycles
+
+    static const uint32_t L1D_LAT = 4;  // fixed, and FilterCache does not include L1 delay
+    static const uint32_t FETCH_BYTES_PER_CYCLE = 16;
+    static const uint32_t ISSUES_PER_CYCLE = 4;
+    static const uint32_t RF_READS_PER_CYCLE = 8;
+
+    static const uint32_t IW_SIZE = 54;
+    static const uint32_t ROB_SIZE = 168;
+    static const uint32_t RETIRES_PER_CYCLE = 4;
+    static const uint32_t LQ_SIZE = 64;
+    static const uint32_t SQ_SIZE = 36;
+    static const uint32_t UOP_QUEUE_SIZE = 28;
+
+    typedef BranchPredictorPAg<12, 18, 15> BranchPredictor;
+};
+
+// The original OOOCore configuration: Sandy Bridge windows with Nehalem's ROB read port stalls
+struct OOODefaultParams : public OOOSandyBridgeParams {
+    static const uint32_t RF_READS_PER_CYCLE = 3;
+
+    // Agner's guide says it's a 2-level pred and BHSR is 18 bits, so this is the config that makes sense;
+    // in practice, this is probably closer to the Pentium M's branch predictor, (see Uzelac and Milenkovic,
+    // ISPASS 2009), which get the 18 bits of history through a hybrid predictor (2-level + bimodal + loop)
+    // where a few of the 2-level history bits are in the tag.
+    // Since this is close enough, we'll leave it as is for now. Feel free to reverse-engineer the real thing...
+    // UPDATE: Now pht index is XOR-folded BSHR. This has 6656 bytes total -- not negligible, but not ridiculous.
+    typedef BranchPredictorPAg<11, 18, 14> BranchPredictor;
+};
+
+struct OOONehalemParams : public OOODefaultParams {
+    static const uint32_t IW_SIZE = 36;
+    static const uint32_t ROB_SIZE = 128;
+    static const uint32_t LQ_SIZE = 48;
+    static const uint32_t SQ_SIZE = 32;
+};
+
+struct OOOSkylakeParams : public OOOSandyBridgeParams {
+    static const uint32_t L1D_LAT = 5;
+    static const uint32_t IW_SIZE = 97;
+    static const uint32_t ROB_SIZE = 224;
+    static const uint32_t LQ_SIZE = 72;
+    static const uint32_t SQ_SIZE = 56;
+    static const uint32_t UOP_QUEUE_SIZE = 64;
+
+    typedef BranchPredictorPAg<12, 18, 16> BranchPredictor;
+};
+
+// A wide server core, roughly sized like recent big cores (6-wide, 512-entry ROB)
+struct OOOWideParams : public OOOSkylakeParams {
+    static const uint32_t FETCH_BYTES_PER_CYCLE = 32;
+    static const uint32_t ISSUES_PER_CYCLE = 6;
+    static const uint32_t RF_READS_PER_CYCLE = 12;
+
+    static const uint32_t IW_SIZE = 200;
+    static const uint32_t ROB_SIZE = 512;
+    static const uint32_t RETIRES_PER_CYCLE = 8;
+    static const uint32_t LQ_SIZE = 192;
+    static const uint32_t SQ_SIZE = 114;
+    static const uint32_t UOP_QUEUE_SIZE = 144;
+};
+
+// Any of the above with a TAGE predictor instead of PAg (sys.cores.X.branchPredictor = "TAGE")
+template <typename P>
+struct OOOTAGEParams : public P {
+    typedef BranchPredictorTAGEDefault BranchPredictor;
+};
+
+// Or with TAGE-SC-L (sys.cores.X.branchPredictor = "TAGE-SC-L")
+template <typename P>
+struct OOOTAGESCLParams : public P {
+    typedef BranchPredictorTAGESCLDefault BranchPredictor;
+};
+
 struct BblInfo;
 
+/* Common interface of all OOO core types, used outside of the bound phase
+ * (e.g., by the contention simulator). Everything on the bound-phase path is
+ * in OOOCoreT and non-virtual.
+ */
 class OOOCore : public Core {
+    public:
+        explicit OOOCore(g_string& _name) : Core(_name) {}
+
+        // Contention simulation interface
+        virtual EventRecorder* getEventRecorder() = 0;
+        virtual void cSimStart() = 0;
+        virtual void cSimEnd() = 0;
+};
+
+template <typename P>
+class OOOCoreT : public OOOCore {
     private:
         FilterCache* l1i;
         FilterCache* l1d;
@@ -386,8 +432,8 @@ class OOOCore : public Core {
         //buffers, but we split the associative component from the limited-size modeling.
         //NOTE: We do not model the 10-entry fill buffer here; the weave model should take care
         //to not overlap more than 10 misses.
-        ReorderBuffer<64, 4> loadQueue;
-        ReorderBuffer<36, 4> storeQueue;
+        ReorderBuffer<P::LQ_SIZE, P::RETIRES_PER_CYCLE> loadQueue;
+        ReorderBuffer<P::SQ_SIZE, P::RETIRES_PER_CYCLE> storeQueue;
 
         uint32_t curCycleRFReads; //for RF read stalls
         uint32_t curCycleIssuedUops; //for uop issue limits
@@ -395,17 +441,10 @@ class OOOCore : public Core {
         //This would be something like the Atom... (but careful, the iw probably does not allow 2-wide when configured with 1 slot)
         //WindowStructure<1024, 1 /*size*/, 2 /*width*/> insWindow; //this would be something like an Atom, except all the instruction pairing business...
 
-        //Nehalem
-        WindowStructure<1024, 54 /*size*/> insWindow; //NOTE: IW width is implicitly determined by the decoder, which sets the port masks according to uop type
-        ReorderBuffer<168, 4> rob;
+        WindowStructure<1024, P::IW_SIZE> insWindow; //NOTE: IW width is implicitly determined by the decoder, which sets the port masks according to uop type
+        ReorderBuffer<P::ROB_SIZE, P::RETIRES_PER_CYCLE> rob;
 
-        // Agner's guide says it's a 2-level pred and BHSR is 18 bits, so this is the config that makes sense;
-        // in practice, this is probably closer to the Pentium M's branch predictor, (see Uzelac and Milenkovic,
-        // ISPASS 2009), which get the 18 bits of history through a hybrid predictor (2-level + bimodal + loop)
-        // where a few of the 2-level history bits are in the tag.
-        // Since this is close enough, we'll leave it as is for now. Feel free to reverse-engineer the real thing...
-        // UPDATE: Now pht index is XOR-folded BSHR. This has 6656 bytes total -- not negligible, but not ridiculous.
-        BranchPredictorPAg<11, 18, 14> branchPred;
+        typename P::BranchPredictor branchPred;
 
         Address branchPc;  //0 if last bbl was not a conditional branch
         bool branchTaken;
@@ -413,7 +452,7 @@ class OOOCore : public Core {
         Address branchNotTakenNpc;
 
         uint64_t decodeCycle;
-        CycleQueue<28> uopQueue;  // models issue queue 
+        CycleQueue<P::UOP_QUEUE_SIZE> uopQueue;  // models issue queue
 
         uint64_t instrs, uops, bbls, approxInstrs, mispredBranches;
 
@@ -438,7 +477,7 @@ class OOOCore : public Core {
         uint8_t addressRandomizationTable[256];
 
     public:
-        OOOCore(FilterCache* _l1i, FilterCache* _l1d, g_string& _name, uint32_t _id);
+        OOOCoreT(FilterCache* _l1i, FilterCache* _l1d, g_string& _name, uint32_t _id);
 
         void initStats(AggregateStat* parentStat);
 
@@ -453,8 +492,15 @@ class OOOCore : public Core {
 
         InstrFuncPtrs GetFuncPtrs();
 
+        void warmBbl(ADDRINT bblAddr, BblInfo* bblInfo);
+        void warmLoad(ADDRINT addr);
+        void warmStore(ADDRINT addr);
+        void warmBranch(ADDRINT pc, bool taken);
+
+        void checkpointState(Checkpoint& ckpt);
+
         // Contention simulation interface
-        inline EventRecorder* getEventRecorder() {return cRec.getEventRecorder();}
+        EventRecorder* getEventRecorder() {return cRec.getEventRecorder();}
         void cSimStart();
         void cSimEnd();
 
@@ -480,6 +526,9 @@ class OOOCore : public Core {
 
         inline void bbl(Address bblAddr, BblInfo* bblInfo);
 
+        // Returns the cycle at which addr's translation is available (requires an MMU)
+        inline uint64_t translate(Address addr, uint64_t dispatchCycle);
+
         static void LoadFunc(THREADID tid, ADDRINT addr);
         static void StoreFunc(THREADID tid, ADDRINT addr);
         static void PredLoadFunc(THREADID tid, ADDRINT addr, BOOL pred);
@@ -492,4 +541,10 @@ class OOOCore : public Core {
         ADDRINT RemapAddress(ADDRINT vaPage);
 } ATTR_LINE_ALIGNED;  // Take up an int number of cache lines
 
+typedef OOOCoreT<OOODefaultParams> OOODefaultCore;
+typedef OOOCoreT<OOONehalemParams> OOONehalemCore;
+typedef OOOCoreT<OOOSandyBridgeParams> OOOSandyBridgeCore;
+typedef OOOCoreT<OOOSkylakeParams> OOOSkylakeCore;
+typedef OOOCoreT<OOOWideParams> OOOWideCore;
+
 #endif  // OOO_CORE_H_
@@ -0,0 +1,189 @@
+/** $lic$
+ * Copyright (C) 2012-2014 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "page_alloc.h"
+#include "bithacks.h"
+#include "checkpoint.h"
+#include "process_tree.h"
+
+PageAllocator::PageAllocator(uint32_t _numNodes, uint64_t nodeMB, bool _randomFrames)
+    : numNodes(_numNodes), nodeChunkBits(ilog2(MAX(nodeMB/2, (uint64_t)1))),
+      nodeLineBits(nodeChunkBits + CHUNK_BITS - ilog2(zinfo->lineSize)), randomFrames(_randomFrames), ckptNumMappings(0)
+{
+    if (!numNodes) panic("Page allocator needs at least one NUMA node");
+    if (nodeMB < 2 || !isPow2(nodeMB)) panic("sys.numa.nodeMB must be a power of 2 and at least 2 (MB), %ld given", nodeMB);
+    nodes = gm_calloc<Node>(numNodes);
+    for (uint32_t i = 0; i < numNodes; i++) nodes[i].usedFrames = FRAMES_PER_CHUNK;  // no current chunk
+    spaces = gm_calloc<AddressSpace>(zinfo->lineSize);  // sized to the maximum number of processes, like procArray
+    futex_init(&allocLock);
+    info("Page allocator: %d NUMA nodes of %ld MB, %s frames", numNodes, nodeMB, randomFrames? "random" : "sequential");
+}
+
+void PageAllocator::initStats(AggregateStat* parentStat) {
+    AggregateStat* allocStat = new AggregateStat();
+    allocStat->init("pageAlloc", "Physical page allocator stats");
+    profNodeFrames.init("frames", "4KB frames allocated in each NUMA node", numNodes);
+    allocStat->append(&profNodeFrames);
+    profSpills.init("spills", "Pages placed on another node because theirs was full");
+    allocStat->append(&profSpills);
+    parentStat->append(allocStat);
+}
+
+void PageAllocator::initAddressSpace(uint32_t proc) {
+    futex_lock(&allocLock);
+    AddressSpace& as = spaces[proc];
+    if (!as.root) {
+        ProcessTreeNode* ptn = zinfo->procArray[proc];
+        if (!ptn) panic("Page allocator: process %d does not exist", proc);
+        assert(ptn->getPageBits() <= CHUNK_BITS);  // checked when the process tree is built
+        as.pageLineBits = ptn->getPageBits() - lineBits;
+        as.policy = ptn->getNUMAPolicy();
+        as.bindNode = ptn->getNUMANode();
+        as.root = gm_calloc<PageTable>();
+    }
+    futex_unlock(&allocLock);
+}
+
+uint64_t PageAllocator::pageFault(Address vpn, uint32_t srcId) {
+    uint32_t proc = procIdx;
+    AddressSpace& as = spaces[proc];
+    uint32_t pageBits = as.pageLineBits + lineBits;
+    if (vpn >> VPN_BITS) panic("Process %d accessed address 0x%lx, beyond the page allocator's virtual address space", proc, vpn << pageBits);
+
+    futex_lock(&allocLock);
+    uint64_t entry = lookup(as.root, vpn);  // another thread of the process may have mapped it
+    if (!entry) {
+        uint32_t node;
+        switch (as.policy) {
+            case NUMA_FIRST_TOUCH: node = (srcId < zinfo->numCores)? getCoreNode(srcId) : 0; break;
+            case NUMA_INTERLEAVE: node = vpn % numNodes; break;
+            default: node = as.bindNode;
+        }
+
+        uint64_t ppn;
+        uint32_t spill = 0;
+        while (!allocate((node + spill) % numNodes, pageBits, ppn)) {
+            if (as.policy == NUMA_BIND) panic("Process %d is bound to NUMA node %d, which is out of memory", proc, node);
+            if (++spill == numNodes) panic("Out of simulated physical memory (%d NUMA nodes of %ld MB)", numNodes, 2ul << nodeChunkBits);
+        }
+        if (spill) profSpills.inc();
+        profNodeFrames.inc((node + spill) % numNodes, 1ul << (pageBits - FRAME_BITS));
+
+        entry = ppn + 1;
+        map(proc, vpn, entry);
+    }
+    futex_unlock(&allocLock);
+    return entry;
+}
+
+// Called with allocLock held. Each entry is written after the table it points to is zeroed, so lock-free readers never see garbage.
+void PageAllocator::map(uint32_t proc, Address vpn, uint64_t entry) {
+    PageTable* table = spaces[proc].root;
+    for (uint32_t shift = 2*LEVEL_BITS; shift > 0; shift -= LEVEL_BITS) {
+        volatile uint64_t& e = table->entries[(vpn >> shift) & LEVEL_MASK];
+        if (!e) e = (uint64_t) gm_calloc<PageTable>();
+        table = (PageTable*) e;
+    }
+    table->entries[vpn & LEVEL_MASK] = entry;
+}
+
+bool PageAllocator::allocate(uint32_t node, uint32_t pageBits, uint64_t& ppn) {
+    if (pageBits == CHUNK_BITS) return allocateChunk(node, ppn);
+
+    // 4KB page: take the next frame of the node's current chunk
+    assert(pageBits == FRAME_BITS);
+    Node& n = nodes[node];
+    if (n.usedFrames == FRAMES_PER_CHUNK) {
+        if (!allocateChunk(node, n.curChunk)) return false;
+        n.usedFrames = 0;
+    }
+    uint64_t frame = randomFrames? permute(n.usedFrames, CHUNK_BITS - FRAME_BITS, n.curChunk) : n.usedFrames;
+    n.usedFrames++;
+    ppn = (n.curChunk << (CHUNK_BITS - FRAME_BITS)) | frame;
+    return true;
+}
+
+bool PageAllocator::allocateChunk(uint32_t node, uint64_t& chunk) {
+    Node& n = nodes[node];
+    do {
+        if (n.usedChunks >> nodeChunkBits) return false;
+        uint64_t idx = randomFrames? permute(n.usedChunks, nodeChunkBits, node) : n.usedChunks;
+        n.usedChunks++;
+        chunk = (((uint64_t)node) << nodeChunkBits) | idx;
+    } while (!chunk);  // physical chunk 0 is never used, since some cache arrays treat line address 0 as invalid
+    return true;
+}
+
+// Bijection on [0, 2^bits): odd multiplies and xorshifts are both invertible modulo 2^bits
+uint64_t PageAllocator::permute(uint64_t x, uint32_t bits, uint64_t seed) const {
+    if (!bits) return 0;
+    uint64_t mask = (1ul << bits) - 1;
+    x = (x ^ (seed * 0x9E3779B97F4A7C15ul)) & mask;
+    for (uint32_t i = 0; i < 3; i++) {
+        x = (x * 0xBF58476D1CE4E5B9ul) & mask;
+        x ^= x >> ((bits + 1)/2);
+    }
+    return x;
+}
+
+void PageAllocator::checkpointState(Checkpoint& ckpt) {
+    ckpt.array("pageAlloc.nodes", nodes, numNodes);
+
+    if (!ckpt.isRestoring()) {
+        ckptMappings.clear();
+        for (uint32_t p = 0; p < zinfo->lineSize; p++) {
+            PageTable* root = spaces[p].root;
+            if (!root) continue;
+            for (uint64_t i = 0; i <= LEVEL_MASK; i++) {
+                PageTable* mid = (PageTable*) root->entries[i];
+                if (!mid) continue;
+                for (uint64_t j = 0; j <= LEVEL_MASK; j++) {
+                    PageTable* leaf = (PageTable*) mid->entries[j];
+                    if (!leaf) continue;
+                    for (uint64_t k = 0; k <= LEVEL_MASK; k++) {
+                        if (!leaf->entries[k]) continue;
+                        ckptMappings.push_back(p);
+                        ckptMappings.push_back((((i << LEVEL_BITS) | j) << LEVEL_BITS) | k);
+                        ckptMappings.push_back((uint64_t) leaf->entries[k]);
+                    }
+                }
+            }
+        }
+    }
+
+    ckptNumMappings = ckptMappings.size()/3;
+    ckpt.value("pageAlloc.numMappings", ckptNumMappings);
+    ckptMappings.resize(3*ckptNumMappings);
+    ckpt.array("pageAlloc.mappings", ckptMappings.data(), ckptMappings.size());
+
+    if (ckpt.isRestoring()) {
+        for (uint64_t m = 0; m < ckptNumMappings; m++) {
+            uint32_t p = ckptMappings[3*m];
+            if (!spaces[p].root) initAddressSpace(p);
+            map(p, ckptMappings[3*m + 1], ckptMappings[3*m + 2]);
+        }
+        ckptMappings.clear();
+    }
+}
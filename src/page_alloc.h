@@ -0,0 +1,157 @@
+/** $lic$
+ * Copyright (C) 2012-2014 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PAGE_ALLOC_H_
+#define PAGE_ALLOC_H_
+
+/* Physical page allocator (sys.pageAllocator.enabled).
+ *
+ * Without it, physical line addresses are just virtual line addresses tagged
+ * with the process's procMask bits. With it, each process has its own page
+ * table, and pages get physical frames when first touched, so the addresses
+ * that reach shared caches and memory controllers reflect a realistic
+ * placement:
+ *  - Physical memory is split in sys.numa.nodes nodes of sys.numa.nodeMB
+ *    each. Cores and memory controllers are assigned to nodes in order
+ *    (e.g., with 2 nodes, 16 cores and 4 controllers, cores 0-7 and
+ *    controllers 0-1 are in node 0), and LLC banks send each line to a
+ *    controller of the line's node.
+ *  - Each process places its pages with a NUMA policy (processN.numaPolicy):
+ *    firstTouch (on the node of the core that touches the page first, the
+ *    default), interleave (round-robin across nodes by page number), or bind
+ *    (always on processN.numaNode). Except for bind, pages spill to the next
+ *    node when theirs is full.
+ *  - Pages are 4KB or 2MB (processN.pageSize). Nodes hand out 2MB chunks,
+ *    and 4KB pages are carved from the node's current chunk. With
+ *    sys.pageAllocator.randomFrames (the default), chunks and the frames in
+ *    each chunk are handed out in a pseudo-random order, like a fragmented
+ *    OS allocator would, which spreads pages over cache sets, channels and
+ *    banks; otherwise they are handed out sequentially.
+ *
+ * Pages are never freed (zsim does not see munmap), and forked processes do
+ * not share frames with their parent.
+ */
+
+#include "g_std/g_vector.h"
+#include "galloc.h"
+#include "locks.h"
+#include "memory_hierarchy.h"
+#include "stats.h"
+#include "zsim.h"
+
+class Checkpoint;
+
+enum NUMAPolicy {NUMA_FIRST_TOUCH, NUMA_INTERLEAVE, NUMA_BIND};
+
+class PageAllocator : public GlobAlloc {
+    private:
+        static const uint32_t FRAME_BITS = 12;  // 4KB
+        static const uint32_t CHUNK_BITS = 21;  // 2MB
+        static const uint32_t FRAMES_PER_CHUNK = 1 << (CHUNK_BITS - FRAME_BITS);
+
+        // Page tables are 3-level radix trees over virtual page numbers (48-bit virtual addresses with 4KB pages)
+        static const uint32_t LEVEL_BITS = 12;
+        static const uint32_t LEVEL_MASK = (1 << LEVEL_BITS) - 1;
+        static const uint32_t VPN_BITS = 3*LEVEL_BITS;
+
+        // Inner levels hold pointers to the next level; leaves hold the physical page number + 1 (0 is unmapped)
+        struct PageTable {
+            volatile uint64_t entries[1 << LEVEL_BITS];
+        };
+
+        struct Node {
+            uint64_t usedChunks;
+            uint64_t curChunk;  // physical chunk that 4KB frames are taken from
+            uint32_t usedFrames;  // frames taken from curChunk
+        };
+
+        // Each process's page table and placement, copied from its ProcessTreeNode on its first access
+        struct AddressSpace {
+            PageTable* volatile root;  // set last, so readers that see it see the rest
+            uint32_t pageLineBits;
+            NUMAPolicy policy;
+            uint32_t bindNode;
+        };
+
+        const uint32_t numNodes;
+        const uint32_t nodeChunkBits;  // log2 of 2MB chunks per node
+        const uint32_t nodeLineBits;  // log2 of lines per node
+        const bool randomFrames;
+        Node* nodes;
+        AddressSpace* spaces;  // indexed by procIdx
+
+        lock_t allocLock;  // taken on page faults only; translations read page tables without locking
+
+        VectorCounter profNodeFrames;
+        Counter profSpills;
+
+        // (procIdx, vpn, ppn + 1) triples and their count, kept until the checkpoint is written
+        g_vector<uint64_t> ckptMappings;
+        uint64_t ckptNumMappings;
+
+    public:
+        PageAllocator(uint32_t _numNodes, uint64_t nodeMB, bool _randomFrames);
+
+        void initStats(AggregateStat* parentStat);
+        void checkpointState(Checkpoint& ckpt);
+
+        uint32_t getNumNodes() const { return numNodes; }
+
+        // Node of the given core, or of the given physical line
+        uint32_t getCoreNode(uint32_t coreIdx) const { return coreIdx*numNodes/zinfo->numCores; }
+        uint32_t getNode(Address pLineAddr) const { return pLineAddr >> nodeLineBits; }
+        uint32_t getNodeLineBits() const { return nodeLineBits; }
+
+        /* Translates a virtual line address of the current process, mapping its
+         * page on first touch. srcId is the core that accesses it.
+         */
+        inline Address translate(Address vLineAddr, uint32_t srcId) {
+            AddressSpace& as = spaces[procIdx];
+            if (unlikely(!as.root)) initAddressSpace(procIdx);
+            Address vpn = vLineAddr >> as.pageLineBits;
+            uint64_t entry = lookup(as.root, vpn);
+            if (unlikely(!entry)) entry = pageFault(vpn, srcId);
+            return ((entry - 1) << as.pageLineBits) | (vLineAddr & ((1ul << as.pageLineBits) - 1));
+        }
+
+    private:
+        inline uint64_t lookup(PageTable* table, Address vpn) const {
+            if (unlikely(vpn >> VPN_BITS)) return 0;  // pageFault() panics
+            table = (PageTable*) table->entries[vpn >> (2*LEVEL_BITS)];
+            if (unlikely(!table)) return 0;
+            table = (PageTable*) table->entries[(vpn >> LEVEL_BITS) & LEVEL_MASK];
+            if (unlikely(!table)) return 0;
+            return table->entries[vpn & LEVEL_MASK];
+        }
+
+        void initAddressSpace(uint32_t proc);
+        uint64_t pageFault(Address vpn, uint32_t srcId);
+        void map(uint32_t proc, Address vpn, uint64_t entry);
+        bool allocate(uint32_t node, uint32_t pageBits, uint64_t& ppn);
+        bool allocateChunk(uint32_t node, uint64_t& chunk);
+        uint64_t permute(uint64_t x, uint32_t bits, uint64_t seed) const;
+};
+
+#endif  // PAGE_ALLOC_H_
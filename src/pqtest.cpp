@@ -0,0 +1,275 @@
+/** $lic$
+ * Copyright (C) 2012-2014 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Standalone PrioQueue test. Replays random event streams through PrioQueue
+ * and through a reference queue that holds far elements in a multimap (the
+ * original implementation), and checks that both dequeue the same elements,
+ * in the same order, at the same cycles. Streams mix near and far events
+ * and quantize delays so that many events share a cycle.
+ *
+ * With -b, measures throughput instead: each stream is recorded once as a
+ * sequence of enqueue delays and replayed through both queues, reporting
+ * ns per dequeue+enqueue pair.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <map>
+#include <vector>
+#include "galloc.h"
+#include "log.h"
+#include "mtrand.h"
+#include "prio_queue.h"
+
+struct PQEvent {
+    PQEvent* next;
+    uint32_t id;
+    PQEvent() : next(NULL), id(0) {}
+};
+
+// The original PrioQueue, with a multimap for far elements
+template <typename T, uint32_t B>
+class RefPrioQueue {
+    struct PQBlock {
+        T* array[64];
+        uint64_t occ;
+
+        PQBlock() {
+            for (uint32_t i = 0; i < 64; i++) array[i] = NULL;
+            occ = 0;
+        }
+
+        inline T* dequeue(uint32_t& offset) {
+            uint32_t pos = __builtin_ctzl(occ);
+            T* res = array[pos];
+            T* next = res->next;
+            array[pos] = next;
+            if (!next) occ ^= 1L << pos;
+            offset = pos;
+            res->next = NULL;
+            return res;
+        }
+
+        inline void enqueue(T* obj, uint32_t pos) {
+            occ |= 1L << pos;
+            obj->next = array[pos];
+            array[pos] = obj;
+        }
+    };
+
+    PQBlock blocks[B];
+    std::multimap<uint64_t, T*> feMap;
+    uint64_t curBlock;
+    uint64_t elems;
+
+    public:
+        RefPrioQueue() : curBlock(0), elems(0) {}
+
+        void enqueue(T* obj, uint64_t cycle) {
+            uint64_t absBlock = cycle/64;
+            if (absBlock < curBlock + B) {
+                blocks[absBlock % B].enqueue(obj, cycle % 64);
+            } else {
+                feMap.insert(std::pair<uint64_t, T*>(cycle, obj));
+            }
+            elems++;
+        }
+
+        T* dequeue(uint64_t& deqCycle) {
+            while (!blocks[curBlock % B].occ) {
+                curBlock++;
+                if ((curBlock % (B/2)) == 0 && !feMap.empty()) {
+                    uint64_t topCycle = (curBlock + B)*64;
+                    auto it = feMap.begin();
+                    while (it != feMap.end() && it->first < topCycle) {
+                        blocks[(it->first/64) % B].enqueue(it->second, it->first % 64);
+                        it++;
+                    }
+                    feMap.erase(feMap.begin(), it);
+                }
+            }
+            uint32_t offset;
+            T* obj = blocks[curBlock % B].dequeue(offset);
+            elems--;
+            deqCycle = curBlock*64 + offset;
+            return obj;
+        }
+
+        inline uint64_t size() const {return elems;}
+
+        inline uint64_t firstCycle() const {
+            for (uint32_t i = 0; i < B; i++) {
+                uint64_t occ = blocks[(curBlock + i) % B].occ;
+                if (occ) {
+                    uint64_t cycle = (curBlock + i)*64 + __builtin_ctzl(occ);
+                    return (i < B/2 || feMap.empty())? cycle : std::min(cycle, feMap.begin()->first);
+                }
+            }
+            return feMap.begin()->first;
+        }
+};
+
+static const uint32_t B = 16;  // small window, so that far elements, refills, and rebucketing are frequent
+
+// Runs a stream starting at startCycle and drains both queues. Returns the
+// number of dequeues checked and updates startCycle; panics on the first mismatch
+static uint64_t RunStream(uint32_t seed, uint32_t liveEvents, uint32_t steps,
+        PrioQueue<PQEvent, B>& pq, RefPrioQueue<PQEvent, B>& ref, uint64_t& startCycle) {
+    MTRand rng(seed);
+    std::vector<PQEvent> evs(liveEvents), refEvs(liveEvents);
+
+    // Far delays span from just past the window to many calendar widths; quantum makes cycles collide
+    uint32_t farPct = rng.randInt(50);
+    uint64_t maxFar = 64ul*B << (4 + rng.randInt(10));
+    uint32_t quantum = 1 << rng.randInt(6);
+    auto delay = [&]() -> uint64_t {
+        uint64_t d = (rng.randInt(99) < farPct)? rng.randInt(maxFar) : rng.randInt(64*B/2);
+        return d/quantum*quantum;
+    };
+
+    for (uint32_t i = 0; i < liveEvents; i++) {
+        evs[i].id = refEvs[i].id = i;
+        uint64_t cycle = startCycle + delay();
+        pq.enqueue(&evs[i], cycle);
+        ref.enqueue(&refEvs[i], cycle);
+    }
+
+    uint64_t dequeues = 0;
+    for (uint32_t s = 0; pq.size(); s++) {
+        uint64_t cycle, refCycle;
+        if (pq.firstCycle() != ref.firstCycle()) {
+            panic("Seed %d step %d: firstCycle %ld, reference %ld", seed, s, pq.firstCycle(), ref.firstCycle());
+        }
+        PQEvent* ev = pq.dequeue(cycle);
+        PQEvent* refEv = ref.dequeue(refCycle);
+        if (ev->id != refEv->id || cycle != refCycle) {
+            panic("Seed %d step %d: dequeued event %d at cycle %ld, reference dequeued %d at cycle %ld",
+                    seed, s, ev->id, cycle, refEv->id, refCycle);
+        }
+        dequeues++;
+        startCycle = cycle;
+
+        // Requeue the same event, as simulated events do, then drain
+        if (s < steps) {
+            uint64_t nextCycle = cycle + delay();
+            pq.enqueue(ev, nextCycle);
+            ref.enqueue(refEv, nextCycle);
+        }
+    }
+    if (ref.size()) panic("Seed %d: reference queue has %ld elements left", seed, ref.size());
+    return dequeues;
+}
+
+static double GetTime() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+// Replays a recorded stream of delays through queue Q, keeping liveEvents events queued. Returns elapsed seconds
+template <typename Q>
+static double Replay(Q& q, uint32_t liveEvents, const std::vector<uint32_t>& delays, uint64_t& cycle, uint64_t& checksum) {
+    std::vector<PQEvent> evs(liveEvents);
+    uint32_t d = 0;
+    for (uint32_t i = 0; i < liveEvents; i++) {
+        evs[i].id = i;
+        q.enqueue(&evs[i], cycle + delays[d++]);
+    }
+
+    double start = GetTime();
+    for (; d < delays.size(); d++) {
+        PQEvent* ev = q.dequeue(cycle);
+        checksum += ev->id;
+        q.enqueue(ev, cycle + delays[d]);
+    }
+    double secs = GetTime() - start;
+
+    while (q.size()) q.dequeue(cycle);
+    return secs;
+}
+
+/* Throughput of PrioQueue vs the reference queue, with the simulator's
+ * window size (PQ_BLOCKS in contention_sim.h). Streams range from all-near
+ * (the common case in the weave phase) to half far events.
+ */
+static void Bench(uint64_t ops) {
+    static const uint32_t BB = 1024;
+    PrioQueue<PQEvent, BB>* pq = new PrioQueue<PQEvent, BB>();
+    RefPrioQueue<PQEvent, BB>* ref = new RefPrioQueue<PQEvent, BB>();
+    uint64_t pqCycle = 0, refCycle = 0;
+    uint64_t checksum = 0;
+
+    const uint32_t farPcts[] = {0, 1, 10, 50};
+    for (uint32_t liveEvents = 64; liveEvents <= 16384; liveEvents *= 16) {
+        for (uint32_t farPct : farPcts) {
+            // Record the stream: near delays within half the window, far ones up to 64x past it
+            MTRand rng(liveEvents + farPct);
+            std::vector<uint32_t> delays(liveEvents + ops);
+            for (uint32_t& delay : delays) {
+                delay = (rng.randInt(99) < farPct)? 64*BB + rng.randInt(64*64*BB) : rng.randInt(64*BB/2);
+            }
+
+            double pqSecs = Replay(*pq, liveEvents, delays, pqCycle, checksum);
+            double refSecs = Replay(*ref, liveEvents, delays, refCycle, checksum);
+            info("%5d live, %2d%% far:  PrioQueue %6.2f ns/op  multimap %6.2f ns/op  (%.2fx)",
+                    liveEvents, farPct, 1e9*pqSecs/ops, 1e9*refSecs/ops, refSecs/pqSecs);
+        }
+    }
+    info("checksum %ld", checksum);
+}
+
+int main(int argc, const char* argv[]) {
+    InitLog("[Q] ");
+    if (argc > 1 && strcmp(argv[1], "-b") == 0) {
+        if (argc > 3) {
+            info("Usage: %s -b [ops per stream]", argv[0]);
+            return 1;
+        }
+        gm_init(64 << 20);
+        Bench((argc > 2)? strtoul(argv[2], NULL, 0) : 10000000);
+        return 0;
+    }
+    if (argc > 3) {
+        info("Usage: %s [seeds] [steps per seed] | -b [ops per stream]", argv[0]);
+        return 1;
+    }
+    uint32_t seeds = (argc > 1)? strtoul(argv[1], NULL, 0) : 1000;
+    uint32_t steps = (argc > 2)? strtoul(argv[2], NULL, 0) : 200000;
+    gm_init(64 << 20);  // PrioQueue allocates far nodes in the global heap
+
+    // Streams reuse the same queues (PrioQueue never frees its node pool), starting where the last one drained
+    PrioQueue<PQEvent, B>* pq = new PrioQueue<PQEvent, B>();
+    RefPrioQueue<PQEvent, B>* ref = new RefPrioQueue<PQEvent, B>();
+    uint64_t cycle = 0;
+    uint64_t checked = 0;
+    for (uint32_t seed = 0; seed < seeds; seed++) {
+        uint32_t liveEvents = 1 << (4 + seed % 10);  // 16 to 8K
+        checked += RunStream(seed, liveEvents, steps, *pq, *ref, cycle);
+    }
+    info("%d seeds, %ld dequeues: identical to the reference queue", seeds, checked);
+    return 0;
+}
@@ -25,6 +25,7 @@
 
 #include "prefetcher.h"
 #include "bithacks.h"
+#include "checkpoint.h"
 
 //#define DBG(args...) info(args)
 #define DBG(args...)
@@ -56,11 +57,25 @@ void StreamPrefetcher::initStats(AggregateStat* parentStat) {
     parentStat->append(s);
 }
 
+void StreamPrefetcher::checkpointState(Checkpoint& ckpt) {
+    std::string prefix = name.c_str();
+    ckpt.value(prefix + ".timestamp", timestamp);
+    ckpt.value(prefix + ".tags", tag);
+    ckpt.value(prefix + ".streams", array);
+    if (ckpt.isRestoring()) {
+        // Cycles are from the checkpointed run; restored streams start with no prefetches in flight
+        for (Entry& e : array) {
+            e.lastCycle = 0;
+            for (auto& t : e.times) t.fill(0, 0);
+        }
+    }
+}
+
 uint64_t StreamPrefetcher::access(MemReq& req) {
     uint32_t origChildId = req.childId;
     req.childId = childId;
 
-    if (req.type != GETS) return parent->access(req); //other reqs ignored, including stores
+    if (req.type != GETS || req.is(MemReq::WARM)) return parent->access(req); //other reqs ignored, including stores and warming accesses
 
     profAccesses.inc();
 
@@ -183,8 +198,8 @@ uint64_t StreamPrefetcher::access(MemReq& req) {
 }
 
 // nop for now; do we need to invalidate our own state?
-uint64_t StreamPrefetcher::invalidate(Address lineAddr, InvType type, bool* reqWriteback, uint64_t reqCycle, uint32_t srcId) {
-    return child->invalidate(lineAddr, type, reqWriteback, reqCycle, srcId);
+uint64_t StreamPrefetcher::invalidate(Address lineAddr, InvType type, bool* reqWriteback, uint64_t reqCycle, uint32_t srcId, uint32_t flags) {
+    return child->invalidate(lineAddr, type, reqWriteback, reqCycle, srcId, flags);
 }
 
 
@@ -108,9 +108,10 @@ class StreamPrefetcher : public BaseCache {
         const char* getName() { return name.c_str();}
         void setParents(uint32_t _childId, const g_vector<MemObject*>& parents, Network* network);
         void setChildren(const g_vector<BaseCache*>& children, Network* network);
+        void checkpointState(Checkpoint& ckpt);
 
         uint64_t access(MemReq& req);
-        uint64_t invalidate(Address lineAddr, InvType type, bool* reqWriteback, uint64_t reqCycle, uint32_t srcId);
+        uint64_t invalidate(Address lineAddr, InvType type, bool* reqWriteback, uint64_t reqCycle, uint32_t srcId, uint32_t flags);
 };
 
 #endif  // PREFETCHER_H_
@@ -26,8 +26,27 @@
 #ifndef PRIO_QUEUE_H_
 #define PRIO_QUEUE_H_
 
-#include "g_std/g_multimap.h"
+#include <algorithm>
+#include "bithacks.h"
+#include "g_std/g_vector.h"
+#include "galloc.h"
 
+/* Calendar queue of intrusive (T::next) elements. The near window is B
+ * blocks of 64 1-cycle slots, indexed with a bitmap. Far elements (beyond the
+ * window) go into a coarser calendar of buckets, each as wide as a refill
+ * (B/2 blocks), and those beyond it into an unsorted overflow list. Since
+ * buckets and refills line up, each refill drains whole buckets and never
+ * rescans elements that are not due yet. The number of buckets grows with
+ * the number of far elements in the overflow list, so that the calendar
+ * covers how far ahead elements are actually scheduled. Far elements are
+ * held in pooled nodes, so enqueues never allocate once the pool and the
+ * calendar have warmed up.
+ *
+ * Elements due in the same cycle dequeue in the same order as if they had
+ * been held in a multimap (as in earlier versions): near slots are LIFO, and
+ * far elements move to their slots in insertion order, regardless of how
+ * overflow moves and calendar growth have shuffled them.
+ */
 template <typename T, uint32_t B>
 class PrioQueue {
     struct PQBlock {
@@ -62,16 +81,49 @@ class PrioQueue {
 
     PQBlock blocks[B];
 
-    typedef g_multimap<uint64_t, T*> FEMap; //far element map
-    typedef typename FEMap::iterator FEMapIterator;
+    struct FarNode {
+        uint64_t cycle;
+        uint64_t seq;  // insertion order
+        T* obj;
+        FarNode* next;
+    };
 
-    FEMap feMap;
+    static_assert(B >= 2 && (B & (B - 1)) == 0, "PrioQueue window must be a power of two");
+    static const uint32_t MIN_FAR_BUCKETS = 64;
+    static const uint32_t MAX_FAR_BUCKETS = 1 << 16;
+    static const uint32_t POOL_CHUNK = 256;  // far nodes allocated at once
+
+    FarNode** farBuckets;  // farBuckets[b % numFarBuckets] holds elements with cycle >> farBits == b, for b in [farBase, farBase + numFarBuckets)
+    uint32_t numFarBuckets;
+    uint32_t farBits;  // log2 of the refill width, B/2 blocks
+    uint64_t farBase;  // first bucket not yet drained
+    uint64_t farFirst;  // no far element is in a bucket before this one
+    FarNode* overflow;
+    uint64_t overflowElems;
+    uint64_t overflowMin;  // earliest overflow element, valid if overflowElems
+    FarNode* freeNodes;
+    uint64_t farElems;  // including overflow
+    uint64_t farMin;  // earliest far element, valid if farElems
+    uint64_t farSeq;
+    g_vector<FarNode*> dueNodes;  // far elements moving to blocks[] in the current refill
 
     uint64_t curBlock;
     uint64_t elems;
 
     public:
         PrioQueue() {
+            numFarBuckets = MIN_FAR_BUCKETS;
+            farBuckets = gm_calloc<FarNode*>(numFarBuckets);
+            farBits = ilog2((uint64_t)B*64/2);
+            farBase = 0;
+            farFirst = 0;
+            overflow = NULL;
+            overflowElems = 0;
+            overflowMin = 0;
+            freeNodes = NULL;
+            farElems = 0;
+            farMin = 0;
+            farSeq = 0;
             curBlock = 0;
             elems = 0;
         }
@@ -86,7 +138,18 @@ class PrioQueue {
                 blocks[i].enqueue(obj, offset);
             } else {
                 //info("XXX far enq() %ld", cycle);
-                feMap.insert(std::pair<uint64_t, T*>(cycle, obj));
+                if (!farElems) {
+                    // Refills stop while there are no far elements; catch up to the last one that would have happened
+                    farBase = curBlock/(B/2) + 2;
+                    farFirst = farBase;
+                }
+                farMin = farElems? MIN(farMin, cycle) : cycle;
+                farElems++;
+                FarNode* node = allocNode();
+                node->cycle = cycle;
+                node->seq = farSeq++;
+                node->obj = obj;
+                farInsert(node);
             }
             elems++;
         }
@@ -95,23 +158,8 @@ class PrioQueue {
             assert(elems);
             while (!blocks[curBlock % B].occ) {
                 curBlock++;
-                if ((curBlock % (B/2)) == 0 && !feMap.empty()) {
-                    uint64_t topCycle = (curBlock + B)*64;
-                    //Move every element with cycle < topCycle to blocks[]
-                    FEMapIterator it = feMap.begin();
-                    while (it != feMap.end() && it->first < topCycle) {
-                        uint64_t cycle = it->first;
-                        T* obj = it->second;
-
-                        uint64_t absBlock = cycle/64;
-                        assert(absBlock >= curBlock);
-                        assert(absBlock < curBlock + B);
-                        uint32_t i = absBlock % B;
-                        uint32_t offset = cycle % 64;
-                        blocks[i].enqueue(obj, offset);
-                        it++;
-                    }
-                    feMap.erase(feMap.begin(), it);
+                if ((curBlock % (B/2)) == 0 && farElems) {
+                    refill((curBlock + B)*64);
                 }
             }
 
@@ -142,13 +190,135 @@ class PrioQueue {
                 if (occ) {
                     uint64_t pos = __builtin_ctzl(occ);
                     uint64_t cycle = (curBlock + i)*64 + pos;
-                    return feMap.empty()? cycle : MIN(cycle, feMap.begin()->first);
+                    return farElems? MIN(cycle, farMin) : cycle;
+                }
+            }
+
+            assert(farElems);
+            return farMin;
+        }
+
+    private:
+        FarNode* allocNode() {
+            if (!freeNodes) {
+                FarNode* chunk = gm_calloc<FarNode>(POOL_CHUNK);
+                for (uint32_t i = 0; i < POOL_CHUNK; i++) {
+                    chunk[i].next = freeNodes;
+                    freeNodes = &chunk[i];
+                }
+            }
+            FarNode* node = freeNodes;
+            freeNodes = node->next;
+            return node;
+        }
+
+        inline void freeNode(FarNode* node) {
+            node->next = freeNodes;
+            freeNodes = node;
+        }
+
+        inline void farInsert(FarNode* node) {
+            uint64_t b = node->cycle >> farBits;
+            assert(b >= farBase);
+            FarNode** list;
+            if (b < farBase + numFarBuckets) {
+                list = &farBuckets[b % numFarBuckets];
+                farFirst = MIN(farFirst, b);
+            } else {
+                list = &overflow;
+                overflowMin = overflowElems? MIN(overflowMin, node->cycle) : node->cycle;
+                overflowElems++;
+            }
+            node->next = *list;
+            *list = node;
+        }
+
+        // Moves every far element with cycle < topCycle to blocks[]. topCycle is always a bucket boundary
+        void refill(uint64_t topCycle) {
+            uint64_t newBase = topCycle >> farBits;
+            assert(newBase << farBits == topCycle);
+            uint64_t endBucket = MIN(newBase, farBase + numFarBuckets);
+            for (uint64_t b = MAX(farBase, farFirst); b < endBucket; b++) {
+                for (FarNode* node = farBuckets[b % numFarBuckets]; node; node = node->next) dueNodes.push_back(node);
+                farBuckets[b % numFarBuckets] = NULL;
+            }
+            farBase = newBase;
+            farFirst = MAX(farFirst, farBase);
+
+            if (overflowElems > MAX(farElems/8, 8) && numFarBuckets < MAX_FAR_BUCKETS) {
+                // Many far elements are beyond the calendar; double it
+                grow(topCycle);
+            } else if (overflowElems && (overflowMin >> farBits) < farBase + numFarBuckets) {
+                // The calendar now covers some overflow elements
+                FarNode* node = overflow;
+                overflow = NULL;
+                overflowElems = 0;
+                while (node) {
+                    FarNode* next = node->next;
+                    if (node->cycle < topCycle) dueNodes.push_back(node);
+                    else farInsert(node);
+                    node = next;
+                }
+            }
+
+            // Buckets hold nodes newest first unless overflow moves or growth reordered them
+            auto newerFirst = [](const FarNode* a, const FarNode* b) {return a->seq > b->seq;};
+            if (!std::is_sorted(dueNodes.begin(), dueNodes.end(), newerFirst)) {
+                std::sort(dueNodes.begin(), dueNodes.end(), newerFirst);
+            }
+            for (auto it = dueNodes.rbegin(); it != dueNodes.rend(); ++it) moveNear(*it);
+            dueNodes.clear();
+
+            if (farElems && farMin < topCycle) {
+                // The earliest far element moved; the next one is in the first non-empty bucket, or in the overflow list
+                uint64_t endFar = farBase + numFarBuckets;
+                while (farFirst < endFar && !farBuckets[farFirst % numFarBuckets]) farFirst++;
+                if (farFirst < endFar) {
+                    FarNode* list = farBuckets[farFirst % numFarBuckets];
+                    farMin = list->cycle;
+                    for (FarNode* node = list->next; node; node = node->next) farMin = MIN(farMin, node->cycle);
+                } else {
+                    assert(overflowElems);
+                    farMin = overflowMin;
                 }
             }
+        }
 
-            return feMap.begin()->first;
+        // Doubles the number of buckets, redistributing all far elements (due ones go to dueNodes)
+        void grow(uint64_t topCycle) {
+            FarNode* all = overflow;
+            overflow = NULL;
+            overflowElems = 0;
+            for (uint32_t i = 0; i < numFarBuckets; i++) {
+                FarNode* node = farBuckets[i];
+                while (node) {
+                    FarNode* next = node->next;
+                    node->next = all;
+                    all = node;
+                    node = next;
+                }
+            }
+
+            gm_free(farBuckets);
+            numFarBuckets *= 2;
+            farBuckets = gm_calloc<FarNode*>(numFarBuckets);
+            farFirst = farBase + numFarBuckets;
+            while (all) {
+                FarNode* next = all->next;
+                if (all->cycle < topCycle) dueNodes.push_back(all);
+                else farInsert(all);
+                all = next;
+            }
+        }
+
+        inline void moveNear(FarNode* node) {
+            uint64_t absBlock = node->cycle/64;
+            assert(absBlock >= curBlock);
+            assert(absBlock < curBlock + B);
+            blocks[absBlock % B].enqueue(node->obj, node->cycle % 64);
+            farElems--;
+            freeNode(node);
         }
 };
 
 #endif  // PRIO_QUEUE_H_
-
@@ -28,10 +28,13 @@
 #include <stdlib.h>
 #include <string>
 #include <vector>
+#include "bithacks.h"
 #include "config.h"
 #include "constants.h"
 #include "event_queue.h"
 #include "process_stats.h"
+#include "sampled_stats.h"
+#include "simpoint.h"
 #include "stats.h"
 #include "zsim.h"
 
@@ -184,6 +187,67 @@ static void PopulateLevel(Config& config, const std::string& prefix, std::vector
         g_string syscallBlacklistRegex = config.get<const char*>(p_ss.str() +  ".syscallBlacklistRegex", ".*");
         g_vector<bool> mask(ParseMask(config.get<const char*>(p_ss.str() +  ".mask", DefaultMaskStr().c_str()), zinfo->numCores));
         g_vector<uint64_t> ffiPoints(ParseList<uint64_t>(config.get<const char*>(p_ss.str() +  ".ffiPoints", "")));
+        bool recordTrace = config.get<bool>(p_ss.str() +  ".recordTrace", false);
+        g_string replayTrace = config.get<const char*>(p_ss.str() +  ".replayTrace", "");
+        if (recordTrace && !replayTrace.empty()) panic("process%d: recordTrace and replayTrace are mutually exclusive", idx);
+        uint64_t bbvInterval = config.get<uint64_t>(p_ss.str() +  ".bbvInterval", 0);
+        uint32_t bbvDims = config.get<uint32_t>(p_ss.str() +  ".bbvDims", 15);
+        uint32_t simpointsMaxK = config.get<uint32_t>(p_ss.str() +  ".simpointsMaxK", 30);
+        if (bbvInterval) {
+            if (zinfo->ffReinstrument) panic("process%d: BBV profiling needs fast-forwarded code to be instrumented, so it is incompatible with sim.ffReinstrument", idx);
+            if (!bbvDims) panic("process%d: bbvDims must be > 0", idx);
+        }
+
+        //Sampled simulation: simulate only the samples in this simpoints file, see sampled_stats.h
+        string simpointsFile = config.get<const char*>(p_ss.str() +  ".simpoints", "");
+        uint64_t sampleWarmupInstrs = config.get<uint64_t>(p_ss.str() +  ".sampleWarmupInstrs", 0);
+        uint64_t sampleFunctionalWarmupInstrs = config.get<uint64_t>(p_ss.str() +  ".sampleFunctionalWarmupInstrs", 0);
+        uint64_t sampleTotalInstrs = config.get<uint64_t>(p_ss.str() +  ".sampleTotalInstrs", 0);
+        SampledStatsBackend* sampler = NULL;
+        if (!simpointsFile.empty()) {
+            if (!ffiPoints.empty()) panic("process%d: simpoints and ffiPoints are mutually exclusive (sampling sets ffiPoints)", idx);
+            if (zinfo->sampledStatsBackend) panic("process%d: only one process can run sampled simulation", idx);
+            if (sampleFunctionalWarmupInstrs && !zinfo->ffWarming) panic("process%d: sampleFunctionalWarmupInstrs needs sim.ffWarming", idx);
+            if (!startFastForwarded) {
+                info("process%d: sampled simulation, starting fast-forwarded", idx);
+                startFastForwarded = true;
+            }
+            g_vector<uint64_t> starts, lengths;
+            g_vector<double> weights;
+            for (const SimPoint& sp : ReadSimPoints(simpointsFile.c_str())) {
+                starts.push_back(sp.start);
+                lengths.push_back(sp.length);
+                weights.push_back(sp.weight);
+            }
+            const char* sampledStatsFile = gm_strdup((string(zinfo->outputDir) + "/zsim-sampled.out").c_str());
+            sampler = new SampledStatsBackend(sampledStatsFile, zinfo->rootStat, starts, lengths, weights, sampleWarmupInstrs, sampleFunctionalWarmupInstrs, sampleTotalInstrs);
+            ffiPoints = sampler->getFFIPoints();
+            zinfo->sampledStatsBackend = sampler;
+            info("process%d: sampled simulation, %d samples from %s, %ld warmup instrs, %ld functional warmup instrs%s", idx, sampler->getNumSamples(), simpointsFile.c_str(),
+                    sampleWarmupInstrs, sampleFunctionalWarmupInstrs, (zinfo->ffWarming && !sampleFunctionalWarmupInstrs)? " (all fast-forwarded)" : "");
+        }
+
+        //Page size, used by TLBs and page walks (there are no OS page tables, so all of the process's memory uses one size)
+        uint64_t pageSize = config.get<uint64_t>(p_ss.str() +  ".pageSize", 4096);
+        if (pageSize != (1ul << 12) && pageSize != (1ul << 21) && pageSize != (1ul << 30)) {
+            panic("process%d: pageSize must be 4096 (4KB), 2097152 (2MB), or 1073741824 (1GB), %ld given", idx, pageSize);
+        }
+        uint32_t pageBits = ilog2(pageSize);
+
+        //NUMA placement of the process's pages (see page_alloc.h)
+        string numaPolicyStr = config.get<const char*>(p_ss.str() +  ".numaPolicy", "firstTouch");
+        uint32_t numaNode = config.get<uint32_t>(p_ss.str() +  ".numaNode", 0);
+        NUMAPolicy numaPolicy;
+        if (numaPolicyStr == "firstTouch") numaPolicy = NUMA_FIRST_TOUCH;
+        else if (numaPolicyStr == "interleave") numaPolicy = NUMA_INTERLEAVE;
+        else if (numaPolicyStr == "bind") numaPolicy = NUMA_BIND;
+        else panic("process%d: Invalid numaPolicy %s (firstTouch, interleave, or bind)", idx, numaPolicyStr.c_str());
+        if (zinfo->pageAllocator) {
+            if (pageBits > 21) panic("process%d: the page allocator supports 4KB and 2MB pages only", idx);
+            if (numaPolicy == NUMA_BIND && numaNode >= zinfo->pageAllocator->getNumNodes()) panic("process%d: Invalid numaNode %d", idx, numaNode);
+        } else if (numaPolicy != NUMA_FIRST_TOUCH) {
+            panic("process%d: numaPolicy needs sys.pageAllocator.enabled", idx);
+        }
 
         if (dumpInstrs) {
             if (dumpHeartbeats || dumpCycles) warn("Dumping eventual stats on two different conditions; you won't be able to distinguish both!");
@@ -202,7 +266,7 @@ static void PopulateLevel(Config& config, const std::string& prefix, std::vector
         if (clockDomain >= MAX_CLOCK_DOMAINS) panic("Invalid clock domain %d", clockDomain);
         if (portDomain >= MAX_PORT_DOMAINS) panic("Invalid port domain %d", portDomain);
 
-        ProcessTreeNode* ptn = new ProcessTreeNode(procIdx, groupIdx, startFastForwarded, startPaused, syncedFastForward, clockDomain, portDomain, dumpHeartbeats, dumpsResetHeartbeats, restarts, mask, ffiPoints, syscallBlacklistRegex, gpr);
+        ProcessTreeNode* ptn = new ProcessTreeNode(procIdx, groupIdx, startFastForwarded, startPaused, syncedFastForward, clockDomain, portDomain, dumpHeartbeats, dumpsResetHeartbeats, restarts, mask, ffiPoints, syscallBlacklistRegex, gpr, recordTrace, replayTrace, bbvInterval, bbvDims, simpointsMaxK, sampler, pageBits, numaPolicy, numaNode);
         //info("Created ProcessTreeNode, procIdx %d", procIdx);
         parent->addChild(ptn);
         children.push_back(ptn);
@@ -224,7 +288,7 @@ static void PopulateLevel(Config& config, const std::string& prefix, std::vector
 }
 
 void CreateProcessTree(Config& config) {
-    ProcessTreeNode* rootNode = new ProcessTreeNode(-1, -1, false, false, false, 0, 0, 0, false, 0, g_vector<bool> {},  g_vector<uint64_t> {}, g_string {}, NULL);
+    ProcessTreeNode* rootNode = new ProcessTreeNode(-1, -1, false, false, false, 0, 0, 0, false, 0, g_vector<bool> {},  g_vector<uint64_t> {}, g_string {}, NULL, false, g_string {}, 0, 0, 0, NULL, 12, NUMA_FIRST_TOUCH, 0);
     uint32_t procIdx = 0;
     uint32_t groupIdx = 0;
     std::vector<ProcessTreeNode*> globProcVector;
@@ -30,9 +30,11 @@
 #include "g_std/g_vector.h"
 #include "galloc.h"
 #include "log.h"
+#include "page_alloc.h"
 #include "zsim.h"
 
 class Config;
+class SampledStatsBackend;
 
 class ProcessTreeNode : public GlobAlloc {
     private:
@@ -54,13 +56,25 @@ class ProcessTreeNode : public GlobAlloc {
         const g_vector<bool> mask;
         const g_vector<uint64_t> ffiPoints;
         const g_string syscallBlacklistRegex;
+        const bool recordTrace; //if true, each simulated thread writes a BBL trace (see bbl_trace.h)
+        const g_string replayTrace; //if non-empty, the process replays this trace instead of its own execution
+        const uint64_t bbvInterval; //if non-zero, fast-forwarded threads profile BBVs over intervals of this many instrs (see simpoint.h)
+        const uint32_t bbvDims;
+        const uint32_t simpointsMaxK;
+        SampledStatsBackend* const sampler; //if non-NULL, the process runs sampled simulation (see sampled_stats.h)
+        const uint32_t pageBits; //log2 of the page size backing the process's memory (see tlb.h)
+        const NUMAPolicy numaPolicy; //placement of the process's pages, if the page allocator is enabled (see page_alloc.h)
+        const uint32_t numaNode; //for NUMA_BIND
 
     public:
         ProcessTreeNode(uint32_t _procIdx, uint32_t _groupIdx, bool _inFastForward, bool _inPause, bool _syncedFastForward,
                         uint32_t _clockDomain, uint32_t _portDomain, uint64_t _dumpHeartbeats, bool _dumpsResetHeartbeats, uint32_t _restarts,
-                        const g_vector<bool>& _mask, const g_vector<uint64_t>& _ffiPoints, const g_string& _syscallBlacklistRegex, const char*_patchRoot)
+                        const g_vector<bool>& _mask, const g_vector<uint64_t>& _ffiPoints, const g_string& _syscallBlacklistRegex, const char*_patchRoot,
+                        bool _recordTrace, const g_string& _replayTrace, uint64_t _bbvInterval, uint32_t _bbvDims, uint32_t _simpointsMaxK,
+                        SampledStatsBackend* _sampler, uint32_t _pageBits, NUMAPolicy _numaPolicy, uint32_t _numaNode)
             : patchRoot(_patchRoot), procIdx(_procIdx), groupIdx(_groupIdx), curChildren(0), heartbeats(0), started(false), inFastForward(_inFastForward),
-              inPause(_inPause), restartsLeft(_restarts), syncedFastForward(_syncedFastForward), clockDomain(_clockDomain), portDomain(_portDomain), dumpHeartbeats(_dumpHeartbeats), dumpsResetHeartbeats(_dumpsResetHeartbeats), mask(_mask), ffiPoints(_ffiPoints), syscallBlacklistRegex(_syscallBlacklistRegex) {}
+              inPause(_inPause), restartsLeft(_restarts), syncedFastForward(_syncedFastForward), clockDomain(_clockDomain), portDomain(_portDomain), dumpHeartbeats(_dumpHeartbeats), dumpsResetHeartbeats(_dumpsResetHeartbeats), mask(_mask), ffiPoints(_ffiPoints), syscallBlacklistRegex(_syscallBlacklistRegex),
+              recordTrace(_recordTrace), replayTrace(_replayTrace), bbvInterval(_bbvInterval), bbvDims(_bbvDims), simpointsMaxK(_simpointsMaxK), sampler(_sampler), pageBits(_pageBits), numaPolicy(_numaPolicy), numaNode(_numaNode) {}
 
         void addChild(ProcessTreeNode* child) {
             children.push_back(child);
@@ -136,6 +150,22 @@ class ProcessTreeNode : public GlobAlloc {
             return syscallBlacklistRegex;
         }
 
+        bool getRecordTrace() const {
+            return recordTrace;
+        }
+
+        const g_string& getReplayTrace() const {
+            return replayTrace;
+        }
+
+        uint64_t getBBVInterval() const { return bbvInterval; }
+        uint32_t getBBVDims() const { return bbvDims; }
+        uint32_t getSimPointsMaxK() const { return simpointsMaxK; }
+        SampledStatsBackend* getSampler() const { return sampler; }
+        uint32_t getPageBits() const { return pageBits; }
+        NUMAPolicy getNUMAPolicy() const { return numaPolicy; }
+        uint32_t getNUMANode() const { return numaNode; }
+
         //Currently there's no API to get back to a paused state; processes can start in a paused state, but once they are unpaused, they are unpaused for good
 };
 
@@ -54,6 +54,11 @@ class ReplPolicy : public GlobAlloc {
         virtual uint32_t rankCands(const MemReq* req, ZCands cands) = 0;
 
         virtual void initStats(AggregateStat* parent) {}
+
+        //Saves or restores per-line replacement state (see checkpoint.h); replacement-in-progress state is not saved
+        virtual void checkpointState(Checkpoint& ckpt, const std::string& prefix) {
+            panic("%s: replacement policy does not support checkpoints", prefix.c_str());
+        }
 };
 
 /* Add DECL_RANK_BINDINGS to each class that implements the new interface,
@@ -118,6 +123,11 @@ class LRUReplPolicy : public ReplPolicy {
             array[id] = 0;
         }
 
+        void checkpointState(Checkpoint& ckpt, const std::string& prefix) {
+            ckpt.value(prefix + ".timestamp", timestamp);
+            ckpt.array(prefix + ".lines", array, numLines);
+        }
+
         template <typename C> inline uint32_t rank(const MemReq* req, C cands) {
             uint32_t bestCand = -1;
             uint64_t bestScore = (uint64_t)-1L;
@@ -249,6 +259,11 @@ class NRUReplPolicy : public LegacyReplPolicy {
             candIdx = 0;
             array[id] = 0;
         }
+
+        void checkpointState(Checkpoint& ckpt, const std::string& prefix) {
+            ckpt.value(prefix + ".youngLines", youngLines);
+            ckpt.array(prefix + ".lines", array, numLines);
+        }
 };
 
 class RandReplPolicy : public LegacyReplPolicy {
@@ -286,6 +301,8 @@ class RandReplPolicy : public LegacyReplPolicy {
         void replaced(uint32_t id) {
             candIdx = 0;
         }
+
+        void checkpointState(Checkpoint& ckpt, const std::string& prefix) {} //no per-line state; the RNG keeps its own seed
 };
 
 class LFUReplPolicy : public LegacyReplPolicy {
@@ -370,6 +387,11 @@ class LFUReplPolicy : public LegacyReplPolicy {
             bestRank.reset();
             array[id].acc = 0;
         }
+
+        void checkpointState(Checkpoint& ckpt, const std::string& prefix) {
+            ckpt.value(prefix + ".timestamp", timestamp);
+            ckpt.array(prefix + ".lines", array, numLines);
+        }
 };
 
 //Extends a given replacement policy to profile access ordering violations
@@ -0,0 +1,178 @@
+/** $lic$
+ * Copyright (C) 2012-2014 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "sampled_stats.h"
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include "log.h"
+
+#define CI_Z 1.96  // 95% confidence intervals
+
+SampledStatsBackend::SampledStatsBackend(const char* _filename, AggregateStat* _rootStat, const g_vector<uint64_t>& starts,
+        const g_vector<uint64_t>& lengths, const g_vector<double>& weights, uint64_t warmupInstrs, uint64_t functionalWarmupInstrs, uint64_t _totalInstrs)
+    : filename(_filename), rootStat(_rootStat), totalInstrs(_totalInstrs), startInstrs(0), curSample(-1)
+{
+    assert(starts.size() == lengths.size() && starts.size() == weights.size());
+    if (starts.empty()) panic("Sampled simulation needs at least one sample");
+    uint64_t prevEnd = 0;
+    for (uint32_t i = 0; i < starts.size(); i++) {
+        if (starts[i] < prevEnd) panic("Sample %d (start %ld) overlaps the previous one (end %ld); samples must be sorted and disjoint", i, starts[i], prevEnd);
+        if (!lengths[i]) panic("Sample %d has zero length", i);
+        Sample s = {starts[i], lengths[i], std::min(warmupInstrs, starts[i] - prevEnd), 0, weights[i]};
+        if (s.warmup < warmupInstrs) info("Sample %d: warmup shortened to %ld instrs, too close to the %s", i, s.warmup, i? "previous sample" : "start");
+        uint64_t ffInstrs = starts[i] - s.warmup - prevEnd;
+        s.ffWarmup = functionalWarmupInstrs? std::min(functionalWarmupInstrs, ffInstrs) : ffInstrs;
+        samples.push_back(s);
+        prevEnd = starts[i] + lengths[i];
+    }
+}
+
+g_vector<uint64_t> SampledStatsBackend::getFFIPoints() const {
+    g_vector<uint64_t> res;
+    uint64_t prevEnd = 0;
+    for (const Sample& s : samples) {
+        res.push_back(s.start - s.warmup - prevEnd); //fast-forward
+        res.push_back(s.warmup + s.length); //simulate
+        prevEnd = s.start + s.length;
+    }
+    return res;
+}
+
+void SampledStatsBackend::flattenStats(Stat* s, const g_string& prefix) {
+    g_string name = prefix.empty()? g_string(s->name()) : prefix + "." + s->name();
+    if (AggregateStat* as = dynamic_cast<AggregateStat*>(s)) {
+        for (uint32_t i = 0; i < as->size(); i++) flattenStats(as->get(i), name);
+    } else if (VectorStat* vs = dynamic_cast<VectorStat*>(s)) {
+        for (uint32_t i = 0; i < vs->size(); i++) {
+            char idxStr[16];
+            snprintf(idxStr, sizeof(idxStr), "%d", i);
+            StatRef ref = {s, i, name + "." + (vs->hasCounterNames()? vs->counterName(i) : idxStr)};
+            stats.push_back(ref);
+        }
+    } else if (dynamic_cast<Counter*>(s) || dynamic_cast<ScalarStat*>(s) || dynamic_cast<ProxyStat*>(s) || dynamic_cast<ProxyFuncStat*>(s)) {
+        StatRef ref = {s, 0, name};
+        stats.push_back(ref);
+    } //other stats (e.g., histograms) are not sampled
+}
+
+void SampledStatsBackend::readStats(g_vector<uint64_t>& values) {
+    if (stats.empty()) flattenStats(rootStat, "");
+    values.resize(stats.size());
+    for (uint32_t i = 0; i < stats.size(); i++) {
+        Stat* s = stats[i].s;
+        if (Counter* cs = dynamic_cast<Counter*>(s)) {
+            values[i] = cs->count();
+        } else if (ScalarStat* ss = dynamic_cast<ScalarStat*>(s)) {
+            values[i] = ss->get();
+        } else if (VectorStat* vs = dynamic_cast<VectorStat*>(s)) {
+            values[i] = vs->count(stats[i].idx);
+        } else if (ProxyStat* ps = dynamic_cast<ProxyStat*>(s)) {
+            values[i] = ps->stat();
+        } else if (ProxyFuncStat* pfs = dynamic_cast<ProxyFuncStat*>(s)) {
+            values[i] = pfs->stat();
+        } else {
+            panic("Unrecognized stat type");
+        }
+    }
+}
+
+void SampledStatsBackend::beginSample(uint32_t sample, uint64_t instrs) {
+    if (curSample != -1) {
+        warn("Sample %d starting while sample %d is still running, dropping the latter", sample, curSample);
+    }
+    info("Sample %d/%ld: warmup done, starting detailed window", sample, samples.size());
+    readStats(startValues);
+    startInstrs = instrs;
+    curSample = sample;
+}
+
+void SampledStatsBackend::endSample(uint32_t sample, uint64_t instrs) {
+    if (curSample != (int32_t)sample) {
+        //Only happens if warmup + sample took a single phase; the sample is too short to be meaningful anyhow
+        warn("Sample %d ended before its warmup did, dropping it", sample);
+        curSample = -1;
+        return;
+    }
+    g_vector<uint64_t> endValues;
+    readStats(endValues);
+    g_vector<uint64_t> deltas(stats.size());
+    for (uint32_t i = 0; i < stats.size(); i++) deltas[i] = endValues[i] - startValues[i];
+
+    doneSamples.push_back(sample);
+    doneInstrs.push_back(instrs - startInstrs);
+    doneDeltas.push_back(deltas);
+    curSample = -1;
+    info("Sample %d/%ld done, %ld instrs (%ld requested)", sample, samples.size(), instrs - startInstrs, samples[sample].length);
+}
+
+void SampledStatsBackend::dump(bool buffered) {
+    FILE* f = fopen(filename, "w");
+    if (!f) panic("Could not open %s for writing", filename);
+
+    uint32_t n = doneSamples.size();
+    double totalWeight = 0.0;
+    double doneWeight = 0.0;
+    for (const Sample& s : samples) totalWeight += s.weight;
+    fprintf(f, "# zsim sampled stats\n# %d/%ld samples done\n", n, samples.size());
+    fprintf(f, "# sample start length warmup weight simInstrs\n");
+    for (uint32_t i = 0; i < n; i++) {
+        const Sample& s = samples[doneSamples[i]];
+        fprintf(f, "# %d %ld %ld %ld %.6f %ld\n", doneSamples[i], s.start, s.length, s.warmup, s.weight, doneInstrs[i]);
+        doneWeight += s.weight;
+    }
+    if (!n || doneWeight <= 0.0) {
+        fprintf(f, "# no samples, no estimates\n");
+        fclose(f);
+        return;
+    }
+    if (doneWeight < totalWeight) warn("Sampled stats: only %.1f%% of the sample weight completed", 100.0*doneWeight/totalWeight);
+
+    double scale = totalInstrs? totalInstrs : 1000.0;
+    fprintf(f, "# coverage %.4f of sample weight\n", doneWeight/totalWeight);
+    fprintf(f, "# estimates: %s, with %.0f%% CI half-widths\n", totalInstrs? "whole-program totals" : "per 1000 instructions", 95.0);
+
+    // Weighted mean and variance of per-instruction rates, with weights normalized to the completed samples
+    g_vector<double> w(n);
+    for (uint32_t i = 0; i < n; i++) w[i] = samples[doneSamples[i]].weight/doneWeight;
+    for (uint32_t s = 0; s < stats.size(); s++) {
+        double mean = 0.0;
+        for (uint32_t i = 0; i < n; i++) mean += w[i]*doneDeltas[i][s]/std::max(doneInstrs[i], (uint64_t)1);
+        double var = 0.0;
+        for (uint32_t i = 0; i < n; i++) {
+            double d = ((double)doneDeltas[i][s])/std::max(doneInstrs[i], (uint64_t)1) - mean;
+            var += w[i]*w[i]*d*d;
+        }
+        if (n > 1) var *= ((double)n)/(n - 1);
+        double est = mean*scale;
+        double hw = CI_Z*sqrt(var)*scale;
+        if (n > 1) {
+            fprintf(f, "%s: %.6g +- %.3g (%.2f%%)\n", stats[s].name.c_str(), est, hw, est? 100.0*hw/est : 0.0);
+        } else {
+            fprintf(f, "%s: %.6g\n", stats[s].name.c_str(), est);
+        }
+    }
+    fclose(f);
+}
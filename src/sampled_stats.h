@@ -0,0 +1,109 @@
+/** $lic$
+ * Copyright (C) 2012-2014 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SAMPLED_STATS_H_
+#define SAMPLED_STATS_H_
+
+/* Sampled simulation (as in SimPoint or SMARTS): the process fast-forwards
+ * between a set of weighted samples, and simulates each one in detail after
+ * a warmup window. Sampling is built on FFI: the samples are turned into the
+ * process's ffiPoints (alternating fast-forward and simulated lengths, with
+ * each simulated length covering warmup + sample), and FFI notifies this
+ * backend when each warmup and sample ends. With sim.ffWarming, caches and
+ * predictors are also warmed functionally while fast-forwarding, so the
+ * (detailed) warmup window only needs to cover short-lived state. Functional
+ * warming is much slower than plain fast-forwarding, so it can be limited to
+ * the last functionalWarmupInstrs of each fast-forward interval, right before
+ * the detailed warmup (0, the default, warms whole intervals).
+ *
+ * The backend snapshots every scalar and vector stat at the start and end of
+ * each sample (start is after warmup), and on dump writes, for each stat,
+ * its whole-program estimate: the weighted mean of the per-instruction rates
+ * of all completed samples, extrapolated to the program's instructions, with
+ * a 95% confidence interval. The CI treats the samples as a weighted random
+ * sample of the program's intervals; with one representative per phase (as
+ * SimPoint picks) it is an approximation, as variation within each phase is
+ * not captured.
+ */
+
+#include "g_std/g_string.h"
+#include "g_std/g_vector.h"
+#include "stats.h"
+
+class SampledStatsBackend : public StatsBackend {
+    private:
+        struct Sample {
+            uint64_t start; //in process instructions
+            uint64_t length;
+            uint64_t warmup; //may be shorter than requested if the previous sample is close
+            uint64_t ffWarmup; //functional warmup, at the end of the fast-forward interval before warmup
+            double weight;
+        };
+
+        const char* filename;
+        AggregateStat* rootStat;
+        g_vector<Sample> samples;
+        const uint64_t totalInstrs; //0 if unknown; then estimates are per 1000 instructions
+
+        // Flattened stats, built on first use (stats are immutable by then)
+        struct StatRef {
+            Stat* s;
+            uint32_t idx; //for vector stats
+            g_string name;
+        };
+        g_vector<StatRef> stats;
+
+        g_vector<uint64_t> startValues;
+        uint64_t startInstrs;
+        int32_t curSample; //-1 if not in a sample
+
+        // Per completed sample
+        g_vector<uint32_t> doneSamples;
+        g_vector<uint64_t> doneInstrs;
+        g_vector<g_vector<uint64_t>> doneDeltas;
+
+    public:
+        SampledStatsBackend(const char* _filename, AggregateStat* _rootStat, const g_vector<uint64_t>& starts, const g_vector<uint64_t>& lengths,
+                const g_vector<double>& weights, uint64_t warmupInstrs, uint64_t functionalWarmupInstrs, uint64_t _totalInstrs);
+
+        // The ffiPoints that drive the process through all samples
+        g_vector<uint64_t> getFFIPoints() const;
+
+        uint32_t getNumSamples() const { return samples.size(); }
+        uint64_t getWarmup(uint32_t sample) const { return samples[sample].warmup; }
+        uint64_t getFunctionalWarmup(uint32_t sample) const { return samples[sample].ffWarmup; }
+
+        // Called at phase ends, with the process's simulated instructions
+        void beginSample(uint32_t sample, uint64_t instrs);
+        void endSample(uint32_t sample, uint64_t instrs);
+
+        virtual void dump(bool buffered);
+
+    private:
+        void flattenStats(Stat* s, const g_string& prefix);
+        void readStats(g_vector<uint64_t>& values);
+};
+
+#endif  // SAMPLED_STATS_H_
@@ -25,6 +25,7 @@
 
 #include "simple_core.h"
 #include "filter_cache.h"
+#include "tlb.h"
 #include "zsim.h"
 
 SimpleCore::SimpleCore(FilterCache* _l1i, FilterCache* _l1d, g_string& _name) : Core(_name), l1i(_l1i), l1d(_l1d), instrs(0), curCycle(0), haltedCycles(0) {
@@ -40,6 +41,7 @@ void SimpleCore::initStats(AggregateStat* parentStat) {
     instrsStat->init("instrs", "Simulated instructions", &instrs);
     coreStat->append(cyclesStat);
     coreStat->append(instrsStat);
+    if (mmu) mmu->initStats(coreStat);
     parentStat->append(coreStat);
 }
 
@@ -48,10 +50,12 @@ uint64_t SimpleCore::getPhaseCycles() const {
 }
 
 void SimpleCore::load(Address addr) {
+    if (mmu) curCycle = mmu->translate(addr, curCycle, [this](Address pteAddr, uint64_t cycle) { return l1d->load(pteAddr, cycle); });
     curCycle = l1d->load(addr, curCycle);
 }
 
 void SimpleCore::store(Address addr) {
+    if (mmu) curCycle = mmu->translate(addr, curCycle, [this](Address pteAddr, uint64_t cycle) { return l1d->load(pteAddr, cycle); });
     curCycle = l1d->store(addr, curCycle);
 }
 
@@ -67,6 +71,23 @@ void SimpleCore::bbl(Address bblAddr, BblInfo* bblInfo) {
     }
 }
 
+void SimpleCore::warmBbl(ADDRINT bblAddr, BblInfo* bblInfo) {
+    Address endBblAddr = bblAddr + bblInfo->bytes;
+    for (Address fetchAddr = bblAddr; fetchAddr < endBblAddr; fetchAddr+=(1 << lineBits)) {
+        l1i->warm(fetchAddr, true);
+    }
+}
+
+void SimpleCore::warmLoad(ADDRINT addr) {
+    if (mmu) mmu->warm(addr, [this](Address pteAddr) { l1d->warm(pteAddr, true); });
+    l1d->warm(addr, true);
+}
+
+void SimpleCore::warmStore(ADDRINT addr) {
+    if (mmu) mmu->warm(addr, [this](Address pteAddr) { l1d->warm(pteAddr, true); });
+    l1d->warm(addr, false);
+}
+
 void SimpleCore::contextSwitch(int32_t gid) {
     if (gid == -1) {
         l1i->contextSwitch();
@@ -57,6 +57,10 @@ class SimpleCore : public Core {
 
         InstrFuncPtrs GetFuncPtrs();
 
+        void warmBbl(ADDRINT bblAddr, BblInfo* bblInfo);
+        void warmLoad(ADDRINT addr);
+        void warmStore(ADDRINT addr);
+
     protected:
         //Simulation functions
         inline void load(Address addr);
@@ -0,0 +1,303 @@
+/** $lic$
+ * Copyright (C) 2012-2014 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "simpoint.h"
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#define KMEANS_SEEDS 5  // k-means runs per k, keeping the one with the lowest distortion
+#define KMEANS_MAX_ITERS 100
+#define BIC_THRESHOLD 0.9  // pick the smallest k whose BIC is within 90% of the best one's (as SimPoint does)
+
+/* Clustering */
+
+// Deterministic 64-bit mixer (splitmix64), used both for projection and k-means seeding
+static inline uint64_t Mix(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ul;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ul;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebul;
+    return x ^ (x >> 31);
+}
+
+static inline double Dist2(const float* a, const double* b, uint32_t dims) {
+    double d = 0.0;
+    for (uint32_t i = 0; i < dims; i++) {
+        double x = a[i] - b[i];
+        d += x*x;
+    }
+    return d;
+}
+
+// One k-means run with k-means++ seeding. Returns the distortion (sum of squared distances to the centroids).
+static double KMeans(const std::vector<float>& x, uint32_t n, uint32_t dims, uint32_t k, uint64_t seed,
+        std::vector<uint32_t>& assign, std::vector<double>& centers)
+{
+    uint64_t rng = seed;
+    auto rand01 = [&rng]() { rng = Mix(rng); return (rng >> 11) * (1.0/9007199254740992.0); };
+
+    // k-means++ seeding
+    centers.assign(k*dims, 0.0);
+    std::vector<double> minDist(n, DBL_MAX);
+    uint32_t c = rng % n;
+    for (uint32_t j = 0; j < k; j++) {
+        for (uint32_t i = 0; i < dims; i++) centers[j*dims + i] = x[c*dims + i];
+        double total = 0.0;
+        for (uint32_t p = 0; p < n; p++) {
+            minDist[p] = std::min(minDist[p], Dist2(&x[p*dims], &centers[j*dims], dims));
+            total += minDist[p];
+        }
+        if (total == 0.0) {
+            // Fewer distinct points than clusters; duplicate centers just end up empty
+            c = 0;
+            continue;
+        }
+        double r = rand01()*total;
+        for (c = 0; c < n - 1; c++) {
+            r -= minDist[c];
+            if (r <= 0.0) break;
+        }
+    }
+
+    // Lloyd iterations
+    assign.assign(n, k);  // invalid, so the first iteration always changes
+    std::vector<uint32_t> counts(k);
+    double distortion = 0.0;
+    for (uint32_t iter = 0; iter < KMEANS_MAX_ITERS; iter++) {
+        bool changed = false;
+        distortion = 0.0;
+        for (uint32_t p = 0; p < n; p++) {
+            uint32_t best = 0;
+            double bestDist = DBL_MAX;
+            for (uint32_t j = 0; j < k; j++) {
+                double d = Dist2(&x[p*dims], &centers[j*dims], dims);
+                if (d < bestDist) {
+                    bestDist = d;
+                    best = j;
+                }
+            }
+            if (assign[p] != best) {
+                assign[p] = best;
+                changed = true;
+            }
+            distortion += bestDist;
+        }
+        if (!changed) break;
+
+        std::fill(centers.begin(), centers.end(), 0.0);
+        std::fill(counts.begin(), counts.end(), 0);
+        for (uint32_t p = 0; p < n; p++) {
+            counts[assign[p]]++;
+            for (uint32_t i = 0; i < dims; i++) centers[assign[p]*dims + i] += x[p*dims + i];
+        }
+        for (uint32_t j = 0; j < k; j++) {
+            if (!counts[j]) continue;  // empty clusters keep a zero center, which is harmless
+            for (uint32_t i = 0; i < dims; i++) centers[j*dims + i] /= counts[j];
+        }
+    }
+    return distortion;
+}
+
+/* Bayesian Information Criterion of a clustering, modeling clusters as spherical Gaussians with a common
+ * variance (Pelleg and Moore, "X-means", ICML 2000).
+ */
+static double BIC(const std::vector<uint32_t>& assign, uint32_t n, uint32_t dims, uint32_t k, double distortion) {
+    if (n <= k) return -DBL_MAX;  // one interval per cluster fits anything, never prefer it
+    std::vector<uint32_t> counts(k);
+    for (uint32_t p = 0; p < n; p++) counts[assign[p]]++;
+
+    double variance = std::max(distortion/(dims*(double)(n - k)), 1e-12);
+    double logLikelihood = -0.5*n*dims*log(2*M_PI*variance) - 0.5*dims*(n - k);
+    for (uint32_t j = 0; j < k; j++) {
+        if (counts[j]) logLikelihood += counts[j]*log(counts[j]/(double)n);
+    }
+    double params = (k - 1) + dims*k + 1;
+    return logLikelihood - 0.5*params*log((double)n);
+}
+
+std::vector<SimPoint> FindSimPoints(const std::vector<float>& vectors, const std::vector<uint64_t>& starts,
+        const std::vector<uint64_t>& lengths, uint32_t dims, uint32_t maxK)
+{
+    uint32_t n = lengths.size();
+    std::vector<SimPoint> res;
+    if (!n) return res;
+    maxK = std::min(maxK, std::max(n - 1, 1u));  // k == n is degenerate (see BIC())
+
+    // Cluster for every k, keeping the best of several seeds for each
+    std::vector<std::vector<uint32_t>> assigns(maxK + 1);
+    std::vector<std::vector<double>> centers(maxK + 1);
+    std::vector<double> bics(maxK + 1);
+    double minBic = DBL_MAX;
+    double maxBic = -DBL_MAX;
+    for (uint32_t k = 1; k <= maxK; k++) {
+        double bestDistortion = DBL_MAX;
+        std::vector<uint32_t> assign;
+        std::vector<double> ctrs;
+        for (uint32_t s = 0; s < KMEANS_SEEDS; s++) {
+            double distortion = KMeans(vectors, n, dims, k, Mix(k*KMEANS_SEEDS + s), assign, ctrs);
+            if (distortion < bestDistortion) {
+                bestDistortion = distortion;
+                assigns[k] = assign;
+                centers[k] = ctrs;
+            }
+        }
+        bics[k] = BIC(assigns[k], n, dims, k, bestDistortion);
+        minBic = std::min(minBic, bics[k]);
+        maxBic = std::max(maxBic, bics[k]);
+    }
+
+    uint32_t k = 1;
+    while (k < maxK && bics[k] < minBic + BIC_THRESHOLD*(maxBic - minBic)) k++;
+    info("SimPoint: %d intervals, picked k = %d (max %d), BIC %g (range [%g, %g])", n, k, maxK, bics[k], minBic, maxBic);
+
+    // Each cluster is represented by the interval closest to its centroid, and weighted by its instructions
+    uint64_t totalInstrs = 0;
+    for (uint64_t l : lengths) totalInstrs += l;
+    std::vector<uint64_t> clusterInstrs(k);
+    std::vector<uint32_t> rep(k, n);
+    std::vector<double> repDist(k, DBL_MAX);
+    for (uint32_t p = 0; p < n; p++) {
+        uint32_t c = assigns[k][p];
+        clusterInstrs[c] += lengths[p];
+        double d = Dist2(&vectors[p*dims], &centers[k][c*dims], dims);
+        if (d < repDist[c]) {
+            repDist[c] = d;
+            rep[c] = p;
+        }
+    }
+
+    for (uint32_t c = 0; c < k; c++) {
+        if (rep[c] == n) continue;  // empty cluster
+        SimPoint sp = {starts[rep[c]], lengths[rep[c]], ((double)clusterInstrs[c])/totalInstrs};
+        res.push_back(sp);
+    }
+    std::sort(res.begin(), res.end(), [](const SimPoint& a, const SimPoint& b) { return a.start < b.start; });
+    return res;
+}
+
+std::vector<SimPoint> ReadSimPoints(const char* file) {
+    FILE* sf = fopen(file, "r");
+    if (!sf) panic("Could not open simpoints file %s", file);
+    std::vector<SimPoint> res;
+    char line[1024];
+    uint32_t lineNum = 0;
+    while (fgets(line, sizeof(line), sf)) {
+        lineNum++;
+        const char* c = line;
+        while (*c == ' ' || *c == '\t') c++;
+        if (*c == '#' || *c == '\n' || *c == '\0') continue;
+        SimPoint sp;
+        if (sscanf(c, "%ld %ld %lf", &sp.start, &sp.length, &sp.weight) != 3 || !sp.length || sp.weight < 0.0) {
+            panic("%s:%d: malformed simpoint, expected \"start length weight\"", file, lineNum);
+        }
+        res.push_back(sp);
+    }
+    fclose(sf);
+    std::sort(res.begin(), res.end(), [](const SimPoint& a, const SimPoint& b) { return a.start < b.start; });
+    return res;
+}
+
+/* BBVProfiler */
+
+BBVProfiler::BBVProfiler(const char* bbvFile, const char* _simpointsFile, uint64_t _interval, uint32_t _dims, uint32_t _maxK)
+    : used(0), interval(_interval), dims(_dims), maxK(_maxK), simpointsFile(_simpointsFile), intervalInstrs(0), totalInstrs(0), done(false)
+{
+    table.resize(1 << 12);
+    f = fopen(bbvFile, "w");
+    if (!f) panic("Could not open BBV file %s for writing", bbvFile);
+    fprintf(f, "# zsim BBVs: interval %ld instrs, %d dims\n# start length vector...\n", interval, dims);
+}
+
+BBVProfiler::~BBVProfiler() {
+    finish();
+}
+
+void BBVProfiler::insert(uint32_t& idx, uint64_t bblAddr) {
+    // Keep the table at most half full
+    if (2*(used + 1) > table.size()) {
+        std::vector<Entry> old(2*table.size());
+        old.swap(table);
+        uint32_t mask = table.size() - 1;
+        for (const Entry& e : old) {
+            if (!e.addr) continue;
+            uint32_t i = hash(e.addr) & mask;
+            while (table[i].addr) i = (i + 1) & mask;
+            table[i] = e;
+        }
+        idx = hash(bblAddr) & mask;
+        while (table[idx].addr) idx = (idx + 1) & mask;
+    }
+    table[idx].addr = bblAddr;
+    table[idx].instrs = 0;
+    used++;
+}
+
+void BBVProfiler::endInterval() {
+    if (done || !intervalInstrs) return;
+
+    // Normalize and project. Each BBL's projection vector has pseudorandom components in [-1, 1).
+    std::vector<double> v(dims, 0.0);
+    for (Entry& e : table) {
+        if (!e.instrs) continue;
+        double frac = ((double)e.instrs)/intervalInstrs;
+        for (uint32_t d = 0; d < dims; d++) {
+            uint64_t r = Mix(e.addr ^ ((uint64_t)d << 56));
+            v[d] += frac*((r >> 11)*(2.0/9007199254740992.0) - 1.0);
+        }
+        e.instrs = 0;  // keep the entry, BBLs tend to recur across intervals
+    }
+
+    fprintf(f, "%ld %ld", totalInstrs, intervalInstrs);
+    for (uint32_t d = 0; d < dims; d++) {
+        fprintf(f, " %.6f", v[d]);
+        vectors.push_back(v[d]);
+    }
+    fprintf(f, "\n");
+    starts.push_back(totalInstrs);
+    lengths.push_back(intervalInstrs);
+
+    totalInstrs += intervalInstrs;
+    intervalInstrs = 0;
+}
+
+void BBVProfiler::finish() {
+    if (done) return;
+    endInterval();
+    done = true;
+    fclose(f);
+    f = NULL;
+
+    if (!maxK || lengths.empty()) return;
+    std::vector<SimPoint> simpoints = FindSimPoints(vectors, starts, lengths, dims, maxK);
+
+    FILE* sf = fopen(simpointsFile.c_str(), "w");
+    if (!sf) panic("Could not open simpoints file %s for writing", simpointsFile.c_str());
+    fprintf(sf, "# zsim simpoints: %ld intervals of %ld instrs, %ld instrs total\n# start length weight\n",
+            lengths.size(), interval, totalInstrs);
+    for (const SimPoint& sp : simpoints) fprintf(sf, "%ld %ld %.6f\n", sp.start, sp.length, sp.weight);
+    fclose(sf);
+    info("Wrote %ld simpoints (%ld intervals) to %s", simpoints.size(), lengths.size(), simpointsFile.c_str());
+}
@@ -0,0 +1,128 @@
+/** $lic$
+ * Copyright (C) 2012-2014 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SIMPOINT_H_
+#define SIMPOINT_H_
+
+/* SimPoint-style phase analysis (Sherwood et al., ASPLOS 2002; Hamerly et
+ * al., JILP 2005).
+ *
+ * While a thread fast-forwards, a BBVProfiler accumulates its basic block
+ * vector (instructions executed per BBL) over fixed-size intervals. At the end
+ * of each interval, the BBV is normalized and randomly projected to a few
+ * dimensions, and written out (one line per interval: start, length, and the
+ * projected vector). Projection uses a per-BBL pseudorandom vector derived
+ * from the BBL address, so no projection matrix needs to be stored, but
+ * vectors are only comparable within a run.
+ *
+ * When profiling ends, the projected vectors are clustered with k-means,
+ * choosing k by BIC as SimPoint does, and the interval closest to each
+ * cluster's centroid is emitted as a simulation point, weighted by the
+ * fraction of instructions in its cluster. Simpoints files have one
+ * "start length weight" line per simulation point, in instructions since the
+ * thread started profiling, plus comments.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "log.h"
+
+struct SimPoint {
+    uint64_t start;
+    uint64_t length;
+    double weight;
+};
+
+// Clusters the n dims-dimensional vectors (row-major), and returns one simpoint per cluster, sorted by start
+std::vector<SimPoint> FindSimPoints(const std::vector<float>& vectors, const std::vector<uint64_t>& starts,
+        const std::vector<uint64_t>& lengths, uint32_t dims, uint32_t maxK);
+
+// Reads a simpoints file (the format FindSimPoints' results are written in), sorted by start
+std::vector<SimPoint> ReadSimPoints(const char* file);
+
+// Process-local; one profiler per thread
+class BBVProfiler {
+    private:
+        struct Entry {
+            uint64_t addr;  // 0 if empty
+            uint64_t instrs;
+        };
+
+        std::vector<Entry> table;  // open addressing, linear probing, power-of-2 size
+        uint32_t used;
+
+        const uint64_t interval;
+        const uint32_t dims;
+        const uint32_t maxK;
+        const std::string simpointsFile;
+        FILE* f;
+
+        uint64_t intervalInstrs;
+        uint64_t totalInstrs;
+        bool done;
+
+        // Projected vectors, for clustering
+        std::vector<float> vectors;
+        std::vector<uint64_t> starts;
+        std::vector<uint64_t> lengths;
+
+    public:
+        BBVProfiler(const char* bbvFile, const char* _simpointsFile, uint64_t _interval, uint32_t _dims, uint32_t _maxK);
+        ~BBVProfiler();
+
+        inline void bbl(uint64_t bblAddr, uint32_t instrs) {
+            if (unlikely(done)) return;  // profile already written
+            uint32_t mask = table.size() - 1;
+            uint32_t idx = hash(bblAddr) & mask;
+            while (table[idx].addr != bblAddr) {
+                if (!table[idx].addr) {
+                    insert(idx, bblAddr);
+                    break;
+                }
+                idx = (idx + 1) & mask;
+            }
+            table[idx].instrs += instrs;
+            intervalInstrs += instrs;
+            if (unlikely(intervalInstrs >= interval)) endInterval();
+        }
+
+        // Ends the current (partial) interval, clusters all intervals, and writes the simpoints file.
+        // Further BBLs are ignored.
+        void finish();
+
+        uint64_t getIntervals() const { return lengths.size(); }
+
+    private:
+        static inline uint32_t hash(uint64_t addr) {
+            return (uint32_t)((addr * 0x9e3779b97f4a7c15ul) >> 32);
+        }
+
+        void insert(uint32_t& idx, uint64_t bblAddr);
+        void endInterval();
+};
+
+#endif  // SIMPOINT_H_
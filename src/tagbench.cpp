@@ -0,0 +1,199 @@
+/** $lic$
+ * Copyright (C) 2012-2014 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Standalone tag lookup benchmark. Runs line address streams through a
+ * set-associative tag array using each tag search in cache_arrays.h that the
+ * host supports (scalar, SSE4.1, AVX2), and reports ns per lookup at several
+ * associativities, plus which one the simulator picks. Streams are
+ * synthetic (a hit-dominated one and a miss-dominated one), plus the memory
+ * accesses of any BBL traces given as arguments (see bbl_trace.h, recorded
+ * with processN.recordTrace). Traces are parsed here rather than through
+ * TraceReader so that this does not depend on Pin or the decoder.
+ */
+
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+#include "bbl_trace.h"
+#include "cache_arrays.h"
+#include "log.h"
+#include "mtrand.h"
+#include "pad.h"
+
+static uint64_t GetVarint(FILE* f, const char* filename) {
+    uint64_t v = 0;
+    uint32_t shift = 0;
+    while (true) {
+        int c = getc_unlocked(f);
+        if (c == EOF) panic("%s: truncated trace", filename);
+        v |= ((uint64_t)(c & 0x7f)) << shift;
+        if (!(c & 0x80)) return v;
+        shift += 7;
+    }
+}
+
+static inline uint64_t GetDelta(FILE* f, const char* filename, uint64_t prev) {
+    uint64_t z = GetVarint(f, filename);
+    return prev + (uint64_t)((int64_t)(z >> 1) ^ -(int64_t)(z & 1));
+}
+
+// Reads the line addresses of all loads and stores in a trace
+static void ReadTrace(const char* filename, std::vector<Address>& lines) {
+    FILE* f = fopen(filename, "r");
+    if (!f) panic("Could not open trace file %s", filename);
+    setvbuf(f, NULL, _IOFBF, 1 << 20);
+
+    TraceHeader hdr;
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 || hdr.magic != TRACE_MAGIC) panic("%s is not a zsim trace", filename);
+    if (hdr.version != TRACE_VERSION) panic("Trace %s has version %d, expected %d", filename, hdr.version, TRACE_VERSION);
+
+    uint64_t prevMemAddr = 0;
+    bool done = false;
+    while (!done) {
+        int c = getc_unlocked(f);
+        if (c == EOF) {
+            warn("%s: truncated trace, using %ld accesses", filename, lines.size());
+            break;
+        }
+        switch ((TraceRecordType)(c & 0xf)) {
+            case TR_BBLDEF:
+                {
+                    GetVarint(f, filename);  // id
+                    uint32_t bytes = GetVarint(f, filename);
+                    if (fseek(f, bytes, SEEK_CUR)) panic("%s: truncated trace", filename);
+                }
+                break;
+            case TR_BBL:
+                GetVarint(f, filename);
+                GetVarint(f, filename);
+                break;
+            case TR_LOAD:
+            case TR_STORE:
+            case TR_PRED_LOAD:
+            case TR_PRED_STORE:
+                prevMemAddr = GetDelta(f, filename, prevMemAddr);
+                lines.push_back(prevMemAddr >> 6);
+                break;
+            case TR_BRANCH:
+                GetVarint(f, filename);
+                GetVarint(f, filename);
+                GetVarint(f, filename);
+                break;
+            case TR_END:
+                done = true;
+                break;
+            default:
+                panic("%s: invalid record tag 0x%x", filename, c);
+        }
+    }
+    fclose(f);
+}
+
+static double GetTime() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+/* Runs the stream through a numLines-line array with the given lookup
+ * function. Misses fill a way chosen round-robin per set, so all runs see
+ * the same array contents. Returns elapsed seconds.
+ */
+template <int32_t (*Find)(const Address*, uint32_t, Address)>
+static double Run(const std::vector<Address>& lines, uint32_t numLines, uint32_t assoc, uint64_t& hits) {
+    uint32_t numSets = numLines/assoc;
+    Address* array = gm_memalign<Address>(CACHE_LINE_BYTES, numLines);
+    std::vector<uint32_t> nextWay(numSets, 0);
+    for (uint32_t i = 0; i < numLines; i++) array[i] = -1L;  // no line address matches
+
+    hits = 0;
+    double start = GetTime();
+    for (Address lineAddr : lines) {
+        uint32_t set = (lineAddr ^ (lineAddr >> 17)) & (numSets - 1);
+        Address* tags = &array[set*assoc];
+        int32_t way = Find(tags, assoc, lineAddr);
+        if (way != -1) {
+            hits++;
+        } else {
+            tags[nextWay[set]] = lineAddr;
+            nextWay[set] = (nextWay[set] + 1) % assoc;
+        }
+    }
+    double secs = GetTime() - start;
+    gm_free(array);
+    return secs;
+}
+
+static void Bench(const char* name, const std::vector<Address>& lines, TagSearchISA isa) {
+    static const uint32_t NUM_LINES = 32768;  // 2 MB
+    for (uint32_t assoc = 4; assoc <= 32; assoc *= 2) {
+        uint64_t hits, simdHits;
+        double secs = Run<findTagScalar>(lines, NUM_LINES, assoc, hits);
+        char buf[256];
+        int len = snprintf(buf, sizeof(buf), "%-12s %2d ways  hit rate %5.1f%%  scalar %6.2f ns", name, assoc, 100.0*hits/lines.size(), 1e9*secs/lines.size());
+#ifdef TAG_SEARCH_SIMD
+        if (isa >= TAG_SEARCH_SSE41) {
+            double simdSecs = Run<findTagSSE41>(lines, NUM_LINES, assoc, simdHits);
+            if (simdHits != hits) panic("%s: SSE4.1 search hit %ld times, scalar loop %ld", name, simdHits, hits);
+            len += snprintf(buf + len, sizeof(buf) - len, "  SSE4.1 %6.2f ns (%.2fx)", 1e9*simdSecs/lines.size(), secs/simdSecs);
+        }
+        if (isa >= TAG_SEARCH_AVX2) {
+            double simdSecs = Run<findTagAVX2>(lines, NUM_LINES, assoc, simdHits);
+            if (simdHits != hits) panic("%s: AVX2 search hit %ld times, scalar loop %ld", name, simdHits, hits);
+            len += snprintf(buf + len, sizeof(buf) - len, "  AVX2 %6.2f ns (%.2fx)", 1e9*simdSecs/lines.size(), secs/simdSecs);
+        }
+#endif
+        info("%s", buf);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    InitLog("[T] ");
+    gm_init(64 << 20);
+    TagSearchISA isa = DetectTagSearchISA();
+    const char* isaNames[] = {"the scalar loop", "SSE4.1", "AVX2"};
+    info("findTag uses %s on this host", isaNames[isa]);
+
+    const uint32_t accesses = 20000000;
+    MTRand rng(42);
+    std::vector<Address> hot(accesses), cold(accesses);
+    for (uint32_t i = 0; i < accesses; i++) {
+        hot[i] = rng.randInt(16384);  // half the array, mostly hits
+        cold[i] = rng.randInt(1 << 20);  // 32x the array, mostly misses
+    }
+    Bench("synth-hot", hot, isa);
+    Bench("synth-cold", cold, isa);
+
+    for (int i = 1; i < argc; i++) {
+        std::vector<Address> lines;
+        ReadTrace(argv[i], lines);
+        if (lines.empty()) {
+            warn("%s: no memory accesses", argv[i]);
+            continue;
+        }
+        Bench(argv[i], lines, isa);
+    }
+    return 0;
+}
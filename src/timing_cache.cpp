@@ -112,6 +112,8 @@ void TimingCache::initStats(AggregateStat* parentStat) {
 
 // TODO(dsm): This is copied verbatim from Cache. We should split Cache into different methods, then call those.
 uint64_t TimingCache::access(MemReq& req) {
+    if (unlikely(req.is(MemReq::WARM))) return Cache::access(req); //functional warming records no events
+
     EventRecorder* evRec = zinfo->eventRecorders[req.srcId];
     assert_msg(evRec, "TimingCache is not connected to TimingCore");
     uint32_t initialRecords = evRec->numRecords();
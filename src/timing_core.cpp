@@ -25,6 +25,7 @@
 
 #include "timing_core.h"
 #include "filter_cache.h"
+#include "tlb.h"
 #include "zsim.h"
 
 #define DEBUG_MSG(args...)
@@ -55,6 +56,8 @@ void TimingCore::initStats(AggregateStat* parentStat) {
     instrsStat->init("instrs", "Simulated instructions", &instrs);
     coreStat->append(instrsStat);
 
+    if (mmu) mmu->initStats(coreStat);
+
     parentStat->append(coreStat);
 }
 
@@ -78,17 +81,28 @@ void TimingCore::leave() {
 }
 
 void TimingCore::loadAndRecord(Address addr) {
+    if (mmu) curCycle = translate(addr);
     uint64_t startCycle = curCycle;
     curCycle = l1d->load(addr, curCycle);
     cRec.record(startCycle);
 }
 
 void TimingCore::storeAndRecord(Address addr) {
+    if (mmu) curCycle = translate(addr);
     uint64_t startCycle = curCycle;
     curCycle = l1d->store(addr, curCycle);
     cRec.record(startCycle);
 }
 
+uint64_t TimingCore::translate(Address addr) {
+    // Each PTE load is recorded, so walks produce the same weave events as regular loads
+    return mmu->translate(addr, curCycle, [this](Address pteAddr, uint64_t cycle) {
+        uint64_t respCycle = l1d->load(pteAddr, cycle);
+        cRec.record(cycle);
+        return respCycle;
+    });
+}
+
 void TimingCore::bblAndRecord(Address bblAddr, BblInfo* bblInfo) {
     instrs += bblInfo->instrs;
     curCycle += bblInfo->instrs;
@@ -101,6 +115,22 @@ void TimingCore::bblAndRecord(Address bblAddr, BblInfo* bblInfo) {
     }
 }
 
+void TimingCore::warmBbl(ADDRINT bblAddr, BblInfo* bblInfo) {
+    Address endBblAddr = bblAddr + bblInfo->bytes;
+    for (Address fetchAddr = bblAddr; fetchAddr < endBblAddr; fetchAddr+=(1 << lineBits)) {
+        l1i->warm(fetchAddr, true);
+    }
+}
+
+void TimingCore::warmLoad(ADDRINT addr) {
+    if (mmu) mmu->warm(addr, [this](Address pteAddr) { l1d->warm(pteAddr, true); });
+    l1d->warm(addr, true);
+}
+
+void TimingCore::warmStore(ADDRINT addr) {
+    if (mmu) mmu->warm(addr, [this](Address pteAddr) { l1d->warm(pteAddr, true); });
+    l1d->warm(addr, false);
+}
 
 InstrFuncPtrs TimingCore::GetFuncPtrs() {
     return {LoadAndRecordFunc, StoreAndRecordFunc, BblAndRecordFunc, BranchFunc, PredLoadAndRecordFunc, PredStoreAndRecordFunc, FPTR_ANALYSIS, {0}};
@@ -60,6 +60,10 @@ class TimingCore : public Core {
 
         InstrFuncPtrs GetFuncPtrs();
 
+        void warmBbl(ADDRINT bblAddr, BblInfo* bblInfo);
+        void warmLoad(ADDRINT addr);
+        void warmStore(ADDRINT addr);
+
         //Contention simulation interface
         inline EventRecorder* getEventRecorder() {return cRec.getEventRecorder();}
         void cSimStart() {curCycle = cRec.cSimStart(curCycle);}
@@ -69,6 +73,7 @@ class TimingCore : public Core {
         inline void loadAndRecord(Address addr);
         inline void storeAndRecord(Address addr);
         inline void bblAndRecord(Address bblAddr, BblInfo* bblInstrs);
+        uint64_t translate(Address addr);
         inline void record(uint64_t startCycle);
 
         static void LoadAndRecordFunc(THREADID tid, ADDRINT addr);
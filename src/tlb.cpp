@@ -0,0 +1,104 @@
+/** $lic$
+ * Copyright (C) 2012-2014 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tlb.h"
+#include "bithacks.h"
+#include "checkpoint.h"
+#include "process_tree.h"
+
+/* TranslationArray */
+
+TranslationArray::TranslationArray(uint32_t entries, uint32_t _ways) : numEntries(entries), ways(_ways), timestamp(0) {
+    if (!ways || entries % ways) panic("Translation array with %d entries can't have %d ways", entries, ways);
+    uint32_t numSets = entries/ways;
+    if (!isPow2(numSets)) panic("Translation array with %d entries and %d ways has %d sets, must be a power of 2", entries, ways, numSets);
+    setMask = numSets - 1;
+    keys = gm_calloc<Address>(numEntries);
+    lastUse = gm_calloc<uint64_t>(numEntries);
+}
+
+void TranslationArray::insert(Address key) {
+    uint32_t first = setIdx(key)*ways;
+    uint32_t victim = first;
+    for (uint32_t i = first; i < first + ways; i++) {
+        if (lastUse[i] < lastUse[victim]) victim = i;  // empty entries have lastUse 0
+    }
+    keys[victim] = key;
+    lastUse[victim] = ++timestamp;
+}
+
+void TranslationArray::checkpointState(Checkpoint& ckpt, const std::string& prefix) {
+    ckpt.value(prefix + ".timestamp", timestamp);
+    ckpt.array(prefix + ".keys", keys, numEntries);
+    ckpt.array(prefix + ".lastUse", lastUse, numEntries);
+}
+
+/* MMU */
+
+MMU::MMU(const g_string& _name, TranslationArray* const* _l1Tlbs, TranslationArray* _l2Tlb, TranslationArray* _l2HugeTlb,
+        TranslationArray* const* _pwcs, uint32_t _l2Lat)
+    : l2Tlb(_l2Tlb), l2HugeTlb(_l2HugeTlb), l2Lat(_l2Lat), lastKey(0), curProcIdx(-1), pageBits(12), sizeIdx(0), name(_name)
+{
+    for (uint32_t i = 0; i < PAGE_SIZES; i++) l1Tlbs[i] = _l1Tlbs[i];
+    for (uint32_t i = 0; i < PT_LEVELS - 1; i++) pwcs[i] = _pwcs[i];
+    if (!l1Tlbs[0] || !l2Tlb) panic("%s: MMU needs an L1 TLB for 4KB pages and an L2 TLB", name.c_str());
+}
+
+void MMU::initStats(AggregateStat* parentStat) {
+    AggregateStat* mmuStat = new AggregateStat();
+    mmuStat->init("tlb", "TLB and page walk stats");
+    profL1Misses.init("l1Misses", "L1 TLB misses"); mmuStat->append(&profL1Misses);
+    profL2Hits.init("l2Hits", "L2 TLB hits"); mmuStat->append(&profL2Hits);
+    profWalks.init("walks", "Page walks"); mmuStat->append(&profWalks);
+    profWalkLoads.init("walkLoads", "PTE loads issued by page walks"); mmuStat->append(&profWalkLoads);
+    profWalkCycles.init("walkCycles", "Cycles spent in page walks"); mmuStat->append(&profWalkCycles);
+    const char* pwcNames[] = {"PML4", "PDPT", "PD"};
+    profPWCHits.init("pwcHits", "Page walks that started below an entry held by each page-walk cache", PT_LEVELS - 1, pwcNames);
+    mmuStat->append(&profPWCHits);
+    parentStat->append(mmuStat);
+}
+
+void MMU::checkpointState(Checkpoint& ckpt) {
+    std::string prefix = std::string(name.c_str()) + ".tlb";
+    const char* sizeNames[] = {"4K", "2M", "1G"};
+    for (uint32_t i = 0; i < PAGE_SIZES; i++) {
+        if (l1Tlbs[i]) l1Tlbs[i]->checkpointState(ckpt, prefix + ".l1-" + sizeNames[i]);
+    }
+    l2Tlb->checkpointState(ckpt, prefix + ".l2");
+    if (l2HugeTlb) l2HugeTlb->checkpointState(ckpt, prefix + ".l2-1G");
+    const char* pwcNames[] = {"pml4", "pdpt", "pd"};
+    for (uint32_t i = 0; i < PT_LEVELS - 1; i++) {
+        if (pwcs[i]) pwcs[i]->checkpointState(ckpt, prefix + ".pwc-" + pwcNames[i]);
+    }
+    lastKey = 0;  // restored arrays may not hold it
+}
+
+void MMU::setProcess() {
+    curProcIdx = procIdx;
+    pageBits = zinfo->procArray[procIdx]->getPageBits();
+    sizeIdx = (pageBits - 12)/9;
+    if (!l1Tlbs[sizeIdx]) panic("%s: process %d uses %d-bit pages, but there is no L1 TLB for them", name.c_str(), procIdx, pageBits);
+    lastKey = 0;
+}
@@ -0,0 +1,224 @@
+/** $lic$
+ * Copyright (C) 2012-2014 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TLB_H_
+#define TLB_H_
+
+/* Address translation: TLBs, page-walk caches, and page walks.
+ *
+ * Cores with sys.cores.X.tlb.enabled get an MMU that translates the
+ * addresses of their loads and stores before they access the L1d:
+ *  - L1 data TLBs, one per page size (4KB, 2MB, 1GB). Hits add no latency,
+ *    as the L1 TLB is looked up in parallel with the (VIPT) L1d.
+ *  - An L2 TLB shared by 4KB and 2MB pages, and an optional one for 1GB
+ *    pages, which add l2Latency cycles.
+ *  - Page-walk caches (PWCs) for the upper levels of the x86-64 4-level
+ *    page table (PML4, PDPT, and PD entries), which let walks skip levels.
+ *  - A page walker that issues the PTE loads that the PWCs do not cover
+ *    through the core's L1d (the core supplies the function that issues
+ *    them), so walks compete for and fill the cache hierarchy and are
+ *    recorded as weave events like any other load.
+ *
+ * zsim does not see the OS's page tables, so each process's memory is backed
+ * by a single page size (processN.pageSize), and page table pages are placed
+ * by hashing the virtual address bits that select them into a region above
+ * the user address space. Like in a real radix tree, the PTEs of nearby pages
+ * share cache lines, and each process has its own page tables. The MMU only
+ * models translation timing: physical addresses come from the filter caches
+ * (see page_alloc.h), and PTE loads are translated like any other access.
+ */
+
+#include <string>
+#include "g_std/g_string.h"
+#include "galloc.h"
+#include "memory_hierarchy.h"
+#include "stats.h"
+#include "zsim.h"
+
+class Checkpoint;
+
+/* Set-associative array of translations with LRU replacement, used for TLBs
+ * and PWCs. Keys are built by the MMU, and are never 0.
+ */
+class TranslationArray : public GlobAlloc {
+    private:
+        Address* keys;
+        uint64_t* lastUse;
+        uint32_t numEntries;
+        uint32_t ways;
+        uint32_t setMask;
+        uint64_t timestamp;
+
+    public:
+        TranslationArray(uint32_t entries, uint32_t _ways);
+
+        inline bool lookup(Address key) {
+            uint32_t first = setIdx(key)*ways;
+            for (uint32_t i = first; i < first + ways; i++) {
+                if (keys[i] == key) {
+                    lastUse[i] = ++timestamp;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void insert(Address key);
+
+        void checkpointState(Checkpoint& ckpt, const std::string& prefix);
+
+    private:
+        inline uint32_t setIdx(Address key) const { return (key >> 2) & setMask; }  // low 2 bits hold the key type
+};
+
+class MMU : public GlobAlloc {
+    public:
+        static const uint32_t PAGE_SIZES = 3;  // 4KB, 2MB, 1GB
+        static const uint32_t PT_LEVELS = 4;  // PML4, PDPT, PD, PT
+
+    private:
+        TranslationArray* l1Tlbs[PAGE_SIZES];
+        TranslationArray* l2Tlb;  // 4KB and 2MB pages
+        TranslationArray* l2HugeTlb;  // 1GB pages, NULL if they are not cached in the L2 TLB
+        TranslationArray* pwcs[PT_LEVELS - 1];  // non-leaf entries of each level, NULL if not cached
+        const uint32_t l2Lat;
+
+        Address lastKey;  // page of the last translation; same-page runs skip the L1 TLB lookup (it is already MRU)
+        uint32_t curProcIdx;  // process we are translating for; cores run threads of several processes
+        uint32_t pageBits;
+        uint32_t sizeIdx;  // 0: 4KB, 1: 2MB, 2: 1GB
+
+        const g_string name;
+
+        Counter profL1Misses, profL2Hits, profWalks, profWalkLoads, profWalkCycles;
+        VectorCounter profPWCHits;
+
+        // Page table pages are hashed into this region, above the 47-bit user address space
+        static const Address PT_REGION_BASE = 1ul << 47;
+        static const uint32_t PT_REGION_PAGE_BITS = 24;  // 64GB worth of 4KB page table pages
+
+    public:
+        // Only the 4KB L1 TLB and the L2 TLB are required
+        MMU(const g_string& _name, TranslationArray* const* _l1Tlbs, TranslationArray* _l2Tlb, TranslationArray* _l2HugeTlb,
+                TranslationArray* const* _pwcs, uint32_t _l2Lat);
+
+        void initStats(AggregateStat* parentStat);
+        void checkpointState(Checkpoint& ckpt);
+
+        /* Returns the cycle at which vAddr's translation is available. On a
+         * page walk, calls loadPte(pteAddr, reqCycle) for each PTE load, which
+         * must issue it and return its response cycle.
+         */
+        template <typename L>
+        inline uint64_t translate(Address vAddr, uint64_t cycle, L loadPte) {
+            return access<true>(vAddr, cycle, loadPte);
+        }
+
+        // Functional warming (sim.ffWarming): updates TLBs and PWCs, and calls warmPte(pteAddr) for each PTE load
+        template <typename W>
+        inline void warm(Address vAddr, W warmPte) {
+            access<false>(vAddr, 0, [&warmPte](Address pteAddr, uint64_t cycle) { warmPte(pteAddr); return cycle; });
+        }
+
+    private:
+        template <bool timing, typename L>
+        inline uint64_t access(Address vAddr, uint64_t cycle, L loadPte) {
+            if (unlikely(procIdx != curProcIdx)) setProcess();
+            Address key = pageKey(vAddr);
+            if (likely(key == lastKey)) return cycle;
+            lastKey = key;
+            if (likely(l1Tlbs[sizeIdx]->lookup(key))) return cycle;
+            return miss<timing>(vAddr, key, cycle, loadPte);
+        }
+
+        template <bool timing, typename L>
+        uint64_t miss(Address vAddr, Address key, uint64_t cycle, L loadPte) {
+            if (timing) profL1Misses.inc();
+            uint64_t respCycle = cycle + l2Lat;
+            TranslationArray* l2 = (sizeIdx == 2)? l2HugeTlb : l2Tlb;
+            if (l2 && l2->lookup(key)) {
+                if (timing) profL2Hits.inc();
+            } else {
+                respCycle = walk<timing>(vAddr, respCycle, loadPte);
+                if (l2) l2->insert(key);
+            }
+            l1Tlbs[sizeIdx]->insert(key);
+            return respCycle;
+        }
+
+        template <bool timing, typename L>
+        uint64_t walk(Address vAddr, uint64_t cycle, L loadPte) {
+            uint64_t startCycle = cycle;
+            uint32_t leaf = PT_LEVELS - 1 - sizeIdx;
+
+            // Skip the levels above the deepest entry held by a PWC
+            uint32_t level = 0;
+            for (uint32_t l = leaf; l > 0; l--) {
+                if (pwcs[l-1] && pwcs[l-1]->lookup(pwcKey(vAddr, l-1))) {
+                    if (timing) profPWCHits.inc(l-1);
+                    level = l;
+                    break;
+                }
+            }
+
+            // PTE loads are dependent, each one provides the next table's address
+            uint32_t loads = 0;
+            for (; level <= leaf; level++) {
+                cycle = loadPte(pteAddr(vAddr, level), cycle);
+                if (level < leaf && pwcs[level]) pwcs[level]->insert(pwcKey(vAddr, level));
+                loads++;
+            }
+
+            if (timing) {
+                profWalks.inc();
+                profWalkLoads.inc(loads);
+                profWalkCycles.inc(cycle - startCycle);
+            }
+            return cycle;
+        }
+
+        void setProcess();
+
+        // Bits of vAddr that index the given level's table (PML4 is level 0)
+        static inline uint32_t levelShift(uint32_t level) { return 39 - 9*level; }
+
+        inline Address pageKey(Address vAddr) const {
+            return procMask | ((vAddr >> pageBits) << 2) | (sizeIdx + 1);
+        }
+
+        // PWC entry of a level is identified by the vAddr bits down to that level's index
+        inline Address pwcKey(Address vAddr, uint32_t level) const {
+            return procMask | ((vAddr >> levelShift(level)) << 2) | (level + 1);
+        }
+
+        inline Address pteAddr(Address vAddr, uint32_t level) const {
+            Address table = ((vAddr >> (levelShift(level) + 9)) << 2) | level;  // bits above this level's index
+            Address tablePage = (table * 0x9E3779B97F4A7C15ul) >> (64 - PT_REGION_PAGE_BITS);
+            Address idx = (vAddr >> levelShift(level)) & 511;
+            return PT_REGION_BASE | (tablePage << 12) | (idx << 3);
+        }
+};
+
+#endif  // TLB_H_
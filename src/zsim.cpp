@@ -40,12 +40,17 @@
 #include <sys/resource.h>
 #include <sys/time.h>
 #include <unistd.h>
+#include "checkpoint.h"
 #include "constants.h"
 #include "contention_sim.h"
+#include "bbl_trace.h"
+#include "sampled_stats.h"
+#include "simpoint.h"
 #include "core.h"
 #include "cpuenum.h"
 #include "cpuid.h"
 #include "debug_zsim.h"
+#include "decode_cache.h"
 #include "event_queue.h"
 #include "galloc.h"
 #include "init.h"
@@ -190,6 +195,56 @@ VOID PIN_FAST_ANALYSIS_CALL IndirectPredStoreSingle(THREADID tid, ADDRINT addr,
 }
 
 
+/* Trace recording: when the process has recordTrace set, simulated threads
+ * run with recordPtrs, which log each callback to the thread's trace and then
+ * forward it to the core's own analysis functions. Since the wrappers only
+ * run while the thread is simulated, fast-forwarded code is not recorded.
+ */
+
+static TraceWriter* traceWriters[MAX_THREADS];
+static InstrFuncPtrs recordedPtrs[MAX_THREADS];
+static TraceReader* traceReader; //non-NULL iff this process replays a trace (see ReplayBasicBlock)
+
+VOID RecordLoadSingle(THREADID tid, ADDRINT addr) {
+    traceWriters[tid]->load(addr);
+    recordedPtrs[tid].loadPtr(tid, addr);
+}
+
+VOID RecordStoreSingle(THREADID tid, ADDRINT addr) {
+    traceWriters[tid]->store(addr);
+    recordedPtrs[tid].storePtr(tid, addr);
+}
+
+VOID RecordBasicBlock(THREADID tid, ADDRINT bblAddr, BblInfo* bblInfo) {
+    traceWriters[tid]->bbl(bblAddr, bblInfo);
+    recordedPtrs[tid].bblPtr(tid, bblAddr, bblInfo);
+}
+
+VOID RecordRecordBranch(THREADID tid, ADDRINT branchPc, BOOL taken, ADDRINT takenNpc, ADDRINT notTakenNpc) {
+    traceWriters[tid]->branch(branchPc, taken, takenNpc, notTakenNpc);
+    recordedPtrs[tid].branchPtr(tid, branchPc, taken, takenNpc, notTakenNpc);
+}
+
+VOID RecordPredLoadSingle(THREADID tid, ADDRINT addr, BOOL pred) {
+    traceWriters[tid]->predLoad(addr, pred);
+    recordedPtrs[tid].predLoadPtr(tid, addr, pred);
+}
+
+VOID RecordPredStoreSingle(THREADID tid, ADDRINT addr, BOOL pred) {
+    traceWriters[tid]->predStore(addr, pred);
+    recordedPtrs[tid].predStorePtr(tid, addr, pred);
+}
+
+static const InstrFuncPtrs recordPtrs = {RecordLoadSingle, RecordStoreSingle, RecordBasicBlock, RecordRecordBranch, RecordPredLoadSingle, RecordPredStoreSingle, FPTR_ANALYSIS};
+
+// Analysis pointers for a thread that has just been given a core
+static inline InstrFuncPtrs GetCorePtrs(uint32_t tid) {
+    if (likely(!traceWriters[tid])) return cores[tid]->GetFuncPtrs();
+    recordedPtrs[tid] = cores[tid]->GetFuncPtrs();
+    return recordPtrs;
+}
+
+
 //Non-simulation variants of analysis functions
 
 // Join variants: Call join on the next instrumentation poin and return to analysis code
@@ -204,7 +259,7 @@ void Join(uint32_t tid) {
         SimEnd();
     }
 
-    fPtrs[tid] = cores[tid]->GetFuncPtrs(); //back to normal pointers
+    fPtrs[tid] = GetCorePtrs(tid); //back to normal pointers
 }
 
 VOID JoinAndLoadSingle(THREADID tid, ADDRINT addr) {
@@ -243,8 +298,51 @@ VOID NOPBasicBlock(THREADID tid, ADDRINT bblAddr, BblInfo* bblInfo) {}
 VOID NOPRecordBranch(THREADID tid, ADDRINT addr, BOOL taken, ADDRINT takenNpc, ADDRINT notTakenNpc) {}
 VOID NOPPredLoadStoreSingle(THREADID tid, ADDRINT addr, BOOL pred) {}
 
+/* BBV profiling: when the process has bbvInterval set, each thread keeps a
+ * BBVProfiler that sees every basic block the thread executes while
+ * fast-forwarding, and picks simpoints when the thread (or the process) ends.
+ */
+static BBVProfiler* bbvProfilers[MAX_THREADS];
+
+/* Functional warming (sim.ffWarming): fast-forwarded threads feed their basic
+ * blocks, loads, stores, and branches to a core, which updates its caches and
+ * predictors without simulating time. FF threads have no core, so each one
+ * warms the core it last ran on, or one from its process mask if it has not
+ * run yet. Warming does not synchronize with threads simulated on the same
+ * core. Both choices stay within the process mask, and init.cpp requires
+ * masks to be disjoint with sim.ffWarming, so the only threads that can run
+ * on a warmed core belong to the same process, which fast-forwards as a whole.
+ */
+static Core* warmCores[MAX_THREADS];
+
+static inline Core* GetWarmCore(THREADID tid) {
+    Core* core = warmCores[tid];
+    if (unlikely(!core)) {
+        const g_vector<bool>& mask = procTreeNode->getMask();
+        uint32_t maskCores = 0;
+        for (bool b : mask) maskCores += b;
+        assert(maskCores);
+        uint32_t pos = tid % maskCores;
+        for (uint32_t c = 0; c < mask.size(); c++) {
+            if (mask[c] && pos-- == 0) {
+                core = zinfo->cores[c];
+                break;
+            }
+        }
+        warmCores[tid] = core;
+    }
+    return core;
+}
+
+VOID WarmLoadSingle(THREADID tid, ADDRINT addr) {GetWarmCore(tid)->warmLoad(addr);}
+VOID WarmStoreSingle(THREADID tid, ADDRINT addr) {GetWarmCore(tid)->warmStore(addr);}
+VOID WarmRecordBranch(THREADID tid, ADDRINT addr, BOOL taken, ADDRINT takenNpc, ADDRINT notTakenNpc) {GetWarmCore(tid)->warmBranch(addr, taken);}
+VOID WarmPredLoadSingle(THREADID tid, ADDRINT addr, BOOL pred) {if (pred) GetWarmCore(tid)->warmLoad(addr);}
+VOID WarmPredStoreSingle(THREADID tid, ADDRINT addr, BOOL pred) {if (pred) GetWarmCore(tid)->warmStore(addr);}
+
 // FF is basically NOP except for basic blocks
 VOID FFBasicBlock(THREADID tid, ADDRINT bblAddr, BblInfo* bblInfo) {
+    if (bbvProfilers[tid]) bbvProfilers[tid]->bbl(bblAddr, bblInfo->instrs);
     if (unlikely(!procTreeNode->isInFastForward())) {
         SimThreadStart(tid);
     }
@@ -259,6 +357,12 @@ VOID FFBasicBlock(THREADID tid, ADDRINT bblAddr, BblInfo* bblInfo) {
  * entry, we install a special handler that advances to the next FFI point and
  * installs the normal FFI handlers (pretty much like joins work).
  *
+ * Sampled simulation (processN.simpoints) is implemented on top of FFI: the
+ * samples become ffiPoints, and NFF intervals also track when each sample's
+ * warmup and detailed window end (see sampled_stats.h). With sim.ffWarming,
+ * FF intervals switch to the warming handlers once they reach the sample's
+ * functional warmup window.
+ *
  * REQUIREMENTS: Single-threaded during FF (non-FF can be MT)
  */
 
@@ -270,6 +374,8 @@ static uint32_t ffiPoint;
 static uint64_t ffiInstrsDone;
 static uint64_t ffiInstrsLimit;
 static bool ffiNFF;
+static bool ffiWarming; //true while this FF interval is warming (sim.ffWarming)
+static uint64_t ffiWarmStart; //ffiInstrsDone where this FF interval starts warming
 
 //Track the non-FF instructions executed at the beginning of this and last interval.
 //Can only be updated at ends of phase, by the NFF tracking event.
@@ -289,7 +395,17 @@ VOID FFITrackNFFInterval() {
     uint64_t* _ffiFFStartInstrs = ffiFFStartInstrs;
     uint64_t* _ffiPrevFFStartInstrs = ffiPrevFFStartInstrs;
     auto ffiGet = [p, startInstrs]() { return zinfo->processStats->getProcessInstrs(p) - startInstrs; };
-    auto ffiFire = [p, _ffiFFStartInstrs, _ffiPrevFFStartInstrs]() {
+
+    //In sampled simulation, this NFF interval is one sample's warmup + detailed window; track where each ends
+    SampledStatsBackend* sampler = procTreeNode->getSampler();
+    uint32_t sample = ffiPoint/2;
+    if (sampler) {
+        auto warmupFire = [p, sampler, sample]() { sampler->beginSample(sample, zinfo->processStats->getProcessInstrs(p)); };
+        zinfo->eventQueue->insert(makeAdaptiveEvent(ffiGet, warmupFire, 0, sampler->getWarmup(sample), MAX_IPC*zinfo->phaseLength));
+    }
+
+    auto ffiFire = [p, _ffiFFStartInstrs, _ffiPrevFFStartInstrs, sampler, sample]() {
+        if (sampler) sampler->endSample(sample, zinfo->processStats->getProcessInstrs(p));
         info("FFI: Entering fast-forward for process %d", p);
         /* Note this is sufficient due to the lack of reinstruments on FF, and this way we do not need to touch global state */
         futex_lock(&zinfo->ffLock);
@@ -304,6 +420,15 @@ VOID FFITrackNFFInterval() {
     ffiNFF = true;
 }
 
+// Called when an FF interval starts, after FFIAdvance()
+static void FFISetWarmWindow() {
+    SampledStatsBackend* sampler = procTreeNode->getSampler();
+    if (!zinfo->ffWarming) ffiWarmStart = (uint64_t)-1;
+    else if (sampler && ffiPoint/2 < sampler->getNumSamples()) ffiWarmStart = ffiInstrsLimit - sampler->getFunctionalWarmup(ffiPoint/2);
+    else ffiWarmStart = ffiInstrsDone;
+    ffiWarming = ffiInstrsDone >= ffiWarmStart;
+}
+
 // Called on process start
 VOID FFIInit() {
     const g_vector<uint64_t>& ffiPoints = procTreeNode->getFFIPoints();
@@ -317,8 +442,10 @@ VOID FFIInit() {
         ffiFFStartInstrs = gm_calloc<uint64_t>(1);
         ffiPrevFFStartInstrs = gm_calloc<uint64_t>(1);
         ffiNFF = false;
+        ffiWarming = false;
         info("FFI mode initialized, %ld ffiPoints", ffiPoints.size());
         if (!procTreeNode->isInFastForward()) FFITrackNFFInterval();
+        else FFISetWarmWindow();
     } else {
         ffiEnabled = false;
     }
@@ -338,6 +465,7 @@ VOID FFIAdvance() {
 }
 
 VOID FFIBasicBlock(THREADID tid, ADDRINT bblAddr, BblInfo* bblInfo) {
+    if (bbvProfilers[tid]) bbvProfilers[tid]->bbl(bblAddr, bblInfo->instrs);
     ffiInstrsDone += bblInfo->instrs;
     if (unlikely(ffiInstrsDone >= ffiInstrsLimit)) {
         FFIAdvance();
@@ -346,9 +474,14 @@ VOID FFIBasicBlock(THREADID tid, ADDRINT bblAddr, BblInfo* bblInfo) {
         info("FFI: Exiting fast-forward");
         ExitFastForward();
         futex_unlock(&zinfo->ffLock);
+        ffiWarming = false;
         FFITrackNFFInterval();
 
         SimThreadStart(tid);
+    } else if (unlikely(!ffiWarming && ffiInstrsDone >= ffiWarmStart)) {
+        info("FFI: Starting functional warmup, %ld instrs left in fast-forward", ffiInstrsLimit - ffiInstrsDone);
+        ffiWarming = true;
+        fPtrs[tid] = GetFFPtrs();
     }
 }
 
@@ -358,7 +491,19 @@ VOID FFIEntryBasicBlock(THREADID tid, ADDRINT bblAddr, BblInfo* bblInfo) {
     FFIAdvance();
     assert(ffiNFF);
     ffiNFF = false;
+    FFISetWarmWindow();
     fPtrs[tid] = GetFFPtrs();
+    fPtrs[tid].bblPtr(tid, bblAddr, bblInfo); //warms this BBL if the interval starts warming
+}
+
+// Warming variants of the FF basic block functions; warm before FF bookkeeping, which may exit FF
+VOID FFWarmBasicBlock(THREADID tid, ADDRINT bblAddr, BblInfo* bblInfo) {
+    GetWarmCore(tid)->warmBbl(bblAddr, bblInfo);
+    FFBasicBlock(tid, bblAddr, bblInfo);
+}
+
+VOID FFIWarmBasicBlock(THREADID tid, ADDRINT bblAddr, BblInfo* bblInfo) {
+    GetWarmCore(tid)->warmBbl(bblAddr, bblInfo);
     FFIBasicBlock(tid, bblAddr, bblInfo);
 }
 
@@ -370,8 +515,12 @@ static const InstrFuncPtrs ffPtrs = {NOPLoadStoreSingle, NOPLoadStoreSingle, FFB
 static const InstrFuncPtrs ffiPtrs = {NOPLoadStoreSingle, NOPLoadStoreSingle, FFIBasicBlock, NOPRecordBranch, NOPPredLoadStoreSingle, NOPPredLoadStoreSingle, FPTR_NOP};
 static const InstrFuncPtrs ffiEntryPtrs = {NOPLoadStoreSingle, NOPLoadStoreSingle, FFIEntryBasicBlock, NOPRecordBranch, NOPPredLoadStoreSingle, NOPPredLoadStoreSingle, FPTR_NOP};
 
+static const InstrFuncPtrs ffWarmPtrs = {WarmLoadSingle, WarmStoreSingle, FFWarmBasicBlock, WarmRecordBranch, WarmPredLoadSingle, WarmPredStoreSingle, FPTR_NOP};
+static const InstrFuncPtrs ffiWarmPtrs = {WarmLoadSingle, WarmStoreSingle, FFIWarmBasicBlock, WarmRecordBranch, WarmPredLoadSingle, WarmPredStoreSingle, FPTR_NOP};
+
 static const InstrFuncPtrs& GetFFPtrs() {
-    return ffiEnabled? (ffiNFF? ffiEntryPtrs : ffiPtrs) : ffPtrs;
+    if (ffiEnabled) return ffiNFF? ffiEntryPtrs : (ffiWarming? ffiWarmPtrs : ffiPtrs);
+    return zinfo->ffWarming? ffWarmPtrs : ffPtrs;
 }
 
 //Fast-forwarding
@@ -469,6 +618,11 @@ VOID CheckForTermination() {
  */
 VOID EndOfPhaseActions() {
     zinfo->profSimTime->transition(PROF_WEAVE);
+    if (unlikely(zinfo->numPhases == 0)) {
+        //Includes init and the instrumentation of all code run so far, which is what the decode cache speeds up
+        info("First phase done, %.3f s after start", (zinfo->profSimTime->count(PROF_INIT) + zinfo->profSimTime->count(PROF_BOUND))/1e9);
+    }
+
     if (zinfo->globalPauseFlag) {
         info("Simulation entering global pause");
         zinfo->profSimTime->transition(PROF_FF);
@@ -486,6 +640,13 @@ VOID EndOfPhaseActions() {
         info("Synced fast-forwarding done, resuming simulation");
     }
 
+    // All simulated threads are stopped, so caches and cores are quiescent. Fast-forwarded threads are not,
+    // but they only touch simulated state with sim.ffWarming, which checkpoints are incompatible with (see init.cpp)
+    if (unlikely(zinfo->checkpointPending || zinfo->numPhases + 1 == zinfo->checkpointPhase)) {
+        SaveCheckpoint(zinfo->checkpointFile);
+        zinfo->checkpointPending = false;
+    }
+
     CheckForTermination();
     zinfo->contentionSim->simulatePhase(zinfo->globPhaseCycles + zinfo->phaseLength);
     zinfo->eventQueue->tick();
@@ -497,11 +658,13 @@ uint32_t TakeBarrier(uint32_t tid, uint32_t cid) {
     uint32_t newCid = zinfo->sched->sync(procIdx, tid, cid);
     clearCid(tid); //this is after the sync for a hack needed to make EndOfPhase reliable
     setCid(tid, newCid);
+    if (newCid != cid) fPtrs[tid] = GetCorePtrs(tid); //cores of different types have different analysis functions
 
     if (procTreeNode->isInFastForward()) {
         info("Thread %d entering fast-forward", tid);
         clearCid(tid);
         zinfo->sched->leave(procIdx, tid, newCid);
+        warmCores[tid] = zinfo->cores[newCid];
         SimThreadFini(tid);
         fPtrs[tid] = GetFFPtrs();
     } else if (zinfo->terminationConditionMet) {
@@ -527,7 +690,8 @@ VOID Instruction(INS ins) {
     //Uncomment to print an instruction trace
     //INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)PrintIp, IARG_THREAD_ID, IARG_REG_VALUE, REG_INST_PTR, IARG_END);
 
-    if (!procTreeNode->isInFastForward() || !zinfo->ffReinstrument) {
+    //Replayed processes get their memory accesses and branches from the trace
+    if (!traceReader && (!procTreeNode->isInFastForward() || !zinfo->ffReinstrument)) {
         AFUNPTR LoadFuncPtr = (AFUNPTR) IndirectLoadSingle;
         AFUNPTR StoreFuncPtr = (AFUNPTR) IndirectStoreSingle;
 
@@ -591,8 +755,81 @@ VOID Instruction(INS ins) {
 }
 
 
+/* Trace replay: a process with replayTrace set runs a trivial, single-threaded
+ * host program (e.g., a spin loop) whose own code is not simulated. Instead,
+ * each host basic block replays one traced basic block, plus the memory
+ * accesses and branches that followed it, through fPtrs. Thus joins, barriers
+ * and fast-forwarding work exactly as with execution-driven simulation. When
+ * the trace ends, the process ends as if the traced program had exited.
+ *
+ * Replay still runs under Pin, so it still needs a host program and costs Pin's
+ * startup and per-BBL dispatch. There is no Pin-free replay driver: the
+ * scheduler, barriers, and phase logic live in this file, and the decoder and
+ * sim threads depend on Pin, so feeding cores from a standalone binary would
+ * need those split out first.
+ */
+
+static TraceRecord replayRec; //next record to dispatch
+static bool replayRecValid;
+static volatile uint32_t replayTid = (uint32_t)-1;
+
+static void EndReplay(THREADID tid) {
+    info("Thread %d finished replaying trace %s (%ld records)", tid, procTreeNode->getReplayTrace().c_str(), traceReader->getRecords());
+    if (fPtrs[tid].type == FPTR_ANALYSIS) {
+        uint32_t cid = getCid(tid);
+        clearCid(tid);
+        zinfo->sched->leave(procIdx, tid, cid);
+    }
+    if (fPtrs[tid].type != FPTR_NOP) SimThreadFini(tid); //NOP threads are fast-forwarding and already finished
+    fPtrs[tid] = nopPtrs;
+    SimEnd();
+}
+
+VOID PIN_FAST_ANALYSIS_CALL ReplayBasicBlock(THREADID tid) {
+    if (unlikely(tid != replayTid)) {
+        if (!__sync_bool_compare_and_swap(&replayTid, (uint32_t)-1, tid)) return; //another thread is replaying
+        info("Thread %d replaying trace %s", tid, procTreeNode->getReplayTrace().c_str());
+    }
+
+    // Records before the first BBL are possible, e.g., if the thread joined on a load
+    bool bblDone = false;
+    while (replayRecValid) {
+        TraceRecord& r = replayRec;
+        switch (r.type) {
+            case TR_BBL:
+                if (bblDone) return;
+                bblDone = true;
+                fPtrs[tid].bblPtr(tid, r.addr, r.bblInfo);
+                break;
+            case TR_LOAD:
+                fPtrs[tid].loadPtr(tid, r.addr);
+                break;
+            case TR_STORE:
+                fPtrs[tid].storePtr(tid, r.addr);
+                break;
+            case TR_PRED_LOAD:
+                fPtrs[tid].predLoadPtr(tid, r.addr, r.flag);
+                break;
+            case TR_PRED_STORE:
+                fPtrs[tid].predStorePtr(tid, r.addr, r.flag);
+                break;
+            case TR_BRANCH:
+                fPtrs[tid].branchPtr(tid, r.addr, r.flag, r.takenNpc, r.notTakenNpc);
+                break;
+            default:
+                panic("Unexpected trace record type %d", r.type);
+        }
+        replayRecValid = traceReader->next(replayRec);
+    }
+    EndReplay(tid);
+}
+
 VOID Trace(TRACE trace, VOID *v) {
-    if (!procTreeNode->isInFastForward() || !zinfo->ffReinstrument) {
+    if (traceReader) {
+        for (BBL bbl = TRACE_BblHead(trace); BBL_Valid(bbl); bbl = BBL_Next(bbl)) {
+            BBL_InsertCall(bbl, IPOINT_BEFORE, (AFUNPTR)ReplayBasicBlock, IARG_FAST_ANALYSIS_CALL, IARG_THREAD_ID, IARG_END);
+        }
+    } else if (!procTreeNode->isInFastForward() || !zinfo->ffReinstrument) {
         // Visit every basic block in the trace
         for (BBL bbl = TRACE_BblHead(trace); BBL_Valid(bbl); bbl = BBL_Next(bbl)) {
             BblInfo* bblInfo = Decoder::decodeBbl(bbl, zinfo->oooDecode);
@@ -843,6 +1080,15 @@ void SimThreadStart(THREADID tid) {
     //Initialize this thread's process-local data
     fPtrs[tid] = joinPtrs; //delayed, MT-safe barrier join
     clearCid(tid); //just in case, set an invalid cid
+
+    //Writers outlive fast-forwarding periods, so only threads we have not seen before get a new one
+    if (procTreeNode->getRecordTrace() && !traceWriters[tid]) {
+        static uint32_t traceIdx = 0;
+        std::stringstream ss;
+        ss << zinfo->outputDir << "/trace-p" << procIdx << "-" << __sync_fetch_and_add(&traceIdx, 1) << ".ztrace";
+        traceWriters[tid] = new TraceWriter(ss.str().c_str(), zinfo->oooDecode);
+        info("Thread %d recording trace to %s", tid, ss.str().c_str());
+    }
 }
 
 VOID ThreadStart(THREADID tid, CONTEXT *ctxt, INT32 flags, VOID *v) {
@@ -859,6 +1105,18 @@ VOID ThreadStart(THREADID tid, CONTEXT *ctxt, INT32 flags, VOID *v) {
         info("Unpaused");
     }
 
+    //Like trace writers, profilers span all of the thread's fast-forwarding periods
+    if (procTreeNode->getBBVInterval() && !bbvProfilers[tid]) {
+        static uint32_t bbvIdx = 0;
+        uint32_t idx = __sync_fetch_and_add(&bbvIdx, 1);
+        std::stringstream bbv_ss, sp_ss;
+        bbv_ss << zinfo->outputDir << "/bbv-p" << procIdx << "-" << idx << ".txt";
+        sp_ss << zinfo->outputDir << "/simpoints-p" << procIdx << "-" << idx << ".txt";
+        bbvProfilers[tid] = new BBVProfiler(bbv_ss.str().c_str(), sp_ss.str().c_str(), procTreeNode->getBBVInterval(),
+                procTreeNode->getBBVDims(), procTreeNode->getSimPointsMaxK());
+        info("Thread %d profiling BBVs to %s", tid, bbv_ss.str().c_str());
+    }
+
     if (procTreeNode->isInFastForward()) {
         info("FF thread %d starting", tid);
         fPtrs[tid] = GetFFPtrs();
@@ -880,6 +1138,18 @@ VOID SimThreadFini(THREADID tid) {
 
 VOID ThreadFini(THREADID tid, const CONTEXT *ctxt, INT32 flags, VOID *v) {
     //NOTE: Thread has no valid cid here!
+    if (traceWriters[tid]) {
+        info("Thread %d recorded %ld trace records", tid, traceWriters[tid]->getRecords());
+        delete traceWriters[tid];
+        traceWriters[tid] = NULL;
+    }
+
+    if (bbvProfilers[tid]) {
+        info("Thread %d profiled %ld BBV intervals", tid, bbvProfilers[tid]->getIntervals());
+        delete bbvProfilers[tid];  // finishes the profile and writes simpoints
+        bbvProfilers[tid] = NULL;
+    }
+
     if (fPtrs[tid].type == FPTR_NOP) {
         info("Shadow/NOP thread %d finished", tid);
         return;
@@ -925,7 +1195,7 @@ VOID SyscallExit(THREADID tid, CONTEXT *ctxt, SYSCALL_STANDARD std, VOID *v) {
         if (!zinfo->blockingSyscalls) {
             fPtrs[tid] = joinPtrs;
         } else {
-            fPtrs[tid] = cores[tid]->GetFuncPtrs(); //go back to normal pointers, directly
+            fPtrs[tid] = GetCorePtrs(tid); //go back to normal pointers, directly
         }
     } else if (ppa == PPA_USE_NOP_PTRS) {
         fPtrs[tid] = nopPtrs;
@@ -1066,6 +1336,9 @@ VOID AfterForkInChild(THREADID tid, const CONTEXT* ctxt, VOID * arg) {
         activeThreads[i] = false;
         inSyscall[i] = false;
         cores[i] = NULL;
+        traceWriters[i] = NULL; //the parent owns these (and their buffered records)
+        bbvProfilers[i] = NULL; //ditto
+        warmCores[i] = NULL;
     }
 
     //We need to launch another copy of the FF control thread
@@ -1095,6 +1368,11 @@ VOID SimEnd() {
     //at this point, we're in charge of exiting our whole process, but we still need to race for the stats
 
     //per-process
+    for (uint32_t i = 0; i < MAX_THREADS; i++) {
+        if (traceWriters[i]) traceWriters[i]->close();
+        if (bbvProfilers[i]) bbvProfilers[i]->finish();
+    }
+
 #ifdef BBL_PROFILING
     Decoder::dumpBblProfile();
 #endif
@@ -1117,12 +1395,13 @@ VOID SimEnd() {
         zinfo->statsBackend->dump(false);
         zinfo->eventualStatsBackend->dump(false);
         zinfo->compactStatsBackend->dump(false);
+        if (zinfo->sampledStatsBackend) zinfo->sampledStatsBackend->dump(false);
 
         // Print NVMain internal stats
         info("Has nvmain %d, num memory controllers %d", zinfo->hasNVMain, zinfo->numMemoryControllers);
         if (zinfo->hasNVMain) {
-            for(uint32_t i = 0; i < zinfo->numMemoryControllers; i++) {
-                dynamic_cast<NVMainMemory*>(zinfo->memoryControllers[i])->printStats();
+            for (MemObject* mem : zinfo->nvmainControllers) {
+                dynamic_cast<NVMainMemory*>(mem)->printStats();
             }
         }
 
@@ -1144,6 +1423,7 @@ VOID SimEnd() {
 #define ZSIM_MAGIC_OP_ROI_END           (1026)
 #define ZSIM_MAGIC_OP_REGISTER_THREAD   (1027)
 #define ZSIM_MAGIC_OP_HEARTBEAT         (1028)
+#define ZSIM_MAGIC_OP_CHECKPOINT        (1034)
 
 VOID HandleMagicOp(THREADID tid, ADDRINT op) {
     switch (op) {
@@ -1178,6 +1458,7 @@ VOID HandleMagicOp(THREADID tid, ADDRINT op) {
                         assert(cid != INVALID_CID);
                         clearCid(tid);
                         zinfo->sched->leave(procIdx, tid, cid);
+                        warmCores[tid] = zinfo->cores[cid];
                         SimThreadFini(tid);
                         fPtrs[tid] = GetFFPtrs();
                     }
@@ -1201,6 +1482,12 @@ VOID HandleMagicOp(THREADID tid, ADDRINT op) {
         case ZSIM_MAGIC_OP_HEARTBEAT:
             procTreeNode->heartbeat(); //heartbeats are per process for now
             return;
+        case ZSIM_MAGIC_OP_CHECKPOINT:
+            //Saved at the end of the current phase (if all threads are fast-forwarding, of the next simulated one)
+            info("Thread %d requested a checkpoint", tid);
+            if (zinfo->ffWarming) panic("Thread %d: checkpoint magic op is incompatible with sim.ffWarming", tid);
+            zinfo->checkpointPending = true;
+            return;
 
         // HACK: Ubik magic ops
         case 1029:
@@ -1534,9 +1821,17 @@ int main(int argc, char *argv[]) {
 
     zinfo->sched->processCleanup(procIdx);
 
+    if (zinfo->decodeCache) zinfo->decodeCache->attach();
+
     VirtCaptureClocks(false);
     FFIInit();
 
+    if (!procTreeNode->getReplayTrace().empty()) {
+        traceReader = new TraceReader(procTreeNode->getReplayTrace().c_str(), zinfo->oooDecode);
+        replayRecValid = traceReader->next(replayRec);
+        info("Replaying trace %s", procTreeNode->getReplayTrace().c_str());
+    }
+
     VirtInit();
 
     //Register instrumentation
@@ -39,13 +39,17 @@ class Core;
 class Scheduler;
 class AggregateStat;
 class StatsBackend;
+class SampledStatsBackend;
 class ProcessTreeNode;
 class ProcessStats;
 class EventQueue;
 class ContentionSim;
 class EventRecorder;
 class PinCmd;
+class DecodeCache;
+class SharedDecodeTable;
 class PortVirtualizer;
+class PageAllocator;
 class VectorCounter;
 
 struct ClockDomainInfo {
@@ -106,7 +110,10 @@ struct GlobSimInfo {
     bool blockingSyscalls;
     bool perProcessCpuEnum; //if true, cpus are enumerated according to per-process masks (e.g., a 16-core mask in a 64-core sim sees 16 cores)
     bool oooDecode; //if true, Decoder does OOO (instr->uop) decoding
+    DecodeCache* decodeCache; //persistent cache of OOO-decoded BBLs, NULL if disabled
+    SharedDecodeTable* decodeTable; //BBLs decoded by any process, NULL if disabled
     bool addressRandomization; //if true, randomize address bits for multiprocesses runs
+    PageAllocator* pageAllocator; //maps virtual to physical pages, NULL if disabled (physical addresses are then virtual ones tagged with procMask)
 
     PAD();
 
@@ -137,6 +144,7 @@ struct GlobSimInfo {
     StatsBackend* statsBackend; //end-of-sim backend
     StatsBackend* eventualStatsBackend;
     StatsBackend* compactStatsBackend;
+    SampledStatsBackend* sampledStatsBackend; //NULL unless a process runs sampled simulation
     ProcessStats* processStats;
 
     TimeBreakdownStat* profSimTime;
@@ -167,6 +175,13 @@ struct GlobSimInfo {
     struct LibInfo libzsimAddrs;
 
     bool ffReinstrument; //true if we should reinstrument on ffwd, works fine with ST apps and it's faster since we run with basically no instrumentation, but it's not precise with MT apps
+    bool ffWarming; //true if fast-forwarded threads functionally warm caches and predictors (see MemReq::WARM)
+
+    //Checkpoints (see checkpoint.h)
+    const char* checkpointFile; //where checkpoints are saved
+    uint64_t checkpointPhase; //if non-zero, save a checkpoint at the end of this phase
+    volatile bool checkpointPending; //set by the checkpoint magic op, saved at the end of the phase
+    g_vector<BaseCache*> caches; //all caches and prefetchers, in init order
 
     //fftoggle stuff
     lock_t ffToggleLocks[256]; //f*ing Pin and its f*ing inability to handle external signals...
@@ -179,6 +194,7 @@ struct GlobSimInfo {
     bool hasDRAMCache;
     uint32_t numMemoryControllers;
     g_vector<MemObject*> memoryControllers;
+    g_vector<MemObject*> nvmainControllers;  // includes those nested in other memory objects (e.g., DRAM caches)
 };
 
 